@@ -0,0 +1,85 @@
+#version 330
+
+in vec2 texCoord;
+
+out vec4 fragColor;
+
+uniform bool stencilDebugRender;
+
+uniform sampler2D gPosition;
+uniform sampler2D gNormal;
+uniform sampler2D gSpecular;
+uniform sampler2D gDiffuse;
+
+// Shared with all programs, see UniformBuffer.h
+layout (std140) uniform FrameUniforms {
+	mat4 viewMatrix;
+	mat4 projMatrix;
+	mat4 invProj;
+	vec2 screenSize;
+	float near;
+	float far;
+};
+
+// The lights of this pass, see LightBatches.h. View space position and
+// radius, then color and strength, for each light
+const int LIGHT_BATCH_MAX_SIZE = 64;
+layout (std140) uniform LightBatch {
+	int batchLightCount;
+	vec4 batchLights[2 * LIGHT_BATCH_MAX_SIZE];
+};
+
+void main()
+{
+	vec3 vsPosition = texture(gPosition, texCoord).rgb;
+	// Nothing was drawn where the cleared position is behind the camera
+	if (vsPosition.z >= 0.0) {
+		discard;
+	}
+	vec3 vsNormal = texture(gNormal, texCoord).rgb;
+	vec3 diffuse = texture(gDiffuse, texCoord).rgb;
+	vec3 specular = texture(gSpecular, texCoord).rgb;
+	vec3 vsViewDir = normalize(-vsPosition);
+
+	vec3 color = vec3(0.0);
+	int reached = 0;
+	for (int i = 0; i < batchLightCount; i++) {
+		vec4 positionRadius = batchLights[2 * i];
+		vec3 lightDiff = positionRadius.xyz - vsPosition;
+		float lightDistSquared = dot(lightDiff, lightDiff);
+		// Skip the shading for lights that do not reach the pixel
+		if (lightDistSquared >= positionRadius.w * positionRadius.w) {
+			continue;
+		}
+		reached++;
+		vec4 colorStrength = batchLights[2 * i + 1];
+		float lightDist = sqrt(lightDistSquared);
+		vec3 vsLightDir = lightDiff / lightDist;
+
+		float diffuseFactor = max(dot(vsLightDir, vsNormal), 0.0);
+
+		vec3 h = normalize(vsLightDir + vsViewDir);
+		float reflFactor = max(dot(h, vsNormal), 0.0);
+		float shininess = 110;
+		float specFactor = pow(reflFactor, shininess);
+
+		float lightDistFactor = colorStrength.a * lightDist + 1;
+
+		color += lightDistFactor * (
+			diffuse * colorStrength.rgb * diffuseFactor +
+			specFactor * specular * colorStrength.rgb
+		);
+	}
+	// Nothing is blended for pixels no light of the batch reaches
+	if (reached == 0) {
+		discard;
+	}
+
+	if (stencilDebugRender) {
+		// Number of lights reaching the pixel, from blue to red, scaled down
+		// since overlapping batches add up
+		float load = float(reached) / 16.0;
+		color = mix(vec3(0.0, 0.0, 0.3), vec3(1.0, 0.2, 0.0), min(load, 1.0)) / 4.0;
+	}
+	fragColor = vec4(color, 1.0);
+}
@@ -0,0 +1,86 @@
+#version 330
+
+in vec2 texCoord;
+
+out vec4 fragColor;
+
+uniform bool stencilDebugRender;
+
+uniform sampler2D gPosition;
+uniform sampler2D gNormal;
+uniform sampler2D gSpecular;
+uniform sampler2D gDiffuse;
+
+// View space lights, two texels each: position and strength, color and radius
+uniform samplerBuffer lightData;
+// Offset and count of the light indices of each cluster
+uniform usamplerBuffer clusterRanges;
+uniform usamplerBuffer clusterLights;
+
+// Shared with all programs, see UniformBuffer.h
+layout (std140) uniform FrameUniforms {
+	mat4 viewMatrix;
+	mat4 projMatrix;
+	mat4 invProj;
+	vec2 screenSize;
+	float near;
+	float far;
+};
+
+// Cluster grid, see LightClusters.h
+const int CLUSTER_COUNT_X = 16;
+const int CLUSTER_COUNT_Y = 9;
+const int CLUSTER_COUNT_Z = 24;
+
+void main()
+{
+	vec3 vsPosition = texture(gPosition, texCoord).rgb;
+	// Nothing was drawn where the cleared position is behind the camera
+	if (vsPosition.z >= 0.0) {
+		fragColor = vec4(0.0);
+		return;
+	}
+	vec3 vsNormal = texture(gNormal, texCoord).rgb;
+	vec3 diffuse = texture(gDiffuse, texCoord).rgb;
+	vec3 specular = texture(gSpecular, texCoord).rgb;
+	vec3 vsViewDir = normalize(-vsPosition);
+
+	ivec2 tile = min(ivec2(texCoord * vec2(CLUSTER_COUNT_X, CLUSTER_COUNT_Y)), ivec2(CLUSTER_COUNT_X - 1, CLUSTER_COUNT_Y - 1));
+	int slice = int(floor(log(-vsPosition.z / near) / log(far / near) * CLUSTER_COUNT_Z));
+	slice = clamp(slice, 0, CLUSTER_COUNT_Z - 1);
+	int cluster = tile.x + CLUSTER_COUNT_X * (tile.y + CLUSTER_COUNT_Y * slice);
+	uvec2 range = texelFetch(clusterRanges, cluster).xy;
+
+	vec3 color = vec3(0.0);
+	for (uint i = 0u; i < range.y; i++) {
+		int light = int(texelFetch(clusterLights, int(range.x + i)).r);
+		vec4 positionStrength = texelFetch(lightData, 2 * light);
+		vec3 lightColor = texelFetch(lightData, 2 * light + 1).rgb;
+
+		vec3 lightDiff = positionStrength.xyz - vsPosition;
+		float lightDist = length(lightDiff);
+		vec3 vsLightDir = lightDiff / lightDist;
+
+		float diffuseFactor = max(dot(vsLightDir, vsNormal), 0.0);
+
+		vec3 h = normalize(vsLightDir + vsViewDir);
+		float reflFactor = max(dot(h, vsNormal), 0.0);
+		float shininess = 110;
+		float specFactor = pow(reflFactor, shininess);
+
+		// Clusters are larger than the lights, so the attenuation is clamped at the radius
+		float lightDistFactor = max(positionStrength.w * lightDist + 1, 0.0);
+
+		color += lightDistFactor * (
+			diffuse * lightColor * diffuseFactor +
+			specFactor * specular * lightColor
+		);
+	}
+
+	if (stencilDebugRender) {
+		// Number of lights in the cluster, from blue to red
+		float load = float(range.y) / 16.0;
+		color = mix(vec3(0.0, 0.0, 0.3), vec3(1.0, 0.2, 0.0), min(load, 1.0));
+	}
+	fragColor = vec4(color, 1.0);
+}
@@ -3,28 +3,30 @@
 in vec3 vsPosition;
 in vec3 viewSpaceNormal;
 in vec2 texCoord;
+// Material of the draw, see forward_shader.vert
+flat in vec4 materialColor;
+flat in vec3 materialLayers;
+flat in float materialSpecular;
 
 out vec4 fragColor;
 
-uniform sampler2D textureDiffuse;
-uniform sampler2D textureSpecular;
-uniform vec4 colorDiffuse;
+uniform sampler2DArray textureDiffuse;
+uniform sampler2DArray textureSpecular;
 uniform bool hasDiffuseTexture;
 uniform bool hasSpecularTexture;
-uniform float specular;
 
 void main()
 {
 	vec3 vsNormal = normalize(viewSpaceNormal);
-	vec4 matDiffuse = colorDiffuse;
+	vec4 matDiffuse = materialColor;
 
-	vec3 matSpecular = vec3(specular);
+	vec3 matSpecular = vec3(materialSpecular);
 	if (matDiffuse.a < 0.15) {
 		discard;
 	}
 	vec3 diffuse = matDiffuse.xyz;
 	if (hasDiffuseTexture) {
-		vec4 diffuseTexCol = texture(textureDiffuse, texCoord);
+		vec4 diffuseTexCol = texture(textureDiffuse, vec3(texCoord, materialLayers.x));
 		if (diffuseTexCol.a < 0.6) {
 			discard;
 		}
@@ -33,7 +35,7 @@ void main()
 	}
 
 	if (hasSpecularTexture) {
-		vec4 specTexCol = texture(textureSpecular, texCoord);
+		vec4 specTexCol = texture(textureSpecular, vec3(texCoord, materialLayers.y));
 		matSpecular = specTexCol.xyz;
 	}
 
@@ -11,19 +11,28 @@ in vec3 viewSpaceNormal;
 in vec3 viewSpaceTangent;
 in vec3 viewSpaceBitangent;
 in vec2 texCoord;
+// Material of the draw, see gbufferfill.vert
+flat in vec4 materialColor;
+flat in vec3 materialLayers;
+flat in float materialSpecular;
+flat in float materialReflectiveness;
 
-uniform sampler2D textureDiffuse;
-uniform sampler2D textureSpecular;
-uniform sampler2D textureNormal;
-uniform vec4 colorDiffuse;
+uniform sampler2DArray textureDiffuse;
+uniform sampler2DArray textureSpecular;
+uniform sampler2DArray textureNormal;
 uniform bool hasDiffuseTexture;
 uniform bool hasSpecularTexture;
 uniform bool hasNormalTexture;
-uniform float specular;
-uniform float reflectiveness;
-uniform float texRepeatFactor;
-uniform float near;
-uniform float far;
+
+// Shared with all programs, see UniformBuffer.h
+layout (std140) uniform FrameUniforms {
+	mat4 viewMatrix;
+	mat4 projMatrix;
+	mat4 invProj;
+	vec2 screenSize;
+	float near;
+	float far;
+};
 
 float linearizeDepth(float depth)
 {
@@ -33,17 +42,16 @@ float linearizeDepth(float depth)
 
 void main()
 {
-	vec2 texCoordS = texRepeatFactor * texCoord;
 	vec3 vsNormal = normalize(viewSpaceNormal);
-	vec4 matDiffuse = colorDiffuse;
+	vec4 matDiffuse = materialColor;
 
-	vec3 matSpecular = vec3(specular);
+	vec3 matSpecular = vec3(materialSpecular);
 	if (matDiffuse.a < 0.15) {
 		discard;
 	}
 	vec3 diffuse = matDiffuse.xyz;
 	if (hasDiffuseTexture) {
-		vec4 diffuseTexCol = texture(textureDiffuse, texCoordS);
+		vec4 diffuseTexCol = texture(textureDiffuse, vec3(texCoord, materialLayers.x));
 		if (diffuseTexCol.a < 0.6) {
 			discard;
 		}
@@ -52,7 +60,7 @@ void main()
 	}
 
 	if (hasSpecularTexture) {
-		vec4 specTexCol = texture(textureSpecular, texCoordS);
+		vec4 specTexCol = texture(textureSpecular, vec3(texCoord, materialLayers.y));
 		matSpecular = specTexCol.xyz;
 	}
 
@@ -61,8 +69,10 @@ void main()
 	gDiffuse.rgb = diffuse;
 
 	if (hasNormalTexture) {
-		vec3 texTSNormal = texture(textureNormal, texCoordS).rgb;
-		texTSNormal = normalize(texTSNormal * 2.0 - 1.0);
+		// Only xy is read, as BC5-compressed normal maps have no blue channel
+		vec3 texTSNormal;
+		texTSNormal.xy = texture(textureNormal, vec3(texCoord, materialLayers.z)).rg * 2.0 - 1.0;
+		texTSNormal.z = sqrt(max(1.0 - dot(texTSNormal.xy, texTSNormal.xy), 0.0));
 
 		gNormalMappedNormal.xyz = normalize(
 			texTSNormal.x * normalize(viewSpaceTangent) +
@@ -74,5 +84,5 @@ void main()
 	}
 
 	gSpecular.rgb = matSpecular;
-	gSpecular.a = reflectiveness;
+	gSpecular.a = materialReflectiveness;
 }
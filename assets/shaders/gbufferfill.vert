@@ -1,30 +1,137 @@
 #version 330
 
-layout (location = 0) in vec4 position;
-layout (location = 1) in vec3 normalIn;
-layout (location = 2) in vec3 tangentIn;
-layout (location = 3) in vec3 bitangentIn;
+layout (location = 0) in vec4 positionIn;
+layout (location = 1) in vec3 normalPacked;
+layout (location = 2) in vec3 tangentPacked;
+layout (location = 3) in vec3 bitangentPacked;
 layout (location = 4) in vec2 texCoordIn;
 
+// Per-instance data, used instead of the uniforms below when instanced is
+// set, see InstanceData in Mesh.h
+layout (location = 5) in mat4 instanceModelMatrix;
+layout (location = 9) in mat3 instanceNormalMatrix;
+layout (location = 12) in vec4 instanceColor;
+
+uniform bool instanced;
 uniform mat4 modelMatrix;
-uniform mat4 viewMatrix;
-uniform mat4 projMatrix;
+uniform mat3 normalMatrix;
+uniform vec4 colorDiffuse;
+// Layers of the diffuse, specular and normal textures within their arrays
+uniform vec3 textureLayers;
+uniform float specular;
+uniform float reflectiveness;
+uniform float texRepeatFactor;
+
+// Indirect draws fetch the instance and material records of every instance
+// from buffer textures instead, see RenderQueue.h
+layout (location = 13) in uvec2 drawIndices;
+
+uniform bool indirect;
+uniform samplerBuffer instanceRecords;
+uniform samplerBuffer materialRecords;
+
+// Shared with all programs, see UniformBuffer.h
+layout (std140) uniform FrameUniforms {
+	mat4 viewMatrix;
+	mat4 projMatrix;
+	mat4 invProj;
+	vec2 screenSize;
+	float near;
+	float far;
+};
+
+// Compact vertex format from VertexPacking.h. The position is normalized to
+// the mesh bounds, with the bitangent sign in w, and the normal and tangent
+// are octahedral encoded in xy.
+uniform bool packedVertexFormat;
+uniform vec3 positionOffset;
+uniform vec3 positionScale;
 
 out vec3 viewSpaceNormal;
 out vec3 viewSpaceTangent;
 out vec3 viewSpaceBitangent;
 out vec2 texCoord;
 out vec3 vsPosition;
+flat out vec4 materialColor;
+flat out vec3 materialLayers;
+flat out float materialSpecular;
+flat out float materialReflectiveness;
+
+vec3 octahedralDecode(vec2 e)
+{
+	vec3 v = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	if (v.z < 0.0) {
+		v.xy = (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+	}
+	return normalize(v);
+}
+
+mat4 fetchModelMatrix(int record)
+{
+	return mat4(
+		texelFetch(instanceRecords, record),
+		texelFetch(instanceRecords, record + 1),
+		texelFetch(instanceRecords, record + 2),
+		texelFetch(instanceRecords, record + 3));
+}
+
+mat3 fetchNormalMatrix(int record)
+{
+	return mat3(
+		texelFetch(instanceRecords, record + 4).xyz,
+		texelFetch(instanceRecords, record + 5).xyz,
+		texelFetch(instanceRecords, record + 6).xyz);
+}
 
 void main()
 {
-	mat4 modelViewMatrix = viewMatrix * modelMatrix;
-	mat4 modelViewProjectionMatrix = projMatrix * modelViewMatrix;
-	mat4 normalMatrix = inverse(transpose(modelViewMatrix));
-	viewSpaceNormal = vec3(normalize((normalMatrix * vec4(normalIn,0.0)).xyz));
-	viewSpaceTangent = vec3(normalize((normalMatrix * vec4(tangentIn,0.0)).xyz));
-	viewSpaceBitangent = vec3(normalize((normalMatrix * vec4(bitangentIn,0.0)).xyz));
-	vsPosition = (viewMatrix * modelMatrix * position).xyz;
-	texCoord = texCoordIn;
-	gl_Position = projMatrix * viewMatrix * modelMatrix * position;
+	mat4 model = instanced ? instanceModelMatrix : modelMatrix;
+	mat3 normalModel = instanced ? instanceNormalMatrix : normalMatrix;
+	materialColor = instanced ? colorDiffuse * instanceColor : colorDiffuse;
+	materialLayers = textureLayers;
+	materialSpecular = specular;
+	materialReflectiveness = reflectiveness;
+	float texRepeat = texRepeatFactor;
+	vec3 offset = positionOffset;
+	vec3 scale = positionScale;
+	if (indirect) {
+		// Records of InstanceData and MaterialRecord in Mesh.h, in vec4 texels
+		int instance = int(drawIndices.x) * 8;
+		int material = int(drawIndices.y) * 4;
+		model = fetchModelMatrix(instance);
+		normalModel = fetchNormalMatrix(instance);
+		materialColor = texelFetch(materialRecords, material) * texelFetch(instanceRecords, instance + 7);
+		vec4 layersRepeat = texelFetch(materialRecords, material + 1);
+		vec4 offsetSpecular = texelFetch(materialRecords, material + 2);
+		vec4 scaleReflectiveness = texelFetch(materialRecords, material + 3);
+		materialLayers = layersRepeat.xyz;
+		texRepeat = layersRepeat.w;
+		offset = offsetSpecular.xyz;
+		materialSpecular = offsetSpecular.w;
+		scale = scaleReflectiveness.xyz;
+		materialReflectiveness = scaleReflectiveness.w;
+	}
+
+	vec4 position = positionIn;
+	vec3 normalIn = normalPacked;
+	vec3 tangentIn = tangentPacked;
+	vec3 bitangentIn = bitangentPacked;
+	if (packedVertexFormat) {
+		position = vec4(positionIn.xyz * scale + offset, 1.0);
+		normalIn = octahedralDecode(normalPacked.xy);
+		tangentIn = octahedralDecode(tangentPacked.xy);
+		bitangentIn = cross(normalIn, tangentIn) * (positionIn.w > 0.5 ? 1.0 : -1.0);
+	}
+
+	mat4 modelViewMatrix = viewMatrix * model;
+
+	// The view matrix is a rigid transform, so its upper 3x3 transforms
+	// normals as is
+	mat3 viewNormalMatrix = mat3(viewMatrix) * normalModel;
+	viewSpaceNormal = normalize(viewNormalMatrix * normalIn);
+	viewSpaceTangent = normalize(viewNormalMatrix * tangentIn);
+	viewSpaceBitangent = normalize(viewNormalMatrix * bitangentIn);
+	vsPosition = (modelViewMatrix * position).xyz;
+	texCoord = texRepeat * texCoordIn;
+	gl_Position = projMatrix * modelViewMatrix * position;
 }
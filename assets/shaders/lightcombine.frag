@@ -13,11 +13,15 @@ uniform sampler2D lastFrame;
 uniform sampler2D ssrTexture;
 uniform sampler2D lightTex;
 
-uniform float screenWidth;
-uniform float screenHeight;
-
-uniform float near;
-uniform float far;
+// Shared with all programs, see UniformBuffer.h
+layout (std140) uniform FrameUniforms {
+	mat4 viewMatrix;
+	mat4 projMatrix;
+	mat4 invProj;
+	vec2 screenSize;
+	float near;
+	float far;
+};
 
 uniform bool showDebugBar;
 uniform bool ssao;
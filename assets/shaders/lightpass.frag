@@ -1,7 +1,5 @@
 #version 330
 
-in vec2 texCoord;
-
 out vec4 fragColor;
 
 uniform bool stencilDebugRender;
@@ -11,16 +9,32 @@ uniform sampler2D gNormal;
 uniform sampler2D gSpecular;
 uniform sampler2D gDiffuse;
 
-uniform float near;
-uniform float far;
+// Shared with all programs, see UniformBuffer.h
+layout (std140) uniform FrameUniforms {
+	mat4 viewMatrix;
+	mat4 projMatrix;
+	mat4 invProj;
+	vec2 screenSize;
+	float near;
+	float far;
+};
 
-uniform vec3 lightPos;
-uniform vec3 lightColor;
-uniform float lightStrength;
+// Parameters of the light of the instance, see lightvolume.vert and
+// lightquad.vert
+flat in vec3 lightPos;
+flat in vec3 lightColor;
+flat in float lightStrength;
+// View space depths the light reaches
+flat in vec2 depthRange;
 
 void main()
 {
+	// The G-buffer has the size of the screen
+	vec2 texCoord = gl_FragCoord.xy / screenSize;
 	vec3 vsPosition = texture(gPosition, texCoord).rgb;
+	if (vsPosition.z < depthRange.x || vsPosition.z > depthRange.y) {
+		discard;
+	}
 	vec3 vsNormal = texture(gNormal, texCoord).rgb;
 	vec3 diffuse = texture(gDiffuse, texCoord).rgb;
 	vec3 specular = texture(gSpecular, texCoord).rgb;
@@ -38,8 +52,9 @@ void main()
 	float shininess = 110;
 	float specFactor = pow(reflFactor, shininess);
 
-	float lightIntensity = lightStrength;
-	float lightDistFactor = lightIntensity * lightDist + 1;
+	// Geometry in front of the volume also passes the depth test, so the
+	// attenuation is clamped at the radius
+	float lightDistFactor = max(lightStrength * lightDist + 1, 0.0);
 
 	vec3 color = lightDistFactor * (
 		diffuse * lightColor * diffuseFactor +
@@ -0,0 +1,26 @@
+#version 330
+
+// Per instance, see LightQuads.h: screen rectangle in normalized device
+// coordinates, view space position and radius, color and attenuation, and
+// view space depth range
+layout (location = 0) in vec4 rect;
+layout (location = 1) in vec4 lightPositionRadius;
+layout (location = 2) in vec4 lightColorStrength;
+layout (location = 3) in vec2 lightDepthRange;
+
+flat out vec3 lightPos;
+flat out vec3 lightColor;
+flat out float lightStrength;
+flat out vec2 depthRange;
+
+void main()
+{
+	lightPos = lightPositionRadius.xyz;
+	lightColor = lightColorStrength.rgb;
+	lightStrength = lightColorStrength.a;
+	depthRange = lightDepthRange;
+
+	// Triangle strip corners from the vertex id
+	vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+	gl_Position = vec4(mix(rect.xy, rect.zw, corner), 0.0, 1.0);
+}
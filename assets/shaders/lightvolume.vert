@@ -0,0 +1,33 @@
+#version 330
+
+// Unit icosphere, see LightVolumes.h
+layout (location = 0) in vec3 positionIn;
+// Per instance: world space position and radius, color and attenuation
+layout (location = 1) in vec4 lightPositionRadius;
+layout (location = 2) in vec4 lightColorStrength;
+
+flat out vec3 lightPos;
+flat out vec3 lightColor;
+flat out float lightStrength;
+flat out vec2 depthRange;
+
+// Shared with all programs, see UniformBuffer.h
+layout (std140) uniform FrameUniforms {
+	mat4 viewMatrix;
+	mat4 projMatrix;
+	mat4 invProj;
+	vec2 screenSize;
+	float near;
+	float far;
+};
+
+void main()
+{
+	lightPos = (viewMatrix * vec4(lightPositionRadius.xyz, 1.0)).xyz;
+	lightColor = lightColorStrength.rgb;
+	lightStrength = lightColorStrength.a;
+	depthRange = lightPos.z + vec2(-lightPositionRadius.w, lightPositionRadius.w);
+
+	vec3 vsPosition = lightPos + mat3(viewMatrix) * positionIn * lightPositionRadius.w;
+	gl_Position = projMatrix * vec4(vsPosition, 1.0);
+}
@@ -1,17 +1,36 @@
 #version 330
 
-layout (location = 0) in vec4 position;
+layout (location = 0) in vec4 positionIn;
 layout (location = 2) in vec2 texCoordIn;
 
 out vec2 texCoord;
 out vec3 vsPosition;
 
 uniform mat4 modelMatrix;
-uniform mat4 viewMatrix;
-uniform mat4 projMatrix;
+
+// Shared with all programs, see UniformBuffer.h
+layout (std140) uniform FrameUniforms {
+	mat4 viewMatrix;
+	mat4 projMatrix;
+	mat4 invProj;
+	vec2 screenSize;
+	float near;
+	float far;
+};
+
+// Compact vertex format from VertexPacking.h, with positions normalized to
+// the mesh bounds
+uniform bool packedVertexFormat;
+uniform vec3 positionOffset;
+uniform vec3 positionScale;
 
 void main()
 {
+	vec4 position = positionIn;
+	if (packedVertexFormat) {
+		position = vec4(positionIn.xyz * positionScale + positionOffset, 1.0);
+	}
+
 	mat4 modelViewMatrix = viewMatrix * modelMatrix;
 	mat4 modelViewProjectionMatrix = projMatrix * modelViewMatrix;
 	vsPosition = (viewMatrix * modelMatrix * position).xyz;
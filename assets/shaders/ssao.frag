@@ -8,17 +8,24 @@ uniform sampler2D gPosition;
 uniform sampler2D gNormal;
 uniform sampler2D texNoise;
 
-uniform mat4 invProj;
 uniform int width;
 uniform int height;
 
-const int kernelSize = 32;
-uniform vec3 samples[kernelSize];
+// Shared with all programs, see UniformBuffer.h
+layout (std140) uniform FrameUniforms {
+	mat4 viewMatrix;
+	mat4 projMatrix;
+	mat4 invProj;
+	vec2 screenSize;
+	float near;
+	float far;
+};
 
-uniform mat4 projMatrix;
+layout (std140) uniform StaticUniforms {
+	vec4 ssaoKernel[64];
+};
 
-uniform float near;
-uniform float far;
+const int kernelSize = 32;
 
 void main()
 {
@@ -35,7 +42,7 @@ void main()
 
 	float occlusion = 0.0;
 	for (int i = 0; i < kernelSize; i++) {
-		vec3 sample = tbn * samples[i];
+		vec3 sample = tbn * ssaoKernel[i].xyz;
 		sample = sample * radius + vsPos;
 
 		vec4 offset = vec4(sample, 1.0);
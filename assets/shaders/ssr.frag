@@ -9,8 +9,15 @@ uniform sampler2D gSpecular;
 uniform sampler2D gNormal;
 uniform sampler2D lastFrame;
 
-uniform mat4 viewMatrix;
-uniform mat4 projMatrix;
+// Shared with all programs, see UniformBuffer.h
+layout (std140) uniform FrameUniforms {
+	mat4 viewMatrix;
+	mat4 projMatrix;
+	mat4 invProj;
+	vec2 screenSize;
+	float near;
+	float far;
+};
 
 const float reflectionEdgeSmoothing = 3;
 
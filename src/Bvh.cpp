@@ -0,0 +1,450 @@
+//===----------------------------------------------------------------------===//
+//
+// This file is part of the Noxoscope project
+//
+// Copyright (c) 2016 Niklas Helmertz
+//
+//===----------------------------------------------------------------------===//
+
+#include "Bvh.h"
+
+#include <cmath>
+#include <limits>
+#include <utility>
+#include <algorithm>
+
+#include <glm/glm.hpp>
+
+static float surfaceArea(glm::vec3 boxMin, glm::vec3 boxMax) {
+	glm::vec3 size = boxMax - boxMin;
+	return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+namespace {
+enum class Containment {
+	Outside,
+	Intersecting,
+	Inside
+};
+}
+
+static Containment classifyBox(const Frustum& frustum, glm::vec3 boxMin, glm::vec3 boxMax) {
+	glm::vec3 center = (boxMin + boxMax) * 0.5f;
+	glm::vec3 extent = (boxMax - boxMin) * 0.5f;
+	auto result = Containment::Inside;
+	for (auto& plane : frustum.planes) {
+		float distance = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w;
+		float reach = std::abs(plane.x) * extent.x + std::abs(plane.y) * extent.y + std::abs(plane.z) * extent.z;
+		if (distance + reach < 0.0f) {
+			return Containment::Outside;
+		}
+		if (distance - reach < 0.0f) {
+			result = Containment::Intersecting;
+		}
+	}
+	return result;
+}
+
+static bool boxOverlapsSphere(glm::vec3 boxMin, glm::vec3 boxMax, glm::vec3 center, float radius) {
+	glm::vec3 offset = center - glm::clamp(center, boxMin, boxMax);
+	return glm::dot(offset, offset) <= radius * radius;
+}
+
+// Distance along the ray to where it enters the box, or infinity if it misses
+static float rayEntry(glm::vec3 origin, glm::vec3 inverseDirection, glm::vec3 boxMin, glm::vec3 boxMax) {
+	glm::vec3 t0 = (boxMin - origin) * inverseDirection;
+	glm::vec3 t1 = (boxMax - origin) * inverseDirection;
+	glm::vec3 near = glm::min(t0, t1);
+	glm::vec3 far = glm::max(t0, t1);
+	float entry = std::max({near.x, near.y, near.z, 0.0f});
+	float exit = std::min({far.x, far.y, far.z});
+	return entry <= exit ? entry : std::numeric_limits<float>::infinity();
+}
+
+int32_t Bvh::allocateNode() {
+	if (freeList == BVH_NULL) {
+		nodes.emplace_back();
+		return static_cast<int32_t>(nodes.size() - 1);
+	}
+	int32_t index = freeList;
+	freeList = nodes[index].parent;
+	return index;
+}
+
+void Bvh::freeNode(int32_t index) {
+	nodes[index].parent = freeList;
+	freeList = index;
+}
+
+BvhProxy Bvh::insert(uint32_t object, glm::vec3 boxMin, glm::vec3 boxMax) {
+	int32_t leaf = allocateNode();
+	auto& node = nodes[leaf];
+	node.boxMin = boxMin;
+	node.boxMax = boxMax;
+	node.left = BVH_NULL;
+	node.right = BVH_NULL;
+	node.object = object;
+	insertLeaf(leaf);
+	objectCount++;
+	return leaf;
+}
+
+void Bvh::remove(BvhProxy proxy) {
+	removeLeaf(proxy);
+	freeNode(proxy);
+	objectCount--;
+}
+
+void Bvh::update(BvhProxy proxy, glm::vec3 boxMin, glm::vec3 boxMax) {
+	nodes[proxy].boxMin = boxMin;
+	nodes[proxy].boxMax = boxMax;
+	refit(nodes[proxy].parent);
+}
+
+void Bvh::clear() {
+	nodes.clear();
+	root = BVH_NULL;
+	freeList = BVH_NULL;
+	objectCount = 0;
+}
+
+void Bvh::insertLeaf(int32_t leaf) {
+	using namespace glm;
+	if (root == BVH_NULL) {
+		root = leaf;
+		nodes[leaf].parent = BVH_NULL;
+		return;
+	}
+
+	// Descend while a child is a cheaper sibling than the current node,
+	// counting the growth of the ancestors as inherited cost
+	vec3 boxMin = nodes[leaf].boxMin;
+	vec3 boxMax = nodes[leaf].boxMax;
+	int32_t index = root;
+	while (!nodes[index].isLeaf()) {
+		auto& node = nodes[index];
+		float area = surfaceArea(node.boxMin, node.boxMax);
+		float combinedArea = surfaceArea(min(node.boxMin, boxMin), max(node.boxMax, boxMax));
+		float cost = 2.0f * combinedArea;
+		float inheritedCost = 2.0f * (combinedArea - area);
+
+		auto childCost = [&](int32_t child) {
+			auto& c = nodes[child];
+			float grown = surfaceArea(min(c.boxMin, boxMin), max(c.boxMax, boxMax));
+			return (c.isLeaf() ? grown : grown - surfaceArea(c.boxMin, c.boxMax)) + inheritedCost;
+		};
+		float leftCost = childCost(node.left);
+		float rightCost = childCost(node.right);
+		if (cost < leftCost && cost < rightCost) {
+			break;
+		}
+		index = leftCost < rightCost ? node.left : node.right;
+	}
+
+	int32_t sibling = index;
+	int32_t oldParent = nodes[sibling].parent;
+	int32_t newParent = allocateNode();
+	auto& parent = nodes[newParent];
+	parent.parent = oldParent;
+	parent.left = sibling;
+	parent.right = leaf;
+	nodes[sibling].parent = newParent;
+	nodes[leaf].parent = newParent;
+	if (oldParent == BVH_NULL) {
+		root = newParent;
+	} else if (nodes[oldParent].left == sibling) {
+		nodes[oldParent].left = newParent;
+	} else {
+		nodes[oldParent].right = newParent;
+	}
+	refit(newParent);
+}
+
+void Bvh::removeLeaf(int32_t leaf) {
+	if (leaf == root) {
+		root = BVH_NULL;
+		return;
+	}
+
+	int32_t parent = nodes[leaf].parent;
+	int32_t grandParent = nodes[parent].parent;
+	int32_t sibling = nodes[parent].left == leaf ? nodes[parent].right : nodes[parent].left;
+	nodes[sibling].parent = grandParent;
+	if (grandParent == BVH_NULL) {
+		root = sibling;
+	} else {
+		if (nodes[grandParent].left == parent) {
+			nodes[grandParent].left = sibling;
+		} else {
+			nodes[grandParent].right = sibling;
+		}
+		refit(grandParent);
+	}
+	freeNode(parent);
+}
+
+void Bvh::refit(int32_t index) {
+	while (index != BVH_NULL) {
+		auto& node = nodes[index];
+		node.boxMin = glm::min(nodes[node.left].boxMin, nodes[node.right].boxMin);
+		node.boxMax = glm::max(nodes[node.left].boxMax, nodes[node.right].boxMax);
+		index = node.parent;
+	}
+}
+
+void Bvh::rebuild() {
+	if (root == BVH_NULL) {
+		return;
+	}
+
+	std::vector<int32_t> leaves;
+	leaves.reserve(objectCount);
+	std::vector<int32_t> stack{root};
+	while (!stack.empty()) {
+		int32_t index = stack.back();
+		stack.pop_back();
+		if (nodes[index].isLeaf()) {
+			leaves.push_back(index);
+		} else {
+			stack.push_back(nodes[index].left);
+			stack.push_back(nodes[index].right);
+			freeNode(index);
+		}
+	}
+
+	root = build(leaves.data(), leaves.size());
+	nodes[root].parent = BVH_NULL;
+}
+
+int32_t Bvh::build(int32_t* leaves, size_t count) {
+	using namespace glm;
+	if (count == 1) {
+		return leaves[0];
+	}
+
+	auto centroid = [&](int32_t leaf) {
+		return (nodes[leaf].boxMin + nodes[leaf].boxMax) * 0.5f;
+	};
+	vec3 centroidMin(std::numeric_limits<float>::max());
+	vec3 centroidMax(-std::numeric_limits<float>::max());
+	for (size_t i = 0; i < count; i++) {
+		centroidMin = min(centroidMin, centroid(leaves[i]));
+		centroidMax = max(centroidMax, centroid(leaves[i]));
+	}
+	vec3 extent = centroidMax - centroidMin;
+	int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+
+	size_t split = count / 2;
+	if (extent[axis] > 0.0f) {
+		// Bin the leaves by centroid and pick the boundary with the lowest
+		// surface area times object count on both sides
+		struct Bin {
+			vec3 boxMin = vec3(std::numeric_limits<float>::max());
+			vec3 boxMax = vec3(-std::numeric_limits<float>::max());
+			size_t count = 0;
+		};
+		Bin bins[BVH_SAH_BINS];
+		float binScale = BVH_SAH_BINS / extent[axis];
+		auto binOf = [&](int32_t leaf) {
+			int bin = static_cast<int>((centroid(leaf)[axis] - centroidMin[axis]) * binScale);
+			return std::min(bin, BVH_SAH_BINS - 1);
+		};
+		for (size_t i = 0; i < count; i++) {
+			auto& bin = bins[binOf(leaves[i])];
+			bin.boxMin = min(bin.boxMin, nodes[leaves[i]].boxMin);
+			bin.boxMax = max(bin.boxMax, nodes[leaves[i]].boxMax);
+			bin.count++;
+		}
+
+		float rightCosts[BVH_SAH_BINS];
+		Bin right;
+		for (int b = BVH_SAH_BINS - 1; b > 0; b--) {
+			right.boxMin = min(right.boxMin, bins[b].boxMin);
+			right.boxMax = max(right.boxMax, bins[b].boxMax);
+			right.count += bins[b].count;
+			rightCosts[b] = right.count > 0 ? surfaceArea(right.boxMin, right.boxMax) * right.count : 0.0f;
+		}
+		Bin left;
+		float bestCost = std::numeric_limits<float>::infinity();
+		int bestBoundary = 0;
+		for (int b = 1; b < BVH_SAH_BINS; b++) {
+			left.boxMin = min(left.boxMin, bins[b - 1].boxMin);
+			left.boxMax = max(left.boxMax, bins[b - 1].boxMax);
+			left.count += bins[b - 1].count;
+			if (left.count == 0 || left.count == count) {
+				continue;
+			}
+			float cost = surfaceArea(left.boxMin, left.boxMax) * left.count + rightCosts[b];
+			if (cost < bestCost) {
+				bestCost = cost;
+				bestBoundary = b;
+			}
+		}
+		if (bestBoundary > 0) {
+			split = std::partition(leaves, leaves + count, [&](int32_t leaf) {
+				return binOf(leaf) < bestBoundary;
+			}) - leaves;
+		}
+	}
+	if (split == 0 || split == count) {
+		// All centroids are in one bin, so split by count instead
+		split = count / 2;
+		std::nth_element(leaves, leaves + split, leaves + count, [&](int32_t a, int32_t b) {
+			return centroid(a)[axis] < centroid(b)[axis];
+		});
+	}
+
+	int32_t left = build(leaves, split);
+	int32_t right = build(leaves + split, count - split);
+	int32_t index = allocateNode();
+	auto& node = nodes[index];
+	node.left = left;
+	node.right = right;
+	node.boxMin = min(nodes[left].boxMin, nodes[right].boxMin);
+	node.boxMax = max(nodes[left].boxMax, nodes[right].boxMax);
+	nodes[left].parent = index;
+	nodes[right].parent = index;
+	return index;
+}
+
+int Bvh::height() const {
+	if (root == BVH_NULL) {
+		return 0;
+	}
+	int result = 0;
+	std::vector<std::pair<int32_t, int>> stack{{root, 1}};
+	while (!stack.empty()) {
+		auto entry = stack.back();
+		stack.pop_back();
+		result = std::max(result, entry.second);
+		auto& node = nodes[entry.first];
+		if (!node.isLeaf()) {
+			stack.emplace_back(node.left, entry.second + 1);
+			stack.emplace_back(node.right, entry.second + 1);
+		}
+	}
+	return result;
+}
+
+void Bvh::collectObjects(int32_t index, std::vector<uint32_t>* objects) const {
+	std::vector<int32_t> stack{index};
+	while (!stack.empty()) {
+		auto& node = nodes[stack.back()];
+		stack.pop_back();
+		if (node.isLeaf()) {
+			objects->push_back(node.object);
+		} else {
+			stack.push_back(node.left);
+			stack.push_back(node.right);
+		}
+	}
+}
+
+void Bvh::queryFrustum(const Frustum& frustum, std::vector<uint32_t>* objects) const {
+	if (root == BVH_NULL) {
+		return;
+	}
+	std::vector<int32_t> stack{root};
+	while (!stack.empty()) {
+		int32_t index = stack.back();
+		stack.pop_back();
+		auto& node = nodes[index];
+		auto containment = classifyBox(frustum, node.boxMin, node.boxMax);
+		if (containment == Containment::Outside) {
+			continue;
+		}
+		// Everything below a box inside all planes is visible without further tests
+		if (containment == Containment::Inside || node.isLeaf()) {
+			collectObjects(index, objects);
+		} else {
+			stack.push_back(node.left);
+			stack.push_back(node.right);
+		}
+	}
+}
+
+void Bvh::queryBox(glm::vec3 boxMin, glm::vec3 boxMax, std::vector<uint32_t>* objects) const {
+	if (root == BVH_NULL) {
+		return;
+	}
+	std::vector<int32_t> stack{root};
+	while (!stack.empty()) {
+		auto& node = nodes[stack.back()];
+		stack.pop_back();
+		if (glm::any(glm::lessThan(node.boxMax, boxMin)) || glm::any(glm::greaterThan(node.boxMin, boxMax))) {
+			continue;
+		}
+		if (node.isLeaf()) {
+			objects->push_back(node.object);
+		} else {
+			stack.push_back(node.left);
+			stack.push_back(node.right);
+		}
+	}
+}
+
+void Bvh::querySphere(glm::vec3 center, float radius, std::vector<uint32_t>* objects) const {
+	if (root == BVH_NULL) {
+		return;
+	}
+	std::vector<int32_t> stack{root};
+	while (!stack.empty()) {
+		auto& node = nodes[stack.back()];
+		stack.pop_back();
+		if (!boxOverlapsSphere(node.boxMin, node.boxMax, center, radius)) {
+			continue;
+		}
+		if (node.isLeaf()) {
+			objects->push_back(node.object);
+		} else {
+			stack.push_back(node.left);
+			stack.push_back(node.right);
+		}
+	}
+}
+
+bool Bvh::raycast(glm::vec3 origin, glm::vec3 direction, float maxDistance, uint32_t* object, float* distance) const {
+	if (root == BVH_NULL) {
+		return false;
+	}
+	glm::vec3 inverseDirection = 1.0f / direction;
+	float nearest = maxDistance;
+	bool hit = false;
+
+	std::vector<std::pair<int32_t, float>> stack;
+	float rootEntry = rayEntry(origin, inverseDirection, nodes[root].boxMin, nodes[root].boxMax);
+	if (rootEntry <= nearest) {
+		stack.emplace_back(root, rootEntry);
+	}
+	while (!stack.empty()) {
+		auto entry = stack.back();
+		stack.pop_back();
+		if (entry.second > nearest) {
+			continue;
+		}
+		auto& node = nodes[entry.first];
+		if (node.isLeaf()) {
+			nearest = entry.second;
+			*object = node.object;
+			hit = true;
+			continue;
+		}
+
+		// Visit the nearer child first, so that it can prune the other
+		float leftEntry = rayEntry(origin, inverseDirection, nodes[node.left].boxMin, nodes[node.left].boxMax);
+		float rightEntry = rayEntry(origin, inverseDirection, nodes[node.right].boxMin, nodes[node.right].boxMax);
+		std::pair<int32_t, float> children[] = {{node.left, leftEntry}, {node.right, rightEntry}};
+		if (leftEntry < rightEntry) {
+			std::swap(children[0], children[1]);
+		}
+		for (auto& child : children) {
+			if (child.second <= nearest) {
+				stack.push_back(child);
+			}
+		}
+	}
+	if (hit) {
+		*distance = nearest;
+	}
+	return hit;
+}
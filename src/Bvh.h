@@ -0,0 +1,109 @@
+//===----------------------------------------------------------------------===//
+//
+// This file is part of the Noxoscope project
+//
+// Copyright (c) 2016 Niklas Helmertz
+//
+//===----------------------------------------------------------------------===//
+//
+// Dynamic bounding volume hierarchy of axis-aligned boxes.
+//
+// Objects are inserted one at a time by descending towards the sibling that
+// least increases the surface area of the tree, as in the dynamic tree of
+// Box2D, and the whole tree can be rebuilt top-down with the binned surface
+// area heuristic once a scene has been loaded. Moving an object only refits
+// the boxes above it, so a tree that has seen large movements should be
+// rebuilt to stay efficient.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef Bvh_H
+#define Bvh_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include <glm/vec3.hpp>
+
+#include "GeometryMath.h"
+
+/// Handle of an object in a Bvh, valid until the object is removed.
+typedef int32_t BvhProxy;
+
+constexpr BvhProxy BVH_NULL = -1;
+
+/// Number of centroid bins evaluated for every split when rebuilding.
+constexpr int BVH_SAH_BINS = 12;
+
+class Bvh {
+public:
+	/// Adds an object, identified to queries by the given value.
+	BvhProxy insert(uint32_t object, glm::vec3 boxMin, glm::vec3 boxMax);
+
+	void remove(BvhProxy proxy);
+
+	/// Changes the box of an object and refits the boxes above it.
+	void update(BvhProxy proxy, glm::vec3 boxMin, glm::vec3 boxMax);
+
+	/// Rebuilds the tree from all objects with the surface area heuristic.
+	/// Proxies stay valid.
+	void rebuild();
+
+	void clear();
+
+	size_t size() const {
+		return objectCount;
+	}
+
+	/// Number of nodes on the longest path from the root to an object.
+	int height() const;
+
+	/// Appends the objects with boxes that are not entirely outside one of
+	/// the frustum planes, with the same test as boxInFrustum.
+	void queryFrustum(const Frustum& frustum, std::vector<uint32_t>* objects) const;
+
+	/// Appends the objects with boxes that overlap the box.
+	void queryBox(glm::vec3 boxMin, glm::vec3 boxMax, std::vector<uint32_t>* objects) const;
+
+	/// Appends the objects with boxes that overlap the sphere.
+	void querySphere(glm::vec3 center, float radius, std::vector<uint32_t>* objects) const;
+
+	/// Finds the object with the nearest box hit by the ray within
+	/// maxDistance, measured in lengths of direction. Rays starting inside
+	/// a box hit it at distance 0. Returns false if nothing is hit.
+	bool raycast(glm::vec3 origin, glm::vec3 direction, float maxDistance, uint32_t* object, float* distance) const;
+
+private:
+	struct Node {
+		glm::vec3 boxMin;
+		glm::vec3 boxMax;
+		/// Parent node, or the next free node for nodes on the free list.
+		int32_t parent;
+		/// Children, with left set to BVH_NULL for leaves.
+		int32_t left;
+		int32_t right;
+		uint32_t object;
+
+		bool isLeaf() const {
+			return left == BVH_NULL;
+		}
+	};
+
+	std::vector<Node> nodes;
+	int32_t root = BVH_NULL;
+	int32_t freeList = BVH_NULL;
+	size_t objectCount = 0;
+
+	int32_t allocateNode();
+	void freeNode(int32_t index);
+	void insertLeaf(int32_t leaf);
+	void removeLeaf(int32_t leaf);
+	/// Recomputes the boxes of index and all of its ancestors.
+	void refit(int32_t index);
+	/// Builds a subtree over the given leaves, returning its root.
+	int32_t build(int32_t* leaves, size_t count);
+	void collectObjects(int32_t index, std::vector<uint32_t>* objects) const;
+};
+
+#endif // Bvh_H
@@ -11,31 +11,38 @@
 
 #include <glm/vec3.hpp>
 
+#include "UniformId.h"
+
 constexpr auto PROGRAM_NAME = "Noxoscope";
 
-constexpr auto UNIFORM_MODEL_MATRIX = "modelMatrix";
-constexpr auto UNIFORM_VIEW_MATRIX = "viewMatrix";
-constexpr auto UNIFORM_PROJECTION_MATRIX = "projMatrix";
-constexpr auto UNIFORM_INVERSE_PROJECTION_MATRIX = "invProj";
-constexpr auto UNIFORM_TEXTURE_DIFFUSE = "textureDiffuse";
-constexpr auto UNIFORM_TEXTURE_SPECULAR = "textureSpecular";
-constexpr auto UNIFORM_TEXTURE_NORMAL = "textureNormal";
-constexpr auto UNIFORM_COLOR_DIFFUSE = "colorDiffuse";
-constexpr auto UNIFORM_HAS_DIFFUSE_TEXTURE = "hasDiffuseTexture";
-constexpr auto UNIFORM_HAS_SPECULAR_TEXTURE = "hasSpecularTexture";
-constexpr auto UNIFORM_HAS_NORMAL_TEXTURE = "hasNormalTexture";
-constexpr auto UNIFORM_SPECULAR = "specular";
-constexpr auto UNIFORM_REFLECTIVENESS = "reflectiveness";
-constexpr auto UNIFORM_SAMPLES = "samples";
-constexpr auto UNIFORM_WIDTH = "width";
-constexpr auto UNIFORM_HEIGHT = "height";
+constexpr UniformId UNIFORM_MODEL_MATRIX{"modelMatrix"};
+constexpr UniformId UNIFORM_NORMAL_MATRIX{"normalMatrix"};
+constexpr UniformId UNIFORM_INSTANCED{"instanced"};
+constexpr UniformId UNIFORM_INDIRECT{"indirect"};
+constexpr UniformId UNIFORM_INSTANCE_RECORDS{"instanceRecords"};
+constexpr UniformId UNIFORM_MATERIAL_RECORDS{"materialRecords"};
+constexpr UniformId UNIFORM_TEXTURE_DIFFUSE{"textureDiffuse"};
+constexpr UniformId UNIFORM_TEXTURE_SPECULAR{"textureSpecular"};
+constexpr UniformId UNIFORM_TEXTURE_NORMAL{"textureNormal"};
+constexpr UniformId UNIFORM_TEXTURE_LAYERS{"textureLayers"};
+constexpr UniformId UNIFORM_COLOR_DIFFUSE{"colorDiffuse"};
+constexpr UniformId UNIFORM_HAS_DIFFUSE_TEXTURE{"hasDiffuseTexture"};
+constexpr UniformId UNIFORM_HAS_SPECULAR_TEXTURE{"hasSpecularTexture"};
+constexpr UniformId UNIFORM_HAS_NORMAL_TEXTURE{"hasNormalTexture"};
+constexpr UniformId UNIFORM_SPECULAR{"specular"};
+constexpr UniformId UNIFORM_REFLECTIVENESS{"reflectiveness"};
+constexpr UniformId UNIFORM_PACKED_VERTEX_FORMAT{"packedVertexFormat"};
+constexpr UniformId UNIFORM_POSITION_OFFSET{"positionOffset"};
+constexpr UniformId UNIFORM_POSITION_SCALE{"positionScale"};
+constexpr UniformId UNIFORM_WIDTH{"width"};
+constexpr UniformId UNIFORM_HEIGHT{"height"};
+constexpr UniformId UNIFORM_TEX_REPEAT_FACTOR{"texRepeatFactor"};
+constexpr UniformId UNIFORM_STENCIL_DEBUG_RENDER{"stencilDebugRender"};
 
 constexpr int DEFAULT_WIDTH = 1280;
 constexpr int DEFAULT_HEIGHT = 720;
 
 constexpr const size_t MAX_MODELS = 512;
-constexpr const size_t MAX_ENTITIES = 512;
-constexpr const size_t MAX_LIGHTS = 512;
 
 extern const glm::vec3 NULL_VECTOR;
 extern const glm::vec3 UNIT_X;
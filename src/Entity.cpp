@@ -8,11 +8,103 @@
 
 #include "Entity.h"
 
-#include <glm/gtc/type_ptr.hpp>
+#include <limits>
+#include <algorithm>
 
-#include "Constants.h"
+#include "GeometryMath.h"
 
-void Entity::render(const ShaderProgram& shader) {
-	glUniformMatrix4fv(shader[UNIFORM_MODEL_MATRIX], 1, GL_FALSE, value_ptr(modelMatrix));
-	this->model->render(shader);
+void Entity::setModelMatrix(const glm::mat4& modelMatrix) {
+	using namespace glm;
+	transform = modelMatrix;
+	scale = maxScale(modelMatrix);
+
+	meshSpheres.clear();
+	meshBoxes.clear();
+	boundsMin = vec3(std::numeric_limits<float>::max());
+	boundsMax = vec3(-std::numeric_limits<float>::max());
+	for (auto& mesh : model->meshes) {
+		vec3 center = vec3(modelMatrix * vec4(mesh.boundsCenter, 1.0f));
+		meshSpheres.push_back(vec4(center, mesh.boundsRadius * scale));
+
+		vec3 meshMin;
+		vec3 meshMax;
+		transformBox(modelMatrix, mesh.boundsMin, mesh.boundsMax, &meshMin, &meshMax);
+		meshBoxes.push_back(meshMin, meshMax);
+		boundsMin = min(boundsMin, meshMin);
+		boundsMax = max(boundsMax, meshMax);
+	}
+	if (model->meshes.empty()) {
+		boundsMin = boundsMax = vec3(modelMatrix[3]);
+	}
+	meshVisible.resize(meshBoxes.paddedSize());
+}
+
+void Entity::selectLods(glm::vec3 cameraPosition, float pixelsPerUnit, float near, LodStatistics* stats) {
+	using namespace glm;
+	for (size_t i = 0; i < model->meshes.size(); i++) {
+		auto& mesh = model->meshes[i];
+		auto& sphere = meshSpheres[i];
+		float distance = std::max(length(vec3(sphere) - cameraPosition) - sphere.w, near);
+		meshLods[i] = static_cast<uint8_t>(mesh.selectLod(pixelsPerUnit * scale / distance, meshLods[i]));
+
+		stats->triangleCount += mesh.lods[meshLods[i]].indexCount / 3;
+		stats->fullDetailTriangleCount += mesh.lods[0].indexCount / 3;
+	}
+}
+
+void Entity::cullMeshes(const Frustum& frustum, const OcclusionBuffer* occlusion, glm::vec3 cameraPosition, bool cullMeshlets, CullStatistics* stats) {
+	using namespace glm;
+	// Backfacing is invariant under the model transform, so test it in model space
+	vec3 modelCameraPosition = vec3(inverse(transform) * vec4(cameraPosition, 1.0f));
+	cullBoxes(frustum, meshBoxes, meshVisible.data());
+
+	draws.counts.clear();
+	draws.offsets.clear();
+	draws.meshStarts.clear();
+	for (size_t i = 0; i < model->meshes.size(); i++) {
+		auto& mesh = model->meshes[i];
+		draws.meshStarts.push_back(draws.counts.size());
+		if (!meshVisible[i]) {
+			continue;
+		}
+		if (occlusion) {
+			vec3 center(meshBoxes.centerX[i], meshBoxes.centerY[i], meshBoxes.centerZ[i]);
+			vec3 extent(meshBoxes.extentX[i], meshBoxes.extentY[i], meshBoxes.extentZ[i]);
+			if (!occlusion->boxVisible(center - extent, center + extent)) {
+				stats->occludedMeshCount++;
+				continue;
+			}
+		}
+		stats->visibleMeshCount++;
+
+		if (!cullMeshlets || meshLods[i] != 0 || mesh.meshlets.empty()) {
+			auto& lod = mesh.lods[meshLods[i]];
+			draws.counts.push_back(static_cast<GLsizei>(lod.indexCount));
+			draws.offsets.push_back(mesh.indexOffset(lod.firstIndex));
+			stats->visibleMeshletCount += meshLods[i] == 0 ? mesh.meshlets.size() : 0;
+			stats->triangleCount += lod.indexCount / 3;
+			continue;
+		}
+
+		// Consecutive visible meshlets are merged into one range
+		size_t rangeEnd = ~size_t(0);
+		for (auto& meshlet : mesh.meshlets) {
+			if (meshletBackfacing(meshlet, modelCameraPosition) ||
+				!sphereInFrustum(frustum, vec3(transform * vec4(meshlet.center, 1.0f)), meshlet.radius * scale)) {
+				continue;
+			}
+			if (meshlet.firstIndex == rangeEnd) {
+				draws.counts.back() += meshlet.indexCount;
+			} else {
+				draws.counts.push_back(static_cast<GLsizei>(meshlet.indexCount));
+				draws.offsets.push_back(mesh.indexOffset(meshlet.firstIndex));
+			}
+			rangeEnd = meshlet.firstIndex + meshlet.indexCount;
+			stats->visibleMeshletCount++;
+			stats->triangleCount += meshlet.indexCount / 3;
+		}
+	}
+	draws.meshStarts.push_back(draws.counts.size());
+	stats->drawCount += draws.counts.size();
+	stats->visibleEntityCount++;
 }
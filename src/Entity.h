@@ -9,16 +9,80 @@
 #ifndef Entity_H
 #define Entity_H
 
+#include <vector>
+#include <cstdint>
+
 #include "Model.h"
+#include "GeometryMath.h"
+#include "FrustumCulling.h"
+#include "OcclusionCulling.h"
+
+/// Triangles of the visible entities drawn with the selected LODs, and at
+/// full detail.
+struct LodStatistics {
+	size_t triangleCount = 0;
+	size_t fullDetailTriangleCount = 0;
+};
+
+/// Results of culling entities, meshes and meshlets against the camera. The
+/// totals of entities, meshes and meshlets are kept by the scene, so that
+/// culling only visits what is in view.
+struct CullStatistics {
+	size_t entityCount = 0;
+	size_t visibleEntityCount = 0;
+	size_t meshCount = 0;
+	size_t visibleMeshCount = 0;
+	/// Entities and meshes inside the frustum but hidden by occluders.
+	size_t occludedEntityCount = 0;
+	size_t occludedMeshCount = 0;
+	size_t meshletCount = 0;
+	size_t visibleMeshletCount = 0;
+	size_t triangleCount = 0;
+	size_t drawCount = 0;
+};
 
 class Entity {
 public:
 	explicit Entity(Model* model, glm::mat4 modelMatrix)
-		: model(model), modelMatrix(modelMatrix) {}
+		: model(model), meshLods(model->meshes.size(), 0) {
+		setModelMatrix(modelMatrix);
+	}
+
+	const glm::mat4& modelMatrix() const {
+		return transform;
+	}
+
+	/// Moves the entity, updating its world space bounds.
+	void setModelMatrix(const glm::mat4& modelMatrix);
+
+	/// Chooses the LOD of every mesh from its error projected to the screen,
+	/// where pixelsPerUnit is the size in pixels of one unit at distance one.
+	void selectLods(glm::vec3 cameraPosition, float pixelsPerUnit, float near, LodStatistics* stats);
+
+	/// Finds the index ranges to draw with the selected LODs. Meshes outside
+	/// of the frustum or hidden in occlusion, if not null, are skipped. If
+	/// cullMeshlets is set, so are the meshlets of full detail meshes that
+	/// are outside or facing away.
+	void cullMeshes(const Frustum& frustum, const OcclusionBuffer* occlusion, glm::vec3 cameraPosition, bool cullMeshlets, CullStatistics* stats);
 
-	void render(const ShaderProgram& shader);
 	Model* model;
-	glm::mat4 modelMatrix;
+	/// Bounding box of all meshes in world space.
+	glm::vec3 boundsMin;
+	glm::vec3 boundsMax;
+	/// Bounding sphere of each mesh in world space, with the radius in w.
+	std::vector<glm::vec4> meshSpheres;
+	/// LOD to draw for each mesh of the model.
+	std::vector<uint8_t> meshLods;
+	/// Index ranges to draw for each mesh, from the last cullMeshes. They are
+	/// left as they were when the entity is culled, so only entities found
+	/// visible in the current frame may be drawn with them.
+	DrawRanges draws;
+private:
+	glm::mat4 transform;
+	float scale;
+	/// Bounding box of each mesh in world space.
+	CullBoxes meshBoxes;
+	std::vector<uint8_t> meshVisible;
 };
 
 #endif // Entity_H
@@ -12,9 +12,20 @@
 #include <string>
 #include <sstream>
 #include <algorithm>
+#include <cctype>
+#include <cstdlib>
 
 #include <SDL.h>
 
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#endif
+
 std::string baseDirRelative(const char* str) {
 	std::stringstream ss;
 	ss << SDL_GetBasePath() << PATH_SEP << str;
@@ -31,3 +42,145 @@ void fixOSPath(std::string& cs) {
 	std::replace(cs.begin(), cs.end(), '/', PATH_SEP);
 	std::replace(cs.begin(), cs.end(), '\\', PATH_SEP);
 }
+
+std::string canonicalPath(const std::string& path) {
+	auto fixedPath = path;
+	fixOSPath(fixedPath);
+	char resolved[MAXPATHLEN];
+#ifdef _WIN32
+	if (_fullpath(resolved, fixedPath.c_str(), MAXPATHLEN) == nullptr) {
+		return fixedPath;
+	}
+	// Windows paths are case-insensitive
+	std::string result(resolved);
+	std::transform(result.begin(), result.end(), result.begin(), [](char c) { return static_cast<char>(std::tolower(static_cast<unsigned char>(c))); });
+	return result;
+#else
+	if (realpath(fixedPath.c_str(), resolved) == nullptr) {
+		return fixedPath;
+	}
+	return resolved;
+#endif
+}
+
+bool getFileInfo(const char* filePath, FileInfo* info) {
+	struct stat fileStat;
+	if (stat(filePath, &fileStat) != 0) {
+		return false;
+	}
+	info->modificationTime = static_cast<int64_t>(fileStat.st_mtime);
+	info->size = static_cast<uint64_t>(fileStat.st_size);
+	return true;
+}
+
+bool makeDirectories(const std::string& dirPath) {
+	auto path = dirPath;
+	fixOSPath(path);
+	for (size_t i = 1; i <= path.size(); i++) {
+		if (i != path.size() && path[i] != PATH_SEP) {
+			continue;
+		}
+		auto partial = path.substr(0, i);
+		struct stat dirStat;
+		if (stat(partial.c_str(), &dirStat) == 0) {
+			continue;
+		}
+#ifdef _WIN32
+		if (_mkdir(partial.c_str()) != 0) {
+#else
+		if (mkdir(partial.c_str(), 0755) != 0) {
+#endif
+			return false;
+		}
+	}
+	return true;
+}
+
+MappedFile::~MappedFile() {
+	close();
+}
+
+MappedFile::MappedFile(MappedFile&& o) {
+	std::swap(mapped, o.mapped);
+	std::swap(length, o.length);
+#ifdef _WIN32
+	std::swap(fileHandle, o.fileHandle);
+	std::swap(mappingHandle, o.mappingHandle);
+#endif
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& o) {
+	std::swap(mapped, o.mapped);
+	std::swap(length, o.length);
+#ifdef _WIN32
+	std::swap(fileHandle, o.fileHandle);
+	std::swap(mappingHandle, o.mappingHandle);
+#endif
+	return *this;
+}
+
+bool MappedFile::open(const char* filePath) {
+	close();
+#ifdef _WIN32
+	auto file = CreateFileA(filePath, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+		CloseHandle(file);
+		return false;
+	}
+	auto mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping == nullptr) {
+		CloseHandle(file);
+		return false;
+	}
+	auto view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (view == nullptr) {
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+	fileHandle = file;
+	mappingHandle = mapping;
+	mapped = static_cast<const char*>(view);
+	length = static_cast<size_t>(fileSize.QuadPart);
+#else
+	int fd = ::open(filePath, O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+	struct stat fileStat;
+	if (fstat(fd, &fileStat) != 0 || fileStat.st_size == 0) {
+		::close(fd);
+		return false;
+	}
+	auto view = mmap(nullptr, static_cast<size_t>(fileStat.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+	// The mapping stays valid after the descriptor is closed
+	::close(fd);
+	if (view == MAP_FAILED) {
+		return false;
+	}
+	mapped = static_cast<const char*>(view);
+	length = static_cast<size_t>(fileStat.st_size);
+#endif
+	return true;
+}
+
+void MappedFile::close() {
+	if (mapped == nullptr) {
+		return;
+	}
+#ifdef _WIN32
+	UnmapViewOfFile(mapped);
+	CloseHandle(mappingHandle);
+	CloseHandle(fileHandle);
+	mappingHandle = nullptr;
+	fileHandle = nullptr;
+#else
+	munmap(const_cast<char*>(mapped), length);
+#endif
+	mapped = nullptr;
+	length = 0;
+}
@@ -10,6 +10,8 @@
 #define FileTools_H
 
 #include <string>
+#include <cstdint>
+#include <cstddef>
 
 #ifdef _MSC_VER
 #include <direct.h>
@@ -29,8 +31,54 @@ static const char PATH_SEP = '\\';
 static const char PATH_SEP = '/';
 #endif
 
+struct FileInfo {
+	int64_t modificationTime;
+	uint64_t size;
+};
+
+/// \brief Read-only memory mapping of a complete file.
+///
+/// The mapping is released when the object is destroyed.
+class MappedFile {
+public:
+	MappedFile() = default;
+	~MappedFile();
+
+	MappedFile(MappedFile const&) = delete;
+	void operator=(MappedFile const&) = delete;
+
+	MappedFile(MappedFile&& o);
+	MappedFile& operator=(MappedFile&& o);
+
+	bool open(const char* filePath);
+	void close();
+
+	const char* data() const {
+		return mapped;
+	}
+
+	size_t size() const {
+		return length;
+	}
+
+private:
+	const char* mapped = nullptr;
+	size_t length = 0;
+#ifdef _WIN32
+	void* fileHandle = nullptr;
+	void* mappingHandle = nullptr;
+#endif
+};
+
 std::string baseDirRelative(const char* str);
 std::string readFile(const char* filePath);
 void fixOSPath(std::string& cs);
 
+/// Resolves path to an absolute path without "." and ".." components or
+/// symbolic links, so that each file has a single name. Returns path with
+/// fixed separators if it cannot be resolved, e.g. when it does not exist.
+std::string canonicalPath(const std::string& path);
+bool getFileInfo(const char* filePath, FileInfo* info);
+bool makeDirectories(const std::string& dirPath);
+
 #endif // FileTools_H
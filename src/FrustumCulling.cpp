@@ -0,0 +1,91 @@
+//===----------------------------------------------------------------------===//
+//
+// This file is part of the Noxoscope project
+//
+// Copyright (c) 2016 Niklas Helmertz
+//
+//===----------------------------------------------------------------------===//
+
+#include "FrustumCulling.h"
+
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define NS_CULL_SSE
+#include <xmmintrin.h>
+#endif
+
+void CullBoxes::clear() {
+	for (auto array : {&centerX, &centerY, &centerZ, &extentX, &extentY, &extentZ}) {
+		array->clear();
+	}
+	count = 0;
+}
+
+void CullBoxes::push_back(glm::vec3 boxMin, glm::vec3 boxMax) {
+	if (count == centerX.size()) {
+		// Padding boxes are empty, at the origin
+		for (auto array : {&centerX, &centerY, &centerZ, &extentX, &extentY, &extentZ}) {
+			array->resize(count + CULL_BATCH_SIZE, 0.0f);
+		}
+	}
+	set(count++, boxMin, boxMax);
+}
+
+void CullBoxes::set(size_t index, glm::vec3 boxMin, glm::vec3 boxMax) {
+	glm::vec3 center = (boxMin + boxMax) * 0.5f;
+	glm::vec3 extent = (boxMax - boxMin) * 0.5f;
+	centerX[index] = center.x;
+	centerY[index] = center.y;
+	centerZ[index] = center.z;
+	extentX[index] = extent.x;
+	extentY[index] = extent.y;
+	extentZ[index] = extent.z;
+}
+
+void cullBoxes(const Frustum& frustum, const CullBoxes& boxes, uint8_t* visible) {
+#ifdef NS_CULL_SSE
+	// Plane components broadcast to all lanes, with absolute values of the
+	// normal for the extent along it
+	__m128 planes[6][7];
+	for (int p = 0; p < 6; p++) {
+		auto& plane = frustum.planes[p];
+		for (int c = 0; c < 4; c++) {
+			planes[p][c] = _mm_set1_ps(plane[c]);
+		}
+		for (int c = 0; c < 3; c++) {
+			planes[p][4 + c] = _mm_set1_ps(std::abs(plane[c]));
+		}
+	}
+
+	__m128 zero = _mm_setzero_ps();
+	for (size_t i = 0; i < boxes.paddedSize(); i += CULL_BATCH_SIZE) {
+		__m128 cx = _mm_loadu_ps(&boxes.centerX[i]);
+		__m128 cy = _mm_loadu_ps(&boxes.centerY[i]);
+		__m128 cz = _mm_loadu_ps(&boxes.centerZ[i]);
+		__m128 ex = _mm_loadu_ps(&boxes.extentX[i]);
+		__m128 ey = _mm_loadu_ps(&boxes.extentY[i]);
+		__m128 ez = _mm_loadu_ps(&boxes.extentZ[i]);
+
+		__m128 outside = zero;
+		for (auto& plane : planes) {
+			__m128 distance = _mm_add_ps(_mm_add_ps(_mm_add_ps(
+				_mm_mul_ps(plane[0], cx), _mm_mul_ps(plane[1], cy)), _mm_mul_ps(plane[2], cz)), plane[3]);
+			__m128 reach = _mm_add_ps(_mm_add_ps(
+				_mm_mul_ps(plane[4], ex), _mm_mul_ps(plane[5], ey)), _mm_mul_ps(plane[6], ez));
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, reach), zero));
+		}
+
+		int mask = _mm_movemask_ps(outside);
+		for (size_t k = 0; k < CULL_BATCH_SIZE; k++) {
+			visible[i + k] = ((mask >> k) & 1) == 0;
+		}
+	}
+#else
+	for (size_t i = 0; i < boxes.size(); i++) {
+		glm::vec3 center(boxes.centerX[i], boxes.centerY[i], boxes.centerZ[i]);
+		glm::vec3 extent(boxes.extentX[i], boxes.extentY[i], boxes.extentZ[i]);
+		visible[i] = boxInFrustum(frustum, center - extent, center + extent);
+	}
+#endif
+}
@@ -0,0 +1,64 @@
+//===----------------------------------------------------------------------===//
+//
+// This file is part of the Noxoscope project
+//
+// Copyright (c) 2016 Niklas Helmertz
+//
+//===----------------------------------------------------------------------===//
+//
+// Frustum culling of many axis-aligned boxes at once.
+//
+// Boxes are stored as separate arrays of center and extent components, so
+// that CULL_BATCH_SIZE boxes are tested against a plane with a few SSE
+// instructions. The result matches boxInFrustum from GeometryMath.h, which
+// is used where SSE is not available.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef FrustumCulling_H
+#define FrustumCulling_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include <glm/vec3.hpp>
+
+#include "GeometryMath.h"
+
+/// Number of boxes tested at a time.
+constexpr size_t CULL_BATCH_SIZE = 4;
+
+/// \brief Axis-aligned boxes as a structure of arrays.
+///
+/// The arrays are padded to a multiple of CULL_BATCH_SIZE, so batches never
+/// need to check for the end.
+class CullBoxes {
+public:
+	void clear();
+	void push_back(glm::vec3 boxMin, glm::vec3 boxMax);
+
+	/// Replaces the box at index.
+	void set(size_t index, glm::vec3 boxMin, glm::vec3 boxMax);
+
+	size_t size() const {
+		return count;
+	}
+
+	/// Size rounded up to a multiple of CULL_BATCH_SIZE.
+	size_t paddedSize() const {
+		return centerX.size();
+	}
+
+	std::vector<float> centerX, centerY, centerZ;
+	std::vector<float> extentX, extentY, extentZ;
+private:
+	size_t count = 0;
+};
+
+/// Sets visible[i] to 1 for every box that is not entirely outside one of
+/// the frustum planes, and to 0 otherwise. visible must hold
+/// boxes.paddedSize() values, of which the padding is left undefined.
+void cullBoxes(const Frustum& frustum, const CullBoxes& boxes, uint8_t* visible);
+
+#endif // FrustumCulling_H
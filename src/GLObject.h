@@ -68,5 +68,6 @@ BASIC_GL_OBJECT(GLFramebuffer, GLFramebufferTraits, GLuint, glGenFramebuffers(1,
 BASIC_GL_OBJECT(GLRenderBuffer, GLRenderbufferTraits, GLuint, glGenRenderbuffers(1, &handle), glDeleteRenderbuffers(1, &handle))
 BASIC_GL_OBJECT(GLVertexArray, GLVertexArrayTraits, GLuint, glGenVertexArrays(1, &handle), glDeleteVertexArrays(1, &handle))
 BASIC_GL_OBJECT(GLBuffer, GLBufferTraits, GLuint, glGenBuffers(1, &handle), glDeleteBuffers(1, &handle))
+BASIC_GL_OBJECT(GLQuery, GLQueryTraits, GLuint, glGenQueries(1, &handle), glDeleteQueries(1, &handle))
 
 #endif // GLObject_H
@@ -0,0 +1,166 @@
+//===----------------------------------------------------------------------===//
+//
+// This file is part of the Noxoscope project
+//
+// Copyright (c) 2016 Niklas Helmertz
+//
+//===----------------------------------------------------------------------===//
+
+#include "GLState.h"
+
+#include "Logging.h"
+
+GLState glState;
+
+void GLState::invalidate() {
+	shadows = Shadows();
+}
+
+void GLState::useProgram(GLuint program) {
+	if (change(&shadows.program, program)) {
+		glUseProgram(program);
+	}
+}
+
+void GLState::bindVertexArray(GLuint vertexArray) {
+	if (change(&shadows.vertexArray, vertexArray)) {
+		glBindVertexArray(vertexArray);
+	}
+}
+
+void GLState::bindFramebuffer(GLuint framebuffer) {
+	if (change(&shadows.framebuffer, framebuffer)) {
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	}
+}
+
+void GLState::bindTexture(GLuint unit, GLuint texture, GLenum target) {
+	if (unit >= GL_STATE_TEXTURE_UNITS) {
+		fatalError("Texture unit {} is not tracked", unit);
+	}
+	Shadow<GLuint>* targetShadows;
+	switch (target) {
+	case GL_TEXTURE_2D:
+		targetShadows = shadows.textures;
+		break;
+	case GL_TEXTURE_2D_ARRAY:
+		targetShadows = shadows.textureArrays;
+		break;
+	case GL_TEXTURE_BUFFER:
+		targetShadows = shadows.textureBuffers;
+		break;
+	default:
+		fatalError("Texture target {} is not tracked", target);
+		return;
+	}
+	auto& shadow = targetShadows[unit];
+	if (shadow.valid && shadow.value == texture) {
+		skippedCount++;
+		return;
+	}
+	if (change(&shadows.activeTextureUnit, unit)) {
+		glActiveTexture(GL_TEXTURE0 + unit);
+	}
+	change(&shadow, texture);
+	glBindTexture(target, texture);
+}
+
+void GLState::viewport(GLint x, GLint y, GLsizei width, GLsizei height) {
+	if (change(&shadows.viewport, {x, y, width, height})) {
+		glViewport(x, y, width, height);
+	}
+}
+
+void GLState::scissor(GLint x, GLint y, GLsizei width, GLsizei height) {
+	if (change(&shadows.scissor, {x, y, width, height})) {
+		glScissor(x, y, width, height);
+	}
+}
+
+void GLState::enable(GLenum capability, bool enabled) {
+	Capability index;
+	switch (capability) {
+	case GL_BLEND: index = CAPABILITY_BLEND; break;
+	case GL_CULL_FACE: index = CAPABILITY_CULL_FACE; break;
+	case GL_DEPTH_TEST: index = CAPABILITY_DEPTH_TEST; break;
+	case GL_SCISSOR_TEST: index = CAPABILITY_SCISSOR_TEST; break;
+	case GL_STENCIL_TEST: index = CAPABILITY_STENCIL_TEST; break;
+	default:
+		issuedCount++;
+		enabled ? glEnable(capability) : glDisable(capability);
+		return;
+	}
+	if (change(&shadows.capabilities[index], enabled)) {
+		enabled ? glEnable(capability) : glDisable(capability);
+	}
+}
+
+void GLState::colorMask(bool enabled) {
+	if (change(&shadows.colorMask, enabled)) {
+		GLboolean mask = enabled ? GL_TRUE : GL_FALSE;
+		glColorMask(mask, mask, mask, mask);
+	}
+}
+
+void GLState::depthMask(bool enabled) {
+	if (change(&shadows.depthMask, enabled)) {
+		glDepthMask(enabled ? GL_TRUE : GL_FALSE);
+	}
+}
+
+void GLState::depthFunc(GLenum func) {
+	if (change(&shadows.depthFunc, func)) {
+		glDepthFunc(func);
+	}
+}
+
+void GLState::cullFace(GLenum face) {
+	if (change(&shadows.cullFace, face)) {
+		glCullFace(face);
+	}
+}
+
+void GLState::stencilMask(GLuint mask) {
+	if (change(&shadows.stencilMask, mask)) {
+		glStencilMask(mask);
+	}
+}
+
+void GLState::stencilFunc(GLenum func, GLint ref, GLuint mask) {
+	if (change(&shadows.stencilFunc, {func, ref, mask})) {
+		glStencilFunc(func, ref, mask);
+	}
+}
+
+void GLState::stencilOpSeparate(GLenum face, GLenum stencilFail, GLenum depthFail, GLenum depthPass) {
+	StencilOp op = {stencilFail, depthFail, depthPass};
+	if (face == GL_FRONT_AND_BACK) {
+		// One call covering both shadows
+		auto& front = shadows.stencilOpFront;
+		auto& back = shadows.stencilOpBack;
+		if (front.valid && front.value == op && back.valid && back.value == op) {
+			skippedCount++;
+			return;
+		}
+		front.value = back.value = op;
+		front.valid = back.valid = true;
+		issuedCount++;
+		glStencilOpSeparate(face, stencilFail, depthFail, depthPass);
+		return;
+	}
+	if (change(face == GL_FRONT ? &shadows.stencilOpFront : &shadows.stencilOpBack, op)) {
+		glStencilOpSeparate(face, stencilFail, depthFail, depthPass);
+	}
+}
+
+void GLState::blendEquation(GLenum mode) {
+	if (change(&shadows.blendEquation, mode)) {
+		glBlendEquation(mode);
+	}
+}
+
+void GLState::blendFunc(GLenum source, GLenum destination) {
+	if (change(&shadows.blendFunc, {source, destination})) {
+		glBlendFunc(source, destination);
+	}
+}
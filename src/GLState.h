@@ -0,0 +1,169 @@
+//===----------------------------------------------------------------------===//
+//
+// This file is part of the Noxoscope project
+//
+// Copyright (c) 2016 Niklas Helmertz
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef GLState_H
+#define GLState_H
+
+#include <cstddef>
+
+#include <GL/glew.h>
+
+/// Number of texture units tracked by GLState.
+constexpr GLuint GL_STATE_TEXTURE_UNITS = 16;
+
+/// \brief Shadow copy of the GL state changed while rendering.
+///
+/// Changes that would set state to its current value are skipped. The shadow
+/// only sees changes made through this class, so invalidate() has to be
+/// called after anything else, such as the GUI or texture uploads, may have
+/// changed the same state.
+class GLState {
+public:
+	/// Forgets all shadowed state, so that the next change of each is issued.
+	void invalidate();
+
+	void useProgram(GLuint program);
+	void bindVertexArray(GLuint vertexArray);
+	void bindFramebuffer(GLuint framebuffer);
+
+	/// Binds a GL_TEXTURE_2D, GL_TEXTURE_2D_ARRAY or GL_TEXTURE_BUFFER
+	/// texture to a texture unit, counted from 0. The targets of a unit are
+	/// tracked separately.
+	void bindTexture(GLuint unit, GLuint texture, GLenum target = GL_TEXTURE_2D);
+
+	void viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+	void scissor(GLint x, GLint y, GLsizei width, GLsizei height);
+
+	/// Enables or disables GL_BLEND, GL_CULL_FACE, GL_DEPTH_TEST,
+	/// GL_SCISSOR_TEST or GL_STENCIL_TEST. Other capabilities are passed
+	/// through.
+	void enable(GLenum capability, bool enabled = true);
+	void disable(GLenum capability) {
+		enable(capability, false);
+	}
+
+	void colorMask(bool enabled);
+	void depthMask(bool enabled);
+	void depthFunc(GLenum func);
+	void cullFace(GLenum face);
+	void stencilMask(GLuint mask);
+	void stencilFunc(GLenum func, GLint ref, GLuint mask);
+	void stencilOpSeparate(GLenum face, GLenum stencilFail, GLenum depthFail, GLenum depthPass);
+	void blendEquation(GLenum mode);
+	void blendFunc(GLenum source, GLenum destination);
+
+	/// GL calls made and skipped since the last resetCounters.
+	size_t issuedCount = 0;
+	size_t skippedCount = 0;
+
+	void resetCounters() {
+		issuedCount = 0;
+		skippedCount = 0;
+	}
+private:
+	template <typename T>
+	struct Shadow {
+		T value;
+		bool valid = false;
+	};
+
+	// Whether a change is needed, updating the shadow and the counters
+	template <typename T>
+	bool change(Shadow<T>* shadow, const T& value) {
+		if (shadow->valid && shadow->value == value) {
+			skippedCount++;
+			return false;
+		}
+		shadow->value = value;
+		shadow->valid = true;
+		issuedCount++;
+		return true;
+	}
+
+	// Capabilities tracked by enable
+	enum Capability {
+		CAPABILITY_BLEND,
+		CAPABILITY_CULL_FACE,
+		CAPABILITY_DEPTH_TEST,
+		CAPABILITY_SCISSOR_TEST,
+		CAPABILITY_STENCIL_TEST,
+		CAPABILITY_COUNT
+	};
+
+	// Viewport or scissor box
+	struct Rect {
+		GLint x;
+		GLint y;
+		GLsizei width;
+		GLsizei height;
+
+		bool operator==(const Rect& o) const {
+			return x == o.x && y == o.y && width == o.width && height == o.height;
+		}
+	};
+
+	struct StencilFunc {
+		GLenum func;
+		GLint ref;
+		GLuint mask;
+
+		bool operator==(const StencilFunc& o) const {
+			return func == o.func && ref == o.ref && mask == o.mask;
+		}
+	};
+
+	struct StencilOp {
+		GLenum stencilFail;
+		GLenum depthFail;
+		GLenum depthPass;
+
+		bool operator==(const StencilOp& o) const {
+			return stencilFail == o.stencilFail && depthFail == o.depthFail && depthPass == o.depthPass;
+		}
+	};
+
+	struct BlendFunc {
+		GLenum source;
+		GLenum destination;
+
+		bool operator==(const BlendFunc& o) const {
+			return source == o.source && destination == o.destination;
+		}
+	};
+
+	// All start out invalid, so that the first change is always issued
+	struct Shadows {
+		Shadow<GLuint> program;
+		Shadow<GLuint> vertexArray;
+		Shadow<GLuint> framebuffer;
+		Shadow<GLuint> activeTextureUnit;
+		Shadow<GLuint> textures[GL_STATE_TEXTURE_UNITS];
+		Shadow<GLuint> textureArrays[GL_STATE_TEXTURE_UNITS];
+		Shadow<GLuint> textureBuffers[GL_STATE_TEXTURE_UNITS];
+		Shadow<Rect> viewport;
+		Shadow<Rect> scissor;
+		Shadow<bool> capabilities[CAPABILITY_COUNT];
+		Shadow<bool> colorMask;
+		Shadow<bool> depthMask;
+		Shadow<GLenum> depthFunc;
+		Shadow<GLenum> cullFace;
+		Shadow<GLuint> stencilMask;
+		Shadow<StencilFunc> stencilFunc;
+		Shadow<StencilOp> stencilOpFront;
+		Shadow<StencilOp> stencilOpBack;
+		Shadow<GLenum> blendEquation;
+		Shadow<BlendFunc> blendFunc;
+	};
+
+	Shadows shadows;
+};
+
+/// State of the GL context used for rendering.
+extern GLState glState;
+
+#endif // GLState_H
@@ -10,8 +10,13 @@
 
 #include <tuple>
 
+#include <glm/gtc/type_ptr.hpp>
+
 #include "Logging.h"
 #include "Model.h"
+#include "GLState.h"
+#include "Constants.h"
+#include "GeometryMath.h"
 
 void attachTextures(const ShaderProgram& shader, const std::initializer_list<std::tuple<GLuint, const char*>>& textureTuples) {
 	GLuint tex = 0;
@@ -19,16 +24,83 @@ void attachTextures(const ShaderProgram& shader, const std::initializer_list<std
 		GLuint texID;
 		const char* texName;
 		std::tie(texID, texName) = tuple;
-		glActiveTexture(GL_TEXTURE0 + tex);
-		glBindTexture(GL_TEXTURE_2D, texID);
+		glState.bindTexture(tex, texID);
 		glUniform1i(shader[texName], tex);
 		tex++;
 	}
 }
 
+void setModelMatrix(const ShaderProgram& shader, const glm::mat4& modelMatrix) {
+	glUniformMatrix4fv(shader[UNIFORM_MODEL_MATRIX], 1, GL_FALSE, glm::value_ptr(modelMatrix));
+	glUniformMatrix3fv(shader[UNIFORM_NORMAL_MATRIX], 1, GL_FALSE, glm::value_ptr(normalMatrix(modelMatrix)));
+}
+
+void enableInstanceAttributes(const InstanceAttribute* attributes, size_t count) {
+	for (size_t i = 0; i < count; i++) {
+		glEnableVertexAttribArray(attributes[i].location);
+		glVertexAttribDivisor(attributes[i].location, 1);
+	}
+}
+
+void pointInstanceAttributes(GLuint buffer, size_t firstInstance, size_t stride, const InstanceAttribute* attributes, size_t count) {
+	// Without base instances in GL 3.3, the attributes are pointed at the
+	// first instance of every draw
+	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+	size_t base = firstInstance * stride;
+	for (size_t i = 0; i < count; i++) {
+		glVertexAttribPointer(attributes[i].location, attributes[i].size, GL_FLOAT, GL_FALSE, static_cast<GLsizei>(stride),
+			reinterpret_cast<GLvoid*>(base + attributes[i].offset));
+	}
+}
+
+void uploadBufferTexture(BufferTexture* target, GLenum format, const void* data, size_t size) {
+	if (target->buffer.handle == 0) {
+		target->buffer.gen();
+		target->texture.gen();
+	}
+	// Empty buffers are padded, since a buffer texture needs storage
+	static const glm::vec4 padding(0.0f);
+	if (size == 0) {
+		data = &padding;
+		size = sizeof(padding);
+	}
+	glBindBuffer(GL_TEXTURE_BUFFER, target->buffer.handle);
+	glBufferData(GL_TEXTURE_BUFFER, size, data, GL_STREAM_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+	// The texture keeps referring to the buffer object after it is orphaned
+	glState.bindTexture(0, target->texture.handle, GL_TEXTURE_BUFFER);
+	glTexBuffer(GL_TEXTURE_BUFFER, format, target->buffer.handle);
+}
+
 void checkFboStatus() {
 	GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
 	if (status != GL_FRAMEBUFFER_COMPLETE) {
 		fatalError("Framebuffer not complete (code: 0x{:X})!", status);
 	}
 }
+
+void GpuTimer::begin() {
+	if (queries[current].handle == 0) {
+		queries[current].gen();
+	}
+	glBeginQuery(GL_TIME_ELAPSED, queries[current].handle);
+}
+
+void GpuTimer::end() {
+	glEndQuery(GL_TIME_ELAPSED);
+	pending[current] = true;
+	current = 1 - current;
+
+	// The other query was issued a frame ago, so it is usually done by now
+	if (pending[current]) {
+		GLint available = 0;
+		glGetQueryObjectiv(queries[current].handle, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (available) {
+			GLuint64 elapsed = 0;
+			glGetQueryObjectui64v(queries[current].handle, GL_QUERY_RESULT, &elapsed);
+			lastMilliseconds = elapsed / 1.0e6f;
+			pending[current] = false;
+		}
+	}
+}
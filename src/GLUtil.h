@@ -10,10 +10,66 @@
 #define GLUtil_H
 
 #include <tuple>
+#include <cstddef>
+
+#include <glm/glm.hpp>
 
 #include "ShaderProgram.h"
+#include "GLObject.h"
 
 void attachTextures(const ShaderProgram& shader, const std::initializer_list<std::tuple<GLuint, const char*>>& textureTuples);
 void checkFboStatus();
 
+/// Sets the model matrix uniform, and the normal matrix derived from it,
+/// for draws that are not instanced.
+void setModelMatrix(const ShaderProgram& shader, const glm::mat4& modelMatrix);
+
+/// Float vertex attribute read from a struct per instance, with its number
+/// of components and offset in the struct.
+struct InstanceAttribute {
+	GLuint location;
+	GLint size;
+	size_t offset;
+};
+
+/// Enables the attributes of the bound vertex array, advancing once per
+/// instance.
+void enableInstanceAttributes(const InstanceAttribute* attributes, size_t count);
+
+/// Points the attributes of the bound vertex array at the instance
+/// firstInstance of an array of structs of the given stride in buffer, which
+/// is left bound to GL_ARRAY_BUFFER.
+void pointInstanceAttributes(GLuint buffer, size_t firstInstance, size_t stride, const InstanceAttribute* attributes, size_t count);
+
+/// \brief Buffer object read by shaders through a buffer texture.
+struct BufferTexture {
+	GLBuffer buffer;
+	GLTexture texture;
+};
+
+/// Replaces the contents of target with size bytes of texels of the given
+/// format, creating it on first use. The buffer is orphaned, so draws still
+/// reading the previous contents do not stall.
+void uploadBufferTexture(BufferTexture* target, GLenum format, const void* data, size_t size);
+
+/// \brief Measures the GPU time of the commands between begin and end.
+///
+/// Two queries are used in turn, so that the result of the previous frame
+/// can be read without waiting for the GPU.
+class GpuTimer {
+public:
+	void begin();
+	void end();
+
+	/// Returns the last measured time, in milliseconds.
+	float milliseconds() const {
+		return lastMilliseconds;
+	}
+private:
+	GLQuery queries[2];
+	bool pending[2] = {false, false};
+	int current = 0;
+	float lastMilliseconds = 0.0f;
+};
+
 #endif // GLUtil_H
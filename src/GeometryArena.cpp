@@ -0,0 +1,165 @@
+//===----------------------------------------------------------------------===//
+//
+// This file is part of the Noxoscope project
+//
+// Copyright (c) 2016 Niklas Helmertz
+//
+//===----------------------------------------------------------------------===//
+
+#include "GeometryArena.h"
+
+#include <algorithm>
+
+#include "Mesh.h"
+#include "VertexPacking.h"
+#include "GLState.h"
+#include "GLUtil.h"
+#include "Logging.h"
+
+// The model matrix as four vec4 columns, then the normal matrix as three vec3
+// padded to vec4, then the color
+static constexpr size_t INSTANCE_ATTRIBUTE_COUNT = 8;
+static const InstanceAttribute INSTANCE_ATTRIBUTES[INSTANCE_ATTRIBUTE_COUNT] = {
+	{INSTANCE_ATTRIBUTE_LOCATION, 4, offsetof(InstanceData, modelMatrix)},
+	{INSTANCE_ATTRIBUTE_LOCATION + 1, 4, offsetof(InstanceData, modelMatrix) + sizeof(glm::vec4)},
+	{INSTANCE_ATTRIBUTE_LOCATION + 2, 4, offsetof(InstanceData, modelMatrix) + 2 * sizeof(glm::vec4)},
+	{INSTANCE_ATTRIBUTE_LOCATION + 3, 4, offsetof(InstanceData, modelMatrix) + 3 * sizeof(glm::vec4)},
+	{INSTANCE_ATTRIBUTE_LOCATION + 4, 3, offsetof(InstanceData, normalMatrix)},
+	{INSTANCE_ATTRIBUTE_LOCATION + 5, 3, offsetof(InstanceData, normalMatrix) + sizeof(glm::vec4)},
+	{INSTANCE_ATTRIBUTE_LOCATION + 6, 3, offsetof(InstanceData, normalMatrix) + 2 * sizeof(glm::vec4)},
+	{INSTANCE_ATTRIBUTE_LOCATION + 7, 4, offsetof(InstanceData, color)},
+};
+
+// Index ranges start at multiples of 4 bytes, so that 16 and 32-bit
+// indices can share the element buffer
+static size_t alignIndexOffset(size_t offset) {
+	return (offset + 3) & ~size_t(3);
+}
+
+// Moves the first usedBytes of buffer into a new buffer of capacity bytes
+static void reallocateBuffer(GLBuffer* buffer, size_t usedBytes, size_t capacity) {
+	GLBuffer resized;
+	resized.gen();
+	glBindBuffer(GL_COPY_WRITE_BUFFER, resized.handle);
+	glBufferData(GL_COPY_WRITE_BUFFER, capacity, nullptr, GL_STATIC_DRAW);
+	if (usedBytes > 0) {
+		glBindBuffer(GL_COPY_READ_BUFFER, buffer->handle);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, usedBytes);
+	}
+	*buffer = std::move(resized);
+}
+
+static size_t grownCapacity(size_t capacity, size_t initial, size_t required) {
+	capacity = std::max(capacity, initial);
+	while (capacity < required) {
+		capacity *= 2;
+	}
+	return capacity;
+}
+
+GeometryArena::GeometryArena(bool packedVertices)
+	: packedVertices(packedVertices),
+	  stride(packedVertices ? sizeof(PackedVertex) : sizeof(Vertex)) {}
+
+GeometryAllocation GeometryArena::allocate(const void* vertices, size_t vertexCount, const void* indices, size_t indexBytes) {
+	if (vao.handle == 0) {
+		vao.gen();
+	}
+
+	size_t vertexOffset = vertexUsed;
+	size_t vertexBytes = vertexCount * stride;
+	if (vertexOffset + vertexBytes > vertexCapacity) {
+		growVertices(vertexOffset + vertexBytes);
+	}
+	size_t indexOffset = alignIndexOffset(indexUsed);
+	if (indexOffset + indexBytes > indexCapacity) {
+		growIndices(indexOffset + indexBytes);
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer.handle);
+	glBufferSubData(GL_ARRAY_BUFFER, vertexOffset, vertexBytes, vertices);
+	// The element buffer binding belongs to the vertex array
+	glState.bindVertexArray(vao.handle);
+	glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, indexOffset, indexBytes, indices);
+
+	vertexUsed = vertexOffset + vertexBytes;
+	indexUsed = indexOffset + indexBytes;
+	return {static_cast<GLint>(vertexOffset / stride), indexOffset};
+}
+
+void GeometryArena::growVertices(size_t required) {
+	vertexCapacity = grownCapacity(vertexCapacity, ARENA_INITIAL_VERTEX_BYTES, required);
+	debug("Growing {} vertex arena to {} KiB", packedVertices ? "packed" : "unpacked", vertexCapacity / 1024);
+	reallocateBuffer(&vertexBuffer, vertexUsed, vertexCapacity);
+	// Vertex attributes refer to the buffer that was bound when they were set
+	setupVertexAttributes();
+}
+
+void GeometryArena::growIndices(size_t required) {
+	indexCapacity = grownCapacity(indexCapacity, ARENA_INITIAL_INDEX_BYTES, required);
+	debug("Growing {} index arena to {} KiB", packedVertices ? "packed" : "unpacked", indexCapacity / 1024);
+	reallocateBuffer(&elemBuffer, indexUsed, indexCapacity);
+	glState.bindVertexArray(vao.handle);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elemBuffer.handle);
+}
+
+void GeometryArena::setupVertexAttributes() {
+	glState.bindVertexArray(vao.handle);
+	glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer.handle);
+
+	if (packedVertices) {
+		// The w component of the position holds the bitangent sign
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 4, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(PackedVertex), nullptr);
+
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, sizeof(PackedVertex), reinterpret_cast<GLvoid*>(offsetof(PackedVertex, normal)));
+
+		glEnableVertexAttribArray(2);
+		glVertexAttribPointer(2, 2, GL_SHORT, GL_TRUE, sizeof(PackedVertex), reinterpret_cast<GLvoid*>(offsetof(PackedVertex, tangent)));
+
+		// The bitangent is rebuilt in the shaders
+		glDisableVertexAttribArray(3);
+
+		glEnableVertexAttribArray(4);
+		glVertexAttribPointer(4, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(PackedVertex), reinterpret_cast<GLvoid*>(offsetof(PackedVertex, texCoords)));
+		return;
+	}
+
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), nullptr);
+
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<GLvoid*>(offsetof(Vertex, normal)));
+
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<GLvoid*>(offsetof(Vertex, tangent)));
+
+	glEnableVertexAttribArray(3);
+	glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<GLvoid*>(offsetof(Vertex, bitangent)));
+
+	glEnableVertexAttribArray(4);
+	glVertexAttribPointer(4, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<GLvoid*>(offsetof(Vertex, texCoords)));
+}
+
+void GeometryArena::bindInstances(GLuint instanceBuffer, size_t firstInstance) {
+	glState.bindVertexArray(vao.handle);
+	pointInstanceAttributes(instanceBuffer, firstInstance, sizeof(InstanceData), INSTANCE_ATTRIBUTES, INSTANCE_ATTRIBUTE_COUNT);
+	if (!instanceAttributes) {
+		enableInstanceAttributes(INSTANCE_ATTRIBUTES, INSTANCE_ATTRIBUTE_COUNT);
+		instanceAttributes = true;
+	}
+}
+
+void GeometryArena::bindDrawIndices(GLuint buffer) {
+	glState.bindVertexArray(vao.handle);
+	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+	glVertexAttribIPointer(DRAW_INDEX_ATTRIBUTE_LOCATION, 2, GL_UNSIGNED_INT, 2 * sizeof(GLuint), nullptr);
+	glVertexAttribDivisor(DRAW_INDEX_ATTRIBUTE_LOCATION, 1);
+	glEnableVertexAttribArray(DRAW_INDEX_ATTRIBUTE_LOCATION);
+}
+
+void GeometryArena::unbindDrawIndices() {
+	glState.bindVertexArray(vao.handle);
+	glDisableVertexAttribArray(DRAW_INDEX_ATTRIBUTE_LOCATION);
+}
@@ -0,0 +1,126 @@
+//===----------------------------------------------------------------------===//
+//
+// This file is part of the Noxoscope project
+//
+// Copyright (c) 2016 Niklas Helmertz
+//
+//===----------------------------------------------------------------------===//
+//
+// Shared vertex and index storage for all meshes of one vertex format.
+//
+// Every mesh is a range of a large vertex buffer and a large element buffer,
+// which are described by a single vertex array. Meshes are drawn with the
+// base vertex variants of the draw calls, so that their indices stay local
+// to the mesh, and switching between meshes of the same format does not
+// touch the vertex array binding at all.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef GeometryArena_H
+#define GeometryArena_H
+
+#include <cstddef>
+
+#include <GL/glew.h>
+
+#include "GLObject.h"
+
+/// Initial sizes of the buffers of an arena, which double when they run out.
+constexpr size_t ARENA_INITIAL_VERTEX_BYTES = 4 * 1024 * 1024;
+constexpr size_t ARENA_INITIAL_INDEX_BYTES = 1024 * 1024;
+
+/// \brief Location of a mesh within a GeometryArena.
+struct GeometryAllocation {
+	/// Value added to every index of the mesh when drawing.
+	GLint baseVertex;
+	/// Byte offset of the first index of the mesh in the element buffer.
+	size_t indexOffset;
+};
+
+class GeometryArena {
+public:
+	/// Creates an empty arena for PackedVertex when packedVertices is set,
+	/// and for Vertex otherwise. No GL objects exist until the first mesh
+	/// is added.
+	explicit GeometryArena(bool packedVertices);
+
+	GeometryArena(const GeometryArena&) = delete;
+	GeometryArena& operator=(const GeometryArena&) = delete;
+
+	/// Appends vertexCount vertices of the format of the arena and
+	/// indexBytes bytes of 16 or 32-bit indices.
+	GeometryAllocation allocate(const void* vertices, size_t vertexCount, const void* indices, size_t indexBytes);
+
+	/// Points the instance attributes of the vertex array at InstanceData
+	/// starting at firstInstance in instanceBuffer.
+	void bindInstances(GLuint instanceBuffer, size_t firstInstance);
+
+	/// Enables the draw index attribute of the vertex array, reading one
+	/// uvec2 per instance from buffer, for indirect draws.
+	void bindDrawIndices(GLuint buffer);
+
+	/// Disables the draw index attribute again, so that draws without one
+	/// do not read past the end of its buffer.
+	void unbindDrawIndices();
+
+	GLuint vertexArray() const {
+		return vao.handle;
+	}
+
+	size_t vertexStride() const {
+		return stride;
+	}
+
+	/// Returns the bytes in use and allocated for vertices.
+	size_t vertexBytes() const {
+		return vertexUsed;
+	}
+
+	size_t vertexCapacityBytes() const {
+		return vertexCapacity;
+	}
+
+	/// Returns the bytes in use and allocated for indices.
+	size_t indexBytes() const {
+		return indexUsed;
+	}
+
+	size_t indexCapacityBytes() const {
+		return indexCapacity;
+	}
+
+private:
+	bool packedVertices;
+	size_t stride;
+	GLVertexArray vao;
+	GLBuffer vertexBuffer;
+	GLBuffer elemBuffer;
+	size_t vertexUsed = 0;
+	size_t vertexCapacity = 0;
+	size_t indexUsed = 0;
+	size_t indexCapacity = 0;
+	/// Whether the instance attributes of the vertex array are enabled,
+	/// which happens on the first instanced draw.
+	bool instanceAttributes = false;
+
+	void growVertices(size_t required);
+	void growIndices(size_t required);
+	void setupVertexAttributes();
+};
+
+/// \brief The arenas of both vertex formats.
+class GeometryArenas {
+public:
+	GeometryArena& get(bool packedVertices) {
+		return packedVertices ? packed : unpacked;
+	}
+
+	const GeometryArena& get(bool packedVertices) const {
+		return packedVertices ? packed : unpacked;
+	}
+private:
+	GeometryArena packed{true};
+	GeometryArena unpacked{false};
+};
+
+#endif // GeometryArena_H
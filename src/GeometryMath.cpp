@@ -8,6 +8,10 @@
 
 #include "GeometryMath.h"
 
+#include <cmath>
+#include <algorithm>
+
+#include <glm/matrix.hpp>
 #include <glm/gtc/quaternion.hpp>
 
 glm::vec3 cartesianToSpherical(glm::vec3 cartesian) {
@@ -28,3 +32,71 @@ glm::vec3 sphericalToCartesian(float radius, float inclination, float azimuth) {
 		radius * sin(inclination) * sin(azimuth)
 	);
 }
+
+Frustum extractFrustum(const glm::mat4& viewProjection) {
+	using namespace glm;
+	// Gribb and Hartmann, with m[column][row]
+	const mat4& m = viewProjection;
+	vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+	vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+	vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+	vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+	Frustum frustum;
+	frustum.planes[0] = row3 + row0;
+	frustum.planes[1] = row3 - row0;
+	frustum.planes[2] = row3 + row1;
+	frustum.planes[3] = row3 - row1;
+	frustum.planes[4] = row3 + row2;
+	frustum.planes[5] = row3 - row2;
+	for (auto& plane : frustum.planes) {
+		plane /= length(vec3(plane));
+	}
+	return frustum;
+}
+
+bool sphereInFrustum(const Frustum& frustum, glm::vec3 center, float radius) {
+	for (auto& plane : frustum.planes) {
+		if (glm::dot(glm::vec3(plane), center) + plane.w < -radius) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool boxInFrustum(const Frustum& frustum, glm::vec3 boxMin, glm::vec3 boxMax) {
+	using namespace glm;
+	vec3 center = (boxMin + boxMax) * 0.5f;
+	vec3 extent = (boxMax - boxMin) * 0.5f;
+	for (auto& plane : frustum.planes) {
+		// Distance of the corner furthest along the plane normal
+		float distance = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w;
+		float reach = std::abs(plane.x) * extent.x + std::abs(plane.y) * extent.y + std::abs(plane.z) * extent.z;
+		if (distance + reach < 0.0f) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void transformBox(const glm::mat4& matrix, glm::vec3 boxMin, glm::vec3 boxMax, glm::vec3* resultMin, glm::vec3* resultMax) {
+	using namespace glm;
+	// Arvo, with the extent along each axis of the transformed box
+	vec3 center = vec3(matrix * vec4((boxMin + boxMax) * 0.5f, 1.0f));
+	vec3 extent = (boxMax - boxMin) * 0.5f;
+	vec3 transformedExtent =
+		abs(vec3(matrix[0])) * extent.x +
+		abs(vec3(matrix[1])) * extent.y +
+		abs(vec3(matrix[2])) * extent.z;
+	*resultMin = center - transformedExtent;
+	*resultMax = center + transformedExtent;
+}
+
+float maxScale(const glm::mat4& matrix) {
+	using namespace glm;
+	return std::max({length(vec3(matrix[0])), length(vec3(matrix[1])), length(vec3(matrix[2]))});
+}
+
+glm::mat3 normalMatrix(const glm::mat4& modelMatrix) {
+	return glm::transpose(glm::inverse(glm::mat3(modelMatrix)));
+}
@@ -10,6 +10,9 @@
 #define GeometryMath_H
 
 #include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <glm/mat3x3.hpp>
+#include <glm/mat4x4.hpp>
 
 constexpr float PI_F = 3.14159265358979f;
 
@@ -17,4 +20,29 @@ glm::vec3 cartesianToSpherical(glm::vec3 cartesian);
 glm::vec3 sphericalToCartesian(float radius, float theta, float phi);
 glm::vec3 sphericalToCartesian(glm::vec3 spherical);
 
+/// Planes of a view frustum, with xyz as the normal pointing into the frustum
+/// and w as the distance, so that dot(plane, vec4(p, 1)) >= 0 inside.
+struct Frustum {
+	glm::vec4 planes[6];
+};
+
+/// Extracts the frustum of a view-projection matrix, with normalized planes.
+Frustum extractFrustum(const glm::mat4& viewProjection);
+
+/// Returns false if the sphere is entirely outside of the frustum.
+bool sphereInFrustum(const Frustum& frustum, glm::vec3 center, float radius);
+
+/// Returns false if the axis-aligned box is entirely outside of one of the
+/// frustum planes. Boxes near corners of the frustum may pass while outside.
+bool boxInFrustum(const Frustum& frustum, glm::vec3 boxMin, glm::vec3 boxMax);
+
+/// Finds the axis-aligned box enclosing a box transformed by matrix.
+void transformBox(const glm::mat4& matrix, glm::vec3 boxMin, glm::vec3 boxMax, glm::vec3* resultMin, glm::vec3* resultMax);
+
+/// Returns the largest factor that the matrix scales any axis by.
+float maxScale(const glm::mat4& matrix);
+
+/// Returns the matrix transforming normals along with the given model matrix.
+glm::mat3 normalMatrix(const glm::mat4& modelMatrix);
+
 #endif // GeometryMath_H
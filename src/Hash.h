@@ -0,0 +1,38 @@
+//===----------------------------------------------------------------------===//
+//
+// This file is part of the Noxoscope project
+//
+// Copyright (c) 2016 Niklas Helmertz
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef Hash_H
+#define Hash_H
+
+#include <cstdint>
+#include <cstddef>
+
+constexpr uint64_t FNV_OFFSET_BASIS = 14695981039346656037ull;
+constexpr uint64_t FNV_PRIME = 1099511628211ull;
+
+/// 64-bit FNV-1a hash of a block of memory. Pass a previous result as the
+/// initial hash to hash several blocks as one.
+inline uint64_t hashFnv1a(const void* data, size_t size, uint64_t hash = FNV_OFFSET_BASIS) {
+	auto bytes = static_cast<const unsigned char*>(data);
+	for (size_t i = 0; i < size; i++) {
+		hash ^= bytes[i];
+		hash *= FNV_PRIME;
+	}
+	return hash;
+}
+
+/// 64-bit FNV-1a hash of a null-terminated string, usable at compile time.
+constexpr uint64_t hashString(const char* str, uint64_t hash = FNV_OFFSET_BASIS) {
+	while (*str != '\0') {
+		hash ^= static_cast<unsigned char>(*str++);
+		hash *= FNV_PRIME;
+	}
+	return hash;
+}
+
+#endif // Hash_H
@@ -15,6 +15,14 @@ struct PointLight {
 	glm::vec3 position;
 	float radius;
 	glm::vec3 color;
+
+	/// Factor of the linear attenuation of the light, uploaded with it to
+	/// the lighting shaders. The intensity at a distance is
+	/// 1 + attenuation() * distance, falling from 1 at the light to 0 at the
+	/// radius. Shaders that may reach pixels beyond the radius clamp it at 0.
+	float attenuation() const {
+		return -1.0f / radius;
+	}
 };
 
 #endif // Light_H
@@ -0,0 +1,63 @@
+//===----------------------------------------------------------------------===//
+//
+// This file is part of the Noxoscope project
+//
+// Copyright (c) 2016 Niklas Helmertz
+//
+//===----------------------------------------------------------------------===//
+
+#include "LightBatches.h"
+
+#include <algorithm>
+
+#include "LightQuads.h"
+
+// Spreads the lower 16 bits of a value to the even bits
+static uint32_t spreadBits(uint32_t value) {
+	value &= 0xFFFF;
+	value = (value | (value << 8)) & 0x00FF00FF;
+	value = (value | (value << 4)) & 0x0F0F0F0F;
+	value = (value | (value << 2)) & 0x33333333;
+	value = (value | (value << 1)) & 0x55555555;
+	return value;
+}
+
+void LightBatches::build(const std::vector<PointLight>& lights, const glm::mat4& viewMatrix, const glm::mat4& projection,
+		float near, float far, size_t batchSize) {
+	using namespace glm;
+	this->batchSize = std::min(std::max(batchSize, static_cast<size_t>(1)), LIGHT_BATCH_MAX_SIZE);
+	entries.clear();
+	for (size_t i = 0; i < lights.size(); i++) {
+		vec3 center = vec3(viewMatrix * vec4(lights[i].position, 1.0f));
+		SphereBounds bounds;
+		if (!projectSphere(center, lights[i].radius, projection, near, far, &bounds)) {
+			continue;
+		}
+		vec2 screenCenter = (vec2(bounds.rect.x, bounds.rect.y) + vec2(bounds.rect.z, bounds.rect.w)) * 0.25f + 0.5f;
+		auto x = static_cast<uint32_t>(clamp(screenCenter.x, 0.0f, 1.0f) * 0xFFFF);
+		auto y = static_cast<uint32_t>(clamp(screenCenter.y, 0.0f, 1.0f) * 0xFFFF);
+		entries.push_back({spreadBits(x) | (spreadBits(y) << 1), static_cast<uint32_t>(i), bounds.rect});
+	}
+	std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+		return a.morton < b.morton;
+	});
+
+	size_t count = (entries.size() + this->batchSize - 1) / this->batchSize;
+	batches.resize(count);
+	rects.resize(count);
+	for (size_t batch = 0; batch < count; batch++) {
+		auto& uniforms = batches[batch];
+		size_t first = batch * this->batchSize;
+		size_t last = std::min(first + this->batchSize, entries.size());
+		uniforms.lightCount = static_cast<GLint>(last - first);
+		vec4 rect(1.0f, 1.0f, -1.0f, -1.0f);
+		for (size_t i = first; i < last; i++) {
+			auto& light = lights[entries[i].light];
+			size_t slot = 2 * (i - first);
+			uniforms.lights[slot] = vec4(vec3(viewMatrix * vec4(light.position, 1.0f)), light.radius);
+			uniforms.lights[slot + 1] = vec4(light.color, light.attenuation());
+			rect = vec4(min(vec2(rect), vec2(entries[i].rect)), max(vec2(rect.z, rect.w), vec2(entries[i].rect.z, entries[i].rect.w)));
+		}
+		rects[batch] = rect;
+	}
+}
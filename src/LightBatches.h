@@ -0,0 +1,76 @@
+//===----------------------------------------------------------------------===//
+//
+// This file is part of the Noxoscope project
+//
+// Copyright (c) 2016 Niklas Helmertz
+//
+//===----------------------------------------------------------------------===//
+//
+// Batched deferred shading without compute shaders.
+//
+// The lights are split into batches of up to LIGHT_BATCH_MAX_SIZE, each
+// uploaded as a uniform block and shaded in one full screen pass that loops
+// over the lights of the batch, so the light buffer is blended once per
+// batch instead of once per light. Lights close to each other on screen are
+// batched together, in the order of the Morton codes of their centers, and
+// every pass is scissored to the union of the screen rectangles of its
+// lights.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LightBatches_H
+#define LightBatches_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include <glm/glm.hpp>
+
+#include "Light.h"
+#include "UniformBuffer.h"
+
+/// Batch sizes to choose from.
+constexpr size_t LIGHT_BATCH_SIZES[] = {16, 32, 64};
+
+class LightBatches {
+public:
+	/// Groups the lights in view into batches of at most batchSize lights.
+	void build(const std::vector<PointLight>& lights, const glm::mat4& viewMatrix, const glm::mat4& projection,
+		float near, float far, size_t batchSize);
+
+	size_t batchCount() const {
+		return batches.size();
+	}
+
+	/// Block contents of a batch.
+	const LightBatchUniforms& uniforms(size_t batch) const {
+		return batches[batch];
+	}
+
+	/// Normalized device coordinates of the rectangle covering the lights of
+	/// a batch, min x and y then max.
+	glm::vec4 rect(size_t batch) const {
+		return rects[batch];
+	}
+
+	/// Index in the built lights of a light of a batch, in the order of its
+	/// block.
+	uint32_t lightIndex(size_t batch, size_t light) const {
+		return entries[batch * batchSize + light].light;
+	}
+
+private:
+	struct Entry {
+		uint32_t morton;
+		uint32_t light;
+		glm::vec4 rect;
+	};
+
+	size_t batchSize = 0;
+	std::vector<Entry> entries;
+	std::vector<LightBatchUniforms> batches;
+	std::vector<glm::vec4> rects;
+};
+
+#endif // LightBatches_H
@@ -0,0 +1,157 @@
+//===----------------------------------------------------------------------===//
+//
+// This file is part of the Noxoscope project
+//
+// Copyright (c) 2016 Niklas Helmertz
+//
+//===----------------------------------------------------------------------===//
+
+#include "LightClusters.h"
+
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+#include "GLState.h"
+
+void LightClusters::setProjection(const glm::mat4& projection, float near, float far) {
+	using namespace glm;
+	if (!clusterMins.empty() && projection == this->projection && near == this->near && far == this->far) {
+		return;
+	}
+	this->projection = projection;
+	this->near = near;
+	this->far = far;
+	sliceScale = 1.0f / std::log(far / near);
+
+	// Corners of the tiles on the near plane, as view space rays to scale by depth
+	mat4 inverseProjection = inverse(projection);
+	std::vector<vec3> rays((CLUSTER_COUNT_X + 1) * (CLUSTER_COUNT_Y + 1));
+	for (int y = 0; y <= CLUSTER_COUNT_Y; y++) {
+		for (int x = 0; x <= CLUSTER_COUNT_X; x++) {
+			vec4 ndc(-1.0f + 2.0f * x / CLUSTER_COUNT_X, -1.0f + 2.0f * y / CLUSTER_COUNT_Y, -1.0f, 1.0f);
+			vec4 p = inverseProjection * ndc;
+			vec3 point = vec3(p) / p.w;
+			rays[y * (CLUSTER_COUNT_X + 1) + x] = point / -point.z;
+		}
+	}
+
+	clusterMins.resize(CLUSTER_COUNT);
+	clusterMaxs.resize(CLUSTER_COUNT);
+	for (int z = 0; z < CLUSTER_COUNT_Z; z++) {
+		float depths[] = {
+			near * std::pow(far / near, static_cast<float>(z) / CLUSTER_COUNT_Z),
+			near * std::pow(far / near, static_cast<float>(z + 1) / CLUSTER_COUNT_Z)
+		};
+		for (int y = 0; y < CLUSTER_COUNT_Y; y++) {
+			for (int x = 0; x < CLUSTER_COUNT_X; x++) {
+				vec3 low(std::numeric_limits<float>::max());
+				vec3 high(-std::numeric_limits<float>::max());
+				for (int corner = 0; corner < 4; corner++) {
+					vec3 ray = rays[(y + corner / 2) * (CLUSTER_COUNT_X + 1) + x + corner % 2];
+					for (float depth : depths) {
+						low = min(low, ray * depth);
+						high = max(high, ray * depth);
+					}
+				}
+				int cluster = clusterIndex(x, y, z);
+				clusterMins[cluster] = low;
+				clusterMaxs[cluster] = high;
+			}
+		}
+	}
+}
+
+int LightClusters::slice(float depth) const {
+	int z = static_cast<int>(std::floor(std::log(depth / near) * sliceScale * CLUSTER_COUNT_Z));
+	return std::min(std::max(z, 0), CLUSTER_COUNT_Z - 1);
+}
+
+void LightClusters::assign(const std::vector<PointLight>& lights, const glm::mat4& viewMatrix) {
+	using namespace glm;
+	pairClusters.clear();
+	pairLights.clear();
+	for (size_t i = 0; i < lights.size(); i++) {
+		vec3 center = vec3(viewMatrix * vec4(lights[i].position, 1.0f));
+		float radius = lights[i].radius;
+		float nearDepth = std::max(-center.z - radius, near);
+		float farDepth = std::min(-center.z + radius, far);
+		if (nearDepth > farDepth) {
+			continue;
+		}
+
+		// Tiles covered by the box around the sphere, within its depth range
+		vec2 ndcMin(std::numeric_limits<float>::max());
+		vec2 ndcMax(-std::numeric_limits<float>::max());
+		for (int corner = 0; corner < 8; corner++) {
+			vec4 p(center.x + ((corner & 1) ? radius : -radius), center.y + ((corner & 2) ? radius : -radius), (corner & 4) ? -farDepth : -nearDepth, 1.0f);
+			vec4 clip = projection * p;
+			vec2 ndc = vec2(clip) / clip.w;
+			ndcMin = min(ndcMin, ndc);
+			ndcMax = max(ndcMax, ndc);
+		}
+		auto tile = [](float ndc, int count) {
+			return std::min(std::max(static_cast<int>(std::floor((ndc * 0.5f + 0.5f) * count)), 0), count - 1);
+		};
+		if (ndcMax.x < -1.0f || ndcMin.x > 1.0f || ndcMax.y < -1.0f || ndcMin.y > 1.0f) {
+			continue;
+		}
+		int x0 = tile(ndcMin.x, CLUSTER_COUNT_X);
+		int x1 = tile(ndcMax.x, CLUSTER_COUNT_X);
+		int y0 = tile(ndcMin.y, CLUSTER_COUNT_Y);
+		int y1 = tile(ndcMax.y, CLUSTER_COUNT_Y);
+		int z0 = slice(nearDepth);
+		int z1 = slice(farDepth);
+
+		for (int z = z0; z <= z1; z++) {
+			for (int y = y0; y <= y1; y++) {
+				for (int x = x0; x <= x1; x++) {
+					int cluster = clusterIndex(x, y, z);
+					vec3 offset = center - clamp(center, clusterMins[cluster], clusterMaxs[cluster]);
+					if (dot(offset, offset) <= radius * radius) {
+						pairClusters.push_back(static_cast<uint32_t>(cluster));
+						pairLights.push_back(static_cast<uint32_t>(i));
+					}
+				}
+			}
+		}
+	}
+
+	// Counting sort of the assignments by cluster
+	ranges.assign(2 * CLUSTER_COUNT, 0);
+	for (auto cluster : pairClusters) {
+		ranges[2 * cluster + 1]++;
+	}
+	uint32_t offset = 0;
+	for (int cluster = 0; cluster < CLUSTER_COUNT; cluster++) {
+		ranges[2 * cluster] = offset;
+		offset += ranges[2 * cluster + 1];
+	}
+	indices.resize(pairLights.size());
+	std::vector<uint32_t> next(CLUSTER_COUNT);
+	for (int cluster = 0; cluster < CLUSTER_COUNT; cluster++) {
+		next[cluster] = ranges[2 * cluster];
+	}
+	for (size_t i = 0; i < pairLights.size(); i++) {
+		indices[next[pairClusters[i]]++] = pairLights[i];
+	}
+}
+
+void LightClusterTextures::update(const LightClusters& clusters, const std::vector<PointLight>& lights, const glm::mat4& viewMatrix) {
+	using namespace glm;
+	lightTexels.clear();
+	lightTexels.reserve(lights.size() * CLUSTER_LIGHT_TEXELS);
+	for (auto& light : lights) {
+		lightTexels.push_back(vec4(vec3(viewMatrix * vec4(light.position, 1.0f)), light.attenuation()));
+		lightTexels.push_back(vec4(light.color, light.radius));
+	}
+	uploadBufferTexture(&lightData, GL_RGBA32F, lightTexels.data(), lightTexels.size() * sizeof(vec4));
+	uploadBufferTexture(&ranges, GL_RG32UI, clusters.clusterRanges().data(), clusters.clusterRanges().size() * sizeof(uint32_t));
+	uploadBufferTexture(&indices, GL_R32UI, clusters.lightIndices().data(), clusters.lightIndices().size() * sizeof(uint32_t));
+}
+
+void LightClusterTextures::bind(GLuint firstUnit) const {
+	glState.bindTexture(firstUnit, lightData.texture.handle, GL_TEXTURE_BUFFER);
+	glState.bindTexture(firstUnit + 1, ranges.texture.handle, GL_TEXTURE_BUFFER);
+	glState.bindTexture(firstUnit + 2, indices.texture.handle, GL_TEXTURE_BUFFER);
+}
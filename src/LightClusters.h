@@ -0,0 +1,118 @@
+//===----------------------------------------------------------------------===//
+//
+// This file is part of the Noxoscope project
+//
+// Copyright (c) 2016 Niklas Helmertz
+//
+//===----------------------------------------------------------------------===//
+//
+// Clustered light culling for deferred shading.
+//
+// The view frustum is divided into a grid of clusters: screen tiles that are
+// split into depth slices growing exponentially from the near to the far
+// plane. Every light is assigned to the clusters whose view space bounding
+// boxes intersect its sphere, on the CPU since compute shaders are not
+// available with OpenGL 3.3. The light lists are uploaded as buffer
+// textures, which the shading pass reads to loop over only the lights of
+// the cluster of each pixel.
+//
+// The grid dimensions and the slice formula are repeated in
+// clusteredlight.frag and have to be kept in sync with it.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LightClusters_H
+#define LightClusters_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "Light.h"
+#include "GLObject.h"
+#include "GLUtil.h"
+
+constexpr int CLUSTER_COUNT_X = 16;
+constexpr int CLUSTER_COUNT_Y = 9;
+constexpr int CLUSTER_COUNT_Z = 24;
+constexpr int CLUSTER_COUNT = CLUSTER_COUNT_X * CLUSTER_COUNT_Y * CLUSTER_COUNT_Z;
+
+/// Texels of light data per light in the light buffer texture.
+constexpr int CLUSTER_LIGHT_TEXELS = 2;
+
+class LightClusters {
+public:
+	/// Computes the bounds of the clusters for a perspective projection,
+	/// which has to be called before assigning lights. Does nothing if the
+	/// projection has not changed.
+	void setProjection(const glm::mat4& projection, float near, float far);
+
+	/// Assigns the lights, given in world space, to the clusters they reach.
+	void assign(const std::vector<PointLight>& lights, const glm::mat4& viewMatrix);
+
+	/// Depth slice of a view space distance in front of the camera.
+	int slice(float depth) const;
+
+	static int clusterIndex(int x, int y, int z) {
+		return x + CLUSTER_COUNT_X * (y + CLUSTER_COUNT_Y * z);
+	}
+
+	/// Offset into lightIndices and light count of each cluster, interleaved.
+	const std::vector<uint32_t>& clusterRanges() const {
+		return ranges;
+	}
+
+	/// Indices of the lights of all clusters, in cluster order.
+	const std::vector<uint32_t>& lightIndices() const {
+		return indices;
+	}
+
+	/// View space bounding box of a cluster.
+	glm::vec3 clusterMin(int cluster) const {
+		return clusterMins[cluster];
+	}
+	glm::vec3 clusterMax(int cluster) const {
+		return clusterMaxs[cluster];
+	}
+
+private:
+	glm::mat4 projection;
+	float near = 0.0f;
+	float far = 0.0f;
+	/// Precomputed 1 / log(far / near), to find slices.
+	float sliceScale = 0.0f;
+	std::vector<glm::vec3> clusterMins;
+	std::vector<glm::vec3> clusterMaxs;
+	std::vector<uint32_t> ranges;
+	std::vector<uint32_t> indices;
+	/// Cluster and light of every assignment, before sorting by cluster.
+	std::vector<uint32_t> pairClusters;
+	std::vector<uint32_t> pairLights;
+};
+
+/// \brief Buffer textures holding the lights and cluster lists for shading.
+///
+/// The lights are stored in view space as CLUSTER_LIGHT_TEXELS RGBA32F
+/// texels: position and strength, then color and radius.
+class LightClusterTextures {
+public:
+	/// Uploads the current light lists of clusters, and the lights in view
+	/// space. The buffers are orphaned, so draws still reading the previous
+	/// contents do not stall.
+	void update(const LightClusters& clusters, const std::vector<PointLight>& lights, const glm::mat4& viewMatrix);
+
+	/// Binds the light data, cluster ranges and light indices to three
+	/// consecutive texture units starting at firstUnit.
+	void bind(GLuint firstUnit) const;
+
+private:
+	BufferTexture lightData;
+	BufferTexture ranges;
+	BufferTexture indices;
+	std::vector<glm::vec4> lightTexels;
+};
+
+#endif // LightClusters_H
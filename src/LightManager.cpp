@@ -0,0 +1,256 @@
+//===----------------------------------------------------------------------===//
+//
+// This file is part of the Noxoscope project
+//
+// Copyright (c) 2016 Niklas Helmertz
+//
+//===----------------------------------------------------------------------===//
+
+#include "LightManager.h"
+
+#include <cmath>
+#include <algorithm>
+
+#include "LightClusters.h"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define NS_LIGHT_SSE
+#include <xmmintrin.h>
+#endif
+
+// Trees with fewer insertions since their last rebuild are kept as they are
+constexpr size_t LIGHT_REBUILD_MIN_INSERTS = 64;
+
+static void lightBox(const PointLight& light, float margin, glm::vec3* boxMin, glm::vec3* boxMax) {
+	float extent = light.radius * (1.0f + margin);
+	*boxMin = light.position - glm::vec3(extent);
+	*boxMax = light.position + glm::vec3(extent);
+}
+
+LightId LightManager::add(const PointLight& light) {
+	LightId id;
+	if (freeIds.empty()) {
+		id = static_cast<LightId>(indices.size());
+		indices.push_back(LIGHT_NULL);
+	} else {
+		id = freeIds.back();
+		freeIds.pop_back();
+	}
+	auto index = static_cast<uint32_t>(lights.size());
+	indices[id] = index;
+	lights.push_back(light);
+	ids.push_back(id);
+
+	Record record;
+	lightBox(light, LIGHT_BOX_MARGIN, &record.boxMin, &record.boxMax);
+	record.proxy = bvh.insert(id, record.boxMin, record.boxMax);
+	record.orbit = LIGHT_NULL;
+	record.orbitSlot = LIGHT_NULL;
+	records.push_back(record);
+	insertCount++;
+	return id;
+}
+
+void LightManager::remove(LightId id) {
+	uint32_t index = indices[id];
+	leaveOrbit(index);
+	bvh.remove(records[index].proxy);
+
+	// The last light takes the place of the removed one
+	uint32_t last = static_cast<uint32_t>(lights.size() - 1);
+	if (index != last) {
+		lights[index] = lights[last];
+		ids[index] = ids[last];
+		records[index] = records[last];
+		indices[ids[index]] = index;
+	}
+	lights.pop_back();
+	ids.pop_back();
+	records.pop_back();
+	indices[id] = LIGHT_NULL;
+	freeIds.push_back(id);
+}
+
+void LightManager::set(LightId id, const PointLight& light) {
+	uint32_t index = indices[id];
+	lights[index] = light;
+	if (records[index].orbit != LIGHT_NULL) {
+		storeOrbitOffset(index);
+	}
+	moved(index);
+}
+
+void LightManager::moved(uint32_t index) {
+	auto& light = lights[index];
+	auto& record = records[index];
+	glm::vec3 boxMin;
+	glm::vec3 boxMax;
+	lightBox(light, 0.0f, &boxMin, &boxMax);
+	if (glm::all(glm::greaterThanEqual(boxMin, record.boxMin)) && glm::all(glm::lessThanEqual(boxMax, record.boxMax))) {
+		return;
+	}
+	// Reinserting finds a new place for the light, where refitting would
+	// only grow the boxes along the way it moves
+	bvh.remove(record.proxy);
+	lightBox(light, LIGHT_BOX_MARGIN, &record.boxMin, &record.boxMax);
+	record.proxy = bvh.insert(ids[index], record.boxMin, record.boxMax);
+	insertCount++;
+}
+
+size_t LightManager::addOrbit(glm::vec3 center, float angularSpeed) {
+	Orbit orbit;
+	orbit.center = center;
+	orbit.angularSpeed = angularSpeed;
+	orbits.push_back(std::move(orbit));
+	return orbits.size() - 1;
+}
+
+void LightManager::setOrbit(LightId id, size_t orbit) {
+	uint32_t index = indices[id];
+	leaveOrbit(index);
+	auto& target = orbits[orbit];
+	records[index].orbit = static_cast<uint32_t>(orbit);
+	records[index].orbitSlot = static_cast<uint32_t>(target.lights.size());
+	target.lights.push_back(id);
+	target.offsetX.push_back(0.0f);
+	target.offsetZ.push_back(0.0f);
+	storeOrbitOffset(index);
+}
+
+void LightManager::leaveOrbit(uint32_t index) {
+	auto& record = records[index];
+	if (record.orbit == LIGHT_NULL) {
+		return;
+	}
+	auto& orbit = orbits[record.orbit];
+	uint32_t slot = record.orbitSlot;
+	uint32_t last = static_cast<uint32_t>(orbit.lights.size() - 1);
+	if (slot != last) {
+		orbit.lights[slot] = orbit.lights[last];
+		orbit.offsetX[slot] = orbit.offsetX[last];
+		orbit.offsetZ[slot] = orbit.offsetZ[last];
+		records[indices[orbit.lights[slot]]].orbitSlot = slot;
+	}
+	orbit.lights.pop_back();
+	orbit.offsetX.pop_back();
+	orbit.offsetZ.pop_back();
+	record.orbit = LIGHT_NULL;
+	record.orbitSlot = LIGHT_NULL;
+}
+
+void LightManager::storeOrbitOffset(uint32_t index) {
+	auto& record = records[index];
+	auto& orbit = orbits[record.orbit];
+	orbit.offsetX[record.orbitSlot] = lights[index].position.x - orbit.center.x;
+	orbit.offsetZ[record.orbitSlot] = lights[index].position.z - orbit.center.z;
+}
+
+void LightManager::animate(float seconds) {
+	for (auto& orbit : orbits) {
+		// Rotation around the y axis, the same as glm::rotateY
+		float angle = orbit.angularSpeed * seconds;
+		float c = std::cos(angle);
+		float s = std::sin(angle);
+		float* x = orbit.offsetX.data();
+		float* z = orbit.offsetZ.data();
+		size_t count = orbit.lights.size();
+		size_t i = 0;
+#ifdef NS_LIGHT_SSE
+		__m128 cosines = _mm_set1_ps(c);
+		__m128 sines = _mm_set1_ps(s);
+		for (; i + 4 <= count; i += 4) {
+			__m128 oldX = _mm_loadu_ps(x + i);
+			__m128 oldZ = _mm_loadu_ps(z + i);
+			_mm_storeu_ps(x + i, _mm_add_ps(_mm_mul_ps(oldX, cosines), _mm_mul_ps(oldZ, sines)));
+			_mm_storeu_ps(z + i, _mm_sub_ps(_mm_mul_ps(oldZ, cosines), _mm_mul_ps(oldX, sines)));
+		}
+#endif
+		for (; i < count; i++) {
+			float oldX = x[i];
+			x[i] = oldX * c + z[i] * s;
+			z[i] = z[i] * c - oldX * s;
+		}
+
+		for (size_t j = 0; j < count; j++) {
+			uint32_t index = indices[orbit.lights[j]];
+			lights[index].position.x = orbit.center.x + x[j];
+			lights[index].position.z = orbit.center.z + z[j];
+			moved(index);
+		}
+	}
+}
+
+void LightManager::cull(const glm::mat4& viewMatrix, const glm::mat4& projection, int screenHeight, LightCullStatistics* stats) {
+	using namespace glm;
+	if (insertCount >= LIGHT_REBUILD_MIN_INSERTS && insertCount >= bvh.size() / 2) {
+		bvh.rebuild();
+		insertCount = 0;
+	}
+
+	auto frustum = extractFrustum(projection * viewMatrix);
+	candidates.clear();
+	bvh.queryFrustum(frustum, &candidates);
+	// Gathering in storage order keeps the output stable between frames
+	visibleIndexList.clear();
+	for (auto id : candidates) {
+		visibleIndexList.push_back(indices[id]);
+	}
+	std::sort(visibleIndexList.begin(), visibleIndexList.end());
+
+	// Radius in pixels of a sphere of radius 1 at a distance of 1
+	float pixelScale = projection[1][1] * 0.5f * screenHeight;
+	*stats = LightCullStatistics();
+	stats->lightCount = lights.size();
+	visible.clear();
+	size_t kept = 0;
+	for (auto index : visibleIndexList) {
+		auto& light = lights[index];
+		if (!sphereInFrustum(frustum, light.position, light.radius)) {
+			continue;
+		}
+		float depth = -(viewMatrix * vec4(light.position, 1.0f)).z;
+		if (depth > light.radius && light.radius * pixelScale < LIGHT_MIN_SCREEN_RADIUS * depth) {
+			stats->smallCount++;
+			continue;
+		}
+		if (std::max({light.color.r, light.color.g, light.color.b}) < LIGHT_MIN_INTENSITY) {
+			stats->dimCount++;
+			continue;
+		}
+		visibleIndexList[kept++] = index;
+		visible.push_back(light);
+	}
+	visibleIndexList.resize(kept);
+	stats->visibleCount = kept;
+}
+
+void LightManager::queryFrustum(const Frustum& frustum, std::vector<LightId>* found) const {
+	size_t first = found->size();
+	bvh.queryFrustum(frustum, found);
+	// The tree boxes include the margin, so the spheres are tested again
+	auto last = std::remove_if(found->begin() + first, found->end(), [&](LightId id) {
+		auto& light = lights[indices[id]];
+		return !sphereInFrustum(frustum, light.position, light.radius);
+	});
+	found->erase(last, found->end());
+}
+
+void LightManager::queryCluster(const LightClusters& clusters, int cluster, const glm::mat4& viewMatrix, std::vector<LightId>* found) const {
+	using namespace glm;
+	vec3 viewMin = clusters.clusterMin(cluster);
+	vec3 viewMax = clusters.clusterMax(cluster);
+	vec3 boxMin;
+	vec3 boxMax;
+	transformBox(inverse(viewMatrix), viewMin, viewMax, &boxMin, &boxMax);
+	size_t first = found->size();
+	bvh.queryBox(boxMin, boxMax, found);
+
+	// Exact test against the box in view space, as in the cluster assignment
+	auto last = std::remove_if(found->begin() + first, found->end(), [&](LightId id) {
+		auto& light = lights[indices[id]];
+		vec3 center = vec3(viewMatrix * vec4(light.position, 1.0f));
+		vec3 offset = center - clamp(center, viewMin, viewMax);
+		return dot(offset, offset) > light.radius * light.radius;
+	});
+	found->erase(last, found->end());
+}
@@ -0,0 +1,163 @@
+//===----------------------------------------------------------------------===//
+//
+// This file is part of the Noxoscope project
+//
+// Copyright (c) 2016 Niklas Helmertz
+//
+//===----------------------------------------------------------------------===//
+//
+// Storage and culling of the point lights of the scene.
+//
+// Lights are kept densely, with stable ids mapping to their current index,
+// and in a bounding volume hierarchy over their spheres. The boxes in the
+// tree are enlarged by a margin, so that lights moving a little do not
+// change the tree at all.
+//
+// Each frame, the lights in the view frustum are gathered through the tree,
+// skipping those too small on screen or too dim to change a pixel, so the
+// renderers only see the lights that contribute to the frame.
+//
+// Lights orbiting a vertical axis are animated in batches, with their
+// offsets from the axis stored as separate x and z arrays that are rotated
+// four lights at a time with SSE.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LightManager_H
+#define LightManager_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include <glm/glm.hpp>
+
+#include "Bvh.h"
+#include "Light.h"
+#include "GeometryMath.h"
+
+class LightClusters;
+
+typedef uint32_t LightId;
+
+constexpr LightId LIGHT_NULL = UINT32_MAX;
+
+/// Margin of the boxes of lights in the tree, relative to their radius.
+constexpr float LIGHT_BOX_MARGIN = 0.25f;
+
+/// Lights with a smaller radius on screen, in pixels, are culled.
+constexpr float LIGHT_MIN_SCREEN_RADIUS = 1.0f;
+
+/// Lights with no color component above this are culled, since they do not
+/// reach one quantization step of an 8-bit color.
+constexpr float LIGHT_MIN_INTENSITY = 1.0f / 255.0f;
+
+/// \brief Counts of the lights culled in the last frame.
+struct LightCullStatistics {
+	size_t lightCount = 0;
+	size_t visibleCount = 0;
+	size_t smallCount = 0;
+	size_t dimCount = 0;
+};
+
+class LightManager {
+public:
+	LightId add(const PointLight& light);
+
+	void remove(LightId id);
+
+	/// Replaces the position, radius and color of a light.
+	void set(LightId id, const PointLight& light);
+
+	const PointLight& get(LightId id) const {
+		return lights[indices[id]];
+	}
+
+	size_t size() const {
+		return lights.size();
+	}
+
+	/// All lights, in an order that changes when lights are removed.
+	const std::vector<PointLight>& all() const {
+		return lights;
+	}
+
+	/// Id of the light at an index of all().
+	LightId idAt(size_t index) const {
+		return ids[index];
+	}
+
+	/// Adds a group of lights rotating around the vertical axis through
+	/// center, with angularSpeed in radians per second. Returns the orbit.
+	size_t addOrbit(glm::vec3 center, float angularSpeed);
+
+	/// Makes a light follow an orbit.
+	void setOrbit(LightId id, size_t orbit);
+
+	/// Moves the lights of all orbits by the given time.
+	void animate(float seconds);
+
+	/// Gathers the lights that are in the frustum and large and bright
+	/// enough to contribute to a screen of the given height.
+	void cull(const glm::mat4& viewMatrix, const glm::mat4& projection, int screenHeight, LightCullStatistics* stats);
+
+	/// Lights found by the last cull, in the order of all().
+	const std::vector<PointLight>& visibleLights() const {
+		return visible;
+	}
+
+	/// Indices in all() of the lights of visibleLights().
+	const std::vector<uint32_t>& visibleIndices() const {
+		return visibleIndexList;
+	}
+
+	/// Appends the lights with spheres that may intersect the frustum.
+	void queryFrustum(const Frustum& frustum, std::vector<LightId>* found) const;
+
+	/// Appends the lights with spheres that intersect the view space box of
+	/// a cluster.
+	void queryCluster(const LightClusters& clusters, int cluster, const glm::mat4& viewMatrix, std::vector<LightId>* found) const;
+
+private:
+	struct Record {
+		BvhProxy proxy;
+		/// Box of the light in the tree.
+		glm::vec3 boxMin;
+		glm::vec3 boxMax;
+		/// Orbit of the light and its index within it, or LIGHT_NULL.
+		uint32_t orbit;
+		uint32_t orbitSlot;
+	};
+
+	struct Orbit {
+		glm::vec3 center;
+		float angularSpeed;
+		std::vector<LightId> lights;
+		/// Offsets of the lights from the axis.
+		std::vector<float> offsetX;
+		std::vector<float> offsetZ;
+	};
+
+	std::vector<PointLight> lights;
+	std::vector<LightId> ids;
+	std::vector<Record> records;
+	/// Index of the light of each id, or LIGHT_NULL for free ids.
+	std::vector<uint32_t> indices;
+	std::vector<LightId> freeIds;
+	std::vector<Orbit> orbits;
+	Bvh bvh;
+	/// Lights inserted into the tree since it was last rebuilt.
+	size_t insertCount = 0;
+
+	std::vector<PointLight> visible;
+	std::vector<uint32_t> visibleIndexList;
+	std::vector<LightId> candidates;
+
+	/// Updates the box of a light in the tree if it no longer contains the
+	/// sphere of the light.
+	void moved(uint32_t index);
+	void leaveOrbit(uint32_t index);
+	void storeOrbitOffset(uint32_t index);
+};
+
+#endif // LightManager_H
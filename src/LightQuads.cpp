@@ -0,0 +1,133 @@
+//===----------------------------------------------------------------------===//
+//
+// This file is part of the Noxoscope project
+//
+// Copyright (c) 2016 Niklas Helmertz
+//
+//===----------------------------------------------------------------------===//
+
+#include "LightQuads.h"
+
+#include <cmath>
+#include <algorithm>
+
+#include "GLState.h"
+
+bool projectSphere(const glm::vec3& center, float radius, const glm::mat4& projection,
+		float near, float far, SphereBounds* bounds) {
+	using namespace glm;
+	float depth = -center.z;
+	if (depth + radius < near || depth - radius > far) {
+		return false;
+	}
+	bounds->nearDepth = std::max(depth - radius, near);
+	bounds->farDepth = std::min(depth + radius, far);
+	if (depth - radius <= near) {
+		bounds->rect = vec4(-1.0f, -1.0f, 1.0f, 1.0f);
+		return true;
+	}
+
+	// The planes through the camera tangent to the sphere, found separately
+	// for each axis in the plane of that axis and the depth
+	vec2 low;
+	vec2 high;
+	for (int axis = 0; axis < 2; axis++) {
+		vec2 c(center[axis], depth);
+		float distance = length(c);
+		float cosine = std::sqrt(distance * distance - radius * radius) / distance;
+		float sine = radius / distance;
+		// Points of tangency, rotating the center by the angle of the tangent
+		// either way and scaling it to the tangent length
+		vec2 a = cosine * vec2(cosine * c.x - sine * c.y, sine * c.x + cosine * c.y);
+		vec2 b = cosine * vec2(cosine * c.x + sine * c.y, -sine * c.x + cosine * c.y);
+		float projectedA = (projection[axis][axis] * a.x - projection[2][axis] * a.y) / a.y;
+		float projectedB = (projection[axis][axis] * b.x - projection[2][axis] * b.y) / b.y;
+		low[axis] = std::min(projectedA, projectedB);
+		high[axis] = std::max(projectedA, projectedB);
+	}
+	if (low.x > 1.0f || low.y > 1.0f || high.x < -1.0f || high.y < -1.0f) {
+		return false;
+	}
+	bounds->rect = vec4(max(low, vec2(-1.0f)), min(high, vec2(1.0f)));
+	return true;
+}
+
+const InstanceAttribute LightQuads::ATTRIBUTES[ATTRIBUTE_COUNT] = {
+	{LIGHT_QUAD_ATTRIBUTE_LOCATION, 4, offsetof(Quad, rect)},
+	{LIGHT_QUAD_ATTRIBUTE_LOCATION + 1, 4, offsetof(Quad, positionRadius)},
+	{LIGHT_QUAD_ATTRIBUTE_LOCATION + 2, 4, offsetof(Quad, colorStrength)},
+	{LIGHT_QUAD_ATTRIBUTE_LOCATION + 3, 2, offsetof(Quad, depthRange)},
+};
+
+void LightQuads::create() {
+	vao.regen();
+	instanceBuffer.regen();
+	glState.bindVertexArray(vao.handle);
+	enableInstanceAttributes(ATTRIBUTES, ATTRIBUTE_COUNT);
+	glState.bindVertexArray(0);
+}
+
+void LightQuads::update(const std::vector<PointLight>& lights, const glm::mat4& viewMatrix, const glm::mat4& projection,
+		float near, float far, int width, int height) {
+	using namespace glm;
+	quads.clear();
+	windowDepths.clear();
+	pixelCoverage.assign(lights.size(), 0);
+	totalCoverage = 0;
+
+	auto windowDepth = [&projection](float depth) {
+		double ndc = (-projection[2][2] * depth + projection[3][2]) / depth;
+		return std::min(std::max(ndc * 0.5 + 0.5, 0.0), 1.0);
+	};
+	for (size_t i = 0; i < lights.size(); i++) {
+		auto& light = lights[i];
+		vec3 center = vec3(viewMatrix * vec4(light.position, 1.0f));
+		SphereBounds bounds;
+		if (!projectSphere(center, light.radius, projection, near, far, &bounds)) {
+			continue;
+		}
+		// Pixels whose centers the rectangle covers
+		vec4 pixels = (bounds.rect * 0.5f + 0.5f) * vec4(width, height, width, height);
+		auto x0 = static_cast<int>(std::round(pixels.x));
+		auto y0 = static_cast<int>(std::round(pixels.y));
+		auto x1 = static_cast<int>(std::round(pixels.z));
+		auto y1 = static_cast<int>(std::round(pixels.w));
+		if (x1 <= x0 || y1 <= y0) {
+			continue;
+		}
+		pixelCoverage[i] = static_cast<uint32_t>((x1 - x0) * (y1 - y0));
+		totalCoverage += pixelCoverage[i];
+
+		quads.push_back({
+			bounds.rect,
+			vec4(center, light.radius),
+			vec4(light.color, light.attenuation()),
+			vec2(-bounds.farDepth, -bounds.nearDepth)
+		});
+		windowDepths.push_back({windowDepth(bounds.nearDepth), windowDepth(bounds.farDepth)});
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer.handle);
+	glBufferData(GL_ARRAY_BUFFER, quads.size() * sizeof(Quad), quads.data(), GL_STREAM_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void LightQuads::render(bool depthBounds) const {
+	if (quads.empty()) {
+		return;
+	}
+	// The corners of the quads come from the vertex ids
+	glState.bindVertexArray(vao.handle);
+	if (!depthBounds) {
+		pointInstanceAttributes(instanceBuffer.handle, 0, sizeof(Quad), ATTRIBUTES, ATTRIBUTE_COUNT);
+		glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, static_cast<GLsizei>(quads.size()));
+		return;
+	}
+	glState.enable(GL_DEPTH_BOUNDS_TEST_EXT);
+	for (size_t i = 0; i < quads.size(); i++) {
+		pointInstanceAttributes(instanceBuffer.handle, i, sizeof(Quad), ATTRIBUTES, ATTRIBUTE_COUNT);
+		glDepthBoundsEXT(windowDepths[i].min, windowDepths[i].max);
+		glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, 1);
+	}
+	glState.disable(GL_DEPTH_BOUNDS_TEST_EXT);
+}
@@ -0,0 +1,109 @@
+//===----------------------------------------------------------------------===//
+//
+// This file is part of the Noxoscope project
+//
+// Copyright (c) 2016 Niklas Helmertz
+//
+//===----------------------------------------------------------------------===//
+//
+// Screen space bounded quads for deferred shading.
+//
+// Every light sphere is projected on the CPU to the tightest screen rectangle
+// containing it, and to the range of window depths it spans. The lights are
+// shaded by quads covering only their rectangles, and pixels whose scene
+// depth is outside the range are rejected, by the depth bounds test where
+// EXT_depth_bounds_test is available and otherwise in the shader.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LightQuads_H
+#define LightQuads_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "Light.h"
+#include "GLObject.h"
+#include "GLUtil.h"
+
+/// First attribute location of the light quad vertex shader.
+constexpr GLuint LIGHT_QUAD_ATTRIBUTE_LOCATION = 0;
+
+/// \brief Screen space bounds of a sphere.
+struct SphereBounds {
+	/// Normalized device coordinates of the rectangle, min x and y then max.
+	glm::vec4 rect;
+	/// View space depths, as positive distances in front of the camera.
+	float nearDepth;
+	float farDepth;
+};
+
+/// Projects a view space sphere with a perspective projection. Returns false
+/// if the sphere is outside the view. Spheres crossing the near plane get the
+/// whole screen.
+bool projectSphere(const glm::vec3& center, float radius, const glm::mat4& projection,
+	float near, float far, SphereBounds* bounds);
+
+class LightQuads {
+public:
+	/// Creates the instance buffer and its vertex array.
+	void create();
+
+	/// Finds the bounds and pixel coverage of the lights, and uploads the
+	/// quads of those in view. The buffer is orphaned, so draws still reading
+	/// the previous quads do not stall.
+	void update(const std::vector<PointLight>& lights, const glm::mat4& viewMatrix, const glm::mat4& projection,
+		float near, float far, int width, int height);
+
+	/// Draws the quads. With depth bounds, every quad is drawn separately to
+	/// set its bounds, otherwise all in one instanced draw.
+	void render(bool depthBounds) const;
+
+	/// Pixels covered by the quad of each light of the last update, 0 for
+	/// lights outside the view.
+	const std::vector<uint32_t>& coverage() const {
+		return pixelCoverage;
+	}
+
+	size_t quadCount() const {
+		return quads.size();
+	}
+
+	/// Pixels covered by all quads together.
+	uint64_t coveredPixels() const {
+		return totalCoverage;
+	}
+
+private:
+	/// Per instance attributes: the rectangle, view space position and
+	/// radius of the light, its color and linear attenuation, and the view
+	/// space depth range.
+	struct Quad {
+		glm::vec4 rect;
+		glm::vec4 positionRadius;
+		glm::vec4 colorStrength;
+		glm::vec2 depthRange;
+	};
+
+	/// Window depths of the bounds of each quad, for the depth bounds test.
+	struct DepthBounds {
+		double min;
+		double max;
+	};
+
+	static constexpr size_t ATTRIBUTE_COUNT = 4;
+	static const InstanceAttribute ATTRIBUTES[ATTRIBUTE_COUNT];
+
+	GLVertexArray vao;
+	GLBuffer instanceBuffer;
+	std::vector<Quad> quads;
+	std::vector<DepthBounds> windowDepths;
+	std::vector<uint32_t> pixelCoverage;
+	uint64_t totalCoverage = 0;
+};
+
+#endif // LightQuads_H
@@ -0,0 +1,128 @@
+//===----------------------------------------------------------------------===//
+//
+// This file is part of the Noxoscope project
+//
+// Copyright (c) 2016 Niklas Helmertz
+//
+//===----------------------------------------------------------------------===//
+
+#include "LightVolumes.h"
+
+#include <map>
+#include <cmath>
+#include <utility>
+#include <algorithm>
+
+#include "GLState.h"
+
+void generateIcosphere(int subdivisions, std::vector<glm::vec3>* vertices, std::vector<uint16_t>* indices) {
+	using namespace glm;
+	const float t = (1.0f + std::sqrt(5.0f)) / 2.0f;
+	*vertices = {
+		vec3(-1.0f, t, 0.0f), vec3(1.0f, t, 0.0f), vec3(-1.0f, -t, 0.0f), vec3(1.0f, -t, 0.0f),
+		vec3(0.0f, -1.0f, t), vec3(0.0f, 1.0f, t), vec3(0.0f, -1.0f, -t), vec3(0.0f, 1.0f, -t),
+		vec3(t, 0.0f, -1.0f), vec3(t, 0.0f, 1.0f), vec3(-t, 0.0f, -1.0f), vec3(-t, 0.0f, 1.0f)
+	};
+	*indices = {
+		0, 11, 5, 0, 5, 1, 0, 1, 7, 0, 7, 10, 0, 10, 11,
+		1, 5, 9, 5, 11, 4, 11, 10, 2, 10, 7, 6, 7, 1, 8,
+		3, 9, 4, 3, 4, 2, 3, 2, 6, 3, 6, 8, 3, 8, 9,
+		4, 9, 5, 2, 4, 11, 6, 2, 10, 8, 6, 7, 9, 8, 1
+	};
+	for (auto& vertex : *vertices) {
+		vertex = normalize(vertex);
+	}
+
+	// Every triangle is split into four, with the new vertices shared by the
+	// triangles on both sides of an edge
+	for (int i = 0; i < subdivisions; i++) {
+		std::map<std::pair<uint16_t, uint16_t>, uint16_t> midpoints;
+		auto midpoint = [&](uint16_t a, uint16_t b) {
+			auto key = std::make_pair(std::min(a, b), std::max(a, b));
+			auto it = midpoints.find(key);
+			if (it != midpoints.end()) {
+				return it->second;
+			}
+			auto index = static_cast<uint16_t>(vertices->size());
+			vertices->push_back(normalize((*vertices)[a] + (*vertices)[b]));
+			midpoints.emplace(key, index);
+			return index;
+		};
+		std::vector<uint16_t> subdivided;
+		subdivided.reserve(indices->size() * 4);
+		for (size_t j = 0; j < indices->size(); j += 3) {
+			uint16_t a = (*indices)[j];
+			uint16_t b = (*indices)[j + 1];
+			uint16_t c = (*indices)[j + 2];
+			uint16_t ab = midpoint(a, b);
+			uint16_t bc = midpoint(b, c);
+			uint16_t ca = midpoint(c, a);
+			subdivided.insert(subdivided.end(), {a, ab, ca, b, bc, ab, c, ca, bc, ab, bc, ca});
+		}
+		*indices = std::move(subdivided);
+	}
+
+	// The faces cut into the unit sphere, so it is scaled by the closest one
+	float closest = 1.0f;
+	for (size_t i = 0; i < indices->size(); i += 3) {
+		vec3 a = (*vertices)[(*indices)[i]];
+		vec3 b = (*vertices)[(*indices)[i + 1]];
+		vec3 c = (*vertices)[(*indices)[i + 2]];
+		closest = std::min(closest, dot(normalize(cross(b - a, c - a)), a));
+	}
+	for (auto& vertex : *vertices) {
+		vertex /= closest;
+	}
+}
+
+void LightVolumes::create() {
+	std::vector<glm::vec3> vertices;
+	std::vector<uint16_t> indices;
+	// One subdivision is close enough to the sphere to not shade much outside it
+	generateIcosphere(1, &vertices, &indices);
+	indexCount = static_cast<GLsizei>(indices.size());
+
+	vao.regen();
+	vertexBuffer.regen();
+	indexBuffer.regen();
+	instanceBuffer.regen();
+	glState.bindVertexArray(vao.handle);
+
+	glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer.handle);
+	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec3), vertices.data(), GL_STATIC_DRAW);
+	glEnableVertexAttribArray(LIGHT_VOLUME_POSITION_LOCATION);
+	glVertexAttribPointer(LIGHT_VOLUME_POSITION_LOCATION, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), nullptr);
+
+	glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer.handle);
+	for (GLuint i = 0; i < 2; i++) {
+		glEnableVertexAttribArray(LIGHT_VOLUME_LIGHT_LOCATION + i);
+		glVertexAttribPointer(LIGHT_VOLUME_LIGHT_LOCATION + i, 4, GL_FLOAT, GL_FALSE, sizeof(Instance),
+			reinterpret_cast<GLvoid*>(i * sizeof(glm::vec4)));
+		glVertexAttribDivisor(LIGHT_VOLUME_LIGHT_LOCATION + i, 1);
+	}
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer.handle);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint16_t), indices.data(), GL_STATIC_DRAW);
+	glState.bindVertexArray(0);
+}
+
+void LightVolumes::update(const std::vector<PointLight>& lights) {
+	using namespace glm;
+	instances.clear();
+	instances.reserve(lights.size());
+	for (auto& light : lights) {
+		instances.push_back({vec4(light.position, light.radius), vec4(light.color, light.attenuation())});
+	}
+	instanceCount = static_cast<GLsizei>(instances.size());
+	glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer.handle);
+	glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(Instance), instances.data(), GL_STREAM_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void LightVolumes::render() const {
+	if (instanceCount == 0) {
+		return;
+	}
+	glState.bindVertexArray(vao.handle);
+	glDrawElementsInstanced(GL_TRIANGLES, indexCount, GL_UNSIGNED_SHORT, nullptr, instanceCount);
+}
@@ -0,0 +1,78 @@
+//===----------------------------------------------------------------------===//
+//
+// This file is part of the Noxoscope project
+//
+// Copyright (c) 2016 Niklas Helmertz
+//
+//===----------------------------------------------------------------------===//
+//
+// Instanced light volumes for deferred shading.
+//
+// Every light is drawn as an icosphere scaled to its radius, all in a single
+// instanced draw with the light parameters as per instance attributes. Only
+// the back faces are drawn, with a depth test that passes where scene
+// geometry lies in front of them, so the lighting is only computed for
+// pixels that may be inside the volume, without the stencil pass and clear
+// needed per light otherwise.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LightVolumes_H
+#define LightVolumes_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "Light.h"
+#include "GLObject.h"
+
+/// Attribute locations of the light volume vertex shader.
+constexpr GLuint LIGHT_VOLUME_POSITION_LOCATION = 0;
+constexpr GLuint LIGHT_VOLUME_LIGHT_LOCATION = 1;
+
+/// \brief Generates an icosphere enclosing the unit sphere.
+///
+/// An icosahedron is subdivided the given number of times, and scaled so
+/// that every face is at least at distance 1 from the origin, so a light
+/// volume covers all of the light sphere. Faces wind counterclockwise seen
+/// from the outside.
+void generateIcosphere(int subdivisions, std::vector<glm::vec3>* vertices, std::vector<uint16_t>* indices);
+
+class LightVolumes {
+public:
+	/// Creates the sphere mesh and the instance buffer.
+	void create();
+
+	/// Uploads the lights to the instance buffer. The buffer is orphaned, so
+	/// draws still reading the previous lights do not stall.
+	void update(const std::vector<PointLight>& lights);
+
+	/// Draws the volume of every light of the last update.
+	void render() const;
+
+	size_t lightCount() const {
+		return static_cast<size_t>(instanceCount);
+	}
+
+private:
+	/// Per instance attributes, the light position and radius, then its
+	/// color and linear attenuation.
+	struct Instance {
+		glm::vec4 positionRadius;
+		glm::vec4 colorStrength;
+	};
+
+	GLVertexArray vao;
+	GLBuffer vertexBuffer;
+	GLBuffer indexBuffer;
+	GLBuffer instanceBuffer;
+	GLsizei indexCount = 0;
+	GLsizei instanceCount = 0;
+	std::vector<Instance> instances;
+};
+
+#endif // LightVolumes_H
@@ -8,60 +8,122 @@
 
 #include "Mesh.h"
 
+#include <cfloat>
 #include <tuple>
+#include <algorithm>
 
 #include <glm/gtc/type_ptr.hpp>
 
 #include "Constants.h"
+#include "VertexPacking.h"
+#include "GLState.h"
 
-Mesh::Mesh(const std::vector<Vertex>& vertices, const std::vector<GLuint>& indices, MeshTexture diffuseTexture, MeshTexture specularTexture, MeshTexture normalTexture, glm::vec4 color, float specular)
-	: vertices{vertices},
-	  indices{indices},
-	  diffuseTexture(diffuseTexture),
+GLenum chooseIndexType(size_t vertexCount) {
+	return vertexCount <= 0x10000 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+}
+
+size_t indexTypeSize(GLenum indexType) {
+	return indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+}
+
+Mesh::Mesh(const Vertex* vertices, size_t vertexCount, const GLuint* indices, size_t indexCount, const std::vector<MeshLod>& lods, const std::vector<Meshlet>& meshlets, MeshTexture diffuseTexture, MeshTexture specularTexture, MeshTexture normalTexture, glm::vec4 color, float specular, GeometryArenas& arenas, bool packVertices)
+	: diffuseTexture(diffuseTexture),
 	  specularTexture(specularTexture),
 	  normalTexture(normalTexture),
 	  color{color},
-	  specular{specular} {
-	this->setupMesh();
+	  specular{specular},
+	  indexCount{static_cast<GLsizei>(indexCount)},
+	  indexType{chooseIndexType(vertexCount)},
+	  arena{&arenas.get(packVertices)},
+	  vertexCount{vertexCount},
+	  packedVertices{packVertices},
+	  positionOffset{0.0f},
+	  positionScale{1.0f} {
+	this->lods.push_back({0, indexCount, 0.0f});
+	this->lods.insert(this->lods.end(), lods.begin(), lods.end());
+	this->meshlets = meshlets;
+	size_t totalIndexCount = indexCount;
+	for (auto& lod : lods) {
+		totalIndexCount = std::max(totalIndexCount, lod.firstIndex + lod.indexCount);
+	}
+	this->setupMesh(vertices, vertexCount, indices, totalIndexCount);
 }
 
-void Mesh::setupMesh() {
-	glGenVertexArrays(1, &this->vertexArray);
-	glGenBuffers(1, &this->vertexBuffer);
-	glGenBuffers(1, &this->elemBuffer);
-
-	glBindVertexArray(this->vertexArray);
-	glBindBuffer(GL_ARRAY_BUFFER, this->vertexBuffer);
-
-	glBufferData(GL_ARRAY_BUFFER, this->vertices.size() * sizeof(Vertex), &this->vertices[0], GL_STATIC_DRAW);
-
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->elemBuffer);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, this->indices.size() * sizeof(GLuint), &this->indices[0], GL_STATIC_DRAW);
-
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), nullptr);
+void Mesh::setupMesh(const Vertex* vertices, size_t vertexCount, const GLuint* indices, size_t totalIndexCount) {
+	using namespace glm;
+	vec3 low(FLT_MAX);
+	vec3 high(-FLT_MAX);
+	for (size_t i = 0; i < vertexCount; i++) {
+		low = min(low, vertices[i].position);
+		high = max(high, vertices[i].position);
+	}
+	boundsMin = vertexCount > 0 ? low : vec3(0.0f);
+	boundsMax = vertexCount > 0 ? high : vec3(0.0f);
+	boundsCenter = (boundsMin + boundsMax) / 2.0f;
+	boundsRadius = 0.0f;
+	for (size_t i = 0; i < vertexCount; i++) {
+		boundsRadius = std::max(boundsRadius, distance(boundsCenter, vertices[i].position));
+	}
+	this->totalIndexCount = totalIndexCount;
+
+	GeometryAllocation allocation;
+	if (packedVertices) {
+		auto quantization = positionQuantization(vertices, vertexCount);
+		positionOffset = quantization.offset;
+		positionScale = quantization.scale;
+		std::vector<PackedVertex> packed(vertexCount);
+		for (size_t i = 0; i < vertexCount; i++) {
+			packed[i] = packVertex(vertices[i], quantization);
+		}
+		allocation = upload(packed.data(), vertexCount, indices, totalIndexCount);
+	} else {
+		// Data is uploaded straight from the caller, which may be a mapped cache file
+		allocation = upload(vertices, vertexCount, indices, totalIndexCount);
+	}
+	baseVertex = allocation.baseVertex;
+	indexStart = allocation.indexOffset;
+}
 
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<GLvoid*>(offsetof(Vertex, normal)));
+GeometryAllocation Mesh::upload(const void* vertices, size_t vertexCount, const GLuint* indices, size_t totalIndexCount) {
+	if (indexType == GL_UNSIGNED_SHORT) {
+		std::vector<GLushort> narrowed(indices, indices + totalIndexCount);
+		return arena->allocate(vertices, vertexCount, narrowed.data(), narrowed.size() * sizeof(GLushort));
+	}
+	return arena->allocate(vertices, vertexCount, indices, totalIndexCount * sizeof(GLuint));
+}
 
-	glEnableVertexAttribArray(2);
-	glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<GLvoid*>(offsetof(Vertex, tangent)));
+void Mesh::render(const ShaderProgram& shader, size_t lod) {
+	auto& range = lods[std::min(lod, lods.size() - 1)];
+	auto count = static_cast<GLsizei>(range.indexCount);
+	auto offset = indexOffset(range.firstIndex);
+	render(shader, &count, &offset, 1);
+}
 
-	glEnableVertexAttribArray(3);
-	glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<GLvoid*>(offsetof(Vertex, bitangent)));
+void Mesh::render(const ShaderProgram& shader, const GLsizei* counts, const GLvoid* const* offsets, GLsizei drawCount) {
+	if (drawCount == 0) {
+		return;
+	}
+	bindMaterial(shader);
+
+	glState.bindVertexArray(arena->vertexArray());
+	if (drawCount == 1) {
+		glDrawElementsBaseVertex(GL_TRIANGLES, counts[0], this->indexType, offsets[0], baseVertex);
+	} else {
+		std::vector<GLint> baseVertices(drawCount, baseVertex);
+		glMultiDrawElementsBaseVertex(GL_TRIANGLES, counts, this->indexType, offsets, drawCount, baseVertices.data());
+	}
+}
 
-	glEnableVertexAttribArray(4);
-	glVertexAttribPointer(4, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<GLvoid*>(offsetof(Vertex, texCoords)));
+void Mesh::renderInstanced(const ShaderProgram& shader, GLsizei count, const GLvoid* offset, GLuint instanceBuffer, size_t firstInstance, GLsizei instanceCount) {
+	bindMaterial(shader);
 
-	glBindVertexArray(0);
+	arena->bindInstances(instanceBuffer, firstInstance);
+	glDrawElementsInstancedBaseVertex(GL_TRIANGLES, count, this->indexType, offset, instanceCount, baseVertex);
 }
 
-void Mesh::render(const ShaderProgram& shader) {
+void Mesh::bindMaterial(const ShaderProgram& shader) {
 	using namespace glm;
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, 0);
-
-	GLenum texCount = 0;
+	GLuint texCount = 0;
 
 	auto modelTex = {
 		std::make_tuple(&diffuseTexture, UNIFORM_TEXTURE_DIFFUSE, UNIFORM_HAS_DIFFUSE_TEXTURE),
@@ -75,22 +137,80 @@ void Mesh::render(const ShaderProgram& shader) {
 		auto hasTexName = std::get<2>(texInfo);
 
 		bool hasTex = tex->glObject != nullptr;
-		glActiveTexture(GL_TEXTURE0 + texCount);
-
 		if (hasTex) {
 			glUniform1i(shader[texUniformName], texCount);
-			glBindTexture(GL_TEXTURE_2D, tex->glObject->handle);
+			glState.bindTexture(texCount, tex->glObject->array->handle(), GL_TEXTURE_2D_ARRAY);
 		}
 
 		glUniform1i(shader[hasTexName], hasTex);
 		texCount++;
 	}
 
+	glUniform3fv(shader[UNIFORM_TEXTURE_LAYERS], 1, value_ptr(textureLayers()));
 	glUniform4fv(shader[UNIFORM_COLOR_DIFFUSE], 1, value_ptr(color));
 	glUniform1f(shader[UNIFORM_SPECULAR], specular);
 	glUniform1f(shader[UNIFORM_REFLECTIVENESS], reflectiveness);
+	glUniform1i(shader[UNIFORM_PACKED_VERTEX_FORMAT], packedVertices);
+	glUniform3fv(shader[UNIFORM_POSITION_OFFSET], 1, value_ptr(positionOffset));
+	glUniform3fv(shader[UNIFORM_POSITION_SCALE], 1, value_ptr(positionScale));
+}
+
+glm::vec3 Mesh::textureLayers() const {
+	glm::vec3 layers(0.0f);
+	const MeshTexture* textures[] = {&diffuseTexture, &specularTexture, &normalTexture};
+	for (int i = 0; i < 3; i++) {
+		if (textures[i]->glObject != nullptr) {
+			layers[i] = static_cast<float>(textures[i]->glObject->layer);
+		}
+	}
+	return layers;
+}
+
+const GLvoid* Mesh::indexOffset(size_t firstIndex) const {
+	return reinterpret_cast<const GLvoid*>(indexStart + firstIndex * indexTypeSize(indexType));
+}
+
+DrawElementsIndirectCommand Mesh::indirectCommand(GLsizei count, const GLvoid* offset, GLuint baseInstance, GLuint instanceCount) const {
+	// Offsets are in bytes, while commands count indices
+	auto firstIndex = reinterpret_cast<size_t>(offset) / indexTypeSize(indexType);
+	return {static_cast<GLuint>(count), instanceCount, static_cast<GLuint>(firstIndex), baseVertex, baseInstance};
+}
+
+MaterialRecord Mesh::materialRecord(float texRepeatFactor) const {
+	using namespace glm;
+	return {
+		color,
+		vec4(textureLayers(), texRepeatFactor),
+		vec4(positionOffset, specular),
+		vec4(positionScale, reflectiveness)
+	};
+}
+
+size_t Mesh::vertexMemory() const {
+	return vertexCount * (packedVertices ? sizeof(PackedVertex) : sizeof(Vertex));
+}
+
+size_t Mesh::unpackedVertexMemory() const {
+	return vertexCount * sizeof(Vertex);
+}
+
+size_t Mesh::selectLod(float pixelsPerUnit, size_t currentLod) const {
+	// Errors grow with every level, so take the last one that is small enough
+	size_t lod = 0;
+	while (lod + 1 < lods.size() && lods[lod + 1].error * pixelsPerUnit <= LOD_PIXEL_ERROR) {
+		lod++;
+	}
+	// Only go coarser once the error is clearly below the threshold
+	while (lod > currentLod && lods[lod].error * pixelsPerUnit > LOD_PIXEL_ERROR * LOD_HYSTERESIS) {
+		lod--;
+	}
+	return lod;
+}
+
+size_t Mesh::indexMemory() const {
+	return totalIndexCount * indexTypeSize(indexType);
+}
 
-	glBindVertexArray(this->vertexArray);
-	glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(this->indices.size()), GL_UNSIGNED_INT, nullptr);
-	glBindVertexArray(0);
+size_t Mesh::wideIndexMemory() const {
+	return totalIndexCount * sizeof(GLuint);
 }
@@ -18,6 +18,10 @@
 
 #include "ShaderProgram.h"
 #include "GLObject.h"
+#include "Meshlets.h"
+#include "GeometryArena.h"
+#include "TextureArrays.h"
+#include "OcclusionCulling.h"
 
 struct Vertex {
 	glm::vec3 position;
@@ -27,16 +31,100 @@ struct Vertex {
 	glm::vec2 texCoords;
 };
 
+/// Returns the smallest index type able to address vertexCount vertices,
+/// either GL_UNSIGNED_SHORT or GL_UNSIGNED_INT.
+GLenum chooseIndexType(size_t vertexCount);
+
+/// Returns the size in bytes of a GL_UNSIGNED_SHORT or GL_UNSIGNED_INT index.
+size_t indexTypeSize(GLenum indexType);
+
+/// Projected error in pixels below which a simplified LOD may be drawn.
+constexpr float LOD_PIXEL_ERROR = 1.0f;
+
+/// Fraction of LOD_PIXEL_ERROR the error must fall below before switching
+/// to a coarser LOD, so that meshes near a threshold do not flicker.
+constexpr float LOD_HYSTERESIS = 0.7f;
+
+/// \brief Level of detail of a mesh, as a range of its indices.
+///
+/// The first index is relative to the first index of the mesh, and the
+/// error is the distance in model space to the full detail surface.
+struct MeshLod {
+	size_t firstIndex;
+	size_t indexCount;
+	float error;
+};
+
+/// \brief Index ranges to draw for every mesh of a model, such as the meshlets
+/// that survived culling.
+///
+/// The ranges of mesh i are at [meshStarts[i], meshStarts[i + 1]), with
+/// offsets into the element buffer of its arena as given by Mesh::indexOffset.
+struct DrawRanges {
+	std::vector<GLsizei> counts;
+	std::vector<const GLvoid*> offsets;
+	std::vector<size_t> meshStarts;
+};
+
+/// \brief Per-instance data of instanced draws.
+///
+/// The vertex shaders read the model matrix from four vec4 attributes at
+/// INSTANCE_ATTRIBUTE_LOCATION, followed by the normal matrix as three vec3
+/// and the color as a vec4. Indirect draws read the same data as
+/// INSTANCE_RECORD_TEXELS RGBA32F texels instead.
+struct InstanceData {
+	glm::mat4 modelMatrix;
+	/// Columns are padded to vec4, to keep every field a whole texel.
+	glm::mat3x4 normalMatrix;
+	/// Multiplied with the diffuse color of the material.
+	glm::vec4 color;
+};
+
+static_assert(sizeof(InstanceData) == 128, "Unexpected padding in InstanceData");
+
+constexpr GLuint INSTANCE_ATTRIBUTE_LOCATION = 5;
+constexpr size_t INSTANCE_RECORD_TEXELS = sizeof(InstanceData) / sizeof(glm::vec4);
+
+/// Location of the uvec2 attribute holding the instance and material record
+/// of every instance in indirect draws.
+constexpr GLuint DRAW_INDEX_ATTRIBUTE_LOCATION = 13;
+
+/// \brief Material of a mesh as read by the vertex shaders in indirect draws,
+/// as MATERIAL_RECORD_TEXELS RGBA32F texels.
+struct MaterialRecord {
+	glm::vec4 color;
+	/// Layers of the diffuse, specular and normal textures within their
+	/// arrays, and the texture repeat factor of the model.
+	glm::vec4 layersRepeat;
+	/// Offset and scale of packed vertex positions, with the specular factor
+	/// and the reflectiveness in w.
+	glm::vec4 positionOffsetSpecular;
+	glm::vec4 positionScaleReflectiveness;
+};
+
+constexpr size_t MATERIAL_RECORD_TEXELS = sizeof(MaterialRecord) / sizeof(glm::vec4);
+
+/// \brief Draw read by glMultiDrawElementsIndirect, of instanceCount
+/// instances of an index range.
+struct DrawElementsIndirectCommand {
+	GLuint count;
+	GLuint instanceCount;
+	GLuint firstIndex;
+	GLint baseVertex;
+	/// Offsets the attributes read per instance, which needs
+	/// ARB_base_instance to be anything but zero.
+	GLuint baseInstance;
+};
+
+static_assert(sizeof(DrawElementsIndirectCommand) == 20, "Unexpected padding in DrawElementsIndirectCommand");
+
 struct MeshTexture {
 	aiString path;
-	std::shared_ptr<GLTexture> glObject;
+	std::shared_ptr<StreamedTexture> glObject;
 };
 
 class Mesh {
 public:
-	std::vector<Vertex> vertices;
-	std::vector<GLuint> indices;
-
 	MeshTexture diffuseTexture;
 	MeshTexture specularTexture;
 	MeshTexture normalTexture;
@@ -44,11 +132,85 @@ public:
 	glm::vec4 color;
 	float specular;
 	float reflectiveness = 0;
-	Mesh(const std::vector<Vertex>& vertices, const std::vector<GLuint>& indices, MeshTexture diffuseTex, MeshTexture specTex, MeshTexture normalTexture, glm::vec4 color, float specular);
-	void render(const ShaderProgram& shader);
+	GLsizei indexCount;
+	/// Type of the indices in the element buffer, narrowed to 16 bits when
+	/// the mesh has few enough vertices.
+	GLenum indexType;
+	/// Levels of detail, starting with the full mesh.
+	std::vector<MeshLod> lods;
+	/// Clusters of the full detail indices, for culling.
+	std::vector<Meshlet> meshlets;
+	/// Bounding sphere in model space.
+	glm::vec3 boundsCenter;
+	float boundsRadius;
+	/// Bounding box in model space.
+	glm::vec3 boundsMin;
+	glm::vec3 boundsMax;
+	/// Triangles rasterized for occlusion culling, empty unless the mesh is
+	/// an occluder.
+	OccluderMesh occluder;
+
+	/// Creates a mesh from indexCount indices at full detail, followed by the
+	/// indices of the simplified levels in lods. The data is stored in the
+	/// arena of its vertex format.
+	Mesh(const Vertex* vertices, size_t vertexCount, const GLuint* indices, size_t indexCount, const std::vector<MeshLod>& lods, const std::vector<Meshlet>& meshlets, MeshTexture diffuseTex, MeshTexture specTex, MeshTexture normalTexture, glm::vec4 color, float specular, GeometryArenas& arenas, bool packVertices);
+	void render(const ShaderProgram& shader, size_t lod = 0);
+
+	/// Renders drawCount index ranges in one call. Nothing is bound if there
+	/// are no ranges.
+	void render(const ShaderProgram& shader, const GLsizei* counts, const GLvoid* const* offsets, GLsizei drawCount);
+
+	/// Renders instanceCount instances of one index range, with their
+	/// InstanceData starting at firstInstance in instanceBuffer.
+	void renderInstanced(const ShaderProgram& shader, GLsizei count, const GLvoid* offset, GLuint instanceBuffer, size_t firstInstance, GLsizei instanceCount);
+
+	/// Returns the offset of an index in the element buffer of the arena, for drawing.
+	const GLvoid* indexOffset(size_t firstIndex) const;
+
+	/// Returns the command drawing instanceCount instances of the index range
+	/// at offset, with their data starting at baseInstance.
+	DrawElementsIndirectCommand indirectCommand(GLsizei count, const GLvoid* offset, GLuint baseInstance, GLuint instanceCount) const;
+
+	MaterialRecord materialRecord(float texRepeatFactor) const;
+
+	/// Binds the textures of the mesh and sets the material uniforms of
+	/// shader, as done by every draw.
+	void bindMaterial(const ShaderProgram& shader);
+
+	/// The arena holding the vertices and indices of the mesh.
+	GeometryArena& geometryArena() const {
+		return *arena;
+	}
+
+	/// Chooses the LOD to draw when one unit of model space error covers
+	/// pixelsPerUnit pixels, given the LOD drawn last.
+	size_t selectLod(float pixelsPerUnit, size_t currentLod) const;
+
+	/// Returns the size of the vertex buffer in bytes.
+	size_t vertexMemory() const;
+
+	/// Returns the size the vertex buffer would have with unpacked vertices.
+	size_t unpackedVertexMemory() const;
+
+	/// Returns the size of the element buffer in bytes.
+	size_t indexMemory() const;
+
+	/// Returns the size the element buffer would have with 32-bit indices.
+	size_t wideIndexMemory() const;
 private:
-	GLuint vertexArray, vertexBuffer, elemBuffer;
-	void setupMesh();
+	GeometryArena* arena;
+	/// Location of the vertices and indices within the arena.
+	GLint baseVertex;
+	size_t indexStart;
+	size_t vertexCount;
+	size_t totalIndexCount;
+	/// Whether the vertex buffer holds PackedVertex, see VertexPacking.h.
+	bool packedVertices;
+	glm::vec3 positionOffset;
+	glm::vec3 positionScale;
+	void setupMesh(const Vertex* vertices, size_t vertexCount, const GLuint* indices, size_t totalIndexCount);
+	GeometryAllocation upload(const void* vertices, size_t vertexCount, const GLuint* indices, size_t totalIndexCount);
+	glm::vec3 textureLayers() const;
 };
 
 #endif // Mesh_H
@@ -0,0 +1,293 @@
+//===----------------------------------------------------------------------===//
+//
+// This file is part of the Noxoscope project
+//
+// Copyright (c) 2016 Niklas Helmertz
+//
+//===----------------------------------------------------------------------===//
+
+#include "MeshOptimizer.h"
+
+#include <cstring>
+#include <algorithm>
+#include <unordered_map>
+
+#include <glm/glm.hpp>
+
+#include "Hash.h"
+
+static_assert(sizeof(Vertex) == 14 * sizeof(float), "Vertex must not have padding, as it is hashed and compared bytewise");
+
+static const GLuint NO_VERTEX = ~0u;
+
+VertexCacheStatistics analyzeVertexCache(const GLuint* indices, size_t indexCount, size_t vertexCount, size_t cacheSize) {
+	VertexCacheStatistics stats;
+	stats.triangleCount = indexCount / 3;
+
+	// A vertex is in the FIFO cache if fewer than cacheSize vertices have
+	// been inserted after it
+	std::vector<size_t> insertTime(vertexCount, 0);
+	std::vector<bool> used(vertexCount, false);
+	size_t time = cacheSize + 1;
+	for (size_t i = 0; i < indexCount; i++) {
+		auto index = indices[i];
+		if (time - insertTime[index] > cacheSize) {
+			insertTime[index] = time++;
+			stats.transformedCount++;
+		}
+		if (!used[index]) {
+			used[index] = true;
+			stats.vertexCount++;
+		}
+	}
+	return stats;
+}
+
+namespace {
+struct VertexHash {
+	size_t operator()(const Vertex* vertex) const {
+		return static_cast<size_t>(hashFnv1a(vertex, sizeof(Vertex)));
+	}
+};
+
+struct VertexEqual {
+	bool operator()(const Vertex* a, const Vertex* b) const {
+		return std::memcmp(a, b, sizeof(Vertex)) == 0;
+	}
+};
+}
+
+void weldVertices(std::vector<Vertex>* vertices, std::vector<GLuint>* indices) {
+	std::unordered_map<const Vertex*, GLuint, VertexHash, VertexEqual> unique;
+	unique.reserve(vertices->size());
+	std::vector<GLuint> remap(vertices->size(), NO_VERTEX);
+	std::vector<Vertex> welded;
+	welded.reserve(vertices->size());
+
+	for (auto& index : *indices) {
+		if (remap[index] == NO_VERTEX) {
+			auto inserted = unique.emplace(&(*vertices)[index], static_cast<GLuint>(welded.size()));
+			if (inserted.second) {
+				welded.push_back((*vertices)[index]);
+			}
+			remap[index] = inserted.first->second;
+		}
+		index = remap[index];
+	}
+	*vertices = std::move(welded);
+}
+
+void optimizeVertexCache(std::vector<GLuint>* indices, size_t vertexCount, std::vector<size_t>* clusters, size_t cacheSize) {
+	auto& input = *indices;
+	size_t triangleCount = input.size() / 3;
+	if (triangleCount == 0) {
+		return;
+	}
+
+	// Triangles using each vertex, as ranges in a shared array
+	std::vector<size_t> liveTriangles(vertexCount, 0);
+	for (auto index : input) {
+		liveTriangles[index]++;
+	}
+	std::vector<size_t> adjacencyOffsets(vertexCount + 1, 0);
+	for (size_t v = 0; v < vertexCount; v++) {
+		adjacencyOffsets[v + 1] = adjacencyOffsets[v] + liveTriangles[v];
+	}
+	std::vector<GLuint> adjacency(input.size());
+	std::vector<size_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+	for (size_t t = 0; t < triangleCount; t++) {
+		for (int k = 0; k < 3; k++) {
+			adjacency[fill[input[t * 3 + k]]++] = static_cast<GLuint>(t);
+		}
+	}
+
+	std::vector<size_t> cacheTime(vertexCount, 0);
+	std::vector<bool> emitted(triangleCount, false);
+	std::vector<GLuint> deadEnd;
+	std::vector<GLuint> candidates;
+	std::vector<GLuint> result;
+	result.reserve(input.size());
+	size_t time = cacheSize + 1;
+	size_t cursor = 0;
+
+	auto inCache = [&](GLuint v) {
+		return time - cacheTime[v] <= cacheSize;
+	};
+
+	clusters->push_back(0);
+	GLuint current = input[0];
+	while (current != NO_VERTEX) {
+		// Emit every remaining triangle around the current vertex
+		candidates.clear();
+		for (size_t a = adjacencyOffsets[current]; a < adjacencyOffsets[current + 1]; a++) {
+			auto t = adjacency[a];
+			if (emitted[t]) {
+				continue;
+			}
+			for (int k = 0; k < 3; k++) {
+				auto v = input[t * 3 + k];
+				result.push_back(v);
+				deadEnd.push_back(v);
+				candidates.push_back(v);
+				liveTriangles[v]--;
+				if (!inCache(v)) {
+					cacheTime[v] = time++;
+				}
+			}
+			emitted[t] = true;
+		}
+
+		// Continue with the oldest candidate whose remaining triangles can be
+		// emitted before it is evicted, or else the newest one
+		GLuint next = NO_VERTEX;
+		size_t bestPriority = 0;
+		for (auto v : candidates) {
+			if (liveTriangles[v] == 0) {
+				continue;
+			}
+			size_t priority = 1;
+			if (time - cacheTime[v] + 2 * liveTriangles[v] <= cacheSize) {
+				priority = time - cacheTime[v] + 1;
+			}
+			if (priority > bestPriority) {
+				bestPriority = priority;
+				next = v;
+			}
+		}
+
+		if (next == NO_VERTEX) {
+			// Dead end, so go back to a recently used vertex, or any vertex
+			// with triangles left
+			while (!deadEnd.empty() && next == NO_VERTEX) {
+				auto v = deadEnd.back();
+				deadEnd.pop_back();
+				if (liveTriangles[v] > 0) {
+					next = v;
+				}
+			}
+			while (next == NO_VERTEX && cursor < vertexCount) {
+				if (liveTriangles[cursor] > 0) {
+					next = static_cast<GLuint>(cursor);
+				}
+				cursor++;
+			}
+			if (next != NO_VERTEX && !inCache(next) && result.size() / 3 > clusters->back()) {
+				clusters->push_back(result.size() / 3);
+			}
+		}
+		current = next;
+	}
+
+	*indices = std::move(result);
+}
+
+void optimizeOverdraw(std::vector<GLuint>* indices, const std::vector<Vertex>& vertices, const std::vector<size_t>& clusters, float threshold) {
+	using namespace glm;
+
+	auto& input = *indices;
+	size_t triangleCount = input.size() / 3;
+	if (triangleCount == 0 || clusters.empty()) {
+		return;
+	}
+
+	// Split the clusters once their own ACMR is close to the one of the
+	// whole mesh, since the cache is then not hurt much by reordering them
+	float meshAcmr = analyzeVertexCache(input.data(), input.size(), vertices.size()).acmr();
+	std::vector<size_t> softClusters;
+	std::vector<size_t> insertTime(vertices.size(), 0);
+	size_t time = VERTEX_CACHE_SIZE + 1;
+	for (size_t c = 0; c < clusters.size(); c++) {
+		size_t end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+		size_t start = clusters[c];
+		size_t transformed = 0;
+		softClusters.push_back(start);
+		for (size_t t = start; t < end; t++) {
+			for (int k = 0; k < 3; k++) {
+				auto v = input[t * 3 + k];
+				if (time - insertTime[v] > VERTEX_CACHE_SIZE) {
+					insertTime[v] = time++;
+					transformed++;
+				}
+			}
+			if (t + 1 < end && transformed <= meshAcmr * threshold * (t + 1 - start)) {
+				softClusters.push_back(t + 1);
+				start = t + 1;
+				transformed = 0;
+				// Flush the simulated cache
+				time += VERTEX_CACHE_SIZE + 1;
+			}
+		}
+	}
+
+	// Sort the clusters by how much they face away from the mesh center
+	struct Cluster {
+		size_t start;
+		size_t end;
+		vec3 centroid;
+		vec3 normal;
+		float area;
+	};
+	std::vector<Cluster> sorted;
+	sorted.reserve(softClusters.size());
+	vec3 meshCentroid(0.0f);
+	float meshArea = 0.0f;
+	for (size_t c = 0; c < softClusters.size(); c++) {
+		Cluster cluster{softClusters[c], c + 1 < softClusters.size() ? softClusters[c + 1] : triangleCount, vec3(0.0f), vec3(0.0f), 0.0f};
+		for (size_t t = cluster.start; t < cluster.end; t++) {
+			auto& p0 = vertices[input[t * 3]].position;
+			auto& p1 = vertices[input[t * 3 + 1]].position;
+			auto& p2 = vertices[input[t * 3 + 2]].position;
+			vec3 normal = cross(p1 - p0, p2 - p0);
+			float area = length(normal);
+			cluster.centroid += area * (p0 + p1 + p2) / 3.0f;
+			cluster.normal += normal;
+			cluster.area += area;
+		}
+		meshCentroid += cluster.centroid;
+		meshArea += cluster.area;
+		if (cluster.area > 0.0f) {
+			cluster.centroid /= cluster.area;
+		}
+		sorted.push_back(cluster);
+	}
+	if (meshArea > 0.0f) {
+		meshCentroid /= meshArea;
+	}
+
+	auto sortKey = [&](const Cluster& cluster) {
+		float normalLength = length(cluster.normal);
+		return normalLength > 0.0f ? dot(cluster.centroid - meshCentroid, cluster.normal / normalLength) : 0.0f;
+	};
+	std::stable_sort(sorted.begin(), sorted.end(), [&](const Cluster& a, const Cluster& b) {
+		return sortKey(a) > sortKey(b);
+	});
+
+	std::vector<GLuint> result;
+	result.reserve(input.size());
+	for (auto& cluster : sorted) {
+		result.insert(result.end(), input.begin() + cluster.start * 3, input.begin() + cluster.end * 3);
+	}
+	*indices = std::move(result);
+}
+
+void optimizeVertexFetch(std::vector<Vertex>* vertices, std::vector<GLuint>* indices) {
+	std::vector<GLuint> remap(vertices->size(), NO_VERTEX);
+	std::vector<Vertex> reordered;
+	reordered.reserve(vertices->size());
+	for (auto& index : *indices) {
+		if (remap[index] == NO_VERTEX) {
+			remap[index] = static_cast<GLuint>(reordered.size());
+			reordered.push_back((*vertices)[index]);
+		}
+		index = remap[index];
+	}
+	*vertices = std::move(reordered);
+}
+
+void optimizeMesh(std::vector<Vertex>* vertices, std::vector<GLuint>* indices) {
+	weldVertices(vertices, indices);
+	std::vector<size_t> clusters;
+	optimizeVertexCache(indices, vertices->size(), &clusters);
+	optimizeOverdraw(indices, *vertices, clusters);
+	optimizeVertexFetch(vertices, indices);
+}
@@ -0,0 +1,83 @@
+//===----------------------------------------------------------------------===//
+//
+// This file is part of the Noxoscope project
+//
+// Copyright (c) 2016 Niklas Helmertz
+//
+//===----------------------------------------------------------------------===//
+//
+// Optimization of indexed triangle meshes for the GPU vertex pipeline.
+//
+// The passes are meant to run in the order of optimizeMesh:
+//  - Welding merges bitwise identical vertices, so that they can be shared.
+//  - Vertex cache optimization reorders triangles with the Tipsify algorithm,
+//    from "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw"
+//    by Sander, Nehab and Barczak, to reuse recently transformed vertices.
+//  - Overdraw optimization, from the same paper, sorts clusters of triangles
+//    so that outwards facing ones tend to be drawn first.
+//  - Vertex fetch optimization orders vertices by their first use.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef MeshOptimizer_H
+#define MeshOptimizer_H
+
+#include <vector>
+#include <cstddef>
+
+#include <GL/glew.h>
+
+#include "Mesh.h"
+
+/// Size of the FIFO cache assumed for post-transform vertex reuse.
+constexpr size_t VERTEX_CACHE_SIZE = 16;
+
+/// Clusters may be split when their ACMR is within this factor of the whole mesh.
+constexpr float OVERDRAW_THRESHOLD = 1.05f;
+
+/// Post-transform vertex cache behavior of a triangle list.
+struct VertexCacheStatistics {
+	size_t vertexCount = 0;
+	size_t triangleCount = 0;
+	size_t transformedCount = 0;
+
+	/// Average cache miss ratio, i.e. vertices transformed per triangle.
+	float acmr() const {
+		return triangleCount == 0 ? 0.0f : float(transformedCount) / triangleCount;
+	}
+
+	/// Average transform to vertex ratio, i.e. times each vertex is transformed.
+	float atvr() const {
+		return vertexCount == 0 ? 0.0f : float(transformedCount) / vertexCount;
+	}
+
+	VertexCacheStatistics& operator+=(const VertexCacheStatistics& o) {
+		vertexCount += o.vertexCount;
+		triangleCount += o.triangleCount;
+		transformedCount += o.transformedCount;
+		return *this;
+	}
+};
+
+/// Simulates a FIFO vertex cache of cacheSize entries drawing the triangle list.
+VertexCacheStatistics analyzeVertexCache(const GLuint* indices, size_t indexCount, size_t vertexCount, size_t cacheSize = VERTEX_CACHE_SIZE);
+
+/// Merges vertices with identical attributes, and removes unused vertices.
+void weldVertices(std::vector<Vertex>* vertices, std::vector<GLuint>* indices);
+
+/// Reorders triangles for vertex cache reuse. The first triangle of every
+/// cluster that starts with an empty cache is appended to clusters.
+void optimizeVertexCache(std::vector<GLuint>* indices, size_t vertexCount, std::vector<size_t>* clusters, size_t cacheSize = VERTEX_CACHE_SIZE);
+
+/// Sorts the clusters from optimizeVertexCache to reduce overdraw. Clusters are
+/// first split further as long as their ACMR stays within threshold of the
+/// ACMR of the whole mesh.
+void optimizeOverdraw(std::vector<GLuint>* indices, const std::vector<Vertex>& vertices, const std::vector<size_t>& clusters, float threshold = OVERDRAW_THRESHOLD);
+
+/// Reorders vertices by their first use in the index list.
+void optimizeVertexFetch(std::vector<Vertex>* vertices, std::vector<GLuint>* indices);
+
+/// Runs every optimization pass on a triangle list.
+void optimizeMesh(std::vector<Vertex>* vertices, std::vector<GLuint>* indices);
+
+#endif // MeshOptimizer_H
@@ -0,0 +1,310 @@
+//===----------------------------------------------------------------------===//
+//
+// This file is part of the Noxoscope project
+//
+// Copyright (c) 2016 Niklas Helmertz
+//
+//===----------------------------------------------------------------------===//
+
+#include "MeshSimplifier.h"
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <unordered_map>
+
+#include <glm/glm.hpp>
+
+#include "Hash.h"
+#include "MeshOptimizer.h"
+
+namespace {
+/// Symmetric 4x4 matrix of summed squared plane distances, weighted by area.
+struct Quadric {
+	double a00 = 0, a01 = 0, a02 = 0, a03 = 0;
+	double a11 = 0, a12 = 0, a13 = 0;
+	double a22 = 0, a23 = 0;
+	double a33 = 0;
+	double weight = 0;
+
+	void addPlane(glm::dvec3 n, double d, double w) {
+		a00 += w * n.x * n.x; a01 += w * n.x * n.y; a02 += w * n.x * n.z; a03 += w * n.x * d;
+		a11 += w * n.y * n.y; a12 += w * n.y * n.z; a13 += w * n.y * d;
+		a22 += w * n.z * n.z; a23 += w * n.z * d;
+		a33 += w * d * d;
+		weight += w;
+	}
+
+	Quadric& operator+=(const Quadric& o) {
+		a00 += o.a00; a01 += o.a01; a02 += o.a02; a03 += o.a03;
+		a11 += o.a11; a12 += o.a12; a13 += o.a13;
+		a22 += o.a22; a23 += o.a23;
+		a33 += o.a33;
+		weight += o.weight;
+		return *this;
+	}
+
+	/// Mean squared distance of p to the planes.
+	double error(glm::dvec3 p) const {
+		double e =
+			a00 * p.x * p.x + 2 * a01 * p.x * p.y + 2 * a02 * p.x * p.z + 2 * a03 * p.x +
+			a11 * p.y * p.y + 2 * a12 * p.y * p.z + 2 * a13 * p.y +
+			a22 * p.z * p.z + 2 * a23 * p.z +
+			a33;
+		return weight > 0 ? std::max(e, 0.0) / weight : 0.0;
+	}
+};
+
+struct Collapse {
+	GLuint from;
+	GLuint to;
+	double error;
+};
+
+struct PositionHash {
+	size_t operator()(const glm::vec3& p) const {
+		// Adding zero turns -0 into 0, which compares equal
+		glm::vec3 key = p + glm::vec3(0.0f);
+		return static_cast<size_t>(hashFnv1a(&key, sizeof(key)));
+	}
+};
+}
+
+static uint64_t edgeKey(GLuint a, GLuint b) {
+	return a < b ? (uint64_t(a) << 32) | b : (uint64_t(b) << 32) | a;
+}
+
+// Vertices that must stay in place, on open borders or attribute seams
+static std::vector<bool> findLockedVertices(const std::vector<Vertex>& vertices, const std::vector<GLuint>& indices) {
+	std::vector<bool> locked(vertices.size(), false);
+
+	std::unordered_map<glm::vec3, GLuint, PositionHash> firstAtPosition;
+	firstAtPosition.reserve(vertices.size());
+	for (auto index : indices) {
+		auto inserted = firstAtPosition.emplace(vertices[index].position, index);
+		if (!inserted.second && inserted.first->second != index) {
+			locked[index] = true;
+			locked[inserted.first->second] = true;
+		}
+	}
+
+	std::unordered_map<uint64_t, int> edgeUses;
+	edgeUses.reserve(indices.size());
+	for (size_t t = 0; t < indices.size(); t += 3) {
+		for (int k = 0; k < 3; k++) {
+			edgeUses[edgeKey(indices[t + k], indices[t + (k + 1) % 3])]++;
+		}
+	}
+	for (auto& edge : edgeUses) {
+		if (edge.second == 1) {
+			locked[edge.first >> 32] = true;
+			locked[edge.first & 0xffffffff] = true;
+		}
+	}
+	return locked;
+}
+
+// Whether moving from onto to flips or degenerates any triangle that is kept
+static bool collapseFlips(const std::vector<Vertex>& vertices, const std::vector<GLuint>& indices,
+		const GLuint* triangles, size_t triangleCount, GLuint from, GLuint to) {
+	using namespace glm;
+	for (size_t i = 0; i < triangleCount; i++) {
+		auto tri = &indices[triangles[i] * 3];
+		if (tri[0] == to || tri[1] == to || tri[2] == to) {
+			continue;
+		}
+		vec3 before[3];
+		vec3 after[3];
+		for (int k = 0; k < 3; k++) {
+			before[k] = vertices[tri[k]].position;
+			after[k] = tri[k] == from ? vertices[to].position : before[k];
+		}
+		vec3 normalBefore = cross(before[1] - before[0], before[2] - before[0]);
+		vec3 normalAfter = cross(after[1] - after[0], after[2] - after[0]);
+		if (dot(normalBefore, normalAfter) <= 0.25f * length(normalBefore) * length(normalAfter)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+namespace {
+/// Quadrics and locked vertices of a mesh being simplified, kept between
+/// calls so that successive levels are measured against the original surface.
+class Simplifier {
+public:
+	Simplifier(const std::vector<Vertex>& vertices, const std::vector<GLuint>& indices);
+
+	/// Collapses edges of the triangle list in indices towards targetIndexCount indices.
+	void simplify(std::vector<GLuint>* indices, size_t targetIndexCount);
+
+	/// Distance error of all collapses so far.
+	float error() const {
+		return static_cast<float>(std::sqrt(maxError));
+	}
+private:
+	const std::vector<Vertex>& vertices;
+	std::vector<Quadric> quadrics;
+	std::vector<bool> locked;
+	double maxError = 0;
+};
+}
+
+Simplifier::Simplifier(const std::vector<Vertex>& vertices, const std::vector<GLuint>& indices)
+	: vertices(vertices),
+	  quadrics(vertices.size()),
+	  locked(findLockedVertices(vertices, indices)) {
+	using namespace glm;
+	for (size_t t = 0; t + 2 < indices.size(); t += 3) {
+		dvec3 p0 = vertices[indices[t]].position;
+		dvec3 p1 = vertices[indices[t + 1]].position;
+		dvec3 p2 = vertices[indices[t + 2]].position;
+		dvec3 normal = cross(p1 - p0, p2 - p0);
+		double area = length(normal);
+		if (area == 0) {
+			continue;
+		}
+		normal /= area;
+		for (int k = 0; k < 3; k++) {
+			quadrics[indices[t + k]].addPlane(normal, -dot(normal, p0), area);
+		}
+	}
+}
+
+void Simplifier::simplify(std::vector<GLuint>* indices, size_t targetIndexCount) {
+	using namespace glm;
+
+	auto& result = *indices;
+	std::vector<size_t> adjacencyOffsets(vertices.size() + 1);
+	std::vector<GLuint> adjacency;
+	std::vector<Collapse> collapses;
+	std::vector<bool> touched(vertices.size());
+	std::vector<GLuint> remap(vertices.size());
+
+	while (result.size() > targetIndexCount) {
+		size_t triangleCount = result.size() / 3;
+
+		// Triangles using each vertex, as ranges in a shared array
+		std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+		for (auto index : result) {
+			adjacencyOffsets[index + 1]++;
+		}
+		for (size_t v = 0; v < vertices.size(); v++) {
+			adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+		}
+		adjacency.resize(result.size());
+		std::vector<size_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+		for (size_t t = 0; t < triangleCount; t++) {
+			for (int k = 0; k < 3; k++) {
+				adjacency[fill[result[t * 3 + k]]++] = static_cast<GLuint>(t);
+			}
+		}
+
+		collapses.clear();
+		for (size_t t = 0; t < triangleCount; t++) {
+			for (int k = 0; k < 3; k++) {
+				GLuint a = result[t * 3 + k];
+				GLuint b = result[t * 3 + (k + 1) % 3];
+				Quadric q = quadrics[a];
+				q += quadrics[b];
+				if (!locked[a]) {
+					collapses.push_back({a, b, q.error(dvec3(vertices[b].position))});
+				}
+				if (!locked[b]) {
+					collapses.push_back({b, a, q.error(dvec3(vertices[a].position))});
+				}
+			}
+		}
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse& x, const Collapse& y) {
+			return x.error < y.error;
+		});
+
+		// Apply the cheapest collapses, leaving the neighborhood of each one
+		// alone for the rest of the pass so that the flip checks stay valid
+		std::fill(touched.begin(), touched.end(), false);
+		for (size_t v = 0; v < vertices.size(); v++) {
+			remap[v] = static_cast<GLuint>(v);
+		}
+		size_t remainingTriangles = triangleCount;
+		size_t collapseCount = 0;
+		for (auto& collapse : collapses) {
+			if (remainingTriangles * 3 <= targetIndexCount) {
+				break;
+			}
+			if (touched[collapse.from] || touched[collapse.to]) {
+				continue;
+			}
+			auto triangles = &adjacency[adjacencyOffsets[collapse.from]];
+			size_t count = adjacencyOffsets[collapse.from + 1] - adjacencyOffsets[collapse.from];
+			if (collapseFlips(vertices, result, triangles, count, collapse.from, collapse.to)) {
+				continue;
+			}
+
+			remap[collapse.from] = collapse.to;
+			quadrics[collapse.to] += quadrics[collapse.from];
+			maxError = std::max(maxError, collapse.error);
+			collapseCount++;
+			for (size_t i = 0; i < count; i++) {
+				auto tri = &result[triangles[i] * 3];
+				if (tri[0] == collapse.to || tri[1] == collapse.to || tri[2] == collapse.to) {
+					remainingTriangles--;
+				}
+				for (int k = 0; k < 3; k++) {
+					touched[tri[k]] = true;
+				}
+			}
+		}
+		if (collapseCount == 0) {
+			break;
+		}
+
+		size_t write = 0;
+		for (size_t t = 0; t < triangleCount; t++) {
+			GLuint a = remap[result[t * 3]];
+			GLuint b = remap[result[t * 3 + 1]];
+			GLuint c = remap[result[t * 3 + 2]];
+			if (a != b && b != c && c != a) {
+				result[write++] = a;
+				result[write++] = b;
+				result[write++] = c;
+			}
+		}
+		result.resize(write);
+	}
+}
+
+std::vector<GLuint> simplifyMesh(const std::vector<Vertex>& vertices, const std::vector<GLuint>& indices, size_t targetIndexCount, float* resultError) {
+	std::vector<GLuint> result(indices);
+	Simplifier simplifier(vertices, indices);
+	simplifier.simplify(&result, targetIndexCount);
+	*resultError = simplifier.error();
+	return result;
+}
+
+void generateLods(const std::vector<Vertex>& vertices, std::vector<GLuint>* indices, std::vector<MeshLod>* lods) {
+	// Each level continues from the previous one, with errors still measured
+	// against the full mesh through the accumulated quadrics
+	std::vector<GLuint> current(*indices);
+	Simplifier simplifier(vertices, current);
+	size_t previousTriangles = current.size() / 3;
+	for (size_t i = 0; i < LOD_MAX_COUNT && previousTriangles > LOD_MIN_TRIANGLES; i++) {
+		auto targetTriangles = std::max(static_cast<size_t>(previousTriangles * LOD_REDUCTION), LOD_MIN_TRIANGLES);
+		simplifier.simplify(&current, targetTriangles * 3);
+		if (current.size() / 3 > previousTriangles * (1.0f + LOD_REDUCTION) / 2) {
+			break;
+		}
+
+		auto lod = current;
+		std::vector<size_t> clusters;
+		optimizeVertexCache(&lod, vertices.size(), &clusters);
+
+		MeshLod meshLod;
+		meshLod.firstIndex = indices->size();
+		meshLod.indexCount = lod.size();
+		meshLod.error = simplifier.error();
+		lods->push_back(meshLod);
+		indices->insert(indices->end(), lod.begin(), lod.end());
+
+		previousTriangles = lod.size() / 3;
+	}
+}
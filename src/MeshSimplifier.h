@@ -0,0 +1,51 @@
+//===----------------------------------------------------------------------===//
+//
+// This file is part of the Noxoscope project
+//
+// Copyright (c) 2016 Niklas Helmertz
+//
+//===----------------------------------------------------------------------===//
+//
+// Simplification of indexed triangle meshes into levels of detail.
+//
+// Simplification uses edge collapses ordered by the quadric error metric
+// from "Surface Simplification Using Quadric Error Metrics" by Garland and
+// Heckbert. Every collapse moves a vertex onto one of its neighbors, so a
+// simplified mesh only needs new indices into the original vertex array.
+//
+// Vertices on open borders and attribute seams, i.e. where vertices with
+// the same position but different normals or texture coordinates meet, are
+// never moved, which keeps the texture mapping and hard edges intact.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef MeshSimplifier_H
+#define MeshSimplifier_H
+
+#include <vector>
+#include <cstddef>
+
+#include <GL/glew.h>
+
+#include "Mesh.h"
+
+/// Maximum number of simplified levels built in addition to the full mesh.
+constexpr size_t LOD_MAX_COUNT = 4;
+
+/// Triangle count of each level relative to the previous one.
+constexpr float LOD_REDUCTION = 0.5f;
+
+/// Meshes with fewer triangles than this are not simplified further.
+constexpr size_t LOD_MIN_TRIANGLES = 64;
+
+/// Simplifies a triangle list towards targetIndexCount indices. The returned
+/// indices refer to the same vertex array. The error of the result, as a
+/// distance in model space, is stored in resultError.
+std::vector<GLuint> simplifyMesh(const std::vector<Vertex>& vertices, const std::vector<GLuint>& indices, size_t targetIndexCount, float* resultError);
+
+/// Appends simplified levels of the triangle list in indices to it, in
+/// order of decreasing detail. Levels that would not remove enough triangles
+/// are not built.
+void generateLods(const std::vector<Vertex>& vertices, std::vector<GLuint>* indices, std::vector<MeshLod>* lods);
+
+#endif // MeshSimplifier_H
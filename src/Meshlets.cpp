@@ -0,0 +1,89 @@
+//===----------------------------------------------------------------------===//
+//
+// This file is part of the Noxoscope project
+//
+// Copyright (c) 2016 Niklas Helmertz
+//
+//===----------------------------------------------------------------------===//
+
+#include "Meshlets.h"
+
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+#include <unordered_set>
+
+#include "Mesh.h"
+
+static Meshlet makeMeshlet(const Vertex* vertices, const GLuint* indices, size_t firstIndex, size_t indexCount) {
+	using namespace glm;
+	Meshlet meshlet;
+	meshlet.firstIndex = static_cast<uint32_t>(firstIndex);
+	meshlet.indexCount = static_cast<uint32_t>(indexCount);
+
+	vec3 low(FLT_MAX);
+	vec3 high(-FLT_MAX);
+	vec3 normalSum(0.0f);
+	for (size_t i = firstIndex; i < firstIndex + indexCount; i += 3) {
+		auto& p0 = vertices[indices[i]].position;
+		auto& p1 = vertices[indices[i + 1]].position;
+		auto& p2 = vertices[indices[i + 2]].position;
+		for (auto p : {p0, p1, p2}) {
+			low = min(low, p);
+			high = max(high, p);
+		}
+		vec3 normal = cross(p1 - p0, p2 - p0);
+		float area = length(normal);
+		if (area > 0.0f) {
+			normalSum += normal / area;
+		}
+	}
+
+	meshlet.center = (low + high) / 2.0f;
+	meshlet.radius = 0.0f;
+	for (size_t i = firstIndex; i < firstIndex + indexCount; i++) {
+		meshlet.radius = std::max(meshlet.radius, distance(meshlet.center, vertices[indices[i]].position));
+	}
+
+	// Cone of triangle normals around their average
+	float normalLength = length(normalSum);
+	meshlet.coneAxis = normalLength > 0.0f ? normalSum / normalLength : vec3(0.0f, 0.0f, 1.0f);
+	float minDot = normalLength > 0.0f ? 1.0f : -1.0f;
+	for (size_t i = firstIndex; i < firstIndex + indexCount; i += 3) {
+		auto& p0 = vertices[indices[i]].position;
+		vec3 normal = cross(vertices[indices[i + 1]].position - p0, vertices[indices[i + 2]].position - p0);
+		float area = length(normal);
+		if (area > 0.0f) {
+			minDot = std::min(minDot, dot(meshlet.coneAxis, normal / area));
+		}
+	}
+	// A cone wider than a hemisphere always has some triangle facing the camera
+	meshlet.coneCutoff = minDot <= 0.0f ? 2.0f : std::sqrt(1.0f - minDot * minDot);
+	return meshlet;
+}
+
+void buildMeshlets(const Vertex* vertices, const GLuint* indices, size_t indexCount, std::vector<Meshlet>* meshlets) {
+	std::unordered_set<GLuint> meshletVertices;
+	size_t first = 0;
+	for (size_t i = 0; i + 2 < indexCount; i += 3) {
+		size_t newVertices = 0;
+		for (int k = 0; k < 3; k++) {
+			newVertices += meshletVertices.count(indices[i + k]) == 0;
+		}
+		bool full = (i - first) / 3 >= MESHLET_MAX_TRIANGLES || meshletVertices.size() + newVertices > MESHLET_MAX_VERTICES;
+		if (full) {
+			meshlets->push_back(makeMeshlet(vertices, indices, first, i - first));
+			meshletVertices.clear();
+			first = i;
+		}
+		meshletVertices.insert({indices[i], indices[i + 1], indices[i + 2]});
+	}
+	if (indexCount - first >= 3) {
+		meshlets->push_back(makeMeshlet(vertices, indices, first, (indexCount - first) / 3 * 3));
+	}
+}
+
+bool meshletBackfacing(const Meshlet& meshlet, glm::vec3 cameraPosition) {
+	glm::vec3 view = meshlet.center - cameraPosition;
+	return glm::dot(view, meshlet.coneAxis) >= meshlet.coneCutoff * glm::length(view) + meshlet.radius;
+}
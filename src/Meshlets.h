@@ -0,0 +1,64 @@
+//===----------------------------------------------------------------------===//
+//
+// This file is part of the Noxoscope project
+//
+// Copyright (c) 2016 Niklas Helmertz
+//
+//===----------------------------------------------------------------------===//
+//
+// Decomposition of meshes into small clusters of triangles, meshlets, that
+// can be culled individually on the CPU.
+//
+// A meshlet is a contiguous range of the index list of a mesh, so meshlets
+// need no index data of their own. Since the index list is ordered for the
+// vertex cache by MeshOptimizer.h, consecutive triangles tend to be close.
+//
+// Every meshlet has a bounding sphere for frustum culling, and a normal cone
+// for backface culling of the whole cluster, as in "Optimizing the Graphics
+// Pipeline with Compute" by Wihlidal.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef Meshlets_H
+#define Meshlets_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+struct Vertex;
+
+/// Maximum number of triangles in a meshlet.
+constexpr size_t MESHLET_MAX_TRIANGLES = 124;
+
+/// Maximum number of unique vertices in a meshlet.
+constexpr size_t MESHLET_MAX_VERTICES = 64;
+
+/// \brief Cluster of triangles in a mesh, with bounds for culling.
+///
+/// The first index is relative to the first index of the mesh, and the
+/// bounds are in model space.
+struct Meshlet {
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	glm::vec3 center;
+	float radius;
+	glm::vec3 coneAxis;
+	/// Sine of the angle between the cone axis and the triangle normals
+	/// furthest from it, or larger than one if the cone cannot be culled.
+	float coneCutoff;
+};
+
+static_assert(sizeof(Meshlet) == 40, "Meshlet is stored as is in the model cache");
+
+/// Splits a triangle list into meshlets, in order, appending them to meshlets.
+void buildMeshlets(const Vertex* vertices, const GLuint* indices, size_t indexCount, std::vector<Meshlet>* meshlets);
+
+/// Returns true if every triangle of the meshlet faces away from a camera at
+/// cameraPosition, given in model space.
+bool meshletBackfacing(const Meshlet& meshlet, glm::vec3 cameraPosition);
+
+#endif // Meshlets_H
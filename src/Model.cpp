@@ -9,73 +9,81 @@
 #include <string>
 #include <vector>
 #include <algorithm>
+#include <cfloat>
+#include <unordered_set>
 
 #include <GL/glew.h>
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
-#include <stb_image.h>
 #include <glm/glm.hpp>
 
 #include "Model.h"
+#include "ModelCache.h"
 #include "ShaderProgram.h"
+#include "Constants.h"
 #include "Logging.h"
 #include "FileTools.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
 
-Model::Model(const char* path, std::vector<MeshTexture>& loadedTextures) : Model(path, ModelProps(), loadedTextures) {}
-
-Model::Model(const char* path, ModelProps modelProps, std::vector<MeshTexture>& loadedTextures)
+Model::Model(const ModelData& data, ModelProps modelProps, TextureRegistry& textureRegistry, GeometryArenas& geometryArenas)
 	: modelProps(modelProps),
-	  loadedTextures(loadedTextures) {
-	this->loadModel(path);
+	  textureRegistry(textureRegistry),
+	  geometryArenas(geometryArenas) {
+	this->createMeshes(data);
 }
 
 ModelProps::ModelProps() : magFilter(GL_LINEAR), minFilter(GL_LINEAR_MIPMAP_LINEAR), texRepeatFactor(1) {}
 
 ModelProps::ModelProps(GLint magFilter, GLint minFilter, float texRepeatFactor) : magFilter(magFilter), minFilter(minFilter), texRepeatFactor(texRepeatFactor) {}
 
-void Model::loadModel(std::string path) {
-	Assimp::Importer import;
-	auto scene = import.ReadFile(path,
-		aiProcess_GenNormals |
-		//aiProcess_GenSmoothNormals |
-		aiProcess_CalcTangentSpace |
-		aiProcess_Triangulate |
-		//aiProcess_OptimizeMeshes |
-		//aiProcessPreset_TargetRealtime_MaxQuality |
-		//aiProcess_PreTransformVertices |
-		//aiProcess_JoinIdenticalVertices |
-		//aiProcess_SortByPType |
-		0
-	);
-
-	if (!scene || scene->mFlags == AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
-		fatalError("Assimp error while loading \"{}\":\n{}", path.c_str(), import.GetErrorString());
-		return;
+// Post-processing done by assimp. Part of the model cache key, since changing
+// it changes the imported geometry.
+static const unsigned MODEL_IMPORT_FLAGS =
+	aiProcess_GenNormals |
+	//aiProcess_GenSmoothNormals |
+	aiProcess_CalcTangentSpace |
+	aiProcess_Triangulate |
+	//aiProcess_OptimizeMeshes |
+	//aiProcessPreset_TargetRealtime_MaxQuality |
+	//aiProcess_PreTransformVertices |
+	//aiProcess_JoinIdenticalVertices | // Done by MeshOptimizer
+	//aiProcess_SortByPType |
+	0;
+
+static std::string materialTexturePath(aiMaterial* mat, aiTextureType type) {
+	if (mat->GetTextureCount(type) < 1) {
+		return "";
 	}
-	this->directory = path.substr(0, path.find_last_of('/'));
 
-	this->processNode(scene->mRootNode, scene);
+	aiString path;
+	// Just pick the first one in case of several matches
+	mat->GetTexture(type, 0, &path);
+	return path.C_Str();
 }
 
-void Model::processNode(aiNode* node, const aiScene* scene) {
-	for (GLuint i = 0; i < node->mNumMeshes; i++) {
-		auto mesh = scene->mMeshes[node->mMeshes[i]];
-		this->meshes.push_back(this->processMesh(node, mesh, scene));
-	}
-	for (GLuint i = 0; i < node->mNumChildren; i++) {
-		this->processNode(node->mChildren[i], scene);
-	}
-}
+/// Statistics of the mesh processing passes over all meshes in a model.
+struct ImportReport {
+	// Vertex cache statistics before and after optimization
+	VertexCacheStatistics before;
+	VertexCacheStatistics after;
+	size_t vertexCountBefore = 0;
+
+	size_t simplifiedMeshCount = 0;
+	size_t lodCount = 0;
+	size_t coarsestTriangleCount = 0;
 
-Mesh Model::processMesh(aiNode* node, aiMesh* aiMesh, const aiScene* scene) const {
+	size_t meshletCount = 0;
+};
+
+static void processMesh(aiMesh* aiMesh, const aiScene* scene, ModelProps props, ModelData* data, ImportReport* report) {
 	using namespace glm;
 
 	std::vector<Vertex> vertices;
 	std::vector<GLuint> indices;
-	MeshTexture diffuseTex;
-	MeshTexture specTex;
-	MeshTexture normalTex;
+	vertices.reserve(aiMesh->mNumVertices);
+	indices.reserve(aiMesh->mNumFaces * 3);
 
 	auto toGlm = [](aiVector3D& aiVec) {
 		vec3 v;
@@ -119,6 +127,38 @@ Mesh Model::processMesh(aiNode* node, aiMesh* aiMesh, const aiScene* scene) cons
 		}
 	}
 
+	MeshData mesh;
+
+	// Point and line primitives are left as they are, since the passes only handle triangles
+	bool triangles = aiMesh->mPrimitiveTypes == aiPrimitiveType_TRIANGLE;
+	if (props.optimizeMeshes && triangles) {
+		report->vertexCountBefore += vertices.size();
+		report->before += analyzeVertexCache(indices.data(), indices.size(), vertices.size());
+		optimizeMesh(&vertices, &indices);
+		report->after += analyzeVertexCache(indices.data(), indices.size(), vertices.size());
+	}
+	if (props.generateLods && triangles && !props.optimizeMeshes) {
+		// Seams are found from the index topology, which needs shared vertices
+		weldVertices(&vertices, &indices);
+	}
+	mesh.indexCount = indices.size();
+	if (props.buildMeshlets && triangles) {
+		buildMeshlets(vertices.data(), indices.data(), indices.size(), &mesh.meshlets);
+		report->meshletCount += mesh.meshlets.size();
+	}
+	if (props.generateLods && triangles) {
+		generateLods(vertices, &indices, &mesh.lods);
+		report->simplifiedMeshCount += !mesh.lods.empty();
+		report->lodCount += mesh.lods.size();
+		report->coarsestTriangleCount += (mesh.lods.empty() ? mesh.indexCount : mesh.lods.back().indexCount) / 3;
+	}
+
+	mesh.firstVertex = data->vertexStorage.size();
+	mesh.vertexCount = vertices.size();
+	mesh.firstIndex = data->indexStorage.size();
+	data->vertexStorage.insert(data->vertexStorage.end(), vertices.begin(), vertices.end());
+	data->indexStorage.insert(data->indexStorage.end(), indices.begin(), indices.end());
+
 	vec4 color;
 	float specular = 0.2f;
 
@@ -141,98 +181,127 @@ Mesh Model::processMesh(aiNode* node, aiMesh* aiMesh, const aiScene* scene) cons
 		specular = length(vec3(aiSpec.r, aiSpec.g, aiSpec.b));
 	}
 
-	loadMaterialTextures(mat, aiTextureType_DIFFUSE, &diffuseTex);
-	loadMaterialTextures(mat, aiTextureType_SPECULAR, &specTex);
-	loadMaterialTextures(mat, aiTextureType_NORMALS, &normalTex);
-	if (normalTex.glObject == nullptr) {
-		loadMaterialTextures(mat, aiTextureType_HEIGHT, &normalTex);
+	mesh.material.color = color;
+	mesh.material.specular = specular;
+	mesh.material.diffusePath = materialTexturePath(mat, aiTextureType_DIFFUSE);
+	mesh.material.specularPath = materialTexturePath(mat, aiTextureType_SPECULAR);
+	mesh.material.normalPath = materialTexturePath(mat, aiTextureType_NORMALS);
+	if (mesh.material.normalPath.empty()) {
+		mesh.material.normalPath = materialTexturePath(mat, aiTextureType_HEIGHT);
 	}
 
-	return {vertices, indices, diffuseTex, specTex, normalTex, color, specular};
+	data->meshes.push_back(std::move(mesh));
 }
 
-void Model::loadMaterialTextures(aiMaterial* mat, aiTextureType type, MeshTexture* texture) const {
-	auto typeCount = mat->GetTextureCount(type);
-	if (typeCount < 1) {
-		*texture = {aiString(""), nullptr};
+static void processNode(aiNode* node, const aiScene* scene, ModelProps props, ModelData* data, ImportReport* report) {
+	for (GLuint i = 0; i < node->mNumMeshes; i++) {
+		processMesh(scene->mMeshes[node->mMeshes[i]], scene, props, data, report);
+	}
+	for (GLuint i = 0; i < node->mNumChildren; i++) {
+		processNode(node->mChildren[i], scene, props, data, report);
+	}
+}
+
+static void importGeometry(const std::string& path, ModelProps props, ModelData* data) {
+	ModelCacheKey cacheKey{path, {}, MODEL_IMPORT_FLAGS, props};
+	bool cacheable = getFileInfo(path.c_str(), &cacheKey.sourceInfo);
+	if (cacheable && readModelCache(cacheKey, data)) {
+		data->fromCache = true;
 		return;
 	}
 
-	aiString path;
-	// Just pick the first one in case of several matches
-	mat->GetTexture(type, 0, &path);
+	Assimp::Importer import;
+	auto scene = import.ReadFile(path, MODEL_IMPORT_FLAGS);
 
-	// Check if already loaded
-	for (GLuint j = 0; j < loadedTextures.size(); j++) {
-		if (loadedTextures[j].path == path) {
-			*texture = loadedTextures[j];
-			return;
-		}
+	if (!scene || scene->mFlags == AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
+		data->error = fmt::format("Assimp error while loading \"{}\":\n{}", path, import.GetErrorString());
+		return;
 	}
 
-	debug("Loading: {}", path.C_Str());
-	auto loadRes = loadTexture(path.C_Str(), this->directory.c_str(), modelProps);
-	texture->glObject = std::make_shared<GLTexture>(loadRes);
-	texture->path = path;
-	loadedTextures.push_back(*texture);
-}
+	ImportReport report;
+	processNode(scene->mRootNode, scene, props, data, &report);
+	data->useStorage();
 
-GLuint loadTexture(const std::string& relPath, const std::string& dir, ModelProps modelProps) {
-	int w, h, n;
+	auto name = path.substr(path.find_last_of('/') + 1);
+	if (props.optimizeMeshes) {
+		debug("Optimized {}: {} -> {} vertices, ACMR {:.3f} -> {:.3f}, ATVR {:.3f} -> {:.3f}",
+			name.c_str(), report.vertexCountBefore, report.after.vertexCount,
+			report.before.acmr(), report.after.acmr(), report.before.atvr(), report.after.atvr());
+	}
+	if (report.meshletCount > 0) {
+		debug("Split {} into {} meshlets", name.c_str(), report.meshletCount);
+	}
+	if (report.simplifiedMeshCount > 0) {
+		debug("Generated {} LODs for {}/{} meshes of {}, {} triangles at the coarsest level",
+			report.lodCount, report.simplifiedMeshCount, data->meshes.size(), name.c_str(), report.coarsestTriangleCount);
+	}
 
-	auto fixedRelPath = relPath;
-	auto fixedDir = dir;
-	fixOSPath(fixedRelPath);
-	fixOSPath(fixedDir);
+	if (cacheable) {
+		writeModelCache(cacheKey, *data);
+	}
+}
 
-	std::string fullPath = fmt::format("{}{}{}", fixedDir, PATH_SEP, fixedRelPath);
+ModelData importModel(const std::string& path, ModelProps props) {
+	ModelData data;
+	data.path = path;
+	data.directory = path.substr(0, path.find_last_of('/'));
+	importGeometry(path, props, &data);
+	return data;
+}
 
-	stbi_set_flip_vertically_on_load(true);
-	auto data = stbi_load(fullPath.c_str(), &w, &h, &n, 0);
-	if (data == nullptr) {
-		errorLog("Failed loading texture {}", relPath.c_str());
-		return 0;
+void Model::createMeshes(const ModelData& data) {
+	this->path = data.path;
+	this->directory = data.directory;
+
+	meshes.reserve(data.meshes.size());
+	for (auto& mesh : data.meshes) {
+		MeshTexture diffuseTex;
+		MeshTexture specTex;
+		MeshTexture normalTex;
+		loadMaterialTexture(mesh.material.diffusePath, TextureUsage::Diffuse, &diffuseTex);
+		loadMaterialTexture(mesh.material.specularPath, TextureUsage::Specular, &specTex);
+		loadMaterialTexture(mesh.material.normalPath, TextureUsage::Normal, &normalTex);
+
+		meshes.emplace_back(
+			data.vertices + mesh.firstVertex, mesh.vertexCount,
+			data.indices + mesh.firstIndex, mesh.indexCount, mesh.lods, mesh.meshlets,
+			diffuseTex, specTex, normalTex, mesh.material.color, mesh.material.specular,
+			geometryArenas, modelProps.packVertices);
 	}
 
-	GLuint textureID;
-	glGenTextures(1, &textureID);
-
-	glBindTexture(GL_TEXTURE_2D, textureID);
-
-	GLenum loadFormat;
-	GLint internalFormat;
-	switch (n) {
-	case 1:
-		loadFormat = GL_LUMINANCE;
-		internalFormat = GL_LUMINANCE;
-		break;
-	case 2:
-		loadFormat = GL_LUMINANCE_ALPHA;
-		internalFormat = GL_LUMINANCE_ALPHA;
-		break;
-	case 3:
-		internalFormat = GL_RGB;
-		loadFormat = GL_RGB;
-		break;
-	case 4:
-		internalFormat = GL_RGBA;
-		loadFormat = GL_RGBA;
-		break;
-	default:
-		errorLog("Unrecognized number of channels per pixel ({}) in {}", n, relPath.c_str());
-		return 0;
+	if (!modelProps.occluder) {
+		return;
 	}
+	// Small meshes hide little, so only the ones large relative to the model are rasterized
+	glm::vec3 modelMin(FLT_MAX);
+	glm::vec3 modelMax(-FLT_MAX);
+	for (auto& mesh : meshes) {
+		modelMin = glm::min(modelMin, mesh.boundsMin);
+		modelMax = glm::max(modelMax, mesh.boundsMax);
+	}
+	float minSize = OCCLUDER_MIN_RELATIVE_SIZE * glm::distance(modelMin, modelMax);
+	for (size_t i = 0; i < meshes.size(); i++) {
+		auto& mesh = meshes[i];
+		if (glm::distance(mesh.boundsMin, mesh.boundsMax) < minSize) {
+			continue;
+		}
+		// Simplified levels can bridge concave areas and hide what is behind
+		// them, so occluders keep every triangle of the full detail mesh
+		auto& lod = mesh.lods[0];
+		auto& meshData = data.meshes[i];
+		mesh.occluder = buildOccluder(data.vertices + meshData.firstVertex, data.indices + meshData.firstIndex + lod.firstIndex, lod.indexCount);
+	}
+}
 
-	glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, w, h, 0, loadFormat, GL_UNSIGNED_BYTE, data);
-	glGenerateMipmap(GL_TEXTURE_2D);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, modelProps.magFilter);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, modelProps.minFilter);
-	if (GLEW_EXT_texture_filter_anisotropic) {
-		float aniso;
-		glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &aniso);
-		glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT, aniso);
+void Model::loadMaterialTexture(const std::string& relPath, TextureUsage usage, MeshTexture* texture) const {
+	if (relPath.empty()) {
+		*texture = {aiString(""), nullptr};
+		return;
 	}
-	return textureID;
+
+	auto fullPath = fmt::format("{}{}{}", this->directory, PATH_SEP, relPath);
+	texture->glObject = textureRegistry.acquire(fullPath, usage, modelProps.magFilter, modelProps.minFilter);
+	texture->path = aiString(relPath);
 }
 
 void Model::setDiffuseColor(glm::vec3 color) {
@@ -253,8 +322,21 @@ void Model::setReflectiveness(float reflectiveness) {
 	}
 }
 
+size_t Model::texelMemory() const {
+	std::unordered_set<const StreamedTexture*> counted;
+	size_t total = 0;
+	for (auto& mesh : meshes) {
+		for (auto texture : {&mesh.diffuseTexture, &mesh.specularTexture, &mesh.normalTexture}) {
+			if (texture->glObject && counted.insert(texture->glObject.get()).second) {
+				total += textureMemory(*texture->glObject);
+			}
+		}
+	}
+	return total;
+}
+
 void Model::render(const ShaderProgram& shader) {
-	glUniform1f(glGetUniformLocation(shader.handle, "texRepeatFactor"), modelProps.texRepeatFactor);
+	glUniform1f(shader[UNIFORM_TEX_REPEAT_FACTOR], modelProps.texRepeatFactor);
 
 	for (GLuint i = 0; i < this->meshes.size(); i++) {
 		this->meshes[i].render(shader);
@@ -18,35 +18,62 @@
 
 #include "ShaderProgram.h"
 #include "Mesh.h"
+#include "ModelData.h"
+#include "TextureRegistry.h"
+#include "GeometryArena.h"
 
 struct ModelProps {
 	GLint magFilter;
 	GLint minFilter;
 	float texRepeatFactor;
+	/// Whether to run the mesh optimization passes from MeshOptimizer.h on import.
+	bool optimizeMeshes = true;
+	/// Whether to upload vertices in the compact format from VertexPacking.h.
+	bool packVertices = true;
+	/// Whether to build simplified levels of detail with MeshSimplifier.h on import.
+	bool generateLods = true;
+	/// Whether to split meshes into meshlets with Meshlets.h on import, for culling.
+	bool buildMeshlets = true;
+	/// Whether the large meshes hide other geometry, and are rasterized for
+	/// occlusion culling at full detail.
+	bool occluder = false;
 	ModelProps();
 	ModelProps(GLint magFilter, GLint minFilter, float texRepeatFactor);
 };
 
 class Model {
 public:
-	Model(const char* path, std::vector<MeshTexture>& loadedTextures);
-	Model(const char* path, ModelProps props, std::vector<MeshTexture>& loadedTextures);
+	Model(const ModelData& data, ModelProps props, TextureRegistry& textureRegistry, GeometryArenas& geometryArenas);
 	void render(const ShaderProgram& shader);
 	void setDiffuseColor(glm::vec3 tvec3);
 	void setSpecular(float x);
 	void setReflectiveness(float x);
+
+	float texRepeatFactor() const {
+		return modelProps.texRepeatFactor;
+	}
+
+	/// Returns the GL memory used by the textures of the model, counting
+	/// textures shared between its meshes once.
+	size_t texelMemory() const;
+
 	std::vector<Mesh> meshes;
 	std::string directory;
 	std::string path;
 private:
 	ModelProps modelProps;
-	std::vector<MeshTexture>& loadedTextures;
-	void loadModel(std::string path);
-	void processNode(aiNode* node, const aiScene* scene);
-	Mesh processMesh(aiNode* node, aiMesh* mesh, const aiScene* scene) const;
-	void loadMaterialTextures(aiMaterial* mat, aiTextureType type, MeshTexture* texture) const;
+	TextureRegistry& textureRegistry;
+	GeometryArenas& geometryArenas;
+	void createMeshes(const ModelData& data);
+	void loadMaterialTexture(const std::string& relPath, TextureUsage usage, MeshTexture* texture) const;
 };
 
-GLuint loadTexture(const std::string& relPath, const std::string& dir, ModelProps modelProps);
+/// Imports the geometry and materials of the model at path, without touching
+/// any GL state. Safe to call from any thread.
+///
+/// The binary model cache is used when it holds an up-to-date entry for the
+/// model, and is otherwise rebuilt from the assimp import. Failures are
+/// returned in ModelData::error for the caller to report.
+ModelData importModel(const std::string& path, ModelProps props);
 
 #endif // Model_H
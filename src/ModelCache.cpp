@@ -0,0 +1,313 @@
+//===----------------------------------------------------------------------===//
+//
+// This file is part of the Noxoscope project
+//
+// Copyright (c) 2016 Niklas Helmertz
+//
+//===----------------------------------------------------------------------===//
+
+#include "ModelCache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <thread>
+
+#include "Hash.h"
+#include "Logging.h"
+
+// Layout of a cache file, with every section starting at a 4-byte boundary:
+//
+//   CacheHeader
+//   Source path (not null-terminated)
+//   CachedMesh[meshCount]
+//   CachedLod[lodCount], the simplified levels of every mesh in order
+//   Meshlet[meshletCount], the meshlets of every mesh in order
+//   String table, null-terminated texture paths starting with an empty one
+//   Vertex[vertexCount]
+//   GLuint[indexCount]
+
+constexpr uint32_t MODEL_CACHE_MAGIC = 0x434d584e; // "NXMC"
+constexpr uint32_t MODEL_CACHE_VERSION = 4;
+
+struct CacheHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t vertexSize;
+	uint32_t importFlags;
+	int64_t sourceModificationTime;
+	uint64_t sourceSize;
+	int32_t magFilter;
+	int32_t minFilter;
+	float texRepeatFactor;
+	uint32_t optimizeMeshes;
+	uint32_t generateLods;
+	uint32_t buildMeshlets;
+	uint32_t sourcePathLength;
+	uint32_t meshCount;
+	uint32_t stringTableSize;
+	uint32_t lodCount;
+	uint32_t meshletCount;
+	uint32_t reserved;
+	uint64_t vertexCount;
+	uint64_t indexCount;
+};
+
+struct CachedMesh {
+	uint32_t firstVertex;
+	uint32_t vertexCount;
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	float color[4];
+	float specular;
+	uint32_t diffusePath;
+	uint32_t specularPath;
+	uint32_t normalPath;
+	uint32_t firstLod;
+	uint32_t lodCount;
+	uint32_t firstMeshlet;
+	uint32_t meshletCount;
+};
+
+struct CachedLod {
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	float error;
+};
+
+static_assert(sizeof(CacheHeader) == 96, "Unexpected padding in CacheHeader");
+static_assert(sizeof(CachedMesh) == 64, "Unexpected padding in CachedMesh");
+static_assert(sizeof(CachedLod) == 12, "Unexpected padding in CachedLod");
+static_assert(sizeof(Vertex) % 4 == 0, "Vertex size must keep the index array aligned");
+
+static size_t align4(size_t size) {
+	return (size + 3) & ~size_t(3);
+}
+
+static std::string cacheFilePath(const ModelCacheKey& key) {
+	auto hash = hashFnv1a(key.sourcePath.data(), key.sourcePath.size());
+	hash = hashFnv1a(&key.props.magFilter, sizeof(key.props.magFilter), hash);
+	hash = hashFnv1a(&key.props.minFilter, sizeof(key.props.minFilter), hash);
+	hash = hashFnv1a(&key.props.texRepeatFactor, sizeof(key.props.texRepeatFactor), hash);
+	hash = hashFnv1a(&key.props.optimizeMeshes, sizeof(key.props.optimizeMeshes), hash);
+	hash = hashFnv1a(&key.props.generateLods, sizeof(key.props.generateLods), hash);
+	hash = hashFnv1a(&key.props.buildMeshlets, sizeof(key.props.buildMeshlets), hash);
+	return baseDirRelative(fmt::format("cache{}models{}{:016x}.nxmodel", PATH_SEP, PATH_SEP, hash).c_str());
+}
+
+static CacheHeader makeHeader(const ModelCacheKey& key) {
+	CacheHeader header;
+	std::memset(&header, 0, sizeof(header));
+	header.magic = MODEL_CACHE_MAGIC;
+	header.version = MODEL_CACHE_VERSION;
+	header.vertexSize = sizeof(Vertex);
+	header.importFlags = key.importFlags;
+	header.sourceModificationTime = key.sourceInfo.modificationTime;
+	header.sourceSize = key.sourceInfo.size;
+	header.magFilter = key.props.magFilter;
+	header.minFilter = key.props.minFilter;
+	header.texRepeatFactor = key.props.texRepeatFactor;
+	header.optimizeMeshes = key.props.optimizeMeshes ? 1 : 0;
+	header.generateLods = key.props.generateLods ? 1 : 0;
+	header.buildMeshlets = key.props.buildMeshlets ? 1 : 0;
+	header.sourcePathLength = static_cast<uint32_t>(key.sourcePath.size());
+	return header;
+}
+
+bool readModelCache(const ModelCacheKey& key, ModelData* data) {
+	auto filePath = cacheFilePath(key);
+	MappedFile file;
+	if (!file.open(filePath.c_str())) {
+		return false;
+	}
+	if (file.size() < sizeof(CacheHeader)) {
+		warn("Ignoring truncated model cache file {}", filePath.c_str());
+		return false;
+	}
+
+	CacheHeader expected = makeHeader(key);
+	CacheHeader header;
+	std::memcpy(&header, file.data(), sizeof(header));
+
+	// Everything but the counts must match for the entry to be up to date
+	bool matches =
+		header.magic == expected.magic &&
+		header.version == expected.version &&
+		header.vertexSize == expected.vertexSize &&
+		header.importFlags == expected.importFlags &&
+		header.sourceModificationTime == expected.sourceModificationTime &&
+		header.sourceSize == expected.sourceSize &&
+		header.magFilter == expected.magFilter &&
+		header.minFilter == expected.minFilter &&
+		header.texRepeatFactor == expected.texRepeatFactor &&
+		header.optimizeMeshes == expected.optimizeMeshes &&
+		header.generateLods == expected.generateLods &&
+		header.buildMeshlets == expected.buildMeshlets &&
+		header.sourcePathLength == expected.sourcePathLength;
+	if (!matches) {
+		return false;
+	}
+
+	size_t pathOffset = sizeof(CacheHeader);
+	size_t meshOffset = pathOffset + align4(header.sourcePathLength);
+	size_t lodOffset = meshOffset + header.meshCount * sizeof(CachedMesh);
+	size_t meshletOffset = lodOffset + header.lodCount * sizeof(CachedLod);
+	size_t stringOffset = meshletOffset + header.meshletCount * sizeof(Meshlet);
+	size_t vertexOffset = stringOffset + align4(header.stringTableSize);
+	size_t indexOffset = vertexOffset + header.vertexCount * sizeof(Vertex);
+	size_t endOffset = indexOffset + header.indexCount * sizeof(GLuint);
+	if (endOffset != file.size() || header.stringTableSize == 0) {
+		warn("Ignoring corrupt model cache file {}", filePath.c_str());
+		return false;
+	}
+	if (key.sourcePath.compare(0, std::string::npos, file.data() + pathOffset, header.sourcePathLength) != 0) {
+		// Hash collision with another model
+		return false;
+	}
+
+	auto strings = file.data() + stringOffset;
+	auto stringAt = [&](uint32_t offset) {
+		return offset < header.stringTableSize ? std::string(strings + offset) : std::string();
+	};
+
+	std::vector<MeshData> meshes;
+	meshes.reserve(header.meshCount);
+	for (uint32_t i = 0; i < header.meshCount; i++) {
+		CachedMesh cached;
+		std::memcpy(&cached, file.data() + meshOffset + i * sizeof(CachedMesh), sizeof(cached));
+		if (cached.firstVertex + uint64_t(cached.vertexCount) > header.vertexCount ||
+			cached.firstIndex + uint64_t(cached.indexCount) > header.indexCount ||
+			cached.firstLod + uint64_t(cached.lodCount) > header.lodCount ||
+			cached.firstMeshlet + uint64_t(cached.meshletCount) > header.meshletCount) {
+			warn("Ignoring corrupt model cache file {}", filePath.c_str());
+			return false;
+		}
+
+		MeshData mesh;
+		mesh.firstVertex = cached.firstVertex;
+		mesh.vertexCount = cached.vertexCount;
+		mesh.firstIndex = cached.firstIndex;
+		mesh.indexCount = cached.indexCount;
+		mesh.material.color = glm::vec4(cached.color[0], cached.color[1], cached.color[2], cached.color[3]);
+		mesh.material.specular = cached.specular;
+		mesh.material.diffusePath = stringAt(cached.diffusePath);
+		mesh.material.specularPath = stringAt(cached.specularPath);
+		mesh.material.normalPath = stringAt(cached.normalPath);
+		for (uint32_t l = 0; l < cached.lodCount; l++) {
+			CachedLod cachedLod;
+			std::memcpy(&cachedLod, file.data() + lodOffset + (cached.firstLod + l) * sizeof(CachedLod), sizeof(cachedLod));
+			if (cached.firstIndex + uint64_t(cachedLod.firstIndex) + cachedLod.indexCount > header.indexCount) {
+				warn("Ignoring corrupt model cache file {}", filePath.c_str());
+				return false;
+			}
+			mesh.lods.push_back({cachedLod.firstIndex, cachedLod.indexCount, cachedLod.error});
+		}
+		mesh.meshlets.resize(cached.meshletCount);
+		if (cached.meshletCount > 0) {
+			std::memcpy(mesh.meshlets.data(), file.data() + meshletOffset + cached.firstMeshlet * sizeof(Meshlet), cached.meshletCount * sizeof(Meshlet));
+		}
+		for (auto& meshlet : mesh.meshlets) {
+			if (meshlet.firstIndex + uint64_t(meshlet.indexCount) > cached.indexCount) {
+				warn("Ignoring corrupt model cache file {}", filePath.c_str());
+				return false;
+			}
+		}
+		meshes.push_back(std::move(mesh));
+	}
+
+	data->meshes = std::move(meshes);
+	data->vertices = reinterpret_cast<const Vertex*>(file.data() + vertexOffset);
+	data->indices = reinterpret_cast<const GLuint*>(file.data() + indexOffset);
+	data->vertexCount = header.vertexCount;
+	data->indexCount = header.indexCount;
+	data->mapping = std::move(file);
+	return true;
+}
+
+bool writeModelCache(const ModelCacheKey& key, const ModelData& data) {
+	auto filePath = cacheFilePath(key);
+	auto dirPath = filePath.substr(0, filePath.find_last_of(PATH_SEP));
+	if (!makeDirectories(dirPath)) {
+		warn("Could not create model cache directory {}", dirPath.c_str());
+		return false;
+	}
+
+	std::string strings(1, '\0');
+	auto addString = [&](const std::string& str) -> uint32_t {
+		if (str.empty()) {
+			return 0;
+		}
+		auto offset = static_cast<uint32_t>(strings.size());
+		strings.append(str.c_str(), str.size() + 1);
+		return offset;
+	};
+
+	std::vector<CachedMesh> meshes;
+	std::vector<CachedLod> lods;
+	std::vector<Meshlet> meshlets;
+	meshes.reserve(data.meshes.size());
+	for (auto& mesh : data.meshes) {
+		CachedMesh cached;
+		cached.firstVertex = static_cast<uint32_t>(mesh.firstVertex);
+		cached.vertexCount = static_cast<uint32_t>(mesh.vertexCount);
+		cached.firstIndex = static_cast<uint32_t>(mesh.firstIndex);
+		cached.indexCount = static_cast<uint32_t>(mesh.indexCount);
+		for (int i = 0; i < 4; i++) {
+			cached.color[i] = mesh.material.color[i];
+		}
+		cached.specular = mesh.material.specular;
+		cached.diffusePath = addString(mesh.material.diffusePath);
+		cached.specularPath = addString(mesh.material.specularPath);
+		cached.normalPath = addString(mesh.material.normalPath);
+		cached.firstLod = static_cast<uint32_t>(lods.size());
+		cached.lodCount = static_cast<uint32_t>(mesh.lods.size());
+		for (auto& lod : mesh.lods) {
+			lods.push_back({static_cast<uint32_t>(lod.firstIndex), static_cast<uint32_t>(lod.indexCount), lod.error});
+		}
+		cached.firstMeshlet = static_cast<uint32_t>(meshlets.size());
+		cached.meshletCount = static_cast<uint32_t>(mesh.meshlets.size());
+		meshlets.insert(meshlets.end(), mesh.meshlets.begin(), mesh.meshlets.end());
+		meshes.push_back(cached);
+	}
+
+	auto header = makeHeader(key);
+	header.meshCount = static_cast<uint32_t>(meshes.size());
+	header.stringTableSize = static_cast<uint32_t>(strings.size());
+	header.lodCount = static_cast<uint32_t>(lods.size());
+	header.meshletCount = static_cast<uint32_t>(meshlets.size());
+	header.vertexCount = data.vertexCount;
+	header.indexCount = data.indexCount;
+
+	const char padding[4] = {};
+	// Unique per thread, as the same model may be imported by several at once
+	auto threadHash = std::hash<std::thread::id>()(std::this_thread::get_id());
+	auto tempPath = fmt::format("{}.{:x}.tmp", filePath, threadHash);
+	{
+		std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		out.write(key.sourcePath.data(), key.sourcePath.size());
+		out.write(padding, align4(key.sourcePath.size()) - key.sourcePath.size());
+		out.write(reinterpret_cast<const char*>(meshes.data()), meshes.size() * sizeof(CachedMesh));
+		out.write(reinterpret_cast<const char*>(lods.data()), lods.size() * sizeof(CachedLod));
+		out.write(reinterpret_cast<const char*>(meshlets.data()), meshlets.size() * sizeof(Meshlet));
+		out.write(strings.data(), strings.size());
+		out.write(padding, align4(strings.size()) - strings.size());
+		out.write(reinterpret_cast<const char*>(data.vertices), data.vertexCount * sizeof(Vertex));
+		out.write(reinterpret_cast<const char*>(data.indices), data.indexCount * sizeof(GLuint));
+		if (!out) {
+			warn("Failed writing model cache file {}", tempPath.c_str());
+			out.close();
+			std::remove(tempPath.c_str());
+			return false;
+		}
+	}
+
+	// Replace the old entry in one step, so readers never see a partial file
+	std::remove(filePath.c_str());
+	if (std::rename(tempPath.c_str(), filePath.c_str()) != 0) {
+		warn("Failed replacing model cache file {}", filePath.c_str());
+		std::remove(tempPath.c_str());
+		return false;
+	}
+	return true;
+}
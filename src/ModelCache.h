@@ -0,0 +1,43 @@
+//===----------------------------------------------------------------------===//
+//
+// This file is part of the Noxoscope project
+//
+// Copyright (c) 2016 Niklas Helmertz
+//
+//===----------------------------------------------------------------------===//
+//
+// Binary on-disk cache of imported models.
+//
+// A cache entry stores the final interleaved vertex array, the index array
+// including simplified levels of detail, and the material of every mesh in a
+// model. Entries are memory-mapped when read, so loading a cached model does
+// not parse or copy any vertex data before it is handed to glBufferData.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef ModelCache_H
+#define ModelCache_H
+
+#include <string>
+
+#include "Model.h"
+#include "ModelData.h"
+#include "FileTools.h"
+
+/// Identifies the import a cache entry was built from. An entry with a
+/// different key is considered stale.
+struct ModelCacheKey {
+	std::string sourcePath;
+	FileInfo sourceInfo;
+	unsigned importFlags;
+	ModelProps props;
+};
+
+/// Reads a cache entry matching key into data. Returns false if there is no
+/// valid entry, in which case data is left untouched.
+bool readModelCache(const ModelCacheKey& key, ModelData* data);
+
+/// Writes data as the cache entry for key, replacing any stale entry.
+bool writeModelCache(const ModelCacheKey& key, const ModelData& data);
+
+#endif // ModelCache_H
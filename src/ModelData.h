@@ -0,0 +1,78 @@
+//===----------------------------------------------------------------------===//
+//
+// This file is part of the Noxoscope project
+//
+// Copyright (c) 2016 Niklas Helmertz
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef ModelData_H
+#define ModelData_H
+
+#include <string>
+#include <vector>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "Mesh.h"
+#include "FileTools.h"
+
+/// Material parameters of a mesh, with texture paths relative to the model
+/// directory. Empty paths mean that the material has no such texture.
+struct MeshMaterial {
+	glm::vec4 color;
+	float specular;
+	std::string diffusePath;
+	std::string specularPath;
+	std::string normalPath;
+};
+
+/// Range of a single mesh in the vertex and index arrays of a ModelData.
+/// Indices are relative to the first vertex of the mesh. The indices of the
+/// simplified levels in lods directly follow the indexCount full detail ones.
+/// The meshlets cover the full detail indices.
+struct MeshData {
+	size_t firstVertex;
+	size_t vertexCount;
+	size_t firstIndex;
+	size_t indexCount;
+	std::vector<MeshLod> lods;
+	std::vector<Meshlet> meshlets;
+	MeshMaterial material;
+};
+
+/// \brief CPU-side result of importing a model, ready to be uploaded to GL.
+///
+/// The vertex and index arrays either point into the storage vectors, after
+/// an import through assimp, or directly into a memory-mapped cache file.
+struct ModelData {
+	std::string path;
+	std::string directory;
+	std::vector<MeshData> meshes;
+	const Vertex* vertices = nullptr;
+	const GLuint* indices = nullptr;
+	size_t vertexCount = 0;
+	size_t indexCount = 0;
+
+	std::vector<Vertex> vertexStorage;
+	std::vector<GLuint> indexStorage;
+	MappedFile mapping;
+
+	/// True if the geometry was read from the model cache.
+	bool fromCache = false;
+
+	/// Why the import failed, empty if it succeeded. Imports run on worker
+	/// threads, so failures are reported by whoever receives the data.
+	std::string error;
+
+	/// Points the vertex and index arrays to the storage vectors.
+	void useStorage() {
+		vertices = vertexStorage.data();
+		indices = indexStorage.data();
+		vertexCount = vertexStorage.size();
+		indexCount = indexStorage.size();
+	}
+};
+
+#endif // ModelData_H
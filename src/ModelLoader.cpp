@@ -0,0 +1,87 @@
+//===----------------------------------------------------------------------===//
+//
+// This file is part of the Noxoscope project
+//
+// Copyright (c) 2016 Niklas Helmertz
+//
+//===----------------------------------------------------------------------===//
+
+#include "ModelLoader.h"
+
+#include <chrono>
+
+#include "Logging.h"
+
+typedef std::chrono::high_resolution_clock LoadClock;
+
+static float millisecondsSince(LoadClock::time_point start) {
+	return std::chrono::duration<float, std::milli>(LoadClock::now() - start).count();
+}
+
+size_t ModelLoader::enqueue(const std::string& path, ModelProps props) {
+	Request request;
+	request.path = path;
+	request.props = props;
+	requests.push_back(std::move(request));
+	return requests.size() - 1;
+}
+
+void ModelLoader::load(ThreadPool& pool, const LoadedCallback& onLoaded) {
+	auto start = LoadClock::now();
+	threadCount = pool.threadCount();
+
+	// Requests are not added or removed while loading, so each worker can
+	// access its own request without locking
+	for (size_t id = 0; id < requests.size(); id++) {
+		pool.enqueue([this, id] {
+			auto& request = requests[id];
+			auto importStart = LoadClock::now();
+			request.data = importModel(request.path, request.props);
+			request.fromCache = request.data.fromCache;
+			request.importTime = millisecondsSince(importStart);
+
+			std::lock_guard<std::mutex> lock(mutex);
+			imported.push_back(id);
+			importDone.notify_one();
+		});
+	}
+
+	for (size_t remaining = requests.size(); remaining > 0; remaining--) {
+		size_t id;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			importDone.wait(lock, [this] { return !imported.empty(); });
+			id = imported.front();
+			imported.pop_front();
+		}
+
+		auto& request = requests[id];
+		if (!request.data.error.empty()) {
+			fatalError("{}", request.data.error.c_str());
+		}
+		auto uploadStart = LoadClock::now();
+		onLoaded(id, request.data, request.props);
+		request.uploadTime = millisecondsSince(uploadStart);
+
+		// Release the geometry and the cache mapping once uploaded
+		request.data = ModelData();
+	}
+
+	totalTime = millisecondsSince(start);
+}
+
+void ModelLoader::printReport() const {
+	float importSum = 0.0f;
+	float uploadSum = 0.0f;
+	debug("Model loading report:");
+	for (auto& request : requests) {
+		auto name = request.path.substr(request.path.find_last_of('/') + 1);
+		debug("  {:<40} import {:8.1f} ms{}  upload {:7.1f} ms",
+			name.c_str(), request.importTime, request.fromCache ? " (cached)" : "         ", request.uploadTime);
+		importSum += request.importTime;
+		uploadSum += request.uploadTime;
+	}
+	debug("  {} models on {} threads: {:.1f} ms total, {:.1f} ms import and {:.1f} ms upload if run serially",
+		requests.size(), threadCount, totalTime, importSum, uploadSum);
+	debug("");
+}
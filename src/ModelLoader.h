@@ -0,0 +1,62 @@
+//===----------------------------------------------------------------------===//
+//
+// This file is part of the Noxoscope project
+//
+// Copyright (c) 2016 Niklas Helmertz
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef ModelLoader_H
+#define ModelLoader_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <functional>
+#include <condition_variable>
+
+#include "Model.h"
+#include "ModelData.h"
+#include "ThreadPool.h"
+
+/// \brief Loads a batch of models in parallel.
+///
+/// The CPU-side import of every queued model, i.e. cache lookup or assimp
+/// parsing and vertex conversion, runs on a thread pool. Textures are left to
+/// the TextureStreamer, and load in after the models.
+/// Imported models are handed back one at a time, as they complete, on the
+/// thread that owns the GL context so that GL objects can be created.
+class ModelLoader {
+public:
+	typedef std::function<void(size_t id, const ModelData& data, ModelProps props)> LoadedCallback;
+
+	/// Queues a model for loading, returning an ID identifying it in the callback.
+	size_t enqueue(const std::string& path, ModelProps props = ModelProps());
+
+	/// Imports all queued models using pool, and calls onLoaded for each one on
+	/// the calling thread. Returns when every model has been handed over.
+	void load(ThreadPool& pool, const LoadedCallback& onLoaded);
+
+	/// Logs the time spent importing and uploading each model.
+	void printReport() const;
+
+private:
+	struct Request {
+		std::string path;
+		ModelProps props;
+		ModelData data;
+		bool fromCache = false;
+		float importTime = 0.0f;
+		float uploadTime = 0.0f;
+	};
+
+	std::vector<Request> requests;
+	std::deque<size_t> imported;
+	std::mutex mutex;
+	std::condition_variable importDone;
+	unsigned threadCount = 0;
+	float totalTime = 0.0f;
+};
+
+#endif // ModelLoader_H
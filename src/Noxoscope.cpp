@@ -16,6 +16,8 @@
 #include <vector>
 #include <thread>
 #include <algorithm>
+#include <limits>
+#include <cmath>
 
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
@@ -31,6 +33,8 @@
 #include "FileTools.h"
 #include "GeometryMath.h"
 #include "GLUtil.h"
+#include "GLState.h"
+#include "ModelLoader.h"
 
 void Noxoscope::loadAndRun(SDL_Window* mainWindow, SDL_GLContext mainContext) {
 	Noxoscope noxoscope(mainWindow, mainContext);
@@ -71,6 +75,7 @@ void Noxoscope::run() {
 		maxDeviation = std::max(maxDeviation, std::abs(lastFrametime - frameDiff));
 
 		update(frameDiff);
+		textureStreamer.update();
 
 		if (showGui) {
 			ImGui_ImplSdlGL3_NewFrame(mainwindow);
@@ -133,13 +138,25 @@ void Noxoscope::initialize() {
 		baseDirRelative("assets/shaders/blur.frag").c_str()
 	);
 	lightShader = ShaderProgram(
-		baseDirRelative("assets/shaders/basic_post_process.vert").c_str(),
+		baseDirRelative("assets/shaders/lightvolume.vert").c_str(),
+		baseDirRelative("assets/shaders/lightpass.frag").c_str()
+	);
+	lightQuadShader = ShaderProgram(
+		baseDirRelative("assets/shaders/lightquad.vert").c_str(),
 		baseDirRelative("assets/shaders/lightpass.frag").c_str()
 	);
-	simpleShader = ShaderProgram(
-		baseDirRelative("assets/shaders/simplemvp.vert").c_str(),
-		baseDirRelative("assets/shaders/simple.frag").c_str()
+	batchedLightShader = ShaderProgram(
+		baseDirRelative("assets/shaders/basic_post_process.vert").c_str(),
+		baseDirRelative("assets/shaders/batchedlight.frag").c_str()
 	);
+	clusteredLightShader = ShaderProgram(
+		baseDirRelative("assets/shaders/basic_post_process.vert").c_str(),
+		baseDirRelative("assets/shaders/clusteredlight.frag").c_str()
+	);
+
+	frameUniformBuffer.create(FRAME_UNIFORMS_BINDING, sizeof(FrameUniforms));
+	staticUniformBuffer.create(STATIC_UNIFORMS_BINDING, sizeof(StaticUniforms));
+	lightBatchBuffer.create(LIGHT_BATCH_BINDING, sizeof(LightBatchUniforms));
 
 	onResize();
 }
@@ -153,7 +170,9 @@ void Noxoscope::reloadShaders() {
 	renderTextureShader.reload(false);
 	blurShader.reload(false);
 	lightShader.reload(false);
-	simpleShader.reload(false);
+	lightQuadShader.reload(false);
+	batchedLightShader.reload(false);
+	clusteredLightShader.reload(false);
 }
 
 void Noxoscope::reloadBuffers() {
@@ -254,9 +273,10 @@ void Noxoscope::reloadBuffers() {
 
 	std::uniform_real_distribution<float> randomFloats(0.0f, 1.0f);
 	std::default_random_engine generator;
-	const int NUM_SSAO_KERNEL = 64;
 	const int NUM_SSAO_NOISE = 16;
-	for (int i = 0; i < NUM_SSAO_KERNEL; ++i) {
+	ssaoKernel.clear();
+	ssaoNoise.clear();
+	for (size_t i = 0; i < SSAO_KERNEL_SIZE; ++i) {
 		vec3 sample(
 			randomFloats(generator) * 2.0f - 1.0f,
 			randomFloats(generator) * 2.0f - 1.0f,
@@ -264,11 +284,17 @@ void Noxoscope::reloadBuffers() {
 		);
 		sample = normalize(sample);
 		sample *= randomFloats(generator);
-		float scale = static_cast<float>(i) / NUM_SSAO_KERNEL;
+		float scale = static_cast<float>(i) / SSAO_KERNEL_SIZE;
 		scale = lerp(0.1f, 1.0f, scale * scale);
 		ssaoKernel.push_back(sample * scale);
 	}
 
+	StaticUniforms staticUniforms;
+	for (size_t i = 0; i < SSAO_KERNEL_SIZE; i++) {
+		staticUniforms.ssaoKernel[i] = vec4(ssaoKernel[i], 0.0f);
+	}
+	staticUniformBuffer.update(staticUniforms);
+
 	for (int i = 0; i < NUM_SSAO_NOISE; i++) {
 		vec3 noise(
 			randomFloats(generator) * 2.0f - 1.0f,
@@ -415,84 +441,107 @@ void Noxoscope::loadModels() {
 	glEnableVertexAttribArray(1);
 	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(GLfloat), reinterpret_cast<GLvoid*>(3 * sizeof(GLfloat)));
 
+	lightVolumes.create();
+	lightQuads.create();
+
 	models = std::vector<Model>();
 	models.reserve(MAX_MODELS);
 	entities = std::vector<Entity>();
-	entities.reserve(MAX_ENTITIES);
-	lights = std::vector<PointLight>();
-	lights.reserve(MAX_LIGHTS);
-
-	lights.push_back({vec3(0.0f, 6.0f, 0.0f), 40, 0.3f * PAPAYA_WHIP});
-	mainLight = &lights.back();
-	lights.push_back({vec3(0.0f, 2.4f, 3.0f), 6, RED});
-	redLight = &lights.back();
-	lights.push_back({vec3(0.0f, 2.4f, -3.0f), 6, BLUE});
-	blueLight = &lights.back();
-
-	lights.push_back({vec3(-4.45f, 1.17f, -1.45f), 2.0f, YELLOW});
-	lights.push_back({vec3(-4.45f, 1.17f, 1.45f), 2.0f, YELLOW});
-
-	lights.push_back({vec3(4.395f, 1.17f, -1.45f), 2.0f, YELLOW});
-	lights.push_back({vec3(4.395f, 1.17f, 1.45f), 2.0f, YELLOW});
-
-	lights.push_back({vec3(9.8f, 0.3f, 0.0f), 7.0f, WHITE});
-	lights.push_back({vec3(-9.8f, 0.3f, 0.0f), 7.0f, WHITE});
+	lights.add({vec3(0.0f, 6.0f, 0.0f), 40, 0.3f * PAPAYA_WHIP});
+	auto lampOrbit = lights.addOrbit(vec3(0.0f), 0.3f);
+	lights.setOrbit(lights.add({vec3(0.0f, 2.4f, 3.0f), 6, RED}), lampOrbit);
+	lights.setOrbit(lights.add({vec3(0.0f, 2.4f, -3.0f), 6, BLUE}), lampOrbit);
+
+	lights.add({vec3(-4.45f, 1.17f, -1.45f), 2.0f, YELLOW});
+	lights.add({vec3(-4.45f, 1.17f, 1.45f), 2.0f, YELLOW});
+
+	lights.add({vec3(4.395f, 1.17f, -1.45f), 2.0f, YELLOW});
+	lights.add({vec3(4.395f, 1.17f, 1.45f), 2.0f, YELLOW});
+
+	lights.add({vec3(9.8f, 0.3f, 0.0f), 7.0f, WHITE});
+	lights.add({vec3(-9.8f, 0.3f, 0.0f), 7.0f, WHITE});
+
+	lights.add({vec3(-5.75f, 1.09f, -0.18f), 1.5f, WHITE});
+
+	// Import all models in parallel, and configure them once loaded
+	ModelLoader loader;
+	auto cornellId = loader.enqueue(baseDirRelative("assets/models/cornell-box/CornellBox-Noxoscope.obj"));
+	auto landId = loader.enqueue(baseDirRelative("assets/models/groundplane/plane.obj"), {GL_NEAREST, GL_NEAREST, 12000.0f});
+	auto sponzaPlaneId = loader.enqueue(baseDirRelative("assets/models/groundplane/sponzaplane.obj"), {GL_LINEAR, GL_LINEAR_MIPMAP_LINEAR, 40.0f});
+	auto tempSphereId = loader.enqueue(baseDirRelative("assets/models/sphere/sphere-lowpoly.obj"));
+	auto sphereId = loader.enqueue(baseDirRelative("assets/models/sphere/sphere.obj"));
+	auto normalMapCubeId = loader.enqueue(baseDirRelative("assets/models/normalmap-test-cube/normalmap-test-cube.obj"));
+	auto reflCubeId = loader.enqueue(baseDirRelative("assets/models/cube/cube.obj"));
+	auto reflSphereId = loader.enqueue(baseDirRelative("assets/models/sphere/sphere.obj"));
+#ifdef NDEBUG
+	auto skydomeId = loader.enqueue(baseDirRelative("assets/models/skydome/linkeltje_skydome_linkeltje_2.obj"));
+	ModelProps sponzaProps;
+	sponzaProps.occluder = true;
+	auto sponzaId = loader.enqueue(baseDirRelative("assets/models/sponza/sponza.obj"), sponzaProps);
+	auto dragonId = loader.enqueue(baseDirRelative("assets/models/stanford-dragon/dragon.obj"));
+#endif
 
-	lights.push_back({vec3(-5.75f, 1.09f, -0.18f), 1.5f, WHITE});
+	std::vector<Model*> loaded(MAX_MODELS);
+	loader.load(workerPool, [&](size_t id, const ModelData& data, ModelProps props) {
+		loaded[id] = &addModel(data, props);
+	});
+	loader.printReport();
+	printGeometryMemoryReport();
 
-	auto& cornell = addModel("assets/models/cornell-box/CornellBox-Noxoscope.obj");
+	auto& cornell = *loaded[cornellId];
 	addEntity(cornell, translate(vec3(0.0f, 0.047f, 0.0f)) * yawPitchRoll(radians(90.0f), 0.0f, 0.0f) * scale(vec3(0.5f)));
 
-	auto& land = addModel("assets/models/groundplane/plane.obj", {GL_NEAREST, GL_NEAREST, 12000.0f});
+	auto& land = *loaded[landId];
 	addEntity(land, translate(vec3(0.0f, 0.0f, 0.0f)) * scale(vec3(6000.0f)));
 
-	auto& sponzaPlane = addModel("assets/models/groundplane/sponzaplane.obj", {GL_LINEAR, GL_LINEAR_MIPMAP_LINEAR, 40.0f});
+	auto& sponzaPlane = *loaded[sponzaPlaneId];
 	sponzaPlane.setReflectiveness(1.0f);
 	addEntity(sponzaPlane, translate(vec3(0.0f, 0.045f, 0.0f)) * scale(vec3(40.0f)));
 
-	tempSphere = &addModel("assets/models/sphere/sphere-lowpoly.obj");
+	// Light spheres are tinted per instance with the color of their light
+	tempSphere = loaded[tempSphereId];
+	tempSphere->setDiffuseColor(WHITE);
+	tempSphere->setSpecular(1.0f);
 
-	auto& sphere = addModel("assets/models/sphere/sphere.obj");
+	auto& sphere = *loaded[sphereId];
 	sphere.setDiffuseColor(WHITE);
 	sphere.setSpecular(1.0f);
 	addEntity(sphere, translate(vec3(2.8f, 0.0f, 0.0f)));
 
-	auto& normalMapCube = addModel("assets/models/normalmap-test-cube/normalmap-test-cube.obj");
+	auto& normalMapCube = *loaded[normalMapCubeId];
 	sphere.setDiffuseColor(WHITE);
 	sphere.setSpecular(1.0f);
 	addEntity(normalMapCube, translate(vec3(8.0f, 0.0f, 0.0f)));
 
-	auto& reflCube = addModel("assets/models/cube/cube.obj");
+	auto& reflCube = *loaded[reflCubeId];
 	reflCube.setReflectiveness(1.0f);
 	addEntity(reflCube, translate(vec3(5.0f, 0.0f, 0.0f)));
 
-	auto& reflSphere = addModel("assets/models/sphere/sphere.obj");
+	auto& reflSphere = *loaded[reflSphereId];
 	reflSphere.setReflectiveness(1.0f);
 	addEntity(reflSphere, translate(vec3(6.5f, 0.0f, 0.0f)));
 
 #ifdef NDEBUG
-	auto& skydome = addModel("assets/models/skydome/linkeltje_skydome_linkeltje_2.obj");
+	auto& skydome = *loaded[skydomeId];
 	addEntity(skydome, translate(vec3(0.0f, -210.0f, 0.0f)) * scale(vec3(270.0f)));
 
-	auto& sponza = addModel("assets/models/sponza/sponza.obj");
+	auto& sponza = *loaded[sponzaId];
 	sponza.setDiffuseColor(WHITE);
 	addEntity(sponza, translate(vec3(0.0f, 0.03f, 0.0f)) * scale(vec3(0.008f)) * translate(vec3(62.5f, 0.0f, 38.0f)));
 
-	auto& dragonModel = addModel("assets/models/stanford-dragon/dragon.obj");
+	auto& dragonModel = *loaded[dragonId];
 	dragonModel.setDiffuseColor(1.1f * DARK_RED);
 	dragonModel.setSpecular(1.0f);
 	addEntity(dragonModel, translate(vec3(-7.0f, 0.0f, 0.0f)) * yawPitchRoll(radians(180.0f), 0.0f, 0.0f) * scale(vec3(1.0f)) * translate(vec3(0.0f, 0.0f, 0.0f)));
 #endif
-}
 
-Model& Noxoscope::addModel(const char* path) {
-	ModelProps props;
-	return addModel(path, props);
+	// Entities were inserted one at a time, so build a better tree over all of them
+	entityBvh.rebuild();
 }
 
-Model& Noxoscope::addModel(const char* path, ModelProps props) {
+Model& Noxoscope::addModel(const ModelData& data, ModelProps props) {
 	assert(modelCount < MAX_MODELS);
-	models.emplace_back(baseDirRelative(path).c_str(), props, loadedTextures);
+	models.emplace_back(data, props, textureRegistry, geometryArenas);
 	return models[modelCount++];
 }
 
@@ -502,10 +551,21 @@ Model& Noxoscope::addModelCopy(const Model& model) {
 	return models[modelCount++];
 }
 
-Entity& Noxoscope::addEntity(Model& model, glm::mat4 modelMatrix) {
-	assert(modelCount < MAX_ENTITIES);
+size_t Noxoscope::addEntity(Model& model, glm::mat4 modelMatrix) {
 	entities.emplace_back(&model, modelMatrix);
-	return entities[entityCount++];
+	auto& entity = entities[entityCount];
+	entityProxies.push_back(entityBvh.insert(static_cast<uint32_t>(entityCount), entity.boundsMin, entity.boundsMax));
+	entityMeshCount += model.meshes.size();
+	for (auto& mesh : model.meshes) {
+		entityMeshletCount += mesh.meshlets.size();
+	}
+	return entityCount++;
+}
+
+void Noxoscope::moveEntity(size_t index, glm::mat4 modelMatrix) {
+	auto& entity = entities[index];
+	entity.setModelMatrix(modelMatrix);
+	entityBvh.update(entityProxies[index], entity.boundsMin, entity.boundsMax);
 }
 
 void Noxoscope::getSize(int* w, int* h) const {
@@ -674,8 +734,7 @@ void Noxoscope::update(float fDiff) {
 
 	SDL_Event event;
 
-	redLight->position = rotateY(redLight->position, fDiff * 0.3f);
-	blueLight->position = rotateY(blueLight->position, fDiff * 0.3f);
+	lights.animate(fDiff);
 
 	while (SDL_PollEvent(&event)) {
 		if (showGui) ImGui_ImplSdlGL3_ProcessEvent(&event);
@@ -696,8 +755,8 @@ void Noxoscope::update(float fDiff) {
 			break;
 		}
 	}
-	if (rotModel) {
-		rotModel->modelMatrix = rotModel->modelMatrix * rotate(fDiff, UNIT_Y);
+	if (rotatingEntity != NO_ENTITY) {
+		moveEntity(rotatingEntity, entities[rotatingEntity].modelMatrix() * rotate(fDiff, UNIT_Y));
 	}
 }
 
@@ -750,7 +809,21 @@ SD / frametime      : {:.3f}%
 MD / frametime      : {:.3f}%
 Resolution          : {}x{}
 Internal resolution : {}x{}
-SDL Swapinterval    : {})";
+SDL Swapinterval    : {}
+Streaming textures  : {}
+G-buffer fill       : {:.3f} ms
+Triangles           : {} ({} at full detail)
+Visible triangles   : {}
+Visible entities    : {}/{}
+Visible meshes      : {}/{}
+Occluded            : {} entities, {} meshes ({} occluder triangles)
+Lights              : {}/{} ({} small, {} dim, {} cluster entries)
+Light quads         : {} ({} px, {:.2f}x screen)
+Light batches       : {} of up to {}
+Visible meshlets    : {}/{}
+Draw ranges         : {}
+Draw calls          : {} ({} instanced, {} instances, {} indirect)
+GL state changes    : {} ({} skipped))";
 
 	cachedStatisticsWindowText = fmt::format(STATISTICS_WINDOW_TEMPLATE,
 		to_string(cameraPosition).c_str(),
@@ -765,7 +838,43 @@ SDL Swapinterval    : {})";
 		height,
 		internalWidth,
 		internalHeight,
-		SDL_GL_GetSwapInterval());
+		SDL_GL_GetSwapInterval(),
+		textureStreamer.pendingCount(),
+		gBufferTimer.milliseconds(),
+		lodStatistics.triangleCount,
+		lodStatistics.fullDetailTriangleCount,
+		cullStatistics.triangleCount,
+		cullStatistics.visibleEntityCount,
+		cullStatistics.entityCount,
+		cullStatistics.visibleMeshCount,
+		cullStatistics.meshCount,
+		cullStatistics.occludedEntityCount,
+		cullStatistics.occludedMeshCount,
+		occlusionCulling ? occlusionBuffer.triangleCount() : 0,
+		lightCullStatistics.visibleCount,
+		lightCullStatistics.lightCount,
+		lightCullStatistics.smallCount,
+		lightCullStatistics.dimCount,
+		lightingMode == LIGHTING_CLUSTERED ? lightClusters.lightIndices().size() : 0,
+		lightingMode == LIGHTING_QUADS ? lightQuads.quadCount() : 0,
+		lightingMode == LIGHTING_QUADS ? lightQuads.coveredPixels() : 0,
+		lightingMode == LIGHTING_QUADS ? static_cast<double>(lightQuads.coveredPixels()) / (internalWidth * internalHeight) : 0.0,
+		lightingMode == LIGHTING_BATCHED ? lightBatches.batchCount() : 0,
+		LIGHT_BATCH_SIZES[lightBatchSize],
+		cullStatistics.visibleMeshletCount,
+		cullStatistics.meshletCount,
+		cullStatistics.drawCount,
+		queueStatistics.drawCount,
+		queueStatistics.instancedDrawCount,
+		queueStatistics.instanceCount,
+		queueStatistics.indirectCommandCount,
+		stateIssuedCount,
+		stateSkippedCount);
+
+	if (!textureReportPrinted && textureStreamer.pendingCount() == 0) {
+		printTextureMemoryReport();
+		textureReportPrinted = true;
+	}
 
 	frameTimeAccumulator = 0;
 	deviationAccumulator = 0;
@@ -776,7 +885,59 @@ SDL Swapinterval    : {})";
 }
 
 void Noxoscope::addLightAtPlayer() {
-	lights.push_back({cameraPosition + 2.0f * cameraDirection, 2, WHITE});
+	lights.add({cameraPosition + 2.0f * cameraDirection, 2, WHITE});
+}
+
+void Noxoscope::addRandomLights(size_t count) {
+	using namespace glm;
+	// Small lights spread through the atrium of the Sponza model
+	std::uniform_real_distribution<float> randomFloats(0.0f, 1.0f);
+	std::default_random_engine generator(static_cast<unsigned>(lights.size()));
+	for (size_t i = 0; i < count; i++) {
+		vec3 position(randomFloats(generator) * 24.0f - 12.0f, randomFloats(generator) * 8.0f, randomFloats(generator) * 12.0f - 6.0f);
+		vec3 color(randomFloats(generator), randomFloats(generator), randomFloats(generator));
+		lights.add({position, 0.3f + randomFloats(generator), color});
+	}
+}
+
+void Noxoscope::printTextureMemoryReport() {
+	textureRegistry.collect();
+	textureRegistry.printReport();
+
+	debug("Texture memory per model:");
+	for (auto& model : models) {
+		auto name = model.path.substr(model.path.find_last_of('/') + 1);
+		debug("  {:10.2f} KiB  {}", model.texelMemory() / 1024.0f, name.c_str());
+	}
+	debug("");
+}
+
+void Noxoscope::printGeometryMemoryReport() {
+	const float MIB = 1024.0f * 1024.0f;
+	size_t vertexMemory = 0;
+	size_t unpackedVertexMemory = 0;
+	size_t indexMemory = 0;
+	size_t wideIndexMemory = 0;
+	size_t narrowMeshCount = 0;
+	size_t meshCount = 0;
+	for (auto& model : models) {
+		for (auto& mesh : model.meshes) {
+			vertexMemory += mesh.vertexMemory();
+			unpackedVertexMemory += mesh.unpackedVertexMemory();
+			indexMemory += mesh.indexMemory();
+			wideIndexMemory += mesh.wideIndexMemory();
+			narrowMeshCount += mesh.indexType == GL_UNSIGNED_SHORT;
+			meshCount++;
+		}
+	}
+	debug("Vertex memory: {:.2f} MiB ({:.2f} MiB unpacked)", vertexMemory / MIB, unpackedVertexMemory / MIB);
+	debug("Index memory: {:.2f} MiB ({:.2f} MiB as 32-bit), {}/{} meshes with 16-bit indices",
+		indexMemory / MIB, wideIndexMemory / MIB, narrowMeshCount, meshCount);
+	for (bool packed : {true, false}) {
+		auto& arena = geometryArenas.get(packed);
+		debug("{} arena: {:.2f}/{:.2f} MiB vertices, {:.2f}/{:.2f} MiB indices", packed ? "Packed" : "Unpacked",
+			arena.vertexBytes() / MIB, arena.vertexCapacityBytes() / MIB, arena.indexBytes() / MIB, arena.indexCapacityBytes() / MIB);
+	}
 }
 
 //===----------------------------------------------------------------------===//
@@ -786,12 +947,20 @@ void Noxoscope::addLightAtPlayer() {
 void Noxoscope::render() {
 	using namespace glm;
 
-	glEnable(GL_CULL_FACE);
-	glEnable(GL_DEPTH_TEST);
+	// The GUI and texture uploads change state behind the tracker's back
+	glState.invalidate();
+	stateIssuedCount = glState.issuedCount;
+	stateSkippedCount = glState.skippedCount;
+	glState.resetCounters();
+
+	glState.enable(GL_CULL_FACE);
+	glState.enable(GL_DEPTH_TEST);
 
 	viewMatrix = lookAt(cameraPosition, cameraPosition + cameraDirection, UNIT_Y);
 	projectionMatrix = perspective(70.0f, aspect, near, far);
 	inverseProjection = inverse(projectionMatrix);
+	updateFrameUniforms();
+	prepareDraws();
 
 	if (!fallbackRender) {
 		deferredRender();
@@ -800,14 +969,25 @@ void Noxoscope::render() {
 	}
 	lastProjectionMatrix = projectionMatrix;
 	lastViewMatrix = viewMatrix;
+
+	// Keep later buffer setup from changing the last bound vertex array
+	glState.bindVertexArray(0);
+}
+
+void Noxoscope::updateFrameUniforms() {
+	FrameUniforms frameUniforms;
+	frameUniforms.viewMatrix = viewMatrix;
+	frameUniforms.projMatrix = projectionMatrix;
+	frameUniforms.invProj = inverseProjection;
+	frameUniforms.screenSize = glm::vec2(internalWidth, internalHeight);
+	frameUniforms.nearPlane = near;
+	frameUniforms.farPlane = far;
+	frameUniformBuffer.update(frameUniforms);
 }
 
 void Noxoscope::forwardRender() {
 	mainForwardShader.use();
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-	glUniformMatrix4fv(mainForwardShader[UNIFORM_VIEW_MATRIX], 1, GL_FALSE, value_ptr(viewMatrix));
-	glUniformMatrix4fv(mainForwardShader[UNIFORM_PROJECTION_MATRIX], 1, GL_FALSE, value_ptr(projectionMatrix));
 	renderObjects(mainForwardShader);
 }
 
@@ -816,18 +996,16 @@ void Noxoscope::deferredRender() {
 
 	// Render geometry to G-buffer
 
-	glViewport(0, 0, internalWidth, internalHeight);
-	glBindFramebuffer(GL_FRAMEBUFFER, gBuffer.handle);
+	glState.viewport(0, 0, internalWidth, internalHeight);
+	glState.bindFramebuffer(gBuffer.handle);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 	glClearBufferfv(GL_COLOR, gBufferDepth.handle, value_ptr(WHITE));
 
 	gBufferShader.use();
-	glUniformMatrix4fv(gBufferShader[UNIFORM_VIEW_MATRIX], 1, GL_FALSE, value_ptr(viewMatrix));
-	glUniformMatrix4fv(gBufferShader[UNIFORM_PROJECTION_MATRIX], 1, GL_FALSE, value_ptr(projectionMatrix));
-	glUniform1f(gBufferShader["near"], near);
-	glUniform1f(gBufferShader["far"], far);
 
+	gBufferTimer.begin();
 	renderObjects(gBufferShader);
+	gBufferTimer.end();
 
 	if (ssao) {
 		ssaoRender();
@@ -839,14 +1017,12 @@ void Noxoscope::deferredRender() {
 
 	lightBufferRender();
 
-	glBindFramebuffer(GL_FRAMEBUFFER, currentFinalFbo->handle);
+	glState.bindFramebuffer(currentFinalFbo->handle);
 
 	glClear(GL_COLOR_BUFFER_BIT);
-	glDisable(GL_DEPTH_TEST);
+	glState.disable(GL_DEPTH_TEST);
 	lightCombineShader.use();
 
-	glUniform1f(lightCombineShader["screenWidth"], float(width));
-	glUniform1f(lightCombineShader["screenHeight"], float(height));
 	glUniform1i(lightCombineShader["ssao"], ssao ? GL_TRUE : GL_FALSE);
 	glUniform1i(lightCombineShader["ssr"], ssr ? GL_TRUE : GL_FALSE);
 
@@ -863,21 +1039,18 @@ void Noxoscope::deferredRender() {
 
 	attachTextures(lightCombineShader, gMembers);
 
-	glUniformMatrix4fv(lightCombineShader[UNIFORM_INVERSE_PROJECTION_MATRIX], 1, GL_FALSE, value_ptr(inverseProjection));
-	glUniformMatrix4fv(lightCombineShader[UNIFORM_PROJECTION_MATRIX], 1, GL_FALSE, value_ptr(projectionMatrix));
 	glUniform1i(lightCombineShader["showDebugBar"], showDebugBar);
 
 	renderQuad();
 
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glState.bindFramebuffer(0);
 	renderTextureShader.use();
-	glViewport(0, 0, width, height);
+	glState.viewport(0, 0, width, height);
 
 	glClear(GL_COLOR_BUFFER_BIT);
-	glDisable(GL_DEPTH_TEST);
+	glState.disable(GL_DEPTH_TEST);
 
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, currentFinalTexture->handle);
+	glState.bindTexture(0, currentFinalTexture->handle);
 
 	glUniform1i(renderTextureShader["tex"], 0);
 	renderQuad();
@@ -886,78 +1059,124 @@ void Noxoscope::deferredRender() {
 }
 
 void Noxoscope::lightBufferRender() {
-	using namespace glm;
-
 	// Do shading calculation on G-buffer content
-	glBindFramebuffer(GL_FRAMEBUFFER, lightFbo.handle);
-	glViewport(0, 0, internalWidth, internalHeight);
+	glState.bindFramebuffer(lightFbo.handle);
+	glState.viewport(0, 0, internalWidth, internalHeight);
 	glClear(GL_COLOR_BUFFER_BIT);
-	glEnable(GL_STENCIL_TEST);
-
-	// Render lights using a stencil culling algorithm, using low-polygon spheres
-	for (auto& light : lights) {
-		simpleShader.use();
-
-		glDisable(GL_CULL_FACE);
-		glEnable(GL_DEPTH_TEST);
-		glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
-		glDepthMask(GL_FALSE);
-		glStencilFunc(GL_ALWAYS, 0, 0);
-		glStencilOpSeparate(GL_BACK, GL_KEEP, GL_INCR_WRAP, GL_KEEP);
-		glStencilOpSeparate(GL_FRONT, GL_KEEP, GL_DECR_WRAP, GL_KEEP);
-		glStencilMask(0xFF);
-
-		glClear(GL_STENCIL_BUFFER_BIT);
-
-		glUniformMatrix4fv(simpleShader[UNIFORM_MODEL_MATRIX], 1, GL_FALSE, value_ptr(translate(light.position) * scale(vec3(2 * light.radius))));
-		glUniformMatrix4fv(simpleShader[UNIFORM_VIEW_MATRIX], 1, GL_FALSE, value_ptr(viewMatrix));
-		glUniformMatrix4fv(simpleShader[UNIFORM_PROJECTION_MATRIX], 1, GL_FALSE, value_ptr(projectionMatrix));
-
-		tempSphere->render(simpleShader);
-
-		// Do light calculations using the stencil mask
-		lightShader.use();
-
-		glEnable(GL_CULL_FACE);
-		glDisable(GL_DEPTH_TEST);
-		glEnable(GL_BLEND);
-		glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
-		glDepthMask(GL_TRUE);
-		glStencilFunc(GL_NOTEQUAL, 0, 0xFF);
-		glStencilMask(0x00);
-		glBlendEquation(GL_FUNC_ADD);
-		glBlendFunc(GL_ONE, GL_ONE);
-
-		auto lightInputTextures = {
-			std::make_tuple(gBufferDepth.handle, "gPosition"),
-			std::make_tuple(gBufferNormalMappedNormal.handle, "gNormal"),
-			std::make_tuple(gBufferDiffuse.handle, "gDiffuse"),
-			std::make_tuple(gBufferSpecular.handle, "gSpecular")
-		};
-		attachTextures(lightShader, lightInputTextures);
+	switch (lightingMode) {
+	case LIGHTING_CLUSTERED: clusteredLightRender(); break;
+	case LIGHTING_VOLUMES: lightVolumeRender(); break;
+	case LIGHTING_QUADS: lightQuadRender(); break;
+	case LIGHTING_BATCHED: lightBatchRender(); break;
+	}
+}
 
-		glUniform1i(lightShader["stencilDebugRender"], stencilDebugRender ? GL_TRUE : GL_FALSE);
+void Noxoscope::attachLightInputs(const ShaderProgram& shader) const {
+	auto lightInputTextures = {
+		std::make_tuple(gBufferDepth.handle, "gPosition"),
+		std::make_tuple(gBufferNormalMappedNormal.handle, "gNormal"),
+		std::make_tuple(gBufferDiffuse.handle, "gDiffuse"),
+		std::make_tuple(gBufferSpecular.handle, "gSpecular")
+	};
+	attachTextures(shader, lightInputTextures);
+	glUniform1i(shader[UNIFORM_STENCIL_DEBUG_RENDER], stencilDebugRender ? GL_TRUE : GL_FALSE);
+}
 
-		auto vsLightPos = vec3(viewMatrix * vec4(light.position, 1));
-		glUniform3fv(lightShader["lightPos"], 1, value_ptr(vsLightPos));
-		glUniform3fv(lightShader["lightColor"], 1, value_ptr(light.color));
+void Noxoscope::lightVolumeRender() {
+	// Draw the back faces of all light volumes at once, where they are behind
+	// the scene geometry. Depth clamping keeps volumes reaching past the far
+	// plane from being clipped
+	lightVolumes.update(lights.visibleLights());
+	lightShader.use();
+	glState.enable(GL_CULL_FACE);
+	glState.cullFace(GL_FRONT);
+	glState.enable(GL_DEPTH_TEST);
+	glState.depthFunc(GL_GREATER);
+	glState.depthMask(false);
+	glState.enable(GL_DEPTH_CLAMP);
+	glState.enable(GL_BLEND);
+	glState.blendEquation(GL_FUNC_ADD);
+	glState.blendFunc(GL_ONE, GL_ONE);
+
+	attachLightInputs(lightShader);
+	lightVolumes.render();
+
+	glState.disable(GL_BLEND);
+	glState.disable(GL_DEPTH_CLAMP);
+	glState.disable(GL_DEPTH_TEST);
+	glState.depthFunc(GL_LESS);
+	glState.depthMask(true);
+	glState.cullFace(GL_BACK);
+}
 
-		// Determine an attenuation factor, for very simple linear attenuation
-		glUniform1f(lightShader["lightStrength"], -1.0f / light.radius);
-		renderQuad();
+void Noxoscope::lightQuadRender() {
+	// Shade each light only within the screen rectangle and depth range of
+	// its sphere, found on the CPU
+	lightQuads.update(lights.visibleLights(), viewMatrix, projectionMatrix, near, far, internalWidth, internalHeight);
+	lightQuadShader.use();
+	glState.disable(GL_CULL_FACE);
+	glState.disable(GL_DEPTH_TEST);
+	glState.enable(GL_BLEND);
+	glState.blendEquation(GL_FUNC_ADD);
+	glState.blendFunc(GL_ONE, GL_ONE);
+
+	attachLightInputs(lightQuadShader);
+	lightQuads.render(depthBoundsTest && GLEW_EXT_depth_bounds_test);
+
+	glState.disable(GL_BLEND);
+}
 
-		glDisable(GL_BLEND);
-		glDisable(GL_DEPTH_TEST);
-		glDepthMask(GL_TRUE); // Don't write to depth buffer
+void Noxoscope::lightBatchRender() {
+	// Each pass shades a batch of lights, scissored to where they reach, so
+	// the light buffer is blended once per batch rather than once per light
+	lightBatches.build(lights.visibleLights(), viewMatrix, projectionMatrix, near, far, LIGHT_BATCH_SIZES[lightBatchSize]);
+	batchedLightShader.use();
+	glState.disable(GL_DEPTH_TEST);
+	glState.enable(GL_BLEND);
+	glState.blendEquation(GL_FUNC_ADD);
+	glState.blendFunc(GL_ONE, GL_ONE);
+	glState.enable(GL_SCISSOR_TEST);
+
+	attachLightInputs(batchedLightShader);
+	for (size_t batch = 0; batch < lightBatches.batchCount(); batch++) {
+		auto pixels = (lightBatches.rect(batch) * 0.5f + 0.5f) * glm::vec4(internalWidth, internalHeight, internalWidth, internalHeight);
+		auto x = static_cast<GLint>(std::floor(pixels.x));
+		auto y = static_cast<GLint>(std::floor(pixels.y));
+		glState.scissor(x, y, static_cast<GLsizei>(std::ceil(pixels.z)) - x, static_cast<GLsizei>(std::ceil(pixels.w)) - y);
+		lightBatchBuffer.update(lightBatches.uniforms(batch));
+		renderQuad();
 	}
-	glDisable(GL_STENCIL_TEST);
+
+	glState.disable(GL_SCISSOR_TEST);
+	glState.disable(GL_BLEND);
+}
+
+void Noxoscope::clusteredLightRender() {
+	// Lights are assigned to clusters on the CPU, then shaded in one pass
+	// that only loops over the lights of the cluster of each pixel
+	lightClusters.setProjection(projectionMatrix, near, far);
+	lightClusters.assign(lights.visibleLights(), viewMatrix);
+	lightClusterTextures.update(lightClusters, lights.visibleLights(), viewMatrix);
+
+	clusteredLightShader.use();
+	glState.disable(GL_DEPTH_TEST);
+	glState.disable(GL_BLEND);
+
+	attachLightInputs(clusteredLightShader);
+	const GLuint firstClusterUnit = 4;
+	lightClusterTextures.bind(firstClusterUnit);
+	glUniform1i(clusteredLightShader["lightData"], firstClusterUnit);
+	glUniform1i(clusteredLightShader["clusterRanges"], firstClusterUnit + 1);
+	glUniform1i(clusteredLightShader["clusterLights"], firstClusterUnit + 2);
+
+	renderQuad();
 }
 
 void Noxoscope::ssaoRender() {
 	// use G-buffer to render SSAO texture
-	glBindFramebuffer(GL_FRAMEBUFFER, ssaoFbo.handle);
+	glState.bindFramebuffer(ssaoFbo.handle);
 	glClear(GL_COLOR_BUFFER_BIT);
-	glViewport(0, 0, ssaoWidth, ssaoHeight);
+	glState.viewport(0, 0, ssaoWidth, ssaoHeight);
 
 	ssaoShader.use();
 
@@ -974,35 +1193,29 @@ void Noxoscope::ssaoRender() {
 			GLTexture* tex;
 			const char* texName;
 			std::tie(tex, texName) = sampleTex;
-			glActiveTexture(GL_TEXTURE0 + texCount);
-			glBindTexture(GL_TEXTURE_2D, tex->handle);
+			glState.bindTexture(texCount, tex->handle);
 			glUniform1i(ssaoShader[texName], texCount);
 			texCount++;
 		}
 	}
-	glUniform3fv(ssaoShader[UNIFORM_SAMPLES], ssaoKernel.size(), value_ptr(ssaoKernel.front()));
-	glUniformMatrix4fv(ssaoShader[UNIFORM_PROJECTION_MATRIX], 1, GL_FALSE, value_ptr(projectionMatrix));
 	renderQuad();
 
 	// Blur result
-	glBindFramebuffer(GL_FRAMEBUFFER, ssaoBlurFbo.handle);
+	glState.bindFramebuffer(ssaoBlurFbo.handle);
 
 	blurShader.use();
 
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, ssaoBuffer.handle);
+	glState.bindTexture(0, ssaoBuffer.handle);
 	glUniform1i(lightCombineShader["tex"], 0);
 
 	renderQuad();
 }
 
 void Noxoscope::ssrRender() {
-	glBindFramebuffer(GL_FRAMEBUFFER, ssrFbo.handle);
-	glViewport(0, 0, ssrWidth, ssrHeight);
+	glState.bindFramebuffer(ssrFbo.handle);
+	glState.viewport(0, 0, ssrWidth, ssrHeight);
 
 	ssrShader.use();
-	glUniformMatrix4fv(ssrShader[UNIFORM_VIEW_MATRIX], 1, GL_FALSE, value_ptr(viewMatrix));
-	glUniformMatrix4fv(ssrShader[UNIFORM_PROJECTION_MATRIX], 1, GL_FALSE, value_ptr(projectionMatrix));
 
 	auto gMembers = {
 		std::make_tuple(gBufferDepth.handle, "gPosition"),
@@ -1015,38 +1228,116 @@ void Noxoscope::ssrRender() {
 	renderQuad();
 }
 
+void Noxoscope::prepareDraws() {
+	lodStatistics = LodStatistics();
+	cullStatistics = CullStatistics();
+	queueStatistics = QueueStatistics();
+	// With LODs disabled, any error covers the whole screen
+	float pixelsPerUnit = levelOfDetail ? projectionMatrix[1][1] * internalHeight / 2.0f : std::numeric_limits<float>::infinity();
+	auto frustum = extractFrustum(projectionMatrix * viewMatrix);
+
+	// Lights outside the view, or too small or dim to show, are left out of
+	// the lighting and the debug spheres
+	lights.cull(viewMatrix, projectionMatrix, internalHeight, &lightCullStatistics);
+
+	// Whole entities are culled through the hierarchy first, then the meshes
+	// of the visible ones. The work from here on only visits visible
+	// entities, the draws of the others are left stale and never queued.
+	cullStatistics.entityCount = entityCount;
+	cullStatistics.meshCount = entityMeshCount;
+	cullStatistics.meshletCount = entityMeshletCount;
+	visibleEntities.clear();
+	entityBvh.queryFrustum(frustum, &visibleEntities);
+
+	// The occluders of the visible entities are rasterized before anything is tested against them
+	const OcclusionBuffer* occlusion = nullptr;
+	if (occlusionCulling) {
+		occlusionBuffer.begin(projectionMatrix * viewMatrix);
+		for (auto index : visibleEntities) {
+			auto& e = entities[index];
+			for (auto& mesh : e.model->meshes) {
+				if (!mesh.occluder.indices.empty()) {
+					occlusionBuffer.addOccluder(e.modelMatrix(), mesh.occluder);
+				}
+			}
+		}
+		occlusionBuffer.rasterize(&workerPool);
+		occlusion = &occlusionBuffer;
+	}
+
+	size_t kept = 0;
+	for (auto index : visibleEntities) {
+		auto& e = entities[index];
+		if (occlusion && !occlusion->boxVisible(e.boundsMin, e.boundsMax)) {
+			cullStatistics.occludedEntityCount++;
+			continue;
+		}
+		e.selectLods(cameraPosition, pixelsPerUnit, near, &lodStatistics);
+		e.cullMeshes(frustum, occlusion, cameraPosition, meshletCulling, &cullStatistics);
+		visibleEntities[kept++] = index;
+	}
+	visibleEntities.resize(kept);
+}
+
 void Noxoscope::renderObjects(const ShaderProgram& shaderProgram) {
 	using namespace glm;
-	for (auto& e : entities) {
-		e.render(shaderProgram);
+	renderQueue.clear();
+	for (auto index : visibleEntities) {
+		renderQueue.addEntity(entities[index], RENDER_PASS_OPAQUE, shaderProgram.handle, cameraPosition, far);
 	}
+	renderQueue.sort();
+	renderQueue.submit(shaderProgram, indirectDraws && indirectDrawsSupported(), &queueStatistics);
 
 	if (debugRenderLightSpheres) {
-		for (auto& light : lights) {
-			tempSphere->setSpecular(1.0f);
-			tempSphere->setDiffuseColor(light.color);
-			if (debugSpheresFullSize) {
-				glUniformMatrix4fv(shaderProgram[UNIFORM_MODEL_MATRIX], 1, GL_FALSE, value_ptr(translate(light.position) * scale(vec3(2 * light.radius))));
-				tempSphere->render(shaderProgram);
-			}
-			glUniformMatrix4fv(shaderProgram[UNIFORM_MODEL_MATRIX], 1, GL_FALSE, value_ptr(translate(light.position) * scale(vec3(0.05f * log(light.radius + 1)))));
+		renderLightSpheres(shaderProgram);
+	}
+}
 
-			tempSphere->render(shaderProgram);
+void Noxoscope::renderLightSpheres(const ShaderProgram& shaderProgram) {
+	using namespace glm;
+	// A small sphere at every visible light, then its full volume as a second set
+	lightSphereInstances.clear();
+	auto addSphere = [&](const PointLight& light, float radius) {
+		mat4 model = translate(light.position) * scale(vec3(radius));
+		lightSphereInstances.push_back({model, mat3x4(normalMatrix(model)), vec4(light.color, 1.0f)});
+	};
+	for (auto& light : lights.visibleLights()) {
+		addSphere(light, 0.05f * log(light.radius + 1));
+	}
+	if (debugSpheresFullSize) {
+		for (auto& light : lights.visibleLights()) {
+			addSphere(light, 2 * light.radius);
 		}
 	}
+	if (lightSphereInstances.empty()) {
+		return;
+	}
+
+	if (lightSphereBuffer.handle == 0) {
+		lightSphereBuffer.gen();
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, lightSphereBuffer.handle);
+	glBufferData(GL_ARRAY_BUFFER, lightSphereInstances.size() * sizeof(InstanceData), lightSphereInstances.data(), GL_STREAM_DRAW);
+
+	auto instanceCount = static_cast<GLsizei>(lightSphereInstances.size());
+	glUniform1i(shaderProgram[UNIFORM_INSTANCED], GL_TRUE);
+	for (auto& mesh : tempSphere->meshes) {
+		auto& lod = mesh.lods[0];
+		mesh.renderInstanced(shaderProgram, static_cast<GLsizei>(lod.indexCount), mesh.indexOffset(lod.firstIndex), lightSphereBuffer.handle, 0, instanceCount);
+	}
+	glUniform1i(shaderProgram[UNIFORM_INSTANCED], GL_FALSE);
 }
 
 void Noxoscope::renderQuad() const {
-	glBindVertexArray(quadVao.handle);
+	glState.bindVertexArray(quadVao.handle);
 	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-	glBindVertexArray(0);
 }
 
 void Noxoscope::renderGui() {
 	using namespace ImGui;
 
 	SetNextWindowPos(ImVec2(0, 0), ImGuiSetCond_FirstUseEver);
-	SetNextWindowSize(ImVec2(500, 255), ImGuiSetCond_FirstUseEver);
+	SetNextWindowSize(ImVec2(500, 480), ImGuiSetCond_FirstUseEver);
 	Begin("Frame Statistics", nullptr, ImGuiWindowFlags_ShowBorders);
 	PushFont(monoFont);
 	Text("%s", cachedStatisticsWindowText.c_str());
@@ -1081,6 +1372,19 @@ void Noxoscope::renderGui() {
 	Checkbox("SSR", &ssr);
 	Checkbox("SSAO", &ssao);
 	Checkbox("Fallback render", &fallbackRender);
+	Checkbox("Level of detail", &levelOfDetail);
+	Checkbox("Meshlet culling", &meshletCulling);
+	Checkbox("Occlusion culling", &occlusionCulling);
+	if (indirectDrawsSupported()) {
+		Checkbox("Indirect draws", &indirectDraws);
+	}
+	Combo("Lighting", &lightingMode, "Clustered\0Light volumes\0Light quads\0Batched\0\0");
+	if (lightingMode == LIGHTING_BATCHED) {
+		Combo("Light batch size", &lightBatchSize, "16\0" "32\0" "64\0\0");
+	}
+	if (GLEW_EXT_depth_bounds_test) {
+		Checkbox("Depth bounds test", &depthBoundsTest);
+	}
 
 	bool showGuiTemp = this->showGui;
 	if (Checkbox("Show GUI", &showGuiTemp)) {
@@ -1094,7 +1398,7 @@ void Noxoscope::renderGui() {
 
 	Checkbox("Show light spheres", &debugRenderLightSpheres);
 	Checkbox("Show full volume light spheres", &debugSpheresFullSize);
-	Checkbox("Light stencil debug render", &stencilDebugRender);
+	Checkbox("Light debug render", &stencilDebugRender);
 
 	Checkbox("Show debug bar", &showDebugBar);
 	Checkbox("Show default GUI windows", &extraImguiDebug);
@@ -1102,25 +1406,50 @@ void Noxoscope::renderGui() {
 	if (Button("Add light##top")) {
 		addLightAtPlayer();
 	}
+	SameLine();
+	if (Button("Add 1000 lights")) {
+		addRandomLights(1000);
+	}
 
 	ColorEditMode(ImGuiColorEditMode_HSV);
 
+	// Only the first lights are listed, to keep large light sets usable
+	const size_t MAX_LISTED_LIGHTS = 64;
+	auto& coverage = lightQuads.coverage();
+	auto& visibleIndices = lights.visibleIndices();
+	size_t visibleCursor = 0;
+	size_t index = 0;
 	int lightnum = 1;
-
-	auto i = begin(lights);
-	while (i != end(lights)) {
-		auto& light = *i;
-		Text("%s", fmt::format("Light {}", lightnum).c_str());
-		ColorEdit3(fmt::format("Light color##l{}", lightnum).c_str(), value_ptr(light.color));
-		SliderFloat(fmt::format("Light radius##l{}", lightnum).c_str(), &light.radius, 0, 100);
-		DragFloat3(fmt::format("Light position##l{}", lightnum).c_str(), value_ptr(light.position), 0.05f);
+	while (index < std::min(lights.size(), MAX_LISTED_LIGHTS)) {
+		auto id = lights.idAt(index);
+		auto light = lights.get(id);
+		// Pixels the light was shaded for in the last frame
+		while (visibleCursor < visibleIndices.size() && visibleIndices[visibleCursor] < index) {
+			visibleCursor++;
+		}
+		bool shaded = visibleCursor < visibleIndices.size() && visibleIndices[visibleCursor] == index;
+		if (lightingMode == LIGHTING_QUADS && shaded && visibleCursor < coverage.size()) {
+			Text("%s", fmt::format("Light {} ({} px)", lightnum, coverage[visibleCursor]).c_str());
+		} else {
+			Text("%s", fmt::format("Light {}", lightnum).c_str());
+		}
+		bool changed = ColorEdit3(fmt::format("Light color##l{}", lightnum).c_str(), value_ptr(light.color));
+		changed |= SliderFloat(fmt::format("Light radius##l{}", lightnum).c_str(), &light.radius, 0, 100);
+		changed |= DragFloat3(fmt::format("Light position##l{}", lightnum).c_str(), value_ptr(light.position), 0.05f);
+		if (changed) {
+			lights.set(id, light);
+		}
+		// Removing moves the last light to this index
 		if (Button(fmt::format("Remove light##l{}", lightnum).c_str())) {
-			i = lights.erase(i);
+			lights.remove(id);
 		} else {
-			++i;
+			index++;
 		}
 		lightnum++;
 	}
+	if (lights.size() > MAX_LISTED_LIGHTS) {
+		Text("%s", fmt::format("{} more lights", lights.size() - MAX_LISTED_LIGHTS).c_str());
+	}
 
 	if (Button("Add light##end")) {
 		addLightAtPlayer();
@@ -16,6 +16,7 @@
 #include <string>
 #include <vector>
 #include <chrono>
+#include <cstdint>
 
 #include <SDL.h>
 #include <glm/glm.hpp>
@@ -23,8 +24,33 @@
 #include "Model.h"
 #include "ShaderProgram.h"
 #include "Entity.h"
+#include "Bvh.h"
+#include "OcclusionCulling.h"
+#include "LightClusters.h"
+#include "LightVolumes.h"
+#include "LightQuads.h"
+#include "LightManager.h"
+#include "LightBatches.h"
+#include "RenderQueue.h"
 #include "Light.h"
 #include "GLObject.h"
+#include "GLUtil.h"
+#include "UniformBuffer.h"
+#include "ThreadPool.h"
+#include "TextureStreamer.h"
+#include "TextureRegistry.h"
+
+/// How the lights are shaded from the G-buffer.
+enum LightingMode {
+	/// One pass looping over the lights of the cluster of each pixel.
+	LIGHTING_CLUSTERED,
+	/// The back faces of the light spheres, in one instanced draw.
+	LIGHTING_VOLUMES,
+	/// Quads bounding the light spheres on screen and in depth.
+	LIGHTING_QUADS,
+	/// Full screen passes over batches of lights near each other.
+	LIGHTING_BATCHED
+};
 
 /// Top-level class for the program.
 ///
@@ -49,6 +75,8 @@ public:
 	static void loadAndRun(SDL_Window* mainWindow, SDL_GLContext mainContext);
 
 private:
+	static constexpr size_t NO_ENTITY = SIZE_MAX;
+
 	void onSecondPassed();
 	void reloadBuffers();
 	void loadModels();
@@ -62,22 +90,35 @@ private:
 	void onKeyPress(SDL_Keysym keysym);
 	void update(float fDiff);
 	void renderObjects(const ShaderProgram& shaderProgram);
+	void renderLightSpheres(const ShaderProgram& shaderProgram);
+	void prepareDraws();
 	void ssrRender();
 	void deferredRender();
 	void lightBufferRender();
+	void clusteredLightRender();
+	void lightVolumeRender();
+	void lightQuadRender();
+	void lightBatchRender();
+	void attachLightInputs(const ShaderProgram& shader) const;
 	void render();
 	void addLightAtPlayer();
+	void addRandomLights(size_t count);
+	void printTextureMemoryReport();
+	void printGeometryMemoryReport();
 	void renderGui();
 	void run();
 	void reloadShaders();
 	void renderQuad() const;
+	void updateFrameUniforms();
 	void forwardRender();
 	void ssaoRender();
 	void setupImgui();
-	Model& addModel(const char* path);
-	Model& addModel(const char* path, ModelProps props);
+	Model& addModel(const ModelData& data, ModelProps props);
 	Model& addModelCopy(const Model& model);
-	Entity& addEntity(Model& model, glm::mat4 modelMatrix);
+	/// Adds an entity and returns its index. Entities are stored by value,
+	/// so indices stay valid as more are added, while references do not.
+	size_t addEntity(Model& model, glm::mat4 modelMatrix);
+	void moveEntity(size_t index, glm::mat4 modelMatrix);
 	static void toggleVSync();
 	static void toggleMouseTrap();
 
@@ -88,18 +129,28 @@ private:
 	// Simulation state
 	bool quit = false;
 
+	// Worker threads for CPU-side loading work
+	ThreadPool workerPool;
+	TextureStreamer textureStreamer{workerPool};
+	TextureRegistry textureRegistry{textureStreamer};
+	GeometryArenas geometryArenas;
+
 	// Main data members
 	std::vector<Entity> entities;
 	std::vector<Model> models;
-	std::vector<PointLight> lights;
-	std::vector<MeshTexture> loadedTextures;
+	LightManager lights;
+	/// World space boxes of the entities, with proxies in entity order
+	Bvh entityBvh;
+	std::vector<BvhProxy> entityProxies;
+	RenderQueue renderQueue;
 	size_t entityCount = 0;
+	/// Meshes and meshlets of all entities, counted as they are added
+	size_t entityMeshCount = 0;
+	size_t entityMeshletCount = 0;
 	size_t modelCount = 0;
-	Entity* rotModel = nullptr;
-	PointLight* mainLight = nullptr;
+	/// Index of an entity spun around the y axis every frame, if not NO_ENTITY
+	size_t rotatingEntity = NO_ENTITY;
 	Model* tempSphere = nullptr;
-	PointLight* redLight = nullptr;
-	PointLight* blueLight = nullptr;
 	glm::vec3 cameraPosition = glm::vec3(1.03f, 0.4f, 0);
 	glm::vec3 cameraDirection = normalize(glm::vec3(0, 0.33f, 0) - cameraPosition);
 
@@ -122,8 +173,10 @@ private:
 	ShaderProgram ssrShader;
 	ShaderProgram ssaoShader;
 	ShaderProgram lightShader;
+	ShaderProgram lightQuadShader;
+	ShaderProgram batchedLightShader;
+	ShaderProgram clusteredLightShader;
 	ShaderProgram blurShader;
-	ShaderProgram simpleShader;
 	GLFramebuffer gBuffer;
 	GLFramebuffer finalFbo1;
 	GLFramebuffer finalFbo2;
@@ -151,6 +204,12 @@ private:
 	GLRenderBuffer rboDepth;
 	GLVertexArray quadVao;
 	GLBuffer quadVbo;
+	/// Instances of the debug light spheres, rebuilt every frame
+	std::vector<InstanceData> lightSphereInstances;
+	GLBuffer lightSphereBuffer;
+	UniformBuffer frameUniformBuffer;
+	UniformBuffer staticUniformBuffer;
+	UniformBuffer lightBatchBuffer;
 	std::vector<glm::vec3> ssaoKernel;
 	std::vector<glm::vec3> ssaoNoise;
 	glm::mat4 lastProjectionMatrix;
@@ -179,6 +238,14 @@ private:
 	bool ssao = false;
 	bool liveShaderReload = true;
 	bool stencilDebugRender = false;
+	bool levelOfDetail = true;
+	bool meshletCulling = true;
+	bool occlusionCulling = true;
+	bool indirectDraws = true;
+	int lightingMode = LIGHTING_CLUSTERED;
+	bool depthBoundsTest = true;
+	/// Index into LIGHT_BATCH_SIZES.
+	int lightBatchSize = 1;
 
 	// Rendering statistics
 	int numFrames = 0;
@@ -197,6 +264,21 @@ private:
 	std::chrono::high_resolution_clock::time_point lastRender;
 	std::chrono::high_resolution_clock::time_point now;
 	std::string cachedStatisticsWindowText;
+	bool textureReportPrinted = false;
+	GpuTimer gBufferTimer;
+	LodStatistics lodStatistics;
+	CullStatistics cullStatistics;
+	LightCullStatistics lightCullStatistics;
+	std::vector<uint32_t> visibleEntities;
+	OcclusionBuffer occlusionBuffer;
+	LightClusters lightClusters;
+	LightClusterTextures lightClusterTextures;
+	LightVolumes lightVolumes;
+	LightQuads lightQuads;
+	LightBatches lightBatches;
+	QueueStatistics queueStatistics;
+	size_t stateIssuedCount = 0;
+	size_t stateSkippedCount = 0;
 };
 
 void GLAPIENTRY onDebugEvent(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length, const GLchar* message, const void* userParam);
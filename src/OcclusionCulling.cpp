@@ -0,0 +1,310 @@
+//===----------------------------------------------------------------------===//
+//
+// This file is part of the Noxoscope project
+//
+// Copyright (c) 2016 Niklas Helmertz
+//
+//===----------------------------------------------------------------------===//
+
+#include "OcclusionCulling.h"
+
+#include <cmath>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <limits>
+#include <utility>
+#include <algorithm>
+#include <condition_variable>
+#include <cassert>
+
+#include "ThreadPool.h"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define NS_OCCLUSION_SSE
+#include <xmmintrin.h>
+#endif
+
+static_assert(OCCLUSION_BAND_HEIGHT % OCCLUSION_BLOCK_SIZE == 0, "Bands must consist of whole blocks");
+static_assert(OCCLUSION_BLOCK_SIZE % 4 == 0, "Rows are rasterized four pixels at a time");
+
+OcclusionBuffer::OcclusionBuffer(int width, int height)
+	: width(width),
+	  height(height),
+	  bandCount((height + OCCLUSION_BAND_HEIGHT - 1) / OCCLUSION_BAND_HEIGHT),
+	  viewProjection(1.0f),
+	  depths(width * height, 1.0f),
+	  blockDepths((width / OCCLUSION_BLOCK_SIZE) * (height / OCCLUSION_BLOCK_SIZE), 1.0f),
+	  bandTriangles(bandCount) {
+	assert(width % OCCLUSION_BLOCK_SIZE == 0 && height % OCCLUSION_BLOCK_SIZE == 0);
+}
+
+void OcclusionBuffer::begin(const glm::mat4& viewProjection) {
+	this->viewProjection = viewProjection;
+	std::fill(depths.begin(), depths.end(), 1.0f);
+	std::fill(blockDepths.begin(), blockDepths.end(), 1.0f);
+	triangles.clear();
+	for (auto& band : bandTriangles) {
+		band.clear();
+	}
+}
+
+void OcclusionBuffer::addOccluder(const glm::mat4& modelMatrix, const OccluderMesh& occluder) {
+	using namespace glm;
+	mat4 modelViewProjection = viewProjection * modelMatrix;
+	std::vector<vec4> clip;
+	clip.reserve(occluder.vertices.size());
+	for (auto& v : occluder.vertices) {
+		clip.push_back(modelViewProjection * vec4(v, 1.0f));
+	}
+
+	for (size_t i = 0; i + 2 < occluder.indices.size(); i += 3) {
+		vec4 corners[3] = {clip[occluder.indices[i]], clip[occluder.indices[i + 1]], clip[occluder.indices[i + 2]]};
+		// Signed distances to the near plane, z = -w
+		float distances[3];
+		int inFront = 0;
+		for (int k = 0; k < 3; k++) {
+			distances[k] = corners[k].z + corners[k].w;
+			inFront += distances[k] >= 0.0f;
+		}
+		if (inFront == 3) {
+			addTriangle(corners[0], corners[1], corners[2]);
+			continue;
+		}
+		if (inFront == 0) {
+			continue;
+		}
+
+		// Clip against the near plane, leaving a triangle or a quad
+		vec4 polygon[4];
+		int count = 0;
+		for (int k = 0; k < 3; k++) {
+			int next = (k + 1) % 3;
+			if (distances[k] >= 0.0f) {
+				polygon[count++] = corners[k];
+			}
+			if ((distances[k] >= 0.0f) != (distances[next] >= 0.0f)) {
+				float t = distances[k] / (distances[k] - distances[next]);
+				polygon[count++] = mix(corners[k], corners[next], t);
+			}
+		}
+		for (int k = 2; k < count; k++) {
+			addTriangle(polygon[0], polygon[k - 1], polygon[k]);
+		}
+	}
+}
+
+void OcclusionBuffer::addTriangle(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c) {
+	ScreenVertex screen[3];
+	const glm::vec4* corners[] = {&a, &b, &c};
+	for (int k = 0; k < 3; k++) {
+		auto& p = *corners[k];
+		screen[k].x = (p.x / p.w * 0.5f + 0.5f) * width;
+		screen[k].y = (p.y / p.w * 0.5f + 0.5f) * height;
+		screen[k].z = p.z / p.w;
+	}
+
+	float minX = std::min({screen[0].x, screen[1].x, screen[2].x});
+	float maxX = std::max({screen[0].x, screen[1].x, screen[2].x});
+	float minY = std::min({screen[0].y, screen[1].y, screen[2].y});
+	float maxY = std::max({screen[0].y, screen[1].y, screen[2].y});
+	// Also rejects triangles that are entirely beyond the far plane
+	float minZ = std::min({screen[0].z, screen[1].z, screen[2].z});
+	if (maxX < 0.0f || minX > width || maxY < 0.0f || minY > height || !(minZ < 1.0f)) {
+		return;
+	}
+
+	auto index = static_cast<uint32_t>(triangles.size() / 3);
+	triangles.insert(triangles.end(), screen, screen + 3);
+	int firstBand = static_cast<int>(std::max(minY, 0.0f)) / OCCLUSION_BAND_HEIGHT;
+	int lastBand = static_cast<int>(std::min(maxY, height - 1.0f)) / OCCLUSION_BAND_HEIGHT;
+	for (int band = firstBand; band <= lastBand; band++) {
+		bandTriangles[band].push_back(index);
+	}
+}
+
+void OcclusionBuffer::rasterize(ThreadPool* pool) {
+	if (triangles.empty()) {
+		return;
+	}
+
+	// Bands are claimed by whichever thread gets to them first, so workers
+	// that are busy with other tasks only start on the bands that are left.
+	// The count is copied, since workers starting after the last band never
+	// touch the buffer.
+	struct Job {
+		int bandCount;
+		std::atomic<int> nextBand{0};
+		std::atomic<int> doneCount{0};
+		std::mutex mutex;
+		std::condition_variable done;
+	};
+	auto job = std::make_shared<Job>();
+	job->bandCount = bandCount;
+	auto work = [this, job] {
+		int band;
+		while ((band = job->nextBand++) < job->bandCount) {
+			rasterizeBand(band);
+			if (++job->doneCount == job->bandCount) {
+				std::lock_guard<std::mutex> lock(job->mutex);
+				job->done.notify_all();
+			}
+		}
+	};
+
+	if (pool) {
+		unsigned helpers = std::min(pool->threadCount(), static_cast<unsigned>(bandCount - 1));
+		for (unsigned i = 0; i < helpers; i++) {
+			pool->enqueue(work);
+		}
+	}
+	work();
+	std::unique_lock<std::mutex> lock(job->mutex);
+	job->done.wait(lock, [&] { return job->doneCount == job->bandCount; });
+}
+
+void OcclusionBuffer::rasterizeBand(int band) {
+	int bandStart = band * OCCLUSION_BAND_HEIGHT;
+	int bandEnd = std::min(bandStart + OCCLUSION_BAND_HEIGHT, height);
+
+	for (auto index : bandTriangles[band]) {
+		ScreenVertex v0 = triangles[index * 3];
+		ScreenVertex v1 = triangles[index * 3 + 1];
+		ScreenVertex v2 = triangles[index * 3 + 2];
+		float area = (v1.x - v0.x) * (v2.y - v0.y) - (v2.x - v0.x) * (v1.y - v0.y);
+		if (area < 0.0f) {
+			// Occluders are double sided, so make every triangle counter-clockwise
+			std::swap(v1, v2);
+			area = -area;
+		}
+		if (!(area > 0.0f)) {
+			continue;
+		}
+
+		// Edge functions a * x + b * y + c, positive inside the triangle
+		const ScreenVertex* edges[3][2] = {{&v0, &v1}, {&v1, &v2}, {&v2, &v0}};
+		float a[3];
+		float b[3];
+		float c[3];
+		for (int e = 0; e < 3; e++) {
+			auto& from = *edges[e][0];
+			auto& to = *edges[e][1];
+			a[e] = from.y - to.y;
+			b[e] = to.x - from.x;
+			c[e] = (to.y - from.y) * from.x - (to.x - from.x) * from.y;
+		}
+		float dzdx = ((v1.z - v0.z) * (v2.y - v0.y) - (v2.z - v0.z) * (v1.y - v0.y)) / area;
+		float dzdy = ((v2.z - v0.z) * (v1.x - v0.x) - (v1.z - v0.z) * (v2.x - v0.x)) / area;
+
+		// Pixels with centers inside the bounding box, in whole groups of four
+		float minX = std::min({v0.x, v1.x, v2.x});
+		float maxX = std::max({v0.x, v1.x, v2.x});
+		float minY = std::min({v0.y, v1.y, v2.y});
+		float maxY = std::max({v0.y, v1.y, v2.y});
+		// Clamped before converting, since clipped vertices may be far off screen
+		int xStart = static_cast<int>(std::max(std::ceil(minX - 0.5f), 0.0f)) & ~3;
+		int xEnd = static_cast<int>(std::min(std::floor(maxX - 0.5f), width - 1.0f));
+		int yStart = static_cast<int>(std::max(std::ceil(minY - 0.5f), static_cast<float>(bandStart)));
+		int yEnd = static_cast<int>(std::min(std::floor(maxY - 0.5f), bandEnd - 1.0f));
+
+		for (int y = yStart; y <= yEnd; y++) {
+			float py = y + 0.5f;
+			float rowEdges[3];
+			for (int e = 0; e < 3; e++) {
+				rowEdges[e] = b[e] * py + c[e];
+			}
+			float rowDepth = v0.z + dzdy * (py - v0.y) - dzdx * v0.x;
+			float* row = &depths[y * width];
+#ifdef NS_OCCLUSION_SSE
+			__m128 offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+			__m128 zero = _mm_setzero_ps();
+			__m128 a0 = _mm_set1_ps(a[0]), a1 = _mm_set1_ps(a[1]), a2 = _mm_set1_ps(a[2]);
+			__m128 e0 = _mm_set1_ps(rowEdges[0]), e1 = _mm_set1_ps(rowEdges[1]), e2 = _mm_set1_ps(rowEdges[2]);
+			__m128 depthX = _mm_set1_ps(dzdx);
+			__m128 depthRow = _mm_set1_ps(rowDepth);
+			for (int x = xStart; x <= xEnd; x += 4) {
+				__m128 px = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), offsets);
+				__m128 inside = _mm_and_ps(_mm_and_ps(
+					_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a0, px), e0), zero),
+					_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a1, px), e1), zero)),
+					_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a2, px), e2), zero));
+				__m128 z = _mm_add_ps(_mm_mul_ps(depthX, px), depthRow);
+				__m128 old = _mm_loadu_ps(row + x);
+				__m128 nearest = _mm_min_ps(old, z);
+				_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, old)));
+			}
+#else
+			for (int x = xStart; x <= xEnd; x++) {
+				float px = x + 0.5f;
+				if (a[0] * px + rowEdges[0] >= 0.0f && a[1] * px + rowEdges[1] >= 0.0f && a[2] * px + rowEdges[2] >= 0.0f) {
+					row[x] = std::min(row[x], dzdx * px + rowDepth);
+				}
+			}
+#endif
+		}
+	}
+
+	// Farthest depth of the blocks in the band
+	int blocksPerRow = width / OCCLUSION_BLOCK_SIZE;
+	for (int by = bandStart / OCCLUSION_BLOCK_SIZE; by < bandEnd / OCCLUSION_BLOCK_SIZE; by++) {
+		for (int bx = 0; bx < blocksPerRow; bx++) {
+			float farthest = -std::numeric_limits<float>::infinity();
+			for (int y = by * OCCLUSION_BLOCK_SIZE; y < (by + 1) * OCCLUSION_BLOCK_SIZE; y++) {
+				const float* row = &depths[y * width + bx * OCCLUSION_BLOCK_SIZE];
+				farthest = std::max(farthest, *std::max_element(row, row + OCCLUSION_BLOCK_SIZE));
+			}
+			blockDepths[by * blocksPerRow + bx] = farthest;
+		}
+	}
+}
+
+bool OcclusionBuffer::boxVisible(glm::vec3 boxMin, glm::vec3 boxMax) const {
+	using namespace glm;
+	float minX = std::numeric_limits<float>::infinity();
+	float maxX = -std::numeric_limits<float>::infinity();
+	float minY = std::numeric_limits<float>::infinity();
+	float maxY = -std::numeric_limits<float>::infinity();
+	float nearest = std::numeric_limits<float>::infinity();
+	for (int corner = 0; corner < 8; corner++) {
+		vec3 p((corner & 1) ? boxMax.x : boxMin.x, (corner & 2) ? boxMax.y : boxMin.y, (corner & 4) ? boxMax.z : boxMin.z);
+		vec4 clip = viewProjection * vec4(p, 1.0f);
+		if (clip.w <= 0.0f || clip.z < -clip.w) {
+			return true;
+		}
+		float x = (clip.x / clip.w * 0.5f + 0.5f) * width;
+		float y = (clip.y / clip.w * 0.5f + 0.5f) * height;
+		minX = std::min(minX, x);
+		maxX = std::max(maxX, x);
+		minY = std::min(minY, y);
+		maxY = std::max(maxY, y);
+		nearest = std::min(nearest, clip.z / clip.w);
+	}
+
+	// Every pixel the box touches, even without covering its center
+	int x0 = static_cast<int>(std::max(std::floor(minX), 0.0f));
+	int x1 = static_cast<int>(std::min(std::floor(maxX), width - 1.0f));
+	int y0 = static_cast<int>(std::max(std::floor(minY), 0.0f));
+	int y1 = static_cast<int>(std::min(std::floor(maxY), height - 1.0f));
+	if (x0 > x1 || y0 > y1) {
+		return false;
+	}
+
+	int blocksPerRow = width / OCCLUSION_BLOCK_SIZE;
+	for (int by = y0 / OCCLUSION_BLOCK_SIZE; by <= y1 / OCCLUSION_BLOCK_SIZE; by++) {
+		for (int bx = x0 / OCCLUSION_BLOCK_SIZE; bx <= x1 / OCCLUSION_BLOCK_SIZE; bx++) {
+			if (blockDepths[by * blocksPerRow + bx] < nearest) {
+				continue;
+			}
+			int yEnd = std::min((by + 1) * OCCLUSION_BLOCK_SIZE - 1, y1);
+			int xEnd = std::min((bx + 1) * OCCLUSION_BLOCK_SIZE - 1, x1);
+			for (int y = std::max(by * OCCLUSION_BLOCK_SIZE, y0); y <= yEnd; y++) {
+				for (int x = std::max(bx * OCCLUSION_BLOCK_SIZE, x0); x <= xEnd; x++) {
+					if (depths[y * width + x] >= nearest) {
+						return true;
+					}
+				}
+			}
+		}
+	}
+	return false;
+}
@@ -0,0 +1,133 @@
+//===----------------------------------------------------------------------===//
+//
+// This file is part of the Noxoscope project
+//
+// Copyright (c) 2016 Niklas Helmertz
+//
+//===----------------------------------------------------------------------===//
+//
+// Occlusion culling against a small depth buffer rasterized on the CPU.
+//
+// A few large occluder meshes are transformed, clipped against the near
+// plane and rasterized into a low resolution buffer holding the nearest
+// normalized device depth of every pixel. The buffer is split into bands of
+// rows, which are rasterized in parallel with four pixels tested at a time
+// using SSE. Bounding boxes are then tested against the farthest depth of
+// every block of pixels they cover, and only against the pixels themselves
+// where that is not enough.
+//
+// Pixels are covered if their centers are inside an occluder triangle, so
+// occluders should not extend past the geometry they stand for.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef OcclusionCulling_H
+#define OcclusionCulling_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include <glm/glm.hpp>
+
+class ThreadPool;
+
+/// Default size of the depth buffer, as a multiple of the block size.
+constexpr int OCCLUSION_WIDTH = 256;
+constexpr int OCCLUSION_HEIGHT = 144;
+
+/// Side of the square blocks with a conservative farthest depth.
+constexpr int OCCLUSION_BLOCK_SIZE = 8;
+
+/// Rows in each band rasterized as one task.
+constexpr int OCCLUSION_BAND_HEIGHT = 16;
+
+/// Meshes with a bounding box diagonal below this fraction of that of their
+/// model are not used as occluders.
+constexpr float OCCLUDER_MIN_RELATIVE_SIZE = 0.1f;
+
+/// Triangles of an occluder in model space.
+struct OccluderMesh {
+	std::vector<glm::vec3> vertices;
+	std::vector<uint32_t> indices;
+};
+
+/// Builds an occluder from a triangle list, keeping only the referenced
+/// vertex positions.
+template <typename V>
+OccluderMesh buildOccluder(const V* vertices, const uint32_t* indices, size_t indexCount);
+
+class OcclusionBuffer {
+public:
+	/// Creates a buffer of width by height pixels, which must be multiples of
+	/// OCCLUSION_BLOCK_SIZE.
+	OcclusionBuffer(int width = OCCLUSION_WIDTH, int height = OCCLUSION_HEIGHT);
+
+	/// Clears the buffer to the far plane and removes all occluders, for a
+	/// new frame seen through viewProjection.
+	void begin(const glm::mat4& viewProjection);
+
+	/// Queues the triangles of an occluder placed with modelMatrix.
+	void addOccluder(const glm::mat4& modelMatrix, const OccluderMesh& occluder);
+
+	/// Rasterizes the queued triangles. The calling thread rasterizes bands
+	/// along with any workers of the pool that are free, and the pool may be
+	/// null to rasterize on the calling thread only.
+	void rasterize(ThreadPool* pool);
+
+	/// Returns false if the box is entirely hidden behind the occluders.
+	/// Boxes crossing the near plane are always visible.
+	bool boxVisible(glm::vec3 boxMin, glm::vec3 boxMax) const;
+
+	/// Nearest occluder depth at a pixel, with rows starting at the bottom.
+	float depth(int x, int y) const {
+		return depths[y * width + x];
+	}
+
+	size_t triangleCount() const {
+		return triangles.size() / 3;
+	}
+
+private:
+	struct ScreenVertex {
+		float x;
+		float y;
+		float z;
+	};
+
+	int width;
+	int height;
+	int bandCount;
+	glm::mat4 viewProjection;
+	std::vector<float> depths;
+	/// Farthest depth in each block.
+	std::vector<float> blockDepths;
+	/// Triangles in pixel coordinates, three vertices each.
+	std::vector<ScreenVertex> triangles;
+	/// Triangles overlapping each band.
+	std::vector<std::vector<uint32_t>> bandTriangles;
+
+	void addTriangle(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c);
+	void rasterizeBand(int band);
+};
+
+template <typename V>
+OccluderMesh buildOccluder(const V* vertices, const uint32_t* indices, size_t indexCount) {
+	OccluderMesh occluder;
+	std::vector<uint32_t> remap;
+	occluder.indices.reserve(indexCount);
+	for (size_t i = 0; i < indexCount; i++) {
+		uint32_t index = indices[i];
+		if (index >= remap.size()) {
+			remap.resize(index + 1, ~0u);
+		}
+		if (remap[index] == ~0u) {
+			remap[index] = static_cast<uint32_t>(occluder.vertices.size());
+			occluder.vertices.push_back(vertices[index].position);
+		}
+		occluder.indices.push_back(remap[index]);
+	}
+	return occluder;
+}
+
+#endif // OcclusionCulling_H
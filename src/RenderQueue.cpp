@@ -0,0 +1,322 @@
+//===----------------------------------------------------------------------===//
+//
+// This file is part of the Noxoscope project
+//
+// Copyright (c) 2016 Niklas Helmertz
+//
+//===----------------------------------------------------------------------===//
+
+#include "RenderQueue.h"
+
+#include <cmath>
+#include <algorithm>
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include "Hash.h"
+#include "Constants.h"
+#include "GeometryMath.h"
+#include "GLUtil.h"
+#include "GLState.h"
+
+bool indirectDrawsSupported() {
+	return GLEW_ARB_draw_indirect && GLEW_ARB_multi_draw_indirect && GLEW_ARB_base_instance;
+}
+
+static uint64_t field(uint32_t value, int bits) {
+	return value & ((uint64_t(1) << bits) - 1);
+}
+
+uint64_t makeSortKey(uint32_t pass, uint32_t program, uint32_t textureSet, uint32_t material, uint32_t depth) {
+	uint64_t key = field(pass, SORT_KEY_PASS_BITS);
+	key = (key << SORT_KEY_PROGRAM_BITS) | field(program, SORT_KEY_PROGRAM_BITS);
+	key = (key << SORT_KEY_TEXTURE_SET_BITS) | field(textureSet, SORT_KEY_TEXTURE_SET_BITS);
+	key = (key << SORT_KEY_MATERIAL_BITS) | field(material, SORT_KEY_MATERIAL_BITS);
+	key = (key << SORT_KEY_DEPTH_BITS) | field(depth, SORT_KEY_DEPTH_BITS);
+	return key;
+}
+
+uint32_t sortKeyDepth(float distance, float far) {
+	const uint32_t maxDepth = (1u << SORT_KEY_DEPTH_BITS) - 1;
+	float normalized = std::log2(1.0f + std::max(distance, 0.0f)) / std::log2(1.0f + far);
+	return static_cast<uint32_t>(std::min(normalized, 1.0f) * maxDepth);
+}
+
+void radixSort(DrawItem* items, DrawItem* scratch, size_t count) {
+	// Bytes that vary between keys, as their bits set in either
+	uint64_t anyOnes = 0;
+	uint64_t anyZeros = 0;
+	for (size_t i = 0; i < count; i++) {
+		anyOnes |= items[i].key;
+		anyZeros |= ~items[i].key;
+	}
+	uint64_t varying = anyOnes & anyZeros;
+
+	DrawItem* source = items;
+	DrawItem* destination = scratch;
+	for (int shift = 0; shift < 64; shift += 8) {
+		if (((varying >> shift) & 0xff) == 0) {
+			continue;
+		}
+		size_t offsets[256] = {};
+		for (size_t i = 0; i < count; i++) {
+			offsets[(source[i].key >> shift) & 0xff]++;
+		}
+		size_t sum = 0;
+		for (auto& offset : offsets) {
+			auto bucketCount = offset;
+			offset = sum;
+			sum += bucketCount;
+		}
+		for (size_t i = 0; i < count; i++) {
+			destination[offsets[(source[i].key >> shift) & 0xff]++] = source[i];
+		}
+		std::swap(source, destination);
+	}
+	if (source != items) {
+		std::copy(source, source + count, items);
+	}
+}
+
+// Packs the arrays of the diffuse, specular and normal textures of a mesh.
+// Textures in the same arrays share a texture set, as only their layers
+// differ. Texture names are small integers, so 21 bits each is plenty.
+static uint64_t textureArrays(const Mesh& mesh) {
+	auto handle = [](const MeshTexture& texture) -> uint64_t {
+		return texture.glObject != nullptr ? texture.glObject->array->handle() : 0;
+	};
+	return handle(mesh.diffuseTexture) | handle(mesh.specularTexture) << 21 | handle(mesh.normalTexture) << 42;
+}
+
+uint32_t RenderQueue::textureSetId(const Mesh& mesh) {
+	return textureSets.emplace(textureArrays(mesh), static_cast<uint32_t>(textureSets.size())).first->second;
+}
+
+uint32_t RenderQueue::materialId(const Mesh& mesh, float texRepeatFactor) {
+	float values[] = {mesh.color.r, mesh.color.g, mesh.color.b, mesh.color.a, mesh.specular, mesh.reflectiveness, texRepeatFactor};
+	uint64_t hash = hashFnv1a(values, sizeof(values));
+	return materials.emplace(hash, static_cast<uint32_t>(materials.size())).first->second;
+}
+
+void RenderQueue::addEntity(const Entity& entity, uint32_t pass, GLuint program, glm::vec3 cameraPosition, float far) {
+	using namespace glm;
+	auto& draws = entity.draws;
+	float texRepeatFactor = entity.model->texRepeatFactor();
+	for (size_t i = 0; i < entity.model->meshes.size(); i++) {
+		if (!draws.meshStarts.empty() && draws.meshStarts[i] == draws.meshStarts[i + 1]) {
+			continue;
+		}
+		auto& mesh = entity.model->meshes[i];
+		auto& sphere = entity.meshSpheres[i];
+		float distance = length(vec3(sphere) - cameraPosition) - sphere.w;
+
+		DrawItem item;
+		item.key = makeSortKey(pass, program, textureSetId(mesh), materialId(mesh, texRepeatFactor), sortKeyDepth(distance, far));
+		item.entity = &entity;
+		item.mesh = static_cast<uint32_t>(i);
+		items.push_back(item);
+	}
+}
+
+void RenderQueue::sort() {
+	scratch.resize(items.size());
+	radixSort(items.data(), scratch.data(), items.size());
+}
+
+void RenderQueue::buildBatches() {
+	batches.clear();
+	std::vector<size_t> itemBatches(items.size());
+	size_t groupStart = 0;
+	size_t groupBatches = 0;
+	for (size_t i = 0; i < items.size(); i++) {
+		auto& item = items[i];
+		if ((item.key >> SORT_KEY_DEPTH_BITS) != (items[groupStart].key >> SORT_KEY_DEPTH_BITS)) {
+			groupStart = i;
+			groupBatches = batches.size();
+		}
+
+		auto entity = item.entity;
+		auto& mesh = entity->model->meshes[item.mesh];
+		auto& draws = entity->draws;
+		Batch batch = {entity, item.mesh, 0, nullptr, 0, 1};
+		if (draws.meshStarts.empty()) {
+			auto& lod = mesh.lods[std::min<size_t>(entity->meshLods[item.mesh], mesh.lods.size() - 1)];
+			batch.count = static_cast<GLsizei>(lod.indexCount);
+			batch.offset = mesh.indexOffset(lod.firstIndex);
+		} else if (draws.meshStarts[item.mesh + 1] - draws.meshStarts[item.mesh] == 1) {
+			batch.count = draws.counts[draws.meshStarts[item.mesh]];
+			batch.offset = draws.offsets[draws.meshStarts[item.mesh]];
+		} else {
+			batch.instanceCount = 0;
+		}
+
+		// Join an earlier batch of the same group drawing the same range
+		auto existing = batches.end();
+		if (batch.instanceCount != 0) {
+			existing = std::find_if(batches.begin() + groupBatches, batches.end(), [&](const Batch& b) {
+				return b.instanceCount != 0 && &b.entity->model->meshes[b.mesh] == &mesh &&
+					b.count == batch.count && b.offset == batch.offset;
+			});
+		}
+		if (existing != batches.end()) {
+			existing->instanceCount++;
+			itemBatches[i] = existing - batches.begin();
+		} else {
+			itemBatches[i] = batches.size();
+			batches.push_back(batch);
+		}
+	}
+
+	// Lay out the instances of each batch contiguously
+	size_t instanceCount = 0;
+	for (auto& batch : batches) {
+		batch.firstInstance = instanceCount;
+		instanceCount += std::max<GLsizei>(batch.instanceCount, 1);
+	}
+	instances.resize(instanceCount);
+	std::vector<size_t> filled(batches.size(), 0);
+	for (size_t i = 0; i < items.size(); i++) {
+		auto b = itemBatches[i];
+		auto& instance = instances[batches[b].firstInstance + filled[b]++];
+		instance.modelMatrix = items[i].entity->modelMatrix();
+		instance.normalMatrix = glm::mat3x4(normalMatrix(items[i].entity->modelMatrix()));
+		instance.color = glm::vec4(1.0f);
+	}
+}
+
+void RenderQueue::submit(const ShaderProgram& shader, bool indirect, QueueStatistics* stats) {
+	buildBatches();
+	if (batches.empty()) {
+		return;
+	}
+
+	// Set even when unused, as samplers of different types may not share a unit
+	glUniform1i(shader[UNIFORM_INSTANCE_RECORDS], INSTANCE_RECORD_UNIT);
+	glUniform1i(shader[UNIFORM_MATERIAL_RECORDS], MATERIAL_RECORD_UNIT);
+	uploadBufferTexture(&instanceData, GL_RGBA32F, instances.data(), instances.size() * sizeof(InstanceData));
+	if (indirect) {
+		submitIndirect(shader, stats);
+	} else {
+		submitBatches(shader, stats);
+	}
+}
+
+void RenderQueue::submitBatches(const ShaderProgram& shader, QueueStatistics* stats) {
+	const Model* lastModel = nullptr;
+	bool instanced = false;
+	glUniform1i(shader[UNIFORM_INSTANCED], GL_FALSE);
+	for (auto& batch : batches) {
+		auto entity = batch.entity;
+		if (entity->model != lastModel) {
+			glUniform1f(shader[UNIFORM_TEX_REPEAT_FACTOR], entity->model->texRepeatFactor());
+			lastModel = entity->model;
+		}
+		if ((batch.instanceCount != 0) != instanced) {
+			instanced = !instanced;
+			glUniform1i(shader[UNIFORM_INSTANCED], instanced ? GL_TRUE : GL_FALSE);
+		}
+
+		auto& mesh = entity->model->meshes[batch.mesh];
+		if (batch.instanceCount != 0) {
+			mesh.renderInstanced(shader, batch.count, batch.offset, instanceData.buffer.handle, batch.firstInstance, batch.instanceCount);
+			stats->instancedDrawCount++;
+			stats->instanceCount += batch.instanceCount;
+		} else {
+			auto& draws = entity->draws;
+			auto start = draws.meshStarts[batch.mesh];
+			auto count = static_cast<GLsizei>(draws.meshStarts[batch.mesh + 1] - start);
+			setModelMatrix(shader, entity->modelMatrix());
+			mesh.render(shader, draws.counts.data() + start, draws.offsets.data() + start, count);
+		}
+		stats->drawCount++;
+	}
+
+	// Later draws with the same program set their own matrices
+	if (instanced) {
+		glUniform1i(shader[UNIFORM_INSTANCED], GL_FALSE);
+	}
+}
+
+void RenderQueue::submitIndirect(const ShaderProgram& shader, QueueStatistics* stats) {
+	runs.clear();
+	commands.clear();
+	materialRecords.clear();
+	drawIndices.resize(instances.size());
+	for (size_t b = 0; b < batches.size(); b++) {
+		auto& batch = batches[b];
+		auto& mesh = batch.entity->model->meshes[batch.mesh];
+		materialRecords.push_back(mesh.materialRecord(batch.entity->model->texRepeatFactor()));
+		for (size_t i = 0; i < static_cast<size_t>(std::max<GLsizei>(batch.instanceCount, 1)); i++) {
+			auto instance = batch.firstInstance + i;
+			drawIndices[instance] = glm::uvec2(instance, b);
+		}
+
+		// A run takes every batch drawn with the same vertex array, index type
+		// and textures, as the rest of the material comes from the records
+		bool joinsRun = false;
+		if (!runs.empty()) {
+			auto& first = batches[runs.back().firstBatch];
+			auto& runMesh = first.entity->model->meshes[first.mesh];
+			joinsRun = &runMesh.geometryArena() == &mesh.geometryArena() && runMesh.indexType == mesh.indexType &&
+				textureArrays(runMesh) == textureArrays(mesh);
+		}
+		if (!joinsRun) {
+			runs.push_back({b, commands.size()});
+		}
+
+		auto baseInstance = static_cast<GLuint>(batch.firstInstance);
+		if (batch.instanceCount != 0) {
+			commands.push_back(mesh.indirectCommand(batch.count, batch.offset, baseInstance, batch.instanceCount));
+		} else {
+			auto& draws = batch.entity->draws;
+			for (auto r = draws.meshStarts[batch.mesh]; r < draws.meshStarts[batch.mesh + 1]; r++) {
+				commands.push_back(mesh.indirectCommand(draws.counts[r], draws.offsets[r], baseInstance, 1));
+			}
+		}
+	}
+
+	uploadBufferTexture(&materialData, GL_RGBA32F, materialRecords.data(), materialRecords.size() * sizeof(MaterialRecord));
+	if (commandBuffer.handle == 0) {
+		drawIndexBuffer.gen();
+		commandBuffer.gen();
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, drawIndexBuffer.handle);
+	glBufferData(GL_ARRAY_BUFFER, drawIndices.size() * sizeof(glm::uvec2), drawIndices.data(), GL_STREAM_DRAW);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer.handle);
+	glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data(), GL_STREAM_DRAW);
+
+	glState.bindTexture(INSTANCE_RECORD_UNIT, instanceData.texture.handle, GL_TEXTURE_BUFFER);
+	glState.bindTexture(MATERIAL_RECORD_UNIT, materialData.texture.handle, GL_TEXTURE_BUFFER);
+	glUniform1i(shader[UNIFORM_INSTANCED], GL_FALSE);
+	glUniform1i(shader[UNIFORM_INDIRECT], GL_TRUE);
+
+	GeometryArena* arena = nullptr;
+	for (size_t r = 0; r < runs.size(); r++) {
+		auto& batch = batches[runs[r].firstBatch];
+		auto& mesh = batch.entity->model->meshes[batch.mesh];
+		if (&mesh.geometryArena() != arena) {
+			if (arena != nullptr) {
+				arena->unbindDrawIndices();
+			}
+			// The shaders still fetch the instance attributes, so they must
+			// stay within the instances of this frame
+			arena = &mesh.geometryArena();
+			arena->bindInstances(instanceData.buffer.handle, 0);
+			arena->bindDrawIndices(drawIndexBuffer.handle);
+		}
+		mesh.bindMaterial(shader);
+
+		auto firstCommand = runs[r].firstCommand;
+		auto endCommand = r + 1 < runs.size() ? runs[r + 1].firstCommand : commands.size();
+		glMultiDrawElementsIndirect(GL_TRIANGLES, mesh.indexType, reinterpret_cast<const GLvoid*>(firstCommand * sizeof(DrawElementsIndirectCommand)),
+			static_cast<GLsizei>(endCommand - firstCommand), 0);
+		stats->drawCount++;
+	}
+	arena->unbindDrawIndices();
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	stats->instanceCount += instances.size();
+	stats->indirectCommandCount += commands.size();
+
+	// Later draws with the same program set their own matrices and materials
+	glUniform1i(shader[UNIFORM_INDIRECT], GL_FALSE);
+}
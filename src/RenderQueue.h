@@ -0,0 +1,163 @@
+//===----------------------------------------------------------------------===//
+//
+// This file is part of the Noxoscope project
+//
+// Copyright (c) 2016 Niklas Helmertz
+//
+//===----------------------------------------------------------------------===//
+//
+// Queue of mesh draws, sorted to reduce state changes. Every visible mesh of
+// every entity becomes a draw item with a 64-bit key, made up of the
+// following fields from the most significant bit down:
+//
+//   pass         2 bits
+//   program      6 bits
+//   texture set 20 bits
+//   material    20 bits
+//   depth       16 bits
+//
+// Sorting by the key groups draws sharing a program, then the same textures,
+// then the same material uniforms, and orders each group front to back so
+// that the depth test rejects more hidden fragments. Fields that do not fit
+// are truncated, which only affects grouping, not correctness.
+//
+// Within each group, draws of the same index range of the same mesh, such as
+// many entities sharing a model, are merged into one instanced draw, in the
+// order of their nearest instance.
+//
+// Where indirect draws are supported, consecutive draws sharing a vertex
+// array and textures are issued as one glMultiDrawElementsIndirect instead.
+// The vertex shaders then fetch the transforms of every instance and the
+// material of every draw from buffer textures. GLSL 3.30 has no
+// gl_BaseInstance, so every instance carries the indices of its records in
+// an attribute at DRAW_INDEX_ATTRIBUTE_LOCATION.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef RenderQueue_H
+#define RenderQueue_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <unordered_map>
+
+#include <glm/glm.hpp>
+
+#include "Entity.h"
+#include "ShaderProgram.h"
+#include "GLObject.h"
+#include "GLUtil.h"
+
+/// Pass of all opaque geometry, drawn first.
+constexpr uint32_t RENDER_PASS_OPAQUE = 0;
+
+constexpr int SORT_KEY_PASS_BITS = 2;
+constexpr int SORT_KEY_PROGRAM_BITS = 6;
+constexpr int SORT_KEY_TEXTURE_SET_BITS = 20;
+constexpr int SORT_KEY_MATERIAL_BITS = 20;
+constexpr int SORT_KEY_DEPTH_BITS = 16;
+
+static_assert(SORT_KEY_PASS_BITS + SORT_KEY_PROGRAM_BITS + SORT_KEY_TEXTURE_SET_BITS +
+	SORT_KEY_MATERIAL_BITS + SORT_KEY_DEPTH_BITS == 64, "Sort key fields must fill 64 bits");
+
+/// Texture units of the instance and material records of indirect draws,
+/// following the units of the material textures.
+constexpr GLuint INSTANCE_RECORD_UNIT = 3;
+constexpr GLuint MATERIAL_RECORD_UNIT = 4;
+
+/// Whether the queue can be drawn with indirect draws, which also need base
+/// instances to select the records of every draw.
+bool indirectDrawsSupported();
+
+/// Packs the fields of a sort key, truncating each to its width.
+uint64_t makeSortKey(uint32_t pass, uint32_t program, uint32_t textureSet, uint32_t material, uint32_t depth);
+
+/// Maps a distance from the camera in [0, far] to the depth field of a sort
+/// key, with more precision close to the camera.
+uint32_t sortKeyDepth(float distance, float far);
+
+struct DrawItem {
+	uint64_t key;
+	const Entity* entity;
+	uint32_t mesh;
+};
+
+/// Sorts items by key with a stable LSD radix sort, using scratch as a
+/// buffer of the same size. Bytes that are equal in every key are skipped.
+void radixSort(DrawItem* items, DrawItem* scratch, size_t count);
+
+/// Draw calls made by the last RenderQueue::submit.
+struct QueueStatistics {
+	size_t drawCount = 0;
+	size_t instancedDrawCount = 0;
+	size_t instanceCount = 0;
+	size_t indirectCommandCount = 0;
+};
+
+class RenderQueue {
+public:
+	void clear() {
+		items.clear();
+	}
+
+	/// Adds the meshes of an entity that are not culled, see
+	/// Entity::cullMeshes, to be drawn in the given pass with program.
+	void addEntity(const Entity& entity, uint32_t pass, GLuint program, glm::vec3 cameraPosition, float far);
+
+	void sort();
+
+	/// Draws the items in order. Each item is drawn with the ranges of its
+	/// mesh in Entity::draws, or with its selected LOD if not culled yet.
+	/// Items drawing a single range are instanced. With indirect set, which
+	/// requires indirectDrawsSupported, the draws are issued from a buffer
+	/// of commands.
+	void submit(const ShaderProgram& shader, bool indirect, QueueStatistics* stats);
+
+	size_t size() const {
+		return items.size();
+	}
+private:
+	uint32_t textureSetId(const Mesh& mesh);
+	uint32_t materialId(const Mesh& mesh, float texRepeatFactor);
+	void buildBatches();
+	void submitBatches(const ShaderProgram& shader, QueueStatistics* stats);
+	void submitIndirect(const ShaderProgram& shader, QueueStatistics* stats);
+
+	// Consecutive instances drawing the same range of a mesh, or a single
+	// item with several ranges if instanceCount is zero
+	struct Batch {
+		const Entity* entity;
+		uint32_t mesh;
+		GLsizei count;
+		const GLvoid* offset;
+		size_t firstInstance;
+		GLsizei instanceCount;
+	};
+
+	// Consecutive batches drawn with one indirect call
+	struct Run {
+		size_t firstBatch;
+		size_t firstCommand;
+	};
+
+	std::vector<DrawItem> items;
+	std::vector<DrawItem> scratch;
+	std::vector<Batch> batches;
+	std::vector<InstanceData> instances;
+	BufferTexture instanceData;
+	// Indirect draws, with a material record per batch and the indices of
+	// the records of every instance
+	std::vector<Run> runs;
+	std::vector<DrawElementsIndirectCommand> commands;
+	std::vector<MaterialRecord> materialRecords;
+	std::vector<glm::uvec2> drawIndices;
+	BufferTexture materialData;
+	GLBuffer drawIndexBuffer;
+	GLBuffer commandBuffer;
+	// Dense ids of the texture sets and materials seen so far
+	std::unordered_map<uint64_t, uint32_t> textureSets;
+	std::unordered_map<uint64_t, uint32_t> materials;
+};
+
+#endif // RenderQueue_H
@@ -10,10 +10,13 @@
 
 #include <vector>
 #include <limits>
+#include <utility>
 #include <algorithm>
 
 #include "Logging.h"
 #include "FileTools.h"
+#include "UniformBuffer.h"
+#include "GLState.h"
 
 ShaderProgram::ShaderProgram(const char* vertShader, const char* fragShader) :
 	vertexPath{std::string(vertShader)},
@@ -32,6 +35,7 @@ ShaderProgram::ShaderProgram(ShaderProgram&& o) {
 	std::swap(fileModificationTime, o.fileModificationTime);
 	std::swap(fragmentPath, o.fragmentPath);
 	std::swap(vertexPath, o.vertexPath);
+	std::swap(uniforms, o.uniforms);
 }
 
 ShaderProgram& ShaderProgram::operator=(ShaderProgram&& o) {
@@ -39,11 +43,12 @@ ShaderProgram& ShaderProgram::operator=(ShaderProgram&& o) {
 	std::swap(fileModificationTime, o.fileModificationTime);
 	std::swap(fragmentPath, o.fragmentPath);
 	std::swap(vertexPath, o.vertexPath);
+	std::swap(uniforms, o.uniforms);
 	return *this;
 }
 
 void ShaderProgram::use() const {
-	glUseProgram(handle);
+	glState.useProgram(handle);
 }
 
 void ShaderProgram::reload(bool alwaysReload) {
@@ -62,16 +67,62 @@ void ShaderProgram::reload(bool alwaysReload) {
 		glDeleteProgram(handle);
 		debug("Reloaded {}, {}", vertexPath.c_str(), fragmentPath.c_str());
 		handle = newProg;
+		cacheUniforms();
+		bindUniformBlocks();
 	}
 }
 
-GLint ShaderProgram::getUniform(const char* name) const {
-	auto res = glGetUniformLocation(handle, name);
-	return res;
+void ShaderProgram::bindUniformBlocks() {
+	for (auto& block : UNIFORM_BLOCK_BINDINGS) {
+		auto index = glGetUniformBlockIndex(handle, block.name);
+		if (index != GL_INVALID_INDEX) {
+			glUniformBlockBinding(handle, index, block.binding);
+		}
+	}
 }
 
-GLint ShaderProgram::operator[](const char* uniformName) const {
-	return getUniform(uniformName);
+void ShaderProgram::cacheUniforms() {
+	GLint uniformCount = 0;
+	GLint maxNameLength = 0;
+	glGetProgramiv(handle, GL_ACTIVE_UNIFORMS, &uniformCount);
+	glGetProgramiv(handle, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+
+	std::vector<std::pair<std::string, GLint>> locations;
+	std::vector<GLchar> nameBuffer(maxNameLength + 1);
+	for (GLint i = 0; i < uniformCount; i++) {
+		GLsizei nameLength = 0;
+		GLint arraySize = 0;
+		GLenum type;
+		glGetActiveUniform(handle, GLuint(i), GLsizei(nameBuffer.size()), &nameLength, &arraySize, &type, nameBuffer.data());
+		std::string name(nameBuffer.data(), nameLength);
+
+		// Members of uniform blocks have no location
+		auto location = glGetUniformLocation(handle, name.c_str());
+		if (location == -1) {
+			continue;
+		}
+
+		// Arrays are reported once, as their first element. They can be set
+		// through the bare name as well as through each element.
+		const std::string firstElement = "[0]";
+		if (name.size() > firstElement.size() && name.compare(name.size() - firstElement.size(), firstElement.size(), firstElement) == 0) {
+			auto baseName = name.substr(0, name.size() - firstElement.size());
+			locations.emplace_back(baseName, location);
+			for (GLint element = 0; element < arraySize; element++) {
+				auto elementName = baseName + "[" + std::to_string(element) + "]";
+				locations.emplace_back(elementName, glGetUniformLocation(handle, elementName.c_str()));
+			}
+		} else {
+			locations.emplace_back(name, location);
+		}
+	}
+
+	uniforms.reset(locations.size());
+	for (auto& entry : locations) {
+		if (!uniforms.insert(UniformId(entry.first.c_str()), entry.second)) {
+			warn("Uniform {} in {}, {} has a colliding hash", entry.first, vertexPath, fragmentPath);
+		}
+	}
 }
 
 bool compileShader(GLuint shaderID, const char* source) {
@@ -14,6 +14,8 @@
 
 #include <GL/glew.h>
 
+#include "UniformId.h"
+
 class ShaderProgram {
 public:
 	ShaderProgram() = default;
@@ -28,14 +30,27 @@ public:
 
 	void use() const;
 	void reload(bool alwaysReload);
-	GLint getUniform(const char* name) const;
-	GLint operator[](const char* uniformName) const;
+
+	/// Location of a uniform, or -1 if the program has no active uniform by
+	/// that name. Locations are cached when the program is linked, so this
+	/// makes no GL calls.
+	GLint getUniform(UniformId uniform) const {
+		return uniforms[uniform];
+	}
+
+	GLint operator[](UniformId uniform) const {
+		return uniforms[uniform];
+	}
 
 	GLuint handle = 0;
 private:
+	void cacheUniforms();
+	void bindUniformBlocks();
+
 	std::string vertexPath;
 	std::string fragmentPath;
 	time_t fileModificationTime = 0;
+	UniformTable uniforms;
 };
 
 GLuint loadShader(const char* vertexPath, const char* fragmentPath);
@@ -0,0 +1,155 @@
+//===----------------------------------------------------------------------===//
+//
+// This file is part of the Noxoscope project
+//
+// Copyright (c) 2016 Niklas Helmertz
+//
+//===----------------------------------------------------------------------===//
+
+#include "TextureArrays.h"
+
+#include <algorithm>
+
+#include "Logging.h"
+
+size_t arrayLevelSize(const TextureArrayFormat& format, int level) {
+	size_t width = std::max(1, format.width >> level);
+	size_t height = std::max(1, format.height >> level);
+	if (format.internalFormat == GL_RGBA8) {
+		return width * height * 4;
+	}
+	size_t blockBytes = format.internalFormat == GL_COMPRESSED_RGB_S3TC_DXT1_EXT ? 8 : 16;
+	return ((width + 3) / 4) * ((height + 3) / 4) * blockBytes;
+}
+
+TextureArray::TextureArray(const TextureArrayFormat& format, float maxAnisotropy)
+	: arrayFormat(format),
+	  maxAnisotropy(maxAnisotropy) {
+	resize(TEXTURE_ARRAY_INITIAL_LAYERS);
+}
+
+GLint TextureArray::acquireLayer() {
+	if (!freeLayers.empty()) {
+		GLint layer = freeLayers.back();
+		freeLayers.pop_back();
+		return layer;
+	}
+	if (nextLayer == TEXTURE_ARRAY_MAX_LAYERS) {
+		return -1;
+	}
+	if (nextLayer == capacity) {
+		resize(std::min(capacity * 2, TEXTURE_ARRAY_MAX_LAYERS));
+	}
+	return nextLayer++;
+}
+
+void TextureArray::releaseLayer(GLint layer) {
+	freeLayers.push_back(layer);
+}
+
+size_t TextureArray::layerMemory() const {
+	size_t total = 0;
+	for (int level = 0; level < arrayFormat.levels; level++) {
+		total += arrayLevelSize(arrayFormat, level);
+	}
+	return total;
+}
+
+void TextureArray::resize(GLsizei newCapacity) {
+	auto& format = arrayFormat;
+	bool compressed = format.internalFormat != GL_RGBA8;
+
+	GLTexture resized;
+	resized.gen();
+	glBindTexture(GL_TEXTURE_2D_ARRAY, resized.handle);
+	for (int level = 0; level < format.levels; level++) {
+		GLsizei width = std::max(1, format.width >> level);
+		GLsizei height = std::max(1, format.height >> level);
+		if (compressed) {
+			auto size = static_cast<GLsizei>(arrayLevelSize(format, level) * newCapacity);
+			glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, level, format.internalFormat, width, height, newCapacity, 0, size, nullptr);
+		} else {
+			glTexImage3D(GL_TEXTURE_2D_ARRAY, level, GL_RGBA8, width, height, newCapacity, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+		}
+	}
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, format.levels - 1);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, format.magFilter);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, format.minFilter);
+	if (maxAnisotropy > 0.0f) {
+		glTexParameterf(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_ANISOTROPY_EXT, maxAnisotropy);
+	}
+
+	if (capacity > 0) {
+		// The old layers go through a pixel buffer, which keeps the copy on
+		// the GPU. Uploads may be in progress, so the unpack buffer is restored.
+		GLint unpackBuffer = 0;
+		glGetIntegerv(GL_PIXEL_UNPACK_BUFFER_BINDING, &unpackBuffer);
+		GLBuffer transfer;
+		transfer.gen();
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, transfer.handle);
+		glBufferData(GL_PIXEL_PACK_BUFFER, arrayLevelSize(format, 0) * capacity, nullptr, GL_STREAM_COPY);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, transfer.handle);
+		for (int level = 0; level < format.levels; level++) {
+			GLsizei width = std::max(1, format.width >> level);
+			GLsizei height = std::max(1, format.height >> level);
+			glBindTexture(GL_TEXTURE_2D_ARRAY, texture.handle);
+			if (compressed) {
+				glGetCompressedTexImage(GL_TEXTURE_2D_ARRAY, level, nullptr);
+			} else {
+				glGetTexImage(GL_TEXTURE_2D_ARRAY, level, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+			}
+			glBindTexture(GL_TEXTURE_2D_ARRAY, resized.handle);
+			if (compressed) {
+				auto size = static_cast<GLsizei>(arrayLevelSize(format, level) * capacity);
+				glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, 0, width, height, capacity, format.internalFormat, size, nullptr);
+			} else {
+				glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, 0, width, height, capacity, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+			}
+		}
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, unpackBuffer);
+	}
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+	texture = std::move(resized);
+	capacity = newCapacity;
+}
+
+StreamedTexture::~StreamedTexture() {
+	if (resident) {
+		array->releaseLayer(layer);
+	}
+}
+
+void TextureArrays::place(StreamedTexture* texture, const TextureArrayFormat& format, float maxAnisotropy) {
+	if (texture->resident) {
+		texture->array->releaseLayer(texture->layer);
+	}
+
+	std::shared_ptr<TextureArray> array;
+	GLint layer = -1;
+	for (auto& candidate : arrays) {
+		if (candidate->format() == format && (layer = candidate->acquireLayer()) >= 0) {
+			array = candidate;
+			break;
+		}
+	}
+	if (!array) {
+		debug("Creating {}x{} texture array, format {:#x}", format.width, format.height, format.internalFormat);
+		array = std::make_shared<TextureArray>(format, maxAnisotropy);
+		layer = array->acquireLayer();
+		arrays.push_back(array);
+	}
+
+	texture->array = std::move(array);
+	texture->layer = layer;
+	texture->resident = true;
+}
+
+size_t TextureArrays::memory() const {
+	size_t total = 0;
+	for (auto& array : arrays) {
+		total += array->memory();
+	}
+	return total;
+}
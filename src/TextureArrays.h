@@ -0,0 +1,140 @@
+//===----------------------------------------------------------------------===//
+//
+// This file is part of the Noxoscope project
+//
+// Copyright (c) 2016 Niklas Helmertz
+//
+//===----------------------------------------------------------------------===//
+//
+// Material textures stored as layers of GL_TEXTURE_2D_ARRAY textures.
+//
+// Textures with the same size, format, mip count and filters share an
+// array, so that meshes using different images of the same kind bind the
+// same textures and only differ in the layer index passed to the shaders.
+// Arrays start out small and double their layer count as they fill up, by
+// copying the old layers through a pixel buffer, which works for the block
+// compressed formats as well.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef TextureArrays_H
+#define TextureArrays_H
+
+#include <vector>
+#include <memory>
+#include <cstddef>
+
+#include <GL/glew.h>
+
+#include "GLObject.h"
+
+/// Layers of a texture array when it is created.
+constexpr GLsizei TEXTURE_ARRAY_INITIAL_LAYERS = 4;
+
+/// Layers of a texture array at most, after which another array of the same
+/// format is created. GL 3.3 guarantees at least 256.
+constexpr GLsizei TEXTURE_ARRAY_MAX_LAYERS = 256;
+
+/// \brief Properties shared by all layers of a texture array.
+struct TextureArrayFormat {
+	/// GL_RGBA8, or one of the formats returned by glCompressedFormat.
+	GLenum internalFormat;
+	int width;
+	int height;
+	int levels;
+	GLint magFilter;
+	GLint minFilter;
+
+	bool operator==(const TextureArrayFormat& o) const {
+		return internalFormat == o.internalFormat && width == o.width && height == o.height &&
+			levels == o.levels && magFilter == o.magFilter && minFilter == o.minFilter;
+	}
+};
+
+/// Size in bytes of one layer of a mip level.
+size_t arrayLevelSize(const TextureArrayFormat& format, int level);
+
+class TextureArray {
+public:
+	TextureArray(const TextureArrayFormat& format, float maxAnisotropy);
+
+	TextureArray(TextureArray const&) = delete;
+	void operator=(TextureArray const&) = delete;
+
+	/// Returns an unused layer, growing the array if needed, or -1 if it
+	/// already has TEXTURE_ARRAY_MAX_LAYERS layers in use.
+	///
+	/// Growing replaces the texture object, so the handle must be read again.
+	GLint acquireLayer();
+
+	/// Makes a layer available again. Its contents are left as they are.
+	void releaseLayer(GLint layer);
+
+	GLuint handle() const {
+		return texture.handle;
+	}
+
+	const TextureArrayFormat& format() const {
+		return arrayFormat;
+	}
+
+	/// Size in bytes of a single layer with all its levels.
+	size_t layerMemory() const;
+
+	/// Size in bytes of all layers, used or not.
+	size_t memory() const {
+		return layerMemory() * capacity;
+	}
+
+	GLsizei usedLayers() const {
+		return nextLayer - static_cast<GLsizei>(freeLayers.size());
+	}
+
+private:
+	void resize(GLsizei newCapacity);
+
+	TextureArrayFormat arrayFormat;
+	float maxAnisotropy;
+	GLTexture texture;
+	GLsizei capacity = 0;
+	/// Layers below nextLayer have been handed out at least once.
+	GLsizei nextLayer = 0;
+	std::vector<GLint> freeLayers;
+};
+
+/// \brief A material texture, as a layer of a texture array.
+///
+/// Until the image of the texture is resident, the layer refers to a shared
+/// placeholder that is not owned by the texture.
+struct StreamedTexture {
+	std::shared_ptr<TextureArray> array;
+	GLint layer = 0;
+	/// Whether the layer belongs to this texture.
+	bool resident = false;
+
+	StreamedTexture(std::shared_ptr<TextureArray> array, GLint layer) : array(std::move(array)), layer(layer) {}
+	~StreamedTexture();
+
+	StreamedTexture(StreamedTexture const&) = delete;
+	void operator=(StreamedTexture const&) = delete;
+};
+
+/// \brief All texture arrays of material textures, grouped by format.
+class TextureArrays {
+public:
+	/// Moves texture into a free layer of an array of the given format,
+	/// creating the array if there is none with room left.
+	void place(StreamedTexture* texture, const TextureArrayFormat& format, float maxAnisotropy);
+
+	size_t arrayCount() const {
+		return arrays.size();
+	}
+
+	/// Size in bytes of all arrays, including unused layers.
+	size_t memory() const;
+
+private:
+	std::vector<std::shared_ptr<TextureArray>> arrays;
+};
+
+#endif // TextureArrays_H
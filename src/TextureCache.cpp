@@ -0,0 +1,226 @@
+//===----------------------------------------------------------------------===//
+//
+// This file is part of the Noxoscope project
+//
+// Copyright (c) 2016 Niklas Helmertz
+//
+//===----------------------------------------------------------------------===//
+
+#include "TextureCache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <thread>
+#include <algorithm>
+
+#include "Hash.h"
+#include "Logging.h"
+
+constexpr uint32_t fourCC(char a, char b, char c, char d) {
+	return uint32_t(uint8_t(a)) | uint32_t(uint8_t(b)) << 8 | uint32_t(uint8_t(c)) << 16 | uint32_t(uint8_t(d)) << 24;
+}
+
+constexpr uint32_t DDS_MAGIC = fourCC('D', 'D', 'S', ' ');
+constexpr uint32_t TEXTURE_CACHE_MAGIC = fourCC('N', 'X', 'T', 'C');
+// Version 2 resizes images to powers of two before compressing
+constexpr uint32_t TEXTURE_CACHE_VERSION = 2;
+constexpr uint32_t MAX_TEXTURE_SIZE = 1 << 16;
+constexpr uint32_t MAX_MIP_COUNT = 17;
+
+// Flags from the DDS specification
+constexpr uint32_t DDSD_CAPS = 0x1;
+constexpr uint32_t DDSD_HEIGHT = 0x2;
+constexpr uint32_t DDSD_WIDTH = 0x4;
+constexpr uint32_t DDSD_PIXELFORMAT = 0x1000;
+constexpr uint32_t DDSD_MIPMAPCOUNT = 0x20000;
+constexpr uint32_t DDSD_LINEARSIZE = 0x80000;
+constexpr uint32_t DDPF_FOURCC = 0x4;
+constexpr uint32_t DDSCAPS_COMPLEX = 0x8;
+constexpr uint32_t DDSCAPS_TEXTURE = 0x1000;
+constexpr uint32_t DDSCAPS_MIPMAP = 0x400000;
+
+struct DdsPixelFormat {
+	uint32_t size;
+	uint32_t flags;
+	uint32_t fourCC;
+	uint32_t rgbBitCount;
+	uint32_t rBitMask;
+	uint32_t gBitMask;
+	uint32_t bBitMask;
+	uint32_t aBitMask;
+};
+
+/// Identification of the source image, stored in the reserved DDS fields.
+struct CacheTag {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t sourceModificationTimeLow;
+	uint32_t sourceModificationTimeHigh;
+	uint32_t sourceSizeLow;
+	uint32_t sourceSizeHigh;
+	uint32_t normalMap;
+	uint32_t unused[4];
+};
+
+struct DdsHeader {
+	uint32_t magic;
+	uint32_t size;
+	uint32_t flags;
+	uint32_t height;
+	uint32_t width;
+	uint32_t pitchOrLinearSize;
+	uint32_t depth;
+	uint32_t mipMapCount;
+	CacheTag tag;
+	DdsPixelFormat pixelFormat;
+	uint32_t caps;
+	uint32_t caps2;
+	uint32_t caps3;
+	uint32_t caps4;
+	uint32_t reserved2;
+};
+
+static_assert(sizeof(DdsHeader) == 128, "Unexpected padding in DdsHeader");
+
+static uint32_t formatFourCC(BlockFormat format) {
+	switch (format) {
+	case BlockFormat::BC1:
+		return fourCC('D', 'X', 'T', '1');
+	case BlockFormat::BC3:
+		return fourCC('D', 'X', 'T', '5');
+	case BlockFormat::BC5:
+		return fourCC('A', 'T', 'I', '2');
+	}
+	return 0;
+}
+
+static std::string cacheFilePath(const TextureCacheKey& key) {
+	auto hash = hashFnv1a(key.sourcePath.data(), key.sourcePath.size());
+	hash = hashFnv1a(&key.normalMap, sizeof(key.normalMap), hash);
+	return baseDirRelative(fmt::format("cache{}textures{}{:016x}.dds", PATH_SEP, PATH_SEP, hash).c_str());
+}
+
+static CacheTag makeTag(const TextureCacheKey& key) {
+	CacheTag tag;
+	std::memset(&tag, 0, sizeof(tag));
+	tag.magic = TEXTURE_CACHE_MAGIC;
+	tag.version = TEXTURE_CACHE_VERSION;
+	tag.sourceModificationTimeLow = static_cast<uint32_t>(key.sourceInfo.modificationTime);
+	tag.sourceModificationTimeHigh = static_cast<uint32_t>(uint64_t(key.sourceInfo.modificationTime) >> 32);
+	tag.sourceSizeLow = static_cast<uint32_t>(key.sourceInfo.size);
+	tag.sourceSizeHigh = static_cast<uint32_t>(key.sourceInfo.size >> 32);
+	tag.normalMap = key.normalMap ? 1 : 0;
+	return tag;
+}
+
+bool readTextureCache(const TextureCacheKey& key, CompressedTexture* texture) {
+	auto filePath = cacheFilePath(key);
+	MappedFile file;
+	if (!file.open(filePath.c_str())) {
+		return false;
+	}
+	if (file.size() < sizeof(DdsHeader)) {
+		warn("Ignoring truncated texture cache file {}", filePath.c_str());
+		return false;
+	}
+
+	DdsHeader header;
+	std::memcpy(&header, file.data(), sizeof(header));
+	bool valid =
+		header.magic == DDS_MAGIC &&
+		header.size == sizeof(DdsHeader) - sizeof(header.magic) &&
+		header.width > 0 && header.width <= MAX_TEXTURE_SIZE &&
+		header.height > 0 && header.height <= MAX_TEXTURE_SIZE &&
+		header.mipMapCount > 0 && header.mipMapCount <= MAX_MIP_COUNT;
+	if (!valid) {
+		warn("Ignoring corrupt texture cache file {}", filePath.c_str());
+		return false;
+	}
+	auto expectedTag = makeTag(key);
+	if (std::memcmp(&header.tag, &expectedTag, sizeof(CacheTag)) != 0) {
+		return false;
+	}
+
+	BlockFormat format;
+	if (header.pixelFormat.fourCC == formatFourCC(BlockFormat::BC1)) {
+		format = BlockFormat::BC1;
+	} else if (header.pixelFormat.fourCC == formatFourCC(BlockFormat::BC3)) {
+		format = BlockFormat::BC3;
+	} else if (header.pixelFormat.fourCC == formatFourCC(BlockFormat::BC5)) {
+		format = BlockFormat::BC5;
+	} else {
+		warn("Ignoring texture cache file {} with unknown format", filePath.c_str());
+		return false;
+	}
+
+	std::vector<TextureLevel> levels;
+	int width = header.width;
+	int height = header.height;
+	size_t offset = 0;
+	for (uint32_t i = 0; i < header.mipMapCount; i++) {
+		auto size = levelSize(format, width, height);
+		levels.push_back({width, height, offset, size});
+		offset += size;
+		width = std::max(1, width / 2);
+		height = std::max(1, height / 2);
+	}
+	if (levels.empty() || sizeof(DdsHeader) + offset != file.size()) {
+		warn("Ignoring corrupt texture cache file {}", filePath.c_str());
+		return false;
+	}
+
+	texture->format = format;
+	texture->levels = std::move(levels);
+	texture->data = reinterpret_cast<const unsigned char*>(file.data()) + sizeof(DdsHeader);
+	texture->mapping = std::move(file);
+	return true;
+}
+
+bool writeTextureCache(const TextureCacheKey& key, const CompressedTexture& texture) {
+	auto filePath = cacheFilePath(key);
+	auto dirPath = filePath.substr(0, filePath.find_last_of(PATH_SEP));
+	if (!makeDirectories(dirPath)) {
+		warn("Could not create texture cache directory {}", dirPath.c_str());
+		return false;
+	}
+
+	DdsHeader header;
+	std::memset(&header, 0, sizeof(header));
+	header.magic = DDS_MAGIC;
+	header.size = sizeof(DdsHeader) - sizeof(header.magic);
+	header.flags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_MIPMAPCOUNT | DDSD_LINEARSIZE;
+	header.width = texture.levels[0].width;
+	header.height = texture.levels[0].height;
+	header.pitchOrLinearSize = static_cast<uint32_t>(texture.levels[0].size);
+	header.mipMapCount = static_cast<uint32_t>(texture.levels.size());
+	header.tag = makeTag(key);
+	header.pixelFormat.size = sizeof(DdsPixelFormat);
+	header.pixelFormat.flags = DDPF_FOURCC;
+	header.pixelFormat.fourCC = formatFourCC(texture.format);
+	header.caps = DDSCAPS_TEXTURE | DDSCAPS_COMPLEX | DDSCAPS_MIPMAP;
+
+	// Unique per thread, as the same texture may be compressed by several at once
+	auto threadHash = std::hash<std::thread::id>()(std::this_thread::get_id());
+	auto tempPath = fmt::format("{}.{:x}.tmp", filePath, threadHash);
+	{
+		std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		out.write(reinterpret_cast<const char*>(texture.data), texture.byteSize());
+		if (!out) {
+			warn("Failed writing texture cache file {}", tempPath.c_str());
+			out.close();
+			std::remove(tempPath.c_str());
+			return false;
+		}
+	}
+
+	// Replace the old entry in one step, so readers never see a partial file
+	std::remove(filePath.c_str());
+	if (std::rename(tempPath.c_str(), filePath.c_str()) != 0) {
+		warn("Failed replacing texture cache file {}", filePath.c_str());
+		std::remove(tempPath.c_str());
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,41 @@
+//===----------------------------------------------------------------------===//
+//
+// This file is part of the Noxoscope project
+//
+// Copyright (c) 2016 Niklas Helmertz
+//
+//===----------------------------------------------------------------------===//
+//
+// On-disk cache of block-compressed textures.
+//
+// Entries are standard DDS files holding every mip level, so they can be
+// inspected with common image tools. The source file a texture was compressed
+// from is identified in the reserved header fields. Entries are
+// memory-mapped when read, and uploaded straight from the mapping.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef TextureCache_H
+#define TextureCache_H
+
+#include <string>
+
+#include "TextureCompression.h"
+#include "FileTools.h"
+
+/// Identifies the source image a cache entry was built from. An entry with a
+/// different key is considered stale.
+struct TextureCacheKey {
+	std::string sourcePath;
+	FileInfo sourceInfo;
+	bool normalMap;
+};
+
+/// Reads a cache entry matching key into texture. Returns false if there is
+/// no valid entry, in which case texture is left untouched.
+bool readTextureCache(const TextureCacheKey& key, CompressedTexture* texture);
+
+/// Writes texture as the cache entry for key, replacing any stale entry.
+bool writeTextureCache(const TextureCacheKey& key, const CompressedTexture& texture);
+
+#endif // TextureCache_H
@@ -0,0 +1,329 @@
+//===----------------------------------------------------------------------===//
+//
+// This file is part of the Noxoscope project
+//
+// Copyright (c) 2016 Niklas Helmertz
+//
+//===----------------------------------------------------------------------===//
+
+#include "TextureCompression.h"
+
+#include <cfloat>
+#include <algorithm>
+
+#include <glm/glm.hpp>
+
+size_t blockSize(BlockFormat format) {
+	return format == BlockFormat::BC1 ? 8 : 16;
+}
+
+size_t levelSize(BlockFormat format, int width, int height) {
+	size_t blocksX = std::max(1, (width + 3) / 4);
+	size_t blocksY = std::max(1, (height + 3) / 4);
+	return blocksX * blocksY * blockSize(format);
+}
+
+GLenum glCompressedFormat(BlockFormat format) {
+	switch (format) {
+	case BlockFormat::BC1:
+		return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+	case BlockFormat::BC3:
+		return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+	case BlockFormat::BC5:
+		return GL_COMPRESSED_RG_RGTC2;
+	}
+	return 0;
+}
+
+BlockFormat chooseBlockFormat(const unsigned char* rgba, int width, int height, bool normalMap) {
+	if (normalMap) {
+		return BlockFormat::BC5;
+	}
+	size_t texelCount = size_t(width) * height;
+	for (size_t i = 0; i < texelCount; i++) {
+		if (rgba[i * 4 + 3] != 255) {
+			return BlockFormat::BC3;
+		}
+	}
+	return BlockFormat::BC1;
+}
+
+static void writeLittleEndian(unsigned char* out, uint64_t value, int byteCount) {
+	for (int i = 0; i < byteCount; i++) {
+		out[i] = static_cast<unsigned char>(value >> (8 * i));
+	}
+}
+
+static uint16_t packRgb565(glm::vec3 color) {
+	auto quantize = [](float value, int maxValue) {
+		return static_cast<uint16_t>(glm::clamp(static_cast<int>(value * maxValue / 255.0f + 0.5f), 0, maxValue));
+	};
+	return static_cast<uint16_t>((quantize(color.r, 31) << 11) | (quantize(color.g, 63) << 5) | quantize(color.b, 31));
+}
+
+static glm::vec3 unpackRgb565(uint16_t color) {
+	int r = (color >> 11) & 31;
+	int g = (color >> 5) & 63;
+	int b = color & 31;
+	return glm::vec3((r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2));
+}
+
+void encodeBC1Block(const unsigned char* rgba, unsigned char* block) {
+	using namespace glm;
+
+	vec3 colors[16];
+	vec3 mean(0.0f);
+	vec3 minColor(255.0f);
+	vec3 maxColor(0.0f);
+	for (int i = 0; i < 16; i++) {
+		colors[i] = vec3(rgba[i * 4], rgba[i * 4 + 1], rgba[i * 4 + 2]);
+		mean += colors[i];
+		minColor = min(minColor, colors[i]);
+		maxColor = max(maxColor, colors[i]);
+	}
+	mean /= 16.0f;
+
+	// Find the principal axis of the colors, by power iteration on their
+	// covariance matrix, and pick the extreme colors along it as endpoints
+	mat3 covariance(0.0f);
+	for (auto& color : colors) {
+		covariance += outerProduct(color - mean, color - mean);
+	}
+	vec3 axis = maxColor - minColor;
+	for (int i = 0; i < 8; i++) {
+		axis = covariance * axis;
+		float largest = max(max(abs(axis.x), abs(axis.y)), abs(axis.z));
+		if (largest < FLT_EPSILON) {
+			break;
+		}
+		axis /= largest;
+	}
+
+	vec3 low = mean;
+	vec3 high = mean;
+	float minProjection = FLT_MAX;
+	float maxProjection = -FLT_MAX;
+	for (auto& color : colors) {
+		float projection = dot(color - mean, axis);
+		if (projection < minProjection) {
+			minProjection = projection;
+			low = color;
+		}
+		if (projection > maxProjection) {
+			maxProjection = projection;
+			high = color;
+		}
+	}
+
+	// Pulling the endpoints slightly inwards lowers the average error, as
+	// the extremes are usually outliers
+	vec3 inset = (high - low) / 16.0f;
+	uint16_t color0 = packRgb565(high - inset);
+	uint16_t color1 = packRgb565(low + inset);
+
+	// color0 > color1 selects the four color mode without transparency
+	if (color0 < color1) {
+		std::swap(color0, color1);
+	}
+
+	uint32_t indices = 0;
+	if (color0 != color1) {
+		vec3 endpoint0 = unpackRgb565(color0);
+		vec3 endpoint1 = unpackRgb565(color1);
+		vec3 palette[4] = {
+			endpoint0,
+			endpoint1,
+			(2.0f * endpoint0 + endpoint1) / 3.0f,
+			(endpoint0 + 2.0f * endpoint1) / 3.0f
+		};
+		for (int i = 0; i < 16; i++) {
+			uint32_t best = 0;
+			float bestDistance = FLT_MAX;
+			for (uint32_t j = 0; j < 4; j++) {
+				vec3 diff = colors[i] - palette[j];
+				float distance = dot(diff, diff);
+				if (distance < bestDistance) {
+					bestDistance = distance;
+					best = j;
+				}
+			}
+			indices |= best << (2 * i);
+		}
+	}
+
+	writeLittleEndian(block, color0, 2);
+	writeLittleEndian(block + 2, color1, 2);
+	writeLittleEndian(block + 4, indices, 4);
+}
+
+void encodeBC4Block(const unsigned char* values, int stride, unsigned char* block) {
+	int low = 255;
+	int high = 0;
+	for (int i = 0; i < 16; i++) {
+		low = std::min(low, int(values[i * stride]));
+		high = std::max(high, int(values[i * stride]));
+	}
+
+	// Endpoint 0 > endpoint 1 selects the mode with 6 interpolated values
+	uint64_t indices = 0;
+	if (high != low) {
+		int palette[8] = {high, low};
+		for (int j = 2; j < 8; j++) {
+			palette[j] = ((8 - j) * high + (j - 1) * low + 3) / 7;
+		}
+		for (int i = 0; i < 16; i++) {
+			uint64_t best = 0;
+			int bestDistance = 256;
+			for (int j = 0; j < 8; j++) {
+				int distance = std::abs(values[i * stride] - palette[j]);
+				if (distance < bestDistance) {
+					bestDistance = distance;
+					best = j;
+				}
+			}
+			indices |= best << (3 * i);
+		}
+	}
+
+	block[0] = static_cast<unsigned char>(high);
+	block[1] = static_cast<unsigned char>(low);
+	writeLittleEndian(block + 2, indices, 6);
+}
+
+void encodeBC3Block(const unsigned char* rgba, unsigned char* block) {
+	encodeBC4Block(rgba + 3, 4, block);
+	encodeBC1Block(rgba, block + 8);
+}
+
+void encodeBC5Block(const unsigned char* rgba, unsigned char* block) {
+	encodeBC4Block(rgba, 4, block);
+	encodeBC4Block(rgba + 1, 4, block + 8);
+}
+
+static void compressLevel(const unsigned char* rgba, int width, int height, BlockFormat format, unsigned char* out) {
+	unsigned char texels[16 * 4];
+	for (int blockY = 0; blockY < height; blockY += 4) {
+		for (int blockX = 0; blockX < width; blockX += 4) {
+			// Blocks reaching past the edges repeat the last row or column
+			for (int y = 0; y < 4; y++) {
+				for (int x = 0; x < 4; x++) {
+					int srcX = std::min(blockX + x, width - 1);
+					int srcY = std::min(blockY + y, height - 1);
+					std::copy_n(rgba + (size_t(srcY) * width + srcX) * 4, 4, texels + (y * 4 + x) * 4);
+				}
+			}
+
+			switch (format) {
+			case BlockFormat::BC1:
+				encodeBC1Block(texels, out);
+				break;
+			case BlockFormat::BC3:
+				encodeBC3Block(texels, out);
+				break;
+			case BlockFormat::BC5:
+				encodeBC5Block(texels, out);
+				break;
+			}
+			out += blockSize(format);
+		}
+	}
+}
+
+std::vector<unsigned char> downsampleRgba(const std::vector<unsigned char>& rgba, int width, int height, bool normalMap) {
+	int newWidth = std::max(1, width / 2);
+	int newHeight = std::max(1, height / 2);
+	std::vector<unsigned char> result(size_t(newWidth) * newHeight * 4);
+	for (int y = 0; y < newHeight; y++) {
+		for (int x = 0; x < newWidth; x++) {
+			int x0 = std::min(2 * x, width - 1);
+			int x1 = std::min(2 * x + 1, width - 1);
+			int y0 = std::min(2 * y, height - 1);
+			int y1 = std::min(2 * y + 1, height - 1);
+
+			glm::vec4 sum(0.0f);
+			for (auto texel : {y0 * width + x0, y0 * width + x1, y1 * width + x0, y1 * width + x1}) {
+				auto src = &rgba[size_t(texel) * 4];
+				sum += glm::vec4(src[0], src[1], src[2], src[3]);
+			}
+			glm::vec4 average = sum / 4.0f;
+
+			if (normalMap) {
+				glm::vec3 normal = glm::vec3(average) / 127.5f - 1.0f;
+				if (dot(normal, normal) > FLT_EPSILON) {
+					normal = normalize(normal);
+				}
+				average = glm::vec4((normal + 1.0f) * 127.5f, average.a);
+			}
+
+			auto dst = &result[(size_t(y) * newWidth + x) * 4];
+			for (int c = 0; c < 4; c++) {
+				dst[c] = static_cast<unsigned char>(glm::clamp(average[c] + 0.5f, 0.0f, 255.0f));
+			}
+		}
+	}
+	return result;
+}
+
+int nextPowerOfTwo(int value) {
+	int power = 1;
+	while (power < value) {
+		power *= 2;
+	}
+	return power;
+}
+
+std::vector<unsigned char> resizeRgba(const unsigned char* rgba, int width, int height, int newWidth, int newHeight) {
+	std::vector<unsigned char> result(size_t(newWidth) * newHeight * 4);
+	float scaleX = float(width) / newWidth;
+	float scaleY = float(height) / newHeight;
+	for (int y = 0; y < newHeight; y++) {
+		// Texel centers of the result, in texels of the source
+		float sy = glm::clamp((y + 0.5f) * scaleY - 0.5f, 0.0f, float(height - 1));
+		int y0 = static_cast<int>(sy);
+		int y1 = std::min(y0 + 1, height - 1);
+		float fy = sy - y0;
+		for (int x = 0; x < newWidth; x++) {
+			float sx = glm::clamp((x + 0.5f) * scaleX - 0.5f, 0.0f, float(width - 1));
+			int x0 = static_cast<int>(sx);
+			int x1 = std::min(x0 + 1, width - 1);
+			float fx = sx - x0;
+
+			auto dst = &result[(size_t(y) * newWidth + x) * 4];
+			for (int c = 0; c < 4; c++) {
+				auto texel = [&](int tx, int ty) {
+					return float(rgba[(size_t(ty) * width + tx) * 4 + c]);
+				};
+				float top = glm::mix(texel(x0, y0), texel(x1, y0), fx);
+				float bottom = glm::mix(texel(x0, y1), texel(x1, y1), fx);
+				dst[c] = static_cast<unsigned char>(glm::clamp(glm::mix(top, bottom, fy) + 0.5f, 0.0f, 255.0f));
+			}
+		}
+	}
+	return result;
+}
+
+void compressTexture(const unsigned char* rgba, int width, int height, BlockFormat format, CompressedTexture* texture) {
+	texture->format = format;
+	texture->levels.clear();
+	texture->storage.clear();
+
+	std::vector<unsigned char> level(rgba, rgba + size_t(width) * height * 4);
+	while (true) {
+		TextureLevel compressed;
+		compressed.width = width;
+		compressed.height = height;
+		compressed.offset = texture->storage.size();
+		compressed.size = levelSize(format, width, height);
+		texture->storage.resize(compressed.offset + compressed.size);
+		compressLevel(level.data(), width, height, format, texture->storage.data() + compressed.offset);
+		texture->levels.push_back(compressed);
+
+		if (width == 1 && height == 1) {
+			break;
+		}
+		level = downsampleRgba(level, width, height, format == BlockFormat::BC5);
+		width = std::max(1, width / 2);
+		height = std::max(1, height / 2);
+	}
+	texture->data = texture->storage.data();
+}
@@ -0,0 +1,102 @@
+//===----------------------------------------------------------------------===//
+//
+// This file is part of the Noxoscope project
+//
+// Copyright (c) 2016 Niklas Helmertz
+//
+//===----------------------------------------------------------------------===//
+//
+// CPU encoder for the BC1, BC3 and BC5 block compression formats, also known
+// as DXT1, DXT5 and ATI2/RGTC2.
+//
+// Every format splits the image into 4x4 texel blocks. BC1 stores two RGB565
+// endpoints and a 2-bit palette index per texel in 8 bytes. BC3 adds a BC4
+// alpha block, i.e. two 8-bit endpoints and a 3-bit index per texel, in front
+// of a BC1 color block. BC5 stores two BC4 blocks, for the red and green
+// channels, and is used for tangent space normal maps.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef TextureCompression_H
+#define TextureCompression_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include <GL/glew.h>
+
+#include "FileTools.h"
+
+enum class BlockFormat : uint32_t {
+	BC1,
+	BC3,
+	BC5
+};
+
+/// Size of a single block in bytes.
+size_t blockSize(BlockFormat format);
+
+/// Size of a compressed level in bytes.
+size_t levelSize(BlockFormat format, int width, int height);
+
+/// Internal format used with glCompressedTexImage2D.
+GLenum glCompressedFormat(BlockFormat format);
+
+/// Picks BC5 for normal maps, and otherwise BC3 if the image has any
+/// transparency or BC1 if it has not.
+BlockFormat chooseBlockFormat(const unsigned char* rgba, int width, int height, bool normalMap);
+
+/// Mip level of a texture, as a range of bytes of its data.
+struct TextureLevel {
+	int width;
+	int height;
+	size_t offset;
+	size_t size;
+};
+
+/// \brief Block-compressed texture with a complete mip chain.
+///
+/// The levels either point into storage, after compressing, or directly into
+/// a memory-mapped cache file.
+struct CompressedTexture {
+	BlockFormat format = BlockFormat::BC1;
+	std::vector<TextureLevel> levels;
+	const unsigned char* data = nullptr;
+	std::vector<unsigned char> storage;
+	MappedFile mapping;
+
+	/// Total size of all levels in bytes.
+	size_t byteSize() const {
+		return levels.empty() ? 0 : levels.back().offset + levels.back().size;
+	}
+};
+
+/// Encodes 16 RGBA texels, in rows of 4, as a BC1 block of 8 bytes. Alpha is ignored.
+void encodeBC1Block(const unsigned char* rgba, unsigned char* block);
+
+/// Encodes 16 single channel values, stride bytes apart, as a BC4 block of 8 bytes.
+void encodeBC4Block(const unsigned char* values, int stride, unsigned char* block);
+
+/// Encodes 16 RGBA texels as a BC3 block of 16 bytes.
+void encodeBC3Block(const unsigned char* rgba, unsigned char* block);
+
+/// Encodes the red and green channels of 16 RGBA texels as a BC5 block of 16 bytes.
+void encodeBC5Block(const unsigned char* rgba, unsigned char* block);
+
+/// Halves the size of an RGBA image with a box filter, renormalizing the
+/// texels of normal maps.
+std::vector<unsigned char> downsampleRgba(const std::vector<unsigned char>& rgba, int width, int height, bool normalMap);
+
+/// Smallest power of two not less than value.
+int nextPowerOfTwo(int value);
+
+/// Scales an RGBA image to newWidth x newHeight with bilinear filtering.
+std::vector<unsigned char> resizeRgba(const unsigned char* rgba, int width, int height, int newWidth, int newHeight);
+
+/// Compresses an RGBA image into texture, generating every mip level down
+/// to 1x1 with a box filter. For BC5, the levels are treated as normal maps
+/// and renormalized after filtering.
+void compressTexture(const unsigned char* rgba, int width, int height, BlockFormat format, CompressedTexture* texture);
+
+#endif // TextureCompression_H
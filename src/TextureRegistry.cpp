@@ -0,0 +1,94 @@
+//===----------------------------------------------------------------------===//
+//
+// This file is part of the Noxoscope project
+//
+// Copyright (c) 2016 Niklas Helmertz
+//
+//===----------------------------------------------------------------------===//
+
+#include "TextureRegistry.h"
+
+#include <vector>
+#include <unordered_set>
+#include <utility>
+#include <algorithm>
+
+#include "Hash.h"
+#include "FileTools.h"
+#include "Logging.h"
+
+TextureRegistry::TextureRegistry(TextureStreamer& streamer, bool hashContents)
+	: streamer(streamer),
+	  hashContents(hashContents) {}
+
+std::shared_ptr<StreamedTexture> TextureRegistry::acquire(const std::string& path, TextureUsage usage, GLint magFilter, GLint minFilter) {
+	auto key = canonicalPath(path);
+	auto& entry = byPath[key];
+	if (auto texture = entry.texture.lock()) {
+		return texture;
+	}
+
+	if (hashContents) {
+		MappedFile file;
+		if (file.open(key.c_str())) {
+			entry.contentHash = hashFnv1a(file.data(), file.size());
+			if (auto texture = byContent[entry.contentHash].lock()) {
+				debug("Sharing identical texture for {}", key.c_str());
+				entry.texture = texture;
+				return texture;
+			}
+		}
+	}
+
+	debug("Loading: {}", key.c_str());
+	auto texture = streamer.request(key, usage, magFilter, minFilter);
+	entry.texture = texture;
+	if (hashContents && entry.contentHash != 0) {
+		byContent[entry.contentHash] = texture;
+	}
+	return texture;
+}
+
+void TextureRegistry::collect() {
+	for (auto it = byPath.begin(); it != byPath.end();) {
+		it = it->second.texture.expired() ? byPath.erase(it) : std::next(it);
+	}
+	for (auto it = byContent.begin(); it != byContent.end();) {
+		it = it->second.expired() ? byContent.erase(it) : std::next(it);
+	}
+}
+
+void TextureRegistry::printReport() const {
+	std::vector<std::pair<size_t, const std::string*>> sizes;
+	size_t total = 0;
+	size_t shared = 0;
+	std::unordered_set<const StreamedTexture*> counted;
+	for (auto& entry : byPath) {
+		auto texture = entry.second.texture.lock();
+		if (!texture) {
+			continue;
+		}
+		// Entries sharing a texture by content are only counted once
+		if (!counted.insert(texture.get()).second) {
+			shared++;
+			continue;
+		}
+		auto size = textureMemory(*texture);
+		sizes.emplace_back(size, &entry.first);
+		total += size;
+	}
+	std::sort(sizes.begin(), sizes.end(), [](auto& a, auto& b) { return a.first > b.first; });
+
+	debug("Texture memory report:");
+	for (auto& size : sizes) {
+		debug("  {:10.2f} KiB  {}", size.first / 1024.0f, size.second->c_str());
+	}
+	debug("  {} textures, {:.2f} MiB total, {} shared by content", sizes.size(), total / (1024.0f * 1024.0f), shared);
+	auto& arrays = streamer.textureArrays();
+	debug("  {} texture arrays, {:.2f} MiB allocated", arrays.arrayCount(), arrays.memory() / (1024.0f * 1024.0f));
+	debug("");
+}
+
+size_t textureMemory(const StreamedTexture& texture) {
+	return texture.resident ? texture.array->layerMemory() : 0;
+}
@@ -0,0 +1,68 @@
+//===----------------------------------------------------------------------===//
+//
+// This file is part of the Noxoscope project
+//
+// Copyright (c) 2016 Niklas Helmertz
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef TextureRegistry_H
+#define TextureRegistry_H
+
+#include <string>
+#include <memory>
+#include <cstdint>
+#include <unordered_map>
+
+#include <GL/glew.h>
+
+#include "GLObject.h"
+#include "TextureStreamer.h"
+
+/// \brief Shared textures, looked up by file.
+///
+/// Textures are keyed by their canonical path, so the same file reached
+/// through different relative paths is only loaded once. Optionally, files
+/// are also keyed by a hash of their contents, to share copies of the same
+/// image stored under different names. This reads every texture file once on
+/// the calling thread, so it is disabled by default.
+///
+/// The registry only holds weak references. A texture is deleted when the
+/// last mesh using it is, and is loaded again if acquired after that.
+class TextureRegistry {
+public:
+	explicit TextureRegistry(TextureStreamer& streamer, bool hashContents = false);
+
+	TextureRegistry(TextureRegistry const&) = delete;
+	void operator=(TextureRegistry const&) = delete;
+
+	/// Returns the texture for the image file at path, starting to load it
+	/// through the streamer unless it is already in use.
+	///
+	/// The filters only take effect when the texture is first loaded.
+	std::shared_ptr<StreamedTexture> acquire(const std::string& path, TextureUsage usage, GLint magFilter, GLint minFilter);
+
+	/// Removes entries whose textures have been deleted.
+	void collect();
+
+	/// Logs the texel memory of every live texture, largest first, and the
+	/// memory of the texture arrays holding them.
+	void printReport() const;
+
+private:
+	struct Entry {
+		std::weak_ptr<StreamedTexture> texture;
+		uint64_t contentHash = 0;
+	};
+
+	TextureStreamer& streamer;
+	bool hashContents;
+	std::unordered_map<std::string, Entry> byPath;
+	std::unordered_map<uint64_t, std::weak_ptr<StreamedTexture>> byContent;
+};
+
+/// Returns the GL memory used by all levels of a texture, which is the size
+/// of its layer once it is resident.
+size_t textureMemory(const StreamedTexture& texture);
+
+#endif // TextureRegistry_H
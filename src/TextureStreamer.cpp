@@ -0,0 +1,348 @@
+//===----------------------------------------------------------------------===//
+//
+// This file is part of the Noxoscope project
+//
+// Copyright (c) 2016 Niklas Helmertz
+//
+//===----------------------------------------------------------------------===//
+
+#include "TextureStreamer.h"
+
+#include <vector>
+#include <cstring>
+#include <algorithm>
+
+#include <stb_image.h>
+
+#include "Logging.h"
+#include "FileTools.h"
+#include "TextureCache.h"
+
+struct TextureStreamer::Job {
+	std::string path;
+	std::weak_ptr<StreamedTexture> texture;
+	TextureUsage usage;
+	GLint magFilter;
+	GLint minFilter;
+	bool compress;
+	CompressedTexture compressed;
+	/// Uncompressed RGBA levels, used when compress is not set.
+	std::vector<unsigned char> rgba;
+	std::vector<TextureLevel> rgbaLevels;
+	bool failed = false;
+
+	size_t uploadSize() const {
+		return compress ? compressed.byteSize() : rgba.size();
+	}
+};
+
+/// Decoded jobs handed from the workers to the GL thread. Shared with the
+/// worker tasks, since those may outlive the streamer.
+struct TextureStreamer::SharedQueue {
+	std::mutex mutex;
+	std::deque<std::shared_ptr<Job>> jobs;
+};
+
+// Neutral texels shown while loading: plain material color, the default
+// specular intensity and an unperturbed tangent space normal
+static const unsigned char PLACEHOLDER_TEXELS[][4] = {
+	{255, 255, 255, 255},
+	{51, 51, 51, 255},
+	{128, 128, 255, 255},
+};
+
+// Staged images start at multiples of this
+static const size_t STAGING_ALIGNMENT = 16;
+
+// Waiting for a region fence should never take close to this long, since the
+// region was last used several frames ago
+static const GLuint64 FENCE_TIMEOUT_NS = 1000000000;
+
+void ImageDeleter::operator()(unsigned char* pixels) const {
+	stbi_image_free(pixels);
+}
+
+bool decodeTexture(const std::string& path, TextureImage* image) {
+	int w, h, n;
+	auto data = stbi_load(path.c_str(), &w, &h, &n, 0);
+	if (data == nullptr) {
+		errorLog("Failed loading texture {}", path.c_str());
+		return false;
+	}
+
+	// The flip is done here rather than through stbi_set_flip_vertically_on_load,
+	// which sets global state that is unsafe to use from several threads
+	size_t rowSize = size_t(w) * n;
+	std::vector<unsigned char> row(rowSize);
+	for (int y = 0; y < h / 2; y++) {
+		auto top = data + y * rowSize;
+		auto bottom = data + (h - 1 - y) * rowSize;
+		std::copy(top, top + rowSize, row.begin());
+		std::copy(bottom, bottom + rowSize, top);
+		std::copy(row.begin(), row.end(), bottom);
+	}
+
+	image->width = w;
+	image->height = h;
+	image->channels = n;
+	image->pixels.reset(data);
+	return true;
+}
+
+/// Converts an image with any number of channels to RGBA.
+static std::vector<unsigned char> toRgba(const TextureImage& image) {
+	size_t texelCount = size_t(image.width) * image.height;
+	std::vector<unsigned char> rgba(texelCount * 4);
+	auto src = image.pixels.get();
+	int n = image.channels;
+	for (size_t i = 0; i < texelCount; i++) {
+		auto texel = src + i * n;
+		auto dst = &rgba[i * 4];
+		bool luminance = n < 3;
+		dst[0] = texel[0];
+		dst[1] = luminance ? texel[0] : texel[1];
+		dst[2] = luminance ? texel[0] : texel[2];
+		dst[3] = n == 2 ? texel[1] : n == 4 ? texel[3] : 255;
+	}
+	return rgba;
+}
+
+/// Resizes an image to the next power of two in each direction, so that it
+/// shares texture arrays with more images.
+static void resizeToPowerOfTwo(std::vector<unsigned char>* rgba, int* width, int* height) {
+	int newWidth = nextPowerOfTwo(*width);
+	int newHeight = nextPowerOfTwo(*height);
+	if (newWidth != *width || newHeight != *height) {
+		*rgba = resizeRgba(rgba->data(), *width, *height, newWidth, newHeight);
+		*width = newWidth;
+		*height = newHeight;
+	}
+}
+
+/// Loads the image of job from the compressed texture cache, or by decoding
+/// and, if enabled, compressing it.
+bool TextureStreamer::loadImage(Job& job) {
+	bool normalMap = job.usage == TextureUsage::Normal;
+	if (!job.compress) {
+		TextureImage image;
+		if (!decodeTexture(job.path, &image)) {
+			return false;
+		}
+		auto level = toRgba(image);
+		int width = image.width;
+		int height = image.height;
+		resizeToPowerOfTwo(&level, &width, &height);
+		while (true) {
+			job.rgbaLevels.push_back({width, height, job.rgba.size(), level.size()});
+			job.rgba.insert(job.rgba.end(), level.begin(), level.end());
+			if (width == 1 && height == 1) {
+				break;
+			}
+			level = downsampleRgba(level, width, height, normalMap);
+			width = std::max(1, width / 2);
+			height = std::max(1, height / 2);
+		}
+		return true;
+	}
+
+	TextureCacheKey cacheKey{job.path, {}, normalMap};
+	bool cacheable = getFileInfo(job.path.c_str(), &cacheKey.sourceInfo);
+	if (cacheable && readTextureCache(cacheKey, &job.compressed)) {
+		return true;
+	}
+
+	TextureImage image;
+	if (!decodeTexture(job.path, &image)) {
+		return false;
+	}
+	auto rgba = toRgba(image);
+	int width = image.width;
+	int height = image.height;
+	resizeToPowerOfTwo(&rgba, &width, &height);
+	auto format = chooseBlockFormat(rgba.data(), width, height, normalMap);
+	compressTexture(rgba.data(), width, height, format, &job.compressed);
+	if (cacheable) {
+		writeTextureCache(cacheKey, job.compressed);
+	}
+	return true;
+}
+
+TextureStreamer::TextureStreamer(ThreadPool& pool, size_t uploadBudget, bool compressTextures)
+	: pool(pool),
+	  decoded(std::make_shared<SharedQueue>()),
+	  uploadBudget(uploadBudget),
+	  compressTextures(compressTextures) {}
+
+TextureStreamer::~TextureStreamer() {
+	for (auto& fence : regionFences) {
+		if (fence != nullptr) {
+			glDeleteSync(fence);
+		}
+	}
+	if (persistentMapping != nullptr) {
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, stagingBuffer.handle);
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	}
+}
+
+std::shared_ptr<StreamedTexture> TextureStreamer::request(const std::string& path, TextureUsage usage, GLint magFilter, GLint minFilter) {
+	if (maxAnisotropy == 0.0f && GLEW_EXT_texture_filter_anisotropic) {
+		glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &maxAnisotropy);
+	}
+	if (!placeholders) {
+		createPlaceholders();
+	}
+
+	auto texture = std::make_shared<StreamedTexture>(placeholders, static_cast<GLint>(usage));
+
+	auto job = std::make_shared<Job>();
+	job->path = path;
+	job->texture = texture;
+	job->usage = usage;
+	job->magFilter = magFilter;
+	job->minFilter = minFilter;
+	job->compress = compressTextures && GLEW_EXT_texture_compression_s3tc && (GLEW_VERSION_3_0 || GLEW_ARB_texture_compression_rgtc);
+	pending++;
+
+	auto queue = decoded;
+	pool.enqueue([job, queue] {
+		job->failed = !loadImage(*job);
+		std::lock_guard<std::mutex> lock(queue->mutex);
+		queue->jobs.push_back(job);
+	});
+	return texture;
+}
+
+void TextureStreamer::update() {
+	{
+		std::lock_guard<std::mutex> lock(decoded->mutex);
+		for (auto& job : decoded->jobs) {
+			ready.push_back(std::move(job));
+		}
+		decoded->jobs.clear();
+	}
+	if (ready.empty()) {
+		return;
+	}
+
+	if (stagingBuffer.handle == 0) {
+		createStagingBuffer();
+	}
+
+	auto& fence = regionFences[currentRegion];
+	if (fence != nullptr) {
+		glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_TIMEOUT_NS);
+		glDeleteSync(fence);
+		fence = nullptr;
+	}
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, stagingBuffer.handle);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	GLintptr regionStart = currentRegion * uploadBudget;
+	size_t staged = 0;
+	bool uploadedDirectly = false;
+	while (!ready.empty() && !uploadedDirectly) {
+		auto& job = *ready.front();
+		auto size = job.uploadSize();
+		if (!job.failed && !job.texture.expired()) {
+			if (size > uploadBudget) {
+				// Too large for a staging region, so upload it on its own
+				if (staged > 0) {
+					break;
+				}
+				glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+				upload(job, -1);
+				glBindBuffer(GL_PIXEL_UNPACK_BUFFER, stagingBuffer.handle);
+				uploadedDirectly = true;
+			} else {
+				if (staged + size > uploadBudget) {
+					break;
+				}
+				upload(job, regionStart + static_cast<GLintptr>(staged));
+				staged += (size + STAGING_ALIGNMENT - 1) & ~(STAGING_ALIGNMENT - 1);
+			}
+		}
+		ready.pop_front();
+		pending--;
+	}
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	if (staged > 0) {
+		fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		currentRegion = (currentRegion + 1) % STAGING_REGIONS;
+	}
+}
+
+void TextureStreamer::createPlaceholders() {
+	placeholders = std::make_shared<TextureArray>(TextureArrayFormat{GL_RGBA8, 1, 1, 1, GL_NEAREST, GL_NEAREST}, 0.0f);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, placeholders->handle());
+	for (auto& texel : PLACEHOLDER_TEXELS) {
+		GLint layer = placeholders->acquireLayer();
+		glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, 1, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, texel);
+	}
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+
+void TextureStreamer::createStagingBuffer() {
+	auto size = STAGING_REGIONS * uploadBudget;
+	stagingBuffer.gen();
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, stagingBuffer.handle);
+	if (GLEW_ARB_buffer_storage) {
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_PIXEL_UNPACK_BUFFER, size, nullptr, flags);
+		persistentMapping = static_cast<unsigned char*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, flags));
+	} else {
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+	}
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	debug("Texture staging buffer: {} MiB{}", size / (1024 * 1024), persistentMapping ? ", persistently mapped" : "");
+}
+
+/// Uploads the image of job from the staging buffer at stagingOffset, or
+/// directly from memory if stagingOffset is negative.
+void TextureStreamer::upload(Job& job, GLintptr stagingOffset) {
+	auto& compressed = job.compressed;
+	auto& levels = job.compress ? compressed.levels : job.rgbaLevels;
+	auto source = job.compress ? compressed.data : job.rgba.data();
+	if (stagingOffset >= 0) {
+		auto size = job.uploadSize();
+		if (persistentMapping != nullptr) {
+			std::memcpy(persistentMapping + stagingOffset, source, size);
+		} else {
+			// The region fence has already been waited for, so no synchronization is needed
+			auto mapping = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, stagingOffset, size,
+				GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+			std::memcpy(mapping, source, size);
+			glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		}
+		source = reinterpret_cast<const unsigned char*>(stagingOffset);
+	}
+
+	TextureArrayFormat format;
+	format.internalFormat = job.compress ? glCompressedFormat(compressed.format) : GL_RGBA8;
+	format.width = levels[0].width;
+	format.height = levels[0].height;
+	format.levels = static_cast<int>(levels.size());
+	format.magFilter = job.magFilter;
+	format.minFilter = job.minFilter;
+
+	auto texture = job.texture.lock();
+	arrays.place(texture.get(), format, maxAnisotropy);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, texture->array->handle());
+	// The complete mip chain is precomputed
+	for (size_t i = 0; i < levels.size(); i++) {
+		auto& level = levels[i];
+		if (job.compress) {
+			glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, static_cast<GLint>(i), 0, 0, texture->layer, level.width, level.height, 1,
+				format.internalFormat, static_cast<GLsizei>(level.size), source + level.offset);
+		} else {
+			glTexSubImage3D(GL_TEXTURE_2D_ARRAY, static_cast<GLint>(i), 0, 0, texture->layer, level.width, level.height, 1,
+				GL_RGBA, GL_UNSIGNED_BYTE, source + level.offset);
+		}
+	}
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
@@ -0,0 +1,130 @@
+//===----------------------------------------------------------------------===//
+//
+// This file is part of the Noxoscope project
+//
+// Copyright (c) 2016 Niklas Helmertz
+//
+//===----------------------------------------------------------------------===//
+//
+// Asynchronous texture loading. Images are decoded on worker threads and
+// uploaded on the GL thread through a pixel unpack buffer.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef TextureStreamer_H
+#define TextureStreamer_H
+
+#include <string>
+#include <memory>
+#include <deque>
+#include <mutex>
+
+#include <GL/glew.h>
+
+#include "GLObject.h"
+#include "ThreadPool.h"
+#include "TextureCompression.h"
+#include "TextureArrays.h"
+
+/// Frees pixel data allocated by stb_image.
+struct ImageDeleter {
+	void operator()(unsigned char* pixels) const;
+};
+
+/// Decoded texture image, with rows ordered bottom to top as GL expects.
+struct TextureImage {
+	int width = 0;
+	int height = 0;
+	int channels = 0;
+	std::unique_ptr<unsigned char, ImageDeleter> pixels;
+
+	size_t byteSize() const {
+		return size_t(width) * height * channels;
+	}
+};
+
+/// Decodes an image file without touching any GL state. Safe to call from any thread.
+bool decodeTexture(const std::string& path, TextureImage* image);
+
+/// Determines the placeholder shown until a streamed texture is resident.
+enum class TextureUsage {
+	Diffuse,
+	Specular,
+	Normal
+};
+
+/// \brief Loads textures in the background while rendering continues.
+///
+/// A requested texture is immediately usable, and refers to a neutral 1x1
+/// placeholder for its usage until the real image has been decoded on the
+/// thread pool and uploaded by update(). The upload moves the texture into a
+/// layer of a texture array of matching size and format, see TextureArrays.h,
+/// so users read the array and layer of the texture whenever they bind it.
+/// Images with sides that are not powers of two are resized on import, so
+/// that most textures fall into a few array formats.
+///
+/// When the GL implementation supports BC1, BC3 and BC5, images are block
+/// compressed with a precomputed mip chain, and the result is kept in the
+/// texture cache. Later runs load the compressed cache entry directly, without
+/// decoding the source image.
+///
+/// Uploads are staged through a pixel unpack buffer split into one region per
+/// frame in flight, each guarded by a fence. The buffer is persistently mapped
+/// when ARB_buffer_storage is available, and mapped per upload otherwise.
+class TextureStreamer {
+public:
+	/// \param uploadBudget Maximum number of bytes uploaded by each update().
+	/// Images larger than this are uploaded on their own, directly from memory.
+	///
+	/// \param compressTextures Whether to use block compression when supported.
+	explicit TextureStreamer(ThreadPool& pool, size_t uploadBudget = 16 * 1024 * 1024, bool compressTextures = true);
+	~TextureStreamer();
+
+	TextureStreamer(TextureStreamer const&) = delete;
+	void operator=(TextureStreamer const&) = delete;
+
+	/// Starts loading the image at path, returning the texture it ends up in.
+	std::shared_ptr<StreamedTexture> request(const std::string& path, TextureUsage usage, GLint magFilter, GLint minFilter);
+
+	/// Uploads decoded images within the budget. Call once per frame on the GL thread.
+	void update();
+
+	/// Number of requested textures that are not yet resident.
+	size_t pendingCount() const {
+		return pending;
+	}
+
+	const TextureArrays& textureArrays() const {
+		return arrays;
+	}
+
+private:
+	struct Job;
+	struct SharedQueue;
+
+	static bool loadImage(Job& job);
+	void createStagingBuffer();
+	void createPlaceholders();
+	void upload(Job& job, GLintptr stagingOffset);
+
+	static const int STAGING_REGIONS = 3;
+
+	ThreadPool& pool;
+	std::shared_ptr<SharedQueue> decoded;
+	std::deque<std::shared_ptr<Job>> ready;
+	size_t pending = 0;
+	size_t uploadBudget;
+	bool compressTextures;
+	float maxAnisotropy = 0.0f;
+
+	TextureArrays arrays;
+	/// Array of 1x1 placeholders, with one layer per TextureUsage.
+	std::shared_ptr<TextureArray> placeholders;
+
+	GLBuffer stagingBuffer;
+	unsigned char* persistentMapping = nullptr;
+	GLsync regionFences[STAGING_REGIONS] = {};
+	int currentRegion = 0;
+};
+
+#endif // TextureStreamer_H
@@ -0,0 +1,49 @@
+//===----------------------------------------------------------------------===//
+//
+// This file is part of the Noxoscope project
+//
+// Copyright (c) 2016 Niklas Helmertz
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef ThreadPool_H
+#define ThreadPool_H
+
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <functional>
+#include <condition_variable>
+
+/// \brief Fixed set of worker threads running queued tasks in FIFO order.
+///
+/// Tasks must not touch GL state, since the workers have no GL context.
+/// Tasks still queued when the pool is destroyed are discarded, while
+/// running tasks are waited for.
+class ThreadPool {
+public:
+	/// Creates a pool with threadCount workers, or one per hardware thread if 0.
+	explicit ThreadPool(unsigned threadCount = 0);
+	~ThreadPool();
+
+	ThreadPool(ThreadPool const&) = delete;
+	void operator=(ThreadPool const&) = delete;
+
+	void enqueue(std::function<void()> task);
+
+	unsigned threadCount() const {
+		return static_cast<unsigned>(workers.size());
+	}
+
+private:
+	void workerLoop();
+
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()>> tasks;
+	std::mutex mutex;
+	std::condition_variable taskAvailable;
+	bool stopping = false;
+};
+
+#endif // ThreadPool_H
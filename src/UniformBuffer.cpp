@@ -0,0 +1,23 @@
+//===----------------------------------------------------------------------===//
+//
+// This file is part of the Noxoscope project
+//
+// Copyright (c) 2016 Niklas Helmertz
+//
+//===----------------------------------------------------------------------===//
+
+#include "UniformBuffer.h"
+
+void UniformBuffer::create(GLuint binding, size_t size) {
+	buffer.regen();
+	glBindBuffer(GL_UNIFORM_BUFFER, buffer.handle);
+	glBufferData(GL_UNIFORM_BUFFER, size, nullptr, GL_DYNAMIC_DRAW);
+	glBindBufferBase(GL_UNIFORM_BUFFER, binding, buffer.handle);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void UniformBuffer::update(const void* data, size_t size) {
+	glBindBuffer(GL_UNIFORM_BUFFER, buffer.handle);
+	glBufferData(GL_UNIFORM_BUFFER, size, data, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
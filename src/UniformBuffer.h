@@ -0,0 +1,99 @@
+//===----------------------------------------------------------------------===//
+//
+// This file is part of the Noxoscope project
+//
+// Copyright (c) 2016 Niklas Helmertz
+//
+//===----------------------------------------------------------------------===//
+//
+// Uniform blocks shared by all shader programs. Each block is backed by one
+// buffer bound to a fixed binding point, and every program has its blocks
+// pointed at those binding points when it is linked, so the buffers are
+// set up once and survive shader reloads.
+//
+// The structs here mirror the std140 layout of the blocks declared in the
+// shaders, and have to be kept in sync with them.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef UniformBuffer_H
+#define UniformBuffer_H
+
+#include <cstddef>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "GLObject.h"
+
+constexpr GLuint FRAME_UNIFORMS_BINDING = 0;
+constexpr GLuint STATIC_UNIFORMS_BINDING = 1;
+constexpr GLuint LIGHT_BATCH_BINDING = 2;
+
+constexpr size_t SSAO_KERNEL_SIZE = 64;
+
+/// Most lights shaded by one batched lighting pass.
+constexpr size_t LIGHT_BATCH_MAX_SIZE = 64;
+
+/// Camera and render state, updated once per frame.
+struct FrameUniforms {
+	glm::mat4 viewMatrix;
+	glm::mat4 projMatrix;
+	glm::mat4 invProj;
+	/// Size in pixels of the internal render targets, which every pass but
+	/// SSAO and SSR renders at.
+	glm::vec2 screenSize;
+	float nearPlane;
+	float farPlane;
+};
+
+static_assert(sizeof(FrameUniforms) == 208, "FrameUniforms does not match the std140 layout");
+
+/// Constants that only change when the render buffers are rebuilt.
+struct StaticUniforms {
+	// Arrays of vec3 have a 16 byte stride in std140
+	glm::vec4 ssaoKernel[SSAO_KERNEL_SIZE];
+};
+
+static_assert(sizeof(StaticUniforms) == 16 * SSAO_KERNEL_SIZE, "StaticUniforms does not match the std140 layout");
+
+/// The lights of one batched lighting pass, see LightBatches.h.
+struct LightBatchUniforms {
+	GLint lightCount;
+	GLint padding[3];
+	/// View space position and radius, then color and linear attenuation.
+	glm::vec4 lights[2 * LIGHT_BATCH_MAX_SIZE];
+};
+
+static_assert(sizeof(LightBatchUniforms) == 16 + 32 * LIGHT_BATCH_MAX_SIZE, "LightBatchUniforms does not match the std140 layout");
+
+struct UniformBlockBinding {
+	const char* name;
+	GLuint binding;
+};
+
+/// Block names as declared in the shaders.
+constexpr UniformBlockBinding UNIFORM_BLOCK_BINDINGS[] = {
+	{"FrameUniforms", FRAME_UNIFORMS_BINDING},
+	{"StaticUniforms", STATIC_UNIFORMS_BINDING},
+	{"LightBatch", LIGHT_BATCH_BINDING}
+};
+
+/// \brief Uniform buffer object attached to a fixed binding point.
+class UniformBuffer {
+public:
+	void create(GLuint binding, size_t size);
+
+	/// Replaces the contents of the buffer. The old storage is orphaned, so
+	/// this does not wait for draws still reading it.
+	void update(const void* data, size_t size);
+
+	template <typename T>
+	void update(const T& data) {
+		update(&data, sizeof(T));
+	}
+private:
+	GLBuffer buffer;
+};
+
+#endif // UniformBuffer_H
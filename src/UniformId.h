@@ -0,0 +1,104 @@
+//===----------------------------------------------------------------------===//
+//
+// This file is part of the Noxoscope project
+//
+// Copyright (c) 2016 Niklas Helmertz
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef UniformId_H
+#define UniformId_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include <GL/glew.h>
+
+#include "Hash.h"
+
+/// \brief Name of a shader uniform together with its hash.
+///
+/// Declaring an id as constexpr hashes the name at compile time, so looking
+/// it up in a ShaderProgram costs no string operations.
+struct UniformId {
+	constexpr UniformId(const char* name) : name(name), hash(hashString(name)) {}
+
+	const char* name;
+	uint64_t hash;
+};
+
+/// \brief Uniform locations of a shader program, keyed by name hash.
+///
+/// An open addressing table with linear probing, kept at most half full, so
+/// a lookup is usually a single array access.
+class UniformTable {
+public:
+	UniformTable() : slots(1) {}
+
+	/// Removes all entries, reserving room for uniformCount uniforms.
+	void reset(size_t uniformCount) {
+		size_t capacity = 1;
+		while (capacity < uniformCount * 2) {
+			capacity *= 2;
+		}
+		slots.assign(capacity, Slot());
+		count = 0;
+	}
+
+	/// Adds a uniform, returning false if its hash is already taken.
+	bool insert(UniformId uniform, GLint location) {
+		if ((count + 1) * 2 > slots.size()) {
+			grow();
+		}
+		auto& slot = slots[find(uniform.hash)];
+		if (slot.hash == uniform.hash) {
+			return false;
+		}
+		slot.hash = uniform.hash;
+		slot.location = location;
+		count++;
+		return true;
+	}
+
+	/// Location of a uniform, or -1 if it is not in the table.
+	GLint operator[](UniformId uniform) const {
+		auto& slot = slots[find(uniform.hash)];
+		return slot.hash == uniform.hash ? slot.location : -1;
+	}
+
+	size_t size() const {
+		return count;
+	}
+private:
+	// A zero hash marks an empty slot
+	struct Slot {
+		uint64_t hash = 0;
+		GLint location = -1;
+	};
+
+	// Index of the slot holding hash, or of the empty slot ending its probe
+	size_t find(uint64_t hash) const {
+		size_t mask = slots.size() - 1;
+		size_t i = static_cast<size_t>(hash) & mask;
+		while (slots[i].hash != hash && slots[i].hash != 0) {
+			i = (i + 1) & mask;
+		}
+		return i;
+	}
+
+	void grow() {
+		std::vector<Slot> old(slots.size() * 2);
+		old.swap(slots);
+		for (auto& slot : old) {
+			if (slot.hash != 0) {
+				slots[find(slot.hash)] = slot;
+			}
+		}
+	}
+
+	std::vector<Slot> slots;
+	size_t count = 0;
+};
+
+#endif // UniformId_H
@@ -0,0 +1,111 @@
+//===----------------------------------------------------------------------===//
+//
+// This file is part of the Noxoscope project
+//
+// Copyright (c) 2016 Niklas Helmertz
+//
+//===----------------------------------------------------------------------===//
+
+#include "VertexPacking.h"
+
+#include <cfloat>
+
+#include <glm/gtc/packing.hpp>
+
+PositionQuantization positionQuantization(const Vertex* vertices, size_t vertexCount) {
+	using namespace glm;
+	vec3 low(FLT_MAX);
+	vec3 high(-FLT_MAX);
+	for (size_t i = 0; i < vertexCount; i++) {
+		low = min(low, vertices[i].position);
+		high = max(high, vertices[i].position);
+	}
+	if (vertexCount == 0) {
+		low = high = vec3(0.0f);
+	}
+
+	PositionQuantization quantization;
+	quantization.offset = low;
+	// Flat meshes still need a nonzero scale to be invertible
+	quantization.scale = max(high - low, vec3(FLT_MIN));
+	return quantization;
+}
+
+static glm::vec2 signNotZero(glm::vec2 v) {
+	return glm::vec2(v.x >= 0.0f ? 1.0f : -1.0f, v.y >= 0.0f ? 1.0f : -1.0f);
+}
+
+glm::vec2 octahedralEncode(glm::vec3 v) {
+	using namespace glm;
+	float l1Norm = abs(v.x) + abs(v.y) + abs(v.z);
+	if (l1Norm == 0.0f) {
+		return vec2(0.0f);
+	}
+	v /= l1Norm;
+	vec2 e(v.x, v.y);
+	if (v.z < 0.0f) {
+		e = (1.0f - abs(vec2(v.y, v.x))) * signNotZero(e);
+	}
+	return e;
+}
+
+glm::vec3 octahedralDecode(glm::vec2 e) {
+	using namespace glm;
+	vec3 v(e.x, e.y, 1.0f - abs(e.x) - abs(e.y));
+	if (v.z < 0.0f) {
+		vec2 xy = (1.0f - abs(vec2(v.y, v.x))) * signNotZero(vec2(v.x, v.y));
+		v.x = xy.x;
+		v.y = xy.y;
+	}
+	return normalize(v);
+}
+
+PackedVertex packVertex(const Vertex& vertex, const PositionQuantization& quantization) {
+	using namespace glm;
+	PackedVertex packed;
+
+	vec3 position = (vertex.position - quantization.offset) / quantization.scale;
+	for (int i = 0; i < 3; i++) {
+		packed.position[i] = packUnorm1x16(position[i]);
+	}
+	float bitangentSign = dot(cross(vertex.normal, vertex.tangent), vertex.bitangent) < 0.0f ? 0.0f : 1.0f;
+	packed.position[3] = packUnorm1x16(bitangentSign);
+
+	vec2 normal = octahedralEncode(vertex.normal);
+	vec2 tangent = octahedralEncode(vertex.tangent);
+	for (int i = 0; i < 2; i++) {
+		packed.normal[i] = static_cast<int16_t>(packSnorm1x16(normal[i]));
+		packed.tangent[i] = static_cast<int16_t>(packSnorm1x16(tangent[i]));
+		packed.texCoords[i] = packHalf1x16(vertex.texCoords[i]);
+	}
+	return packed;
+}
+
+Vertex unpackVertex(const PackedVertex& packed, const PositionQuantization& quantization) {
+	using namespace glm;
+	Vertex vertex;
+
+	vec3 position;
+	for (int i = 0; i < 3; i++) {
+		position[i] = unpackUnorm1x16(packed.position[i]);
+	}
+	vertex.position = position * quantization.scale + quantization.offset;
+
+	vec2 normal;
+	vec2 tangent;
+	for (int i = 0; i < 2; i++) {
+		normal[i] = unpackSnorm1x16(static_cast<uint16_t>(packed.normal[i]));
+		tangent[i] = unpackSnorm1x16(static_cast<uint16_t>(packed.tangent[i]));
+		vertex.texCoords[i] = unpackHalf1x16(packed.texCoords[i]);
+	}
+	vertex.normal = octahedralDecode(normal);
+	vertex.tangent = octahedralDecode(tangent);
+
+	float bitangentSign = packed.position[3] > 0x7fff ? 1.0f : -1.0f;
+	vertex.bitangent = bitangentSign * cross(vertex.normal, vertex.tangent);
+	float bitangentLength = length(vertex.bitangent);
+	if (bitangentLength > 0.0f) {
+		vertex.bitangent /= bitangentLength;
+	}
+	return vertex;
+}
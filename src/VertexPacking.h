@@ -0,0 +1,56 @@
+//===----------------------------------------------------------------------===//
+//
+// This file is part of the Noxoscope project
+//
+// Copyright (c) 2016 Niklas Helmertz
+//
+//===----------------------------------------------------------------------===//
+//
+// Compact vertex format, using 20 bytes per vertex instead of the 56 bytes
+// of Vertex. Positions are stored as 16-bit normalized integers within the
+// bounds of their mesh, normals and tangents as octahedral 16-bit vectors,
+// and texture coordinates as half floats. The bitangent is rebuilt from the
+// normal and tangent, using a sign stored in the position w component.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef VertexPacking_H
+#define VertexPacking_H
+
+#include <cstdint>
+#include <cstddef>
+
+#include <glm/glm.hpp>
+
+#include "Mesh.h"
+
+struct PackedVertex {
+	uint16_t position[4];
+	int16_t normal[2];
+	int16_t tangent[2];
+	uint16_t texCoords[2];
+};
+
+static_assert(sizeof(PackedVertex) == 20, "Unexpected padding in PackedVertex");
+
+/// Maps positions within the bounds of a mesh to [0, 1]. The shaders apply
+/// the inverse, as position * scale + offset.
+struct PositionQuantization {
+	glm::vec3 offset;
+	glm::vec3 scale;
+};
+
+PositionQuantization positionQuantization(const Vertex* vertices, size_t vertexCount);
+
+/// Encodes a unit vector as a point in [-1, 1]^2, by projecting it onto an
+/// octahedron and unfolding the lower half.
+glm::vec2 octahedralEncode(glm::vec3 v);
+
+glm::vec3 octahedralDecode(glm::vec2 e);
+
+PackedVertex packVertex(const Vertex& vertex, const PositionQuantization& quantization);
+
+/// Unpacks a vertex the way the shaders do, with a bitangent of unit length.
+Vertex unpackVertex(const PackedVertex& packed, const PositionQuantization& quantization);
+
+#endif // VertexPacking_H
@@ -0,0 +1,187 @@
+//===----------------------------------------------------------------------===//
+//
+// This file is part of the Noxoscope project
+//
+// Copyright (c) 2016 Niklas Helmertz
+//
+//===----------------------------------------------------------------------===//
+
+#include "TestShared.h"
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+#include <Bvh.h>
+
+namespace {
+struct Box {
+	glm::vec3 boxMin;
+	glm::vec3 boxMax;
+	BvhProxy proxy;
+	bool live;
+};
+}
+
+static void randomBox(Box* box) {
+	glm::vec3 center = randomPoint(100.0f);
+	glm::vec3 extent = glm::abs(randomPoint(8.0f));
+	box->boxMin = center - extent;
+	box->boxMax = center + extent;
+}
+
+// Inserts random boxes, then removes, moves and rebuilds at random
+static std::vector<Box> randomTree(Bvh* bvh) {
+	auto count = *rc::gen::inRange<size_t>(0, 120);
+	std::vector<Box> boxes(count);
+	for (size_t i = 0; i < count; i++) {
+		randomBox(&boxes[i]);
+		boxes[i].proxy = bvh->insert(static_cast<uint32_t>(i), boxes[i].boxMin, boxes[i].boxMax);
+		boxes[i].live = true;
+	}
+	for (auto& box : boxes) {
+		switch (*rc::gen::inRange(0, 4)) {
+		case 0:
+			bvh->remove(box.proxy);
+			box.live = false;
+			break;
+		case 1:
+			randomBox(&box);
+			bvh->update(box.proxy, box.boxMin, box.boxMax);
+			break;
+		}
+	}
+	if (*rc::gen::arbitrary<bool>()) {
+		bvh->rebuild();
+	}
+	RC_ASSERT(bvh->size() == static_cast<size_t>(std::count_if(boxes.begin(), boxes.end(), [](const Box& b) { return b.live; })));
+	return boxes;
+}
+
+static float planeMargin(const Frustum& frustum, glm::vec3 boxMin, glm::vec3 boxMax) {
+	glm::vec3 center = (boxMin + boxMax) * 0.5f;
+	glm::vec3 extent = (boxMax - boxMin) * 0.5f;
+	float margin = INFINITY;
+	for (auto& plane : frustum.planes) {
+		float reach = std::abs(plane.x) * extent.x + std::abs(plane.y) * extent.y + std::abs(plane.z) * extent.z;
+		margin = std::min(margin, std::abs(glm::dot(glm::vec3(plane), center) + plane.w + reach));
+	}
+	return margin;
+}
+
+TEST_CASE("Bvh frustum queries match testing every box") {
+	using namespace glm;
+	rc::prop("", []() {
+		Bvh bvh;
+		auto boxes = randomTree(&bvh);
+		auto frustum = extractFrustum(testProjection(0.2f, 100.0f) * randomView(20.0f, 50.0f));
+
+		std::vector<uint32_t> found;
+		bvh.queryFrustum(frustum, &found);
+		std::vector<uint8_t> isFound(boxes.size());
+		for (auto index : found) {
+			RC_ASSERT(index < boxes.size());
+			RC_ASSERT(boxes[index].live);
+			RC_ASSERT(!isFound[index]);
+			isFound[index] = 1;
+		}
+		for (size_t i = 0; i < boxes.size(); i++) {
+			// Rounding may differ on the planes themselves
+			if (boxes[i].live && planeMargin(frustum, boxes[i].boxMin, boxes[i].boxMax) > 1e-3f) {
+				RC_ASSERT(isFound[i] == boxInFrustum(frustum, boxes[i].boxMin, boxes[i].boxMax));
+			}
+		}
+	});
+}
+
+TEST_CASE("Bvh sphere queries match testing every box") {
+	using namespace glm;
+	rc::prop("", []() {
+		Bvh bvh;
+		auto boxes = randomTree(&bvh);
+		vec3 center = randomPoint(100.0f);
+		float radius = floatInRange(0.0f, 40.0f);
+
+		std::vector<uint32_t> found;
+		bvh.querySphere(center, radius, &found);
+		std::sort(found.begin(), found.end());
+		std::vector<uint32_t> expected;
+		for (size_t i = 0; i < boxes.size(); i++) {
+			vec3 offset = center - clamp(center, boxes[i].boxMin, boxes[i].boxMax);
+			if (boxes[i].live && dot(offset, offset) <= radius * radius) {
+				expected.push_back(static_cast<uint32_t>(i));
+			}
+		}
+		RC_ASSERT(found == expected);
+	});
+}
+
+TEST_CASE("Bvh box queries match testing every box") {
+	using namespace glm;
+	rc::prop("", []() {
+		Bvh bvh;
+		auto boxes = randomTree(&bvh);
+		Box query;
+		randomBox(&query);
+
+		std::vector<uint32_t> found;
+		bvh.queryBox(query.boxMin, query.boxMax, &found);
+		std::sort(found.begin(), found.end());
+		std::vector<uint32_t> expected;
+		for (size_t i = 0; i < boxes.size(); i++) {
+			bool overlap = all(lessThanEqual(boxes[i].boxMin, query.boxMax)) && all(lessThanEqual(query.boxMin, boxes[i].boxMax));
+			if (boxes[i].live && overlap) {
+				expected.push_back(static_cast<uint32_t>(i));
+			}
+		}
+		RC_ASSERT(found == expected);
+	});
+}
+
+TEST_CASE("Bvh raycasts find the nearest box") {
+	using namespace glm;
+	rc::prop("", []() {
+		Bvh bvh;
+		auto boxes = randomTree(&bvh);
+		vec3 origin = randomPoint(120.0f);
+		vec3 direction = normalize(randomPoint(1.0f) + vec3(0.0f, 0.0f, 1.5f));
+		float maxDistance = floatInRange(10.0f, 300.0f);
+
+		float nearest = INFINITY;
+		for (auto& box : boxes) {
+			if (!box.live) {
+				continue;
+			}
+			vec3 t0 = (box.boxMin - origin) / direction;
+			vec3 t1 = (box.boxMax - origin) / direction;
+			vec3 near = min(t0, t1);
+			vec3 far = max(t0, t1);
+			float entry = std::max({near.x, near.y, near.z, 0.0f});
+			float exit = std::min({far.x, far.y, far.z});
+			if (entry <= exit && entry <= maxDistance) {
+				nearest = std::min(nearest, entry);
+			}
+		}
+
+		uint32_t object;
+		float distance;
+		bool hit = bvh.raycast(origin, direction, maxDistance, &object, &distance);
+		RC_ASSERT(hit == (nearest != INFINITY));
+		if (hit) {
+			RC_ASSERT(std::abs(distance - nearest) < 1e-3f);
+			RC_ASSERT(boxes[object].live);
+		}
+	});
+}
+
+TEST_CASE("Bvh rebuild keeps a balanced height") {
+	Bvh bvh;
+	// Inserting along a line is the worst case for incremental insertion
+	for (uint32_t i = 0; i < 1024; i++) {
+		glm::vec3 p(static_cast<float>(i), 0.0f, 0.0f);
+		bvh.insert(i, p, p + glm::vec3(0.5f));
+	}
+	bvh.rebuild();
+	REQUIRE(bvh.size() == 1024);
+	REQUIRE(bvh.height() <= 12);
+}
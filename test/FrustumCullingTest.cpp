@@ -0,0 +1,79 @@
+//===----------------------------------------------------------------------===//
+//
+// This file is part of the Noxoscope project
+//
+// Copyright (c) 2016 Niklas Helmertz
+//
+//===----------------------------------------------------------------------===//
+
+#include "TestShared.h"
+
+#include <vector>
+#include <cmath>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <FrustumCulling.h>
+
+// Smallest distance of a box to flipping its result against any plane
+static float planeMargin(const Frustum& frustum, glm::vec3 boxMin, glm::vec3 boxMax) {
+	glm::vec3 center = (boxMin + boxMax) * 0.5f;
+	glm::vec3 extent = (boxMax - boxMin) * 0.5f;
+	float margin = INFINITY;
+	for (auto& plane : frustum.planes) {
+		float reach = std::abs(plane.x) * extent.x + std::abs(plane.y) * extent.y + std::abs(plane.z) * extent.z;
+		margin = std::min(margin, std::abs(glm::dot(glm::vec3(plane), center) + plane.w + reach));
+	}
+	return margin;
+}
+
+TEST_CASE("Batched box culling matches culling one box at a time") {
+	using namespace glm;
+	rc::prop("", []() {
+		auto frustum = extractFrustum(testProjection(0.2f, 100.0f) * randomView(20.0f, 50.0f));
+		auto count = *rc::gen::inRange<size_t>(0, 23);
+
+		CullBoxes boxes;
+		std::vector<vec3> mins;
+		std::vector<vec3> maxs;
+		for (size_t i = 0; i < count; i++) {
+			vec3 center = randomPoint(120.0f);
+			vec3 extent = abs(randomPoint(10.0f));
+			mins.push_back(center - extent);
+			maxs.push_back(center + extent);
+			boxes.push_back(mins.back(), maxs.back());
+		}
+		RC_ASSERT(boxes.size() == count);
+		RC_ASSERT(boxes.paddedSize() % CULL_BATCH_SIZE == 0);
+
+		std::vector<uint8_t> visible(boxes.paddedSize());
+		cullBoxes(frustum, boxes, visible.data());
+		for (size_t i = 0; i < count; i++) {
+			// Rounding may differ on the planes themselves
+			if (planeMargin(frustum, mins[i], maxs[i]) > 1e-3f) {
+				RC_ASSERT(visible[i] == boxInFrustum(frustum, mins[i], maxs[i]));
+			}
+		}
+	});
+}
+
+TEST_CASE("Transformed boxes enclose the transformed corners") {
+	using namespace glm;
+	rc::prop("", []() {
+		mat4 matrix = translate(mat4(1.0f), randomPoint(10.0f)) *
+			rotate(mat4(1.0f), floatInRange(0.0f, 6.0f), normalize(randomPoint(1.0f) + vec3(0.0f, 0.0f, 2.0f))) *
+			scale(mat4(1.0f), abs(randomPoint(3.0f)) + vec3(0.1f));
+		vec3 boxMin = randomPoint(5.0f);
+		vec3 boxMax = boxMin + abs(randomPoint(5.0f));
+
+		vec3 resultMin;
+		vec3 resultMax;
+		transformBox(matrix, boxMin, boxMax, &resultMin, &resultMax);
+		for (int corner = 0; corner < 8; corner++) {
+			vec3 p((corner & 1) ? boxMax.x : boxMin.x, (corner & 2) ? boxMax.y : boxMin.y, (corner & 4) ? boxMax.z : boxMin.z);
+			vec3 transformed = vec3(matrix * vec4(p, 1.0f));
+			RC_ASSERT(all(greaterThanEqual(transformed, resultMin - vec3(1e-3f))));
+			RC_ASSERT(all(lessThanEqual(transformed, resultMax + vec3(1e-3f))));
+		}
+	});
+}
@@ -0,0 +1,60 @@
+//===----------------------------------------------------------------------===//
+//
+// This file is part of the Noxoscope project
+//
+// Copyright (c) 2016 Niklas Helmertz
+//
+//===----------------------------------------------------------------------===//
+
+#include "TestShared.h"
+
+#include <vector>
+
+#include <LightBatches.h>
+#include <LightQuads.h>
+
+TEST_CASE("Every light in view is in one batch covering it") {
+	using namespace glm;
+	rc::prop("", []() {
+		float near = 0.2f;
+		float far = 100.0f;
+		mat4 projection = testProjection(near, far);
+		mat4 view = randomView(5.0f, 20.0f);
+		std::vector<PointLight> lights;
+		auto count = *rc::gen::inRange<size_t>(0, 300);
+		for (size_t i = 0; i < count; i++) {
+			lights.push_back({randomPoint(50.0f), floatInRange(0.1f, 8.0f), vec3(floatInRange(0.0f, 1.0f))});
+		}
+		size_t batchSize = *rc::gen::element<size_t>(16, 32, 64);
+
+		LightBatches batches;
+		batches.build(lights, view, projection, near, far, batchSize);
+		std::vector<int> seen(lights.size(), 0);
+		for (size_t batch = 0; batch < batches.batchCount(); batch++) {
+			auto& uniforms = batches.uniforms(batch);
+			RC_ASSERT(uniforms.lightCount > 0);
+			RC_ASSERT(static_cast<size_t>(uniforms.lightCount) <= batchSize);
+			vec4 rect = batches.rect(batch);
+			for (GLint i = 0; i < uniforms.lightCount; i++) {
+				uint32_t index = batches.lightIndex(batch, i);
+				seen[index]++;
+				auto& light = lights[index];
+				vec3 center = vec3(view * vec4(light.position, 1.0f));
+				RC_ASSERT(length(vec3(uniforms.lights[2 * i]) - center) < 1e-3f);
+				RC_ASSERT(uniforms.lights[2 * i].w == light.radius);
+				RC_ASSERT(vec3(uniforms.lights[2 * i + 1]) == light.color);
+
+				SphereBounds bounds;
+				RC_ASSERT(projectSphere(center, light.radius, projection, near, far, &bounds));
+				RC_ASSERT(rect.x <= bounds.rect.x && rect.y <= bounds.rect.y);
+				RC_ASSERT(rect.z >= bounds.rect.z && rect.w >= bounds.rect.w);
+			}
+		}
+		for (size_t i = 0; i < lights.size(); i++) {
+			SphereBounds bounds;
+			vec3 center = vec3(view * vec4(lights[i].position, 1.0f));
+			bool inView = projectSphere(center, lights[i].radius, projection, near, far, &bounds);
+			RC_ASSERT(seen[i] == (inView ? 1 : 0));
+		}
+	});
+}
@@ -0,0 +1,80 @@
+//===----------------------------------------------------------------------===//
+//
+// This file is part of the Noxoscope project
+//
+// Copyright (c) 2016 Niklas Helmertz
+//
+//===----------------------------------------------------------------------===//
+
+#include "TestShared.h"
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <LightClusters.h>
+
+TEST_CASE("Lights are assigned to the clusters of every point they reach") {
+	using namespace glm;
+	rc::prop("", []() {
+		float near = 0.2f;
+		float far = 500.0f;
+		mat4 projection = testProjection(near, far);
+		mat4 view = randomView(5.0f, 20.0f);
+
+		std::vector<PointLight> lights;
+		auto count = *rc::gen::inRange<size_t>(1, 40);
+		for (size_t i = 0; i < count; i++) {
+			lights.push_back({randomPoint(60.0f), floatInRange(0.1f, 15.0f), vec3(1.0f)});
+		}
+		LightClusters clusters;
+		clusters.setProjection(projection, near, far);
+		clusters.assign(lights, view);
+
+		auto& ranges = clusters.clusterRanges();
+		auto& indices = clusters.lightIndices();
+		for (size_t i = 0; i < lights.size(); i++) {
+			for (int sample = 0; sample < 20; sample++) {
+				// A point inside the light, found the same way as in the shading pass
+				vec3 offset = randomPoint(1.0f);
+				if (length(offset) > 1.0f) {
+					continue;
+				}
+				vec3 point = vec3(view * vec4(lights[i].position + 0.95f * lights[i].radius * offset, 1.0f));
+				vec4 clip = projection * vec4(point, 1.0f);
+				vec2 ndc = vec2(clip) / clip.w;
+				if (-point.z < near || -point.z > far || std::abs(ndc.x) > 1.0f || std::abs(ndc.y) > 1.0f) {
+					continue;
+				}
+				int x = std::min(static_cast<int>((ndc.x * 0.5f + 0.5f) * CLUSTER_COUNT_X), CLUSTER_COUNT_X - 1);
+				int y = std::min(static_cast<int>((ndc.y * 0.5f + 0.5f) * CLUSTER_COUNT_Y), CLUSTER_COUNT_Y - 1);
+				int cluster = LightClusters::clusterIndex(x, y, clusters.slice(-point.z));
+
+				auto first = indices.begin() + ranges[2 * cluster];
+				auto last = first + ranges[2 * cluster + 1];
+				RC_ASSERT(std::find(first, last, static_cast<uint32_t>(i)) != last);
+			}
+		}
+	});
+}
+
+TEST_CASE("Cluster slices follow the depth") {
+	LightClusters clusters;
+	clusters.setProjection(glm::perspective(glm::radians(70.0f), 1.0f, 0.2f, 500.0f), 0.2f, 500.0f);
+	REQUIRE(clusters.slice(0.2f) == 0);
+	REQUIRE(clusters.slice(0.01f) == 0);
+	REQUIRE(clusters.slice(499.0f) == CLUSTER_COUNT_Z - 1);
+	REQUIRE(clusters.slice(10000.0f) == CLUSTER_COUNT_Z - 1);
+	int last = 0;
+	for (float depth = 0.2f; depth < 500.0f; depth *= 1.1f) {
+		int slice = clusters.slice(depth);
+		REQUIRE(slice >= last);
+		// Depth lies within the bounds of the clusters of its slice
+		int cluster = LightClusters::clusterIndex(CLUSTER_COUNT_X / 2, CLUSTER_COUNT_Y / 2, slice);
+		REQUIRE(-depth >= clusters.clusterMin(cluster).z - 1e-3f * depth);
+		REQUIRE(-depth <= clusters.clusterMax(cluster).z + 1e-3f * depth);
+		last = slice;
+	}
+}
@@ -0,0 +1,160 @@
+//===----------------------------------------------------------------------===//
+//
+// This file is part of the Noxoscope project
+//
+// Copyright (c) 2016 Niklas Helmertz
+//
+//===----------------------------------------------------------------------===//
+
+#include "TestShared.h"
+
+#include <map>
+#include <vector>
+#include <algorithm>
+
+#include <glm/gtx/rotate_vector.hpp>
+
+#include <LightManager.h>
+#include <LightClusters.h>
+
+static PointLight randomLight() {
+	return {randomPoint(80.0f), floatInRange(0.1f, 10.0f), glm::vec3(floatInRange(0.0f, 1.0f))};
+}
+
+// Adds, removes and changes lights at random, returning the lights by id
+static std::map<LightId, PointLight> randomLights(LightManager* manager) {
+	std::map<LightId, PointLight> expected;
+	auto count = *rc::gen::inRange<size_t>(0, 150);
+	for (size_t i = 0; i < count; i++) {
+		auto light = randomLight();
+		expected[manager->add(light)] = light;
+	}
+	std::vector<LightId> ids;
+	for (auto& entry : expected) {
+		ids.push_back(entry.first);
+	}
+	for (auto id : ids) {
+		switch (*rc::gen::inRange(0, 4)) {
+		case 0:
+			manager->remove(id);
+			expected.erase(id);
+			break;
+		case 1:
+			expected[id] = randomLight();
+			manager->set(id, expected[id]);
+			break;
+		}
+	}
+	RC_ASSERT(manager->size() == expected.size());
+	for (auto& entry : expected) {
+		RC_ASSERT(manager->get(entry.first).position == entry.second.position);
+	}
+	return expected;
+}
+
+TEST_CASE("Light frustum queries match testing every light") {
+	using namespace glm;
+	rc::prop("", []() {
+		LightManager manager;
+		auto expected = randomLights(&manager);
+		auto frustum = extractFrustum(testProjection(0.2f, 100.0f) * randomView(20.0f, 30.0f));
+
+		std::vector<LightId> found;
+		manager.queryFrustum(frustum, &found);
+		std::sort(found.begin(), found.end());
+		std::vector<LightId> inside;
+		for (auto& entry : expected) {
+			if (sphereInFrustum(frustum, entry.second.position, entry.second.radius)) {
+				inside.push_back(entry.first);
+			}
+		}
+		RC_ASSERT(found == inside);
+	});
+}
+
+TEST_CASE("Light cluster queries match testing every light") {
+	using namespace glm;
+	rc::prop("", []() {
+		LightManager manager;
+		auto expected = randomLights(&manager);
+		mat4 projection = testProjection(0.2f, 100.0f);
+		mat4 view = randomView(20.0f, 30.0f);
+		LightClusters clusters;
+		clusters.setProjection(projection, 0.2f, 100.0f);
+		int cluster = *rc::gen::inRange(0, CLUSTER_COUNT);
+
+		std::vector<LightId> found;
+		manager.queryCluster(clusters, cluster, view, &found);
+		std::sort(found.begin(), found.end());
+		std::vector<LightId> inside;
+		for (auto& entry : expected) {
+			vec3 center = vec3(view * vec4(entry.second.position, 1.0f));
+			vec3 offset = center - clamp(center, clusters.clusterMin(cluster), clusters.clusterMax(cluster));
+			if (dot(offset, offset) <= entry.second.radius * entry.second.radius) {
+				inside.push_back(entry.first);
+			}
+		}
+		RC_ASSERT(found == inside);
+	});
+}
+
+TEST_CASE("Culled lights are outside, small or dim") {
+	using namespace glm;
+	rc::prop("", []() {
+		LightManager manager;
+		randomLights(&manager);
+		mat4 projection = testProjection(0.2f, 100.0f);
+		mat4 view = randomView(20.0f, 30.0f);
+		LightCullStatistics stats;
+		manager.cull(view, projection, 720, &stats);
+
+		auto frustum = extractFrustum(projection * view);
+		auto& visible = manager.visibleIndices();
+		RC_ASSERT(std::is_sorted(visible.begin(), visible.end()));
+		RC_ASSERT(visible.size() == manager.visibleLights().size());
+		RC_ASSERT(stats.visibleCount == visible.size());
+		size_t outside = 0;
+		for (size_t i = 0; i < manager.size(); i++) {
+			auto& light = manager.all()[i];
+			bool found = std::binary_search(visible.begin(), visible.end(), static_cast<uint32_t>(i));
+			if (!sphereInFrustum(frustum, light.position, light.radius)) {
+				RC_ASSERT(!found);
+				outside++;
+			}
+		}
+		RC_ASSERT(outside + stats.visibleCount + stats.smallCount + stats.dimCount == manager.size());
+		for (auto& light : manager.visibleLights()) {
+			RC_ASSERT(std::max({light.color.r, light.color.g, light.color.b}) >= LIGHT_MIN_INTENSITY);
+		}
+	});
+}
+
+TEST_CASE("Orbiting lights rotate around their axis") {
+	using namespace glm;
+	rc::prop("", []() {
+		LightManager manager;
+		vec3 center = randomPoint(10.0f);
+		float speed = floatInRange(-2.0f, 2.0f);
+		auto orbit = manager.addOrbit(center, speed);
+		std::vector<LightId> ids;
+		std::vector<vec3> positions;
+		auto count = *rc::gen::inRange<size_t>(0, 14);
+		for (size_t i = 0; i < count; i++) {
+			auto light = randomLight();
+			ids.push_back(manager.add(light));
+			positions.push_back(light.position);
+			manager.setOrbit(ids.back(), orbit);
+		}
+		// A light that does not orbit stays in place
+		auto still = randomLight();
+		auto stillId = manager.add(still);
+
+		float seconds = floatInRange(0.0f, 1.0f);
+		manager.animate(seconds);
+		for (size_t i = 0; i < count; i++) {
+			vec3 expected = center + rotateY(positions[i] - center, speed * seconds);
+			RC_ASSERT(length(manager.get(ids[i]).position - expected) < 1e-3f);
+		}
+		RC_ASSERT(manager.get(stillId).position == still.position);
+	});
+}
@@ -0,0 +1,74 @@
+//===----------------------------------------------------------------------===//
+//
+// This file is part of the Noxoscope project
+//
+// Copyright (c) 2016 Niklas Helmertz
+//
+//===----------------------------------------------------------------------===//
+
+#include "TestShared.h"
+
+#include <cmath>
+
+#include <LightQuads.h>
+
+TEST_CASE("Sphere bounds contain the sphere and touch it") {
+	using namespace glm;
+	rc::prop("", []() {
+		float near = 0.2f;
+		float far = 500.0f;
+		mat4 projection = testProjection(near, far);
+		vec3 center(floatInRange(-30.0f, 30.0f), floatInRange(-30.0f, 30.0f), floatInRange(-100.0f, 5.0f));
+		float radius = floatInRange(0.1f, 10.0f);
+
+		SphereBounds bounds;
+		bool visible = projectSphere(center, radius, projection, near, far, &bounds);
+		int inside = 0;
+		for (int sample = 0; sample < 200; sample++) {
+			vec3 direction(floatInRange(-1.0f, 1.0f), floatInRange(-1.0f, 1.0f), floatInRange(-1.0f, 1.0f));
+			if (length(direction) < 0.01f) {
+				continue;
+			}
+			vec3 point = center + radius * normalize(direction);
+			vec4 clip = projection * vec4(point, 1.0f);
+			vec3 ndc = vec3(clip) / clip.w;
+			if (-point.z < near || -point.z > far || std::abs(ndc.x) > 1.0f || std::abs(ndc.y) > 1.0f) {
+				continue;
+			}
+			inside++;
+			RC_ASSERT(visible);
+			RC_ASSERT(ndc.x >= bounds.rect.x - 1e-4f);
+			RC_ASSERT(ndc.y >= bounds.rect.y - 1e-4f);
+			RC_ASSERT(ndc.x <= bounds.rect.z + 1e-4f);
+			RC_ASSERT(ndc.y <= bounds.rect.w + 1e-4f);
+			RC_ASSERT(-point.z >= bounds.nearDepth - 1e-4f);
+			RC_ASSERT(-point.z <= bounds.farDepth + 1e-4f);
+		}
+
+		// Unclamped edges are planes through the camera tangent to the sphere
+		if (visible && -center.z - radius > near) {
+			float edges[] = {bounds.rect.x, bounds.rect.z};
+			for (float edge : edges) {
+				if (std::abs(edge) < 1.0f) {
+					vec3 normal = normalize(cross(vec3(0.0f, 1.0f, 0.0f), vec3(edge / projection[0][0], 0.0f, -1.0f)));
+					RC_ASSERT(std::abs(std::abs(dot(normal, center)) - radius) < 1e-3f * (1.0f + length(center)));
+				}
+			}
+		}
+	});
+}
+
+TEST_CASE("Spheres crossing the near plane cover the screen") {
+	using namespace glm;
+	mat4 projection = testProjection(0.2f, 500.0f);
+	SphereBounds bounds;
+	REQUIRE(projectSphere(vec3(0.0f), 2.0f, projection, 0.2f, 500.0f, &bounds));
+	REQUIRE(bounds.rect == vec4(-1.0f, -1.0f, 1.0f, 1.0f));
+	REQUIRE(bounds.nearDepth == 0.2f);
+	REQUIRE(bounds.farDepth == 2.0f);
+	// Behind the camera and past the far plane
+	REQUIRE_FALSE(projectSphere(vec3(0.0f, 0.0f, 5.0f), 2.0f, projection, 0.2f, 500.0f, &bounds));
+	REQUIRE_FALSE(projectSphere(vec3(0.0f, 0.0f, -600.0f), 2.0f, projection, 0.2f, 500.0f, &bounds));
+	// Beside the view
+	REQUIRE_FALSE(projectSphere(vec3(50.0f, 0.0f, -10.0f), 2.0f, projection, 0.2f, 500.0f, &bounds));
+}
@@ -0,0 +1,43 @@
+//===----------------------------------------------------------------------===//
+//
+// This file is part of the Noxoscope project
+//
+// Copyright (c) 2016 Niklas Helmertz
+//
+//===----------------------------------------------------------------------===//
+
+#include "TestShared.h"
+
+#include <map>
+#include <vector>
+#include <utility>
+
+#include <LightVolumes.h>
+
+TEST_CASE("Icospheres are closed and enclose the unit sphere") {
+	using namespace glm;
+	for (int subdivisions = 0; subdivisions <= 3; subdivisions++) {
+		std::vector<vec3> vertices;
+		std::vector<uint16_t> indices;
+		generateIcosphere(subdivisions, &vertices, &indices);
+		REQUIRE(indices.size() == 60u << (2 * subdivisions));
+
+		// Every directed edge appears once, and its reverse in the neighbor
+		std::map<std::pair<uint16_t, uint16_t>, int> edges;
+		for (size_t i = 0; i < indices.size(); i += 3) {
+			vec3 a = vertices[indices[i]];
+			vec3 b = vertices[indices[i + 1]];
+			vec3 c = vertices[indices[i + 2]];
+			vec3 normal = normalize(cross(b - a, c - a));
+			// Counterclockwise from the outside, and outside the unit sphere
+			REQUIRE(dot(normal, a) >= 1.0f - 1e-5f);
+			for (int k = 0; k < 3; k++) {
+				edges[std::make_pair(indices[i + k], indices[i + (k + 1) % 3])]++;
+			}
+		}
+		for (auto& edge : edges) {
+			REQUIRE(edge.second == 1);
+			REQUIRE(edges.count(std::make_pair(edge.first.second, edge.first.first)) == 1);
+		}
+	}
+}
@@ -8,6 +8,8 @@
 
 #include "TestShared.h"
 
+#include <glm/gtc/matrix_transform.hpp>
+
 #include <Logging.h>
 #include <GeometryMath.h>
 
@@ -38,3 +40,19 @@ TEST_CASE("Test converting spherical and back") {
 		}
 	});
 }
+
+TEST_CASE("Spheres are culled against the frustum they are outside of") {
+	using namespace glm;
+	rc::prop("", []() {
+		mat4 projection = perspective(radians(70.0f), 16.0f / 9.0f, 0.2f, 100.0f);
+		auto frustum = extractFrustum(projection);
+		float depth = floatInRange(1.0f, 90.0f);
+		float radius = floatInRange(0.01f, 10.0f);
+
+		RC_ASSERT(sphereInFrustum(frustum, vec3(0.0f, 0.0f, -depth), radius));
+		RC_ASSERT(!sphereInFrustum(frustum, vec3(0.0f, 0.0f, 0.2f + radius * 1.01f), radius));
+		RC_ASSERT(!sphereInFrustum(frustum, vec3(0.0f, 0.0f, -100.5f - radius), radius));
+		// Beyond the side planes, which are less than 90 degrees apart
+		RC_ASSERT(!sphereInFrustum(frustum, vec3(depth * 2.0f + radius * 2.0f, 0.0f, -depth), radius));
+	});
+}
@@ -0,0 +1,84 @@
+//===----------------------------------------------------------------------===//
+//
+// This file is part of the Noxoscope project
+//
+// Copyright (c) 2016 Niklas Helmertz
+//
+//===----------------------------------------------------------------------===//
+
+#include "TestShared.h"
+
+#include <array>
+#include <tuple>
+#include <vector>
+#include <algorithm>
+
+#include <MeshOptimizer.h>
+
+typedef std::array<std::tuple<float, float, float>, 3> Triangle;
+
+// Unindexed grid in the xz plane, with every triangle having its own vertices
+static void makeGrid(int size, std::vector<Vertex>* vertices, std::vector<GLuint>* indices) {
+	auto addVertex = [&](int x, int z) {
+		Vertex vertex = {};
+		vertex.position = glm::vec3(x, 0.0f, z);
+		vertex.normal = glm::vec3(0.0f, 1.0f, 0.0f);
+		indices->push_back(static_cast<GLuint>(vertices->size()));
+		vertices->push_back(vertex);
+	};
+	for (int z = 0; z < size; z++) {
+		for (int x = 0; x < size; x++) {
+			addVertex(x, z);
+			addVertex(x, z + 1);
+			addVertex(x + 1, z);
+			addVertex(x + 1, z);
+			addVertex(x, z + 1);
+			addVertex(x + 1, z + 1);
+		}
+	}
+}
+
+// Triangles by position, rotated to start at their smallest vertex so that
+// the winding order is kept
+static std::vector<Triangle> sortedTriangles(const std::vector<Vertex>& vertices, const std::vector<GLuint>& indices) {
+	std::vector<Triangle> triangles;
+	for (size_t t = 0; t < indices.size() / 3; t++) {
+		Triangle triangle;
+		for (int k = 0; k < 3; k++) {
+			auto& p = vertices[indices[t * 3 + k]].position;
+			triangle[k] = std::make_tuple(p.x, p.y, p.z);
+		}
+		std::rotate(triangle.begin(), std::min_element(triangle.begin(), triangle.end()), triangle.end());
+		triangles.push_back(triangle);
+	}
+	std::sort(triangles.begin(), triangles.end());
+	return triangles;
+}
+
+TEST_CASE("Mesh optimization keeps every triangle and improves vertex reuse") {
+	rc::prop("", []() {
+		int size = *rc::gen::inRange(8, 40);
+		std::vector<Vertex> vertices;
+		std::vector<GLuint> indices;
+		makeGrid(size, &vertices, &indices);
+		auto expectedTriangles = sortedTriangles(vertices, indices);
+
+		optimizeMesh(&vertices, &indices);
+
+		RC_ASSERT(vertices.size() == size_t((size + 1) * (size + 1)));
+		RC_ASSERT(sortedTriangles(vertices, indices) == expectedTriangles);
+
+		auto stats = analyzeVertexCache(indices.data(), indices.size(), vertices.size());
+		RC_ASSERT(stats.vertexCount == vertices.size());
+		RC_ASSERT(stats.acmr() < 0.85f);
+
+		// Vertices are ordered by first use
+		GLuint nextVertex = 0;
+		for (auto index : indices) {
+			RC_ASSERT(index <= nextVertex);
+			if (index == nextVertex) {
+				nextVertex++;
+			}
+		}
+	});
+}
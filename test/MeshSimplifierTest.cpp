@@ -0,0 +1,114 @@
+//===----------------------------------------------------------------------===//
+//
+// This file is part of the Noxoscope project
+//
+// Copyright (c) 2016 Niklas Helmertz
+//
+//===----------------------------------------------------------------------===//
+
+#include "TestShared.h"
+
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+#include <MeshSimplifier.h>
+
+// Indexed grid in the xz plane, facing up. Vertices right of seamColumn get
+// their own copies, with different texture coordinates, to form a seam.
+static void makeGrid(int size, int seamColumn, std::vector<Vertex>* vertices, std::vector<GLuint>* indices) {
+	auto vertexAt = [&](int x, int z, bool right) {
+		Vertex vertex = {};
+		vertex.position = glm::vec3(x, 0.0f, z);
+		vertex.normal = glm::vec3(0.0f, 1.0f, 0.0f);
+		vertex.texCoords = glm::vec2(right ? 1.0f : 0.0f, 0.0f);
+		vertices->push_back(vertex);
+	};
+	for (int z = 0; z <= size; z++) {
+		for (int x = 0; x <= size; x++) {
+			vertexAt(x, z, false);
+		}
+	}
+	for (int z = 0; z <= size; z++) {
+		vertexAt(seamColumn, z, true);
+	}
+
+	auto index = [&](int x, int z, bool right) {
+		if (right && x == seamColumn) {
+			return static_cast<GLuint>((size + 1) * (size + 1) + z);
+		}
+		return static_cast<GLuint>(z * (size + 1) + x);
+	};
+	for (int z = 0; z < size; z++) {
+		for (int x = 0; x < size; x++) {
+			bool right = x >= seamColumn;
+			indices->insert(indices->end(), {index(x, z, right), index(x, z + 1, right), index(x + 1, z, right)});
+			indices->insert(indices->end(), {index(x + 1, z, right), index(x, z + 1, right), index(x + 1, z + 1, right)});
+		}
+	}
+}
+
+TEST_CASE("Simplifying a flat grid keeps its area, borders and seams") {
+	rc::prop("", []() {
+		int size = *rc::gen::inRange(6, 30);
+		int seamColumn = *rc::gen::inRange(1, size);
+		std::vector<Vertex> vertices;
+		std::vector<GLuint> indices;
+		makeGrid(size, seamColumn, &vertices, &indices);
+
+		float error;
+		auto simplified = simplifyMesh(vertices, indices, indices.size() / 4, &error);
+
+		RC_ASSERT(simplified.size() % 3 == 0);
+		RC_ASSERT(simplified.size() < indices.size() / 2);
+		RC_ASSERT(error < 1e-4f);
+
+		float area = 0.0f;
+		for (size_t t = 0; t < simplified.size(); t += 3) {
+			RC_ASSERT(simplified[t] != simplified[t + 1] && simplified[t + 1] != simplified[t + 2] && simplified[t + 2] != simplified[t]);
+			auto& p0 = vertices[simplified[t]].position;
+			auto& p1 = vertices[simplified[t + 1]].position;
+			auto& p2 = vertices[simplified[t + 2]].position;
+			// Winding is counterclockwise seen from above, giving normals along +y
+			area += glm::cross(p1 - p0, p2 - p0).y / 2.0f;
+		}
+		RC_ASSERT(std::abs(area - size * size) < 1e-3f);
+
+		// Every seam vertex is still used on both sides
+		for (int z = 0; z <= size; z++) {
+			auto left = static_cast<GLuint>(z * (size + 1) + seamColumn);
+			auto right = static_cast<GLuint>((size + 1) * (size + 1) + z);
+			RC_ASSERT(std::count(simplified.begin(), simplified.end(), left) > 0);
+			RC_ASSERT(std::count(simplified.begin(), simplified.end(), right) > 0);
+		}
+	});
+}
+
+TEST_CASE("LODs have decreasing triangle counts and increasing errors") {
+	std::vector<Vertex> vertices;
+	std::vector<GLuint> indices;
+	// Bumpy grid, so that simplification has an error
+	makeGrid(40, 20, &vertices, &indices);
+	for (auto& vertex : vertices) {
+		vertex.position.y = std::sin(vertex.position.x * 0.3f) * std::cos(vertex.position.z * 0.2f);
+	}
+	size_t fullIndexCount = indices.size();
+
+	std::vector<MeshLod> lods;
+	generateLods(vertices, &indices, &lods);
+
+	REQUIRE(!lods.empty());
+	size_t previousCount = fullIndexCount;
+	float previousError = 0.0f;
+	size_t end = fullIndexCount;
+	for (auto& lod : lods) {
+		REQUIRE(lod.firstIndex == end);
+		REQUIRE(lod.indexCount < previousCount);
+		REQUIRE(lod.error >= previousError);
+		end += lod.indexCount;
+		previousCount = lod.indexCount;
+		previousError = lod.error;
+	}
+	REQUIRE(end == indices.size());
+	REQUIRE(lods.back().error > 0.0f);
+}
@@ -0,0 +1,76 @@
+//===----------------------------------------------------------------------===//
+//
+// This file is part of the Noxoscope project
+//
+// Copyright (c) 2016 Niklas Helmertz
+//
+//===----------------------------------------------------------------------===//
+
+#include "TestShared.h"
+
+#include <vector>
+#include <unordered_set>
+
+#include <Meshlets.h>
+#include <Mesh.h>
+
+// Indexed grid in the xz plane, facing up
+static void makeGrid(int size, std::vector<Vertex>* vertices, std::vector<GLuint>* indices) {
+	for (int z = 0; z <= size; z++) {
+		for (int x = 0; x <= size; x++) {
+			Vertex vertex = {};
+			vertex.position = glm::vec3(x, 0.0f, z);
+			vertices->push_back(vertex);
+		}
+	}
+	for (int z = 0; z < size; z++) {
+		for (int x = 0; x < size; x++) {
+			GLuint i = z * (size + 1) + x;
+			indices->insert(indices->end(), {i, i + size + 1, i + 1, i + 1, i + size + 1, i + size + 2});
+		}
+	}
+}
+
+TEST_CASE("Meshlets cover every triangle in order within their limits") {
+	rc::prop("", []() {
+		int size = *rc::gen::inRange(1, 40);
+		std::vector<Vertex> vertices;
+		std::vector<GLuint> indices;
+		makeGrid(size, &vertices, &indices);
+
+		std::vector<Meshlet> meshlets;
+		buildMeshlets(vertices.data(), indices.data(), indices.size(), &meshlets);
+
+		size_t next = 0;
+		for (auto& meshlet : meshlets) {
+			RC_ASSERT(meshlet.firstIndex == next);
+			RC_ASSERT(meshlet.indexCount > 0);
+			RC_ASSERT(meshlet.indexCount / 3 <= MESHLET_MAX_TRIANGLES);
+			next += meshlet.indexCount;
+
+			std::unordered_set<GLuint> used(indices.begin() + meshlet.firstIndex, indices.begin() + next);
+			RC_ASSERT(used.size() <= MESHLET_MAX_VERTICES);
+			for (auto index : used) {
+				RC_ASSERT(glm::distance(vertices[index].position, meshlet.center) <= meshlet.radius + 1e-4f);
+			}
+		}
+		RC_ASSERT(next == indices.size());
+	});
+}
+
+TEST_CASE("Flat meshlets are backfacing only from behind") {
+	rc::prop("", []() {
+		std::vector<Vertex> vertices;
+		std::vector<GLuint> indices;
+		makeGrid(4, &vertices, &indices);
+		std::vector<Meshlet> meshlets;
+		buildMeshlets(vertices.data(), indices.data(), indices.size(), &meshlets);
+		RC_ASSERT(meshlets.size() == 1u);
+
+		glm::vec3 camera(floatInRange(-50.0f, 50.0f), floatInRange(0.01f, 50.0f), floatInRange(-50.0f, 50.0f));
+		RC_ASSERT(!meshletBackfacing(meshlets[0], camera));
+		// The bounding sphere makes the test conservative close to the plane
+		camera.y = -camera.y - meshlets[0].radius;
+		RC_ASSERT(meshletBackfacing(meshlets[0], camera));
+	});
+}
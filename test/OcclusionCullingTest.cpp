@@ -0,0 +1,195 @@
+//===----------------------------------------------------------------------===//
+//
+// This file is part of the Noxoscope project
+//
+// Copyright (c) 2016 Niklas Helmertz
+//
+//===----------------------------------------------------------------------===//
+
+#include "TestShared.h"
+
+#include <vector>
+#include <cmath>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <OcclusionCulling.h>
+#include <MeshSimplifier.h>
+#include <ThreadPool.h>
+
+// Triangles in normalized device coordinates, for an identity view projection
+static OccluderMesh randomOccluder() {
+	OccluderMesh occluder;
+	auto count = *rc::gen::inRange<size_t>(1, 12);
+	for (size_t i = 0; i < count * 3; i++) {
+		occluder.vertices.emplace_back(floatInRange(-1.5f, 1.5f), floatInRange(-1.5f, 1.5f), floatInRange(-0.9f, 0.9f));
+		occluder.indices.push_back(static_cast<uint32_t>(i));
+	}
+	return occluder;
+}
+
+static double edge(glm::dvec2 a, glm::dvec2 b, glm::dvec2 p) {
+	return (b.x - a.x) * (p.y - a.y) - (b.y - a.y) * (p.x - a.x);
+}
+
+TEST_CASE("Occluder depth matches the nearest triangle at pixel centers") {
+	using namespace glm;
+	rc::prop("", []() {
+		OcclusionBuffer buffer(64, 32);
+		buffer.begin(mat4(1.0f));
+		auto occluder = randomOccluder();
+		buffer.addOccluder(mat4(1.0f), occluder);
+		buffer.rasterize(nullptr);
+
+		for (int y = 0; y < 32; y++) {
+			for (int x = 0; x < 64; x++) {
+				dvec2 p(x + 0.5, y + 0.5);
+				double expected = 1.0;
+				bool nearEdge = false;
+				for (size_t i = 0; i < occluder.vertices.size(); i += 3) {
+					dvec3 v[3];
+					for (int k = 0; k < 3; k++) {
+						auto& vertex = occluder.vertices[i + k];
+						v[k] = dvec3((vertex.x * 0.5 + 0.5) * 64, (vertex.y * 0.5 + 0.5) * 32, vertex.z);
+					}
+					double area = edge(dvec2(v[0]), dvec2(v[1]), dvec2(v[2]));
+					if (std::abs(area) < 1e-3) {
+						continue;
+					}
+					double w0 = edge(dvec2(v[1]), dvec2(v[2]), p) / area;
+					double w1 = edge(dvec2(v[2]), dvec2(v[0]), p) / area;
+					double w2 = edge(dvec2(v[0]), dvec2(v[1]), p) / area;
+					// Rounding decides coverage on the edges themselves
+					if (std::min({std::abs(w0), std::abs(w1), std::abs(w2)}) < 1e-3) {
+						nearEdge = true;
+					} else if (w0 > 0 && w1 > 0 && w2 > 0) {
+						expected = std::min(expected, w0 * v[0].z + w1 * v[1].z + w2 * v[2].z);
+					}
+				}
+				if (!nearEdge) {
+					RC_ASSERT(std::abs(buffer.depth(x, y) - expected) < 1e-3);
+				}
+			}
+		}
+	});
+}
+
+TEST_CASE("Rasterizing on several threads gives the same depths") {
+	using namespace glm;
+	ThreadPool pool(3);
+	rc::prop("", [&pool]() {
+		auto occluder = randomOccluder();
+		OcclusionBuffer single;
+		OcclusionBuffer threaded;
+		for (auto buffer : {&single, &threaded}) {
+			buffer->begin(mat4(1.0f));
+			buffer->addOccluder(mat4(1.0f), occluder);
+		}
+		single.rasterize(nullptr);
+		threaded.rasterize(&pool);
+		for (int y = 0; y < OCCLUSION_HEIGHT; y++) {
+			for (int x = 0; x < OCCLUSION_WIDTH; x++) {
+				RC_ASSERT(single.depth(x, y) == threaded.depth(x, y));
+			}
+		}
+	});
+}
+
+TEST_CASE("Boxes in front of every occluder are visible") {
+	using namespace glm;
+	rc::prop("", []() {
+		OcclusionBuffer buffer;
+		buffer.begin(mat4(1.0f));
+		auto occluder = randomOccluder();
+		buffer.addOccluder(mat4(1.0f), occluder);
+		buffer.rasterize(nullptr);
+
+		vec3 boxMin(floatInRange(-1.0f, 0.9f), floatInRange(-1.0f, 0.9f), -0.95f);
+		vec3 boxMax = boxMin + vec3(floatInRange(0.01f, 0.1f), floatInRange(0.01f, 0.1f), 0.0f);
+		RC_ASSERT(buffer.boxVisible(boxMin, boxMax));
+	});
+}
+
+TEST_CASE("Walls hide boxes behind them") {
+	using namespace glm;
+	mat4 viewProjection = testProjection(0.2f, 100.0f) *
+		lookAt(vec3(0.0f), vec3(0.0f, 0.0f, -1.0f), vec3(0.0f, 1.0f, 0.0f));
+	OccluderMesh wall;
+	wall.vertices = {vec3(-1.0f, -1.0f, 0.0f), vec3(1.0f, -1.0f, 0.0f), vec3(1.0f, 1.0f, 0.0f), vec3(-1.0f, 1.0f, 0.0f)};
+	wall.indices = {0, 1, 2, 0, 2, 3};
+
+	OcclusionBuffer buffer;
+	buffer.begin(viewProjection);
+	// A wall in front of the camera, and one that crosses the near plane on the side
+	buffer.addOccluder(translate(mat4(1.0f), vec3(0.0f, 0.0f, -5.0f)) * scale(mat4(1.0f), vec3(4.0f)), wall);
+	buffer.addOccluder(translate(mat4(1.0f), vec3(-3.0f, 0.0f, 0.0f)) * rotate(mat4(1.0f), radians(90.0f), vec3(0.0f, 1.0f, 0.0f)) * scale(mat4(1.0f), vec3(10.0f)), wall);
+	buffer.rasterize(nullptr);
+	REQUIRE(buffer.triangleCount() > 2);
+
+	// Behind the front wall
+	REQUIRE_FALSE(buffer.boxVisible(vec3(-1.0f, -1.0f, -12.0f), vec3(1.0f, 1.0f, -10.0f)));
+	// In front of it
+	REQUIRE(buffer.boxVisible(vec3(-1.0f, -1.0f, -4.0f), vec3(1.0f, 1.0f, -3.0f)));
+	// Beside it, where it does not reach
+	REQUIRE(buffer.boxVisible(vec3(11.0f, -1.0f, -12.0f), vec3(12.0f, 1.0f, -10.0f)));
+	// Behind the side wall
+	REQUIRE_FALSE(buffer.boxVisible(vec3(-9.0f, -1.0f, -3.0f), vec3(-8.0f, 1.0f, -2.0f)));
+	// Crossing the near plane
+	REQUIRE(buffer.boxVisible(vec3(-1.0f), vec3(1.0f)));
+}
+
+TEST_CASE("Occluders of meshes never hide their own surface") {
+	using namespace glm;
+	rc::prop("", []() {
+		// A bumpy height field over the screen, seen straight along z with an
+		// identity view projection, so no part of it is behind another
+		const int size = 16;
+		std::vector<Vertex> vertices;
+		for (int y = 0; y <= size; y++) {
+			for (int x = 0; x <= size; x++) {
+				Vertex vertex = {};
+				vertex.position = vec3(x * 2.0f / size - 1.0f, y * 2.0f / size - 1.0f, floatInRange(-0.5f, 0.5f));
+				vertex.normal = vec3(0.0f, 0.0f, -1.0f);
+				vertices.push_back(vertex);
+			}
+		}
+		std::vector<GLuint> indices;
+		auto index = [](int x, int y) {
+			return static_cast<GLuint>(y * (size + 1) + x);
+		};
+		for (int y = 0; y < size; y++) {
+			for (int x = 0; x < size; x++) {
+				indices.insert(indices.end(), {index(x, y), index(x + 1, y), index(x, y + 1)});
+				indices.insert(indices.end(), {index(x + 1, y), index(x + 1, y + 1), index(x, y + 1)});
+			}
+		}
+		std::vector<MeshLod> lods = {{0, indices.size(), 0.0f}};
+		generateLods(vertices, &indices, &lods);
+
+		// The level Model::createMeshes builds occluders from
+		auto& lod = lods[0];
+		auto occluder = buildOccluder(vertices.data(), indices.data() + lod.firstIndex, lod.indexCount);
+		OcclusionBuffer buffer(64, 32);
+		buffer.begin(mat4(1.0f));
+		buffer.addOccluder(mat4(1.0f), occluder);
+		buffer.rasterize(nullptr);
+
+		// Points of the surface at pixel centers, moved slightly towards the camera
+		for (int py = 0; py < 32; py++) {
+			for (int px = 0; px < 64; px++) {
+				vec2 p((px + 0.5f) / 64.0f * size, (py + 0.5f) / 32.0f * size);
+				auto x = static_cast<int>(p.x);
+				auto y = static_cast<int>(p.y);
+				float fx = p.x - x;
+				float fy = p.y - y;
+				float a = vertices[index(x, y)].position.z;
+				float b = vertices[index(x + 1, y)].position.z;
+				float c = vertices[index(x, y + 1)].position.z;
+				float d = vertices[index(x + 1, y + 1)].position.z;
+				float z = fx + fy <= 1.0f ? a + fx * (b - a) + fy * (c - a) : d + (1.0f - fx) * (c - d) + (1.0f - fy) * (b - d);
+				vec3 point(p.x * 2.0f / size - 1.0f, p.y * 2.0f / size - 1.0f, z - 1e-3f);
+				RC_ASSERT(buffer.boxVisible(point, point));
+			}
+		}
+	});
+}
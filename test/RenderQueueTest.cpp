@@ -0,0 +1,53 @@
+//===----------------------------------------------------------------------===//
+//
+// This file is part of the Noxoscope project
+//
+// Copyright (c) 2016 Niklas Helmertz
+//
+//===----------------------------------------------------------------------===//
+
+#include "TestShared.h"
+
+#include <vector>
+#include <algorithm>
+
+#include <RenderQueue.h>
+
+TEST_CASE("Radix sort orders draw items like a stable sort") {
+	rc::prop("", []() {
+		auto keys = *rc::gen::container<std::vector<uint64_t>>(rc::gen::oneOf(
+			rc::gen::arbitrary<uint64_t>(),
+			rc::gen::map(rc::gen::inRange<uint32_t>(0, 16), [](uint32_t depth) {
+				return makeSortKey(RENDER_PASS_OPAQUE, 3, 7, 1, depth);
+			})));
+
+		std::vector<DrawItem> items;
+		for (size_t i = 0; i < keys.size(); i++) {
+			items.push_back({keys[i], nullptr, static_cast<uint32_t>(i)});
+		}
+		auto expected = items;
+		std::stable_sort(expected.begin(), expected.end(), [](const DrawItem& a, const DrawItem& b) {
+			return a.key < b.key;
+		});
+
+		std::vector<DrawItem> scratch(items.size());
+		radixSort(items.data(), scratch.data(), items.size());
+		for (size_t i = 0; i < items.size(); i++) {
+			RC_ASSERT(items[i].key == expected[i].key);
+			RC_ASSERT(items[i].mesh == expected[i].mesh);
+		}
+	});
+}
+
+TEST_CASE("Sort keys order by pass, program, textures, material and depth") {
+	auto key = makeSortKey(1, 2, 3, 4, 5);
+	REQUIRE(key < makeSortKey(2, 0, 0, 0, 0));
+	REQUIRE(key < makeSortKey(1, 3, 0, 0, 0));
+	REQUIRE(key < makeSortKey(1, 2, 4, 0, 0));
+	REQUIRE(key < makeSortKey(1, 2, 3, 5, 0));
+	REQUIRE(key < makeSortKey(1, 2, 3, 4, 6));
+
+	REQUIRE(sortKeyDepth(0.0f, 100.0f) == 0);
+	REQUIRE(sortKeyDepth(1.0f, 100.0f) < sortKeyDepth(2.0f, 100.0f));
+	REQUIRE(sortKeyDepth(1000.0f, 100.0f) == (1u << SORT_KEY_DEPTH_BITS) - 1);
+}
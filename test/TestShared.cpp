@@ -8,6 +8,8 @@
 
 #include "TestShared.h"
 
+#include <glm/gtc/matrix_transform.hpp>
+
 bool approxEqual(float a, float b) {
 	return a == Approx(b);
 }
@@ -19,3 +21,15 @@ float floor0(float x) {
 float floatInRange(float a, float b) {
 	return *rc::gen::inRange(int(floor0(a * 100.0f)), int(floor0(b * 100.0f))) / 100.0f;
 }
+
+glm::vec3 randomPoint(float range) {
+	return glm::vec3(floatInRange(-range, range), floatInRange(-range, range), floatInRange(-range, range));
+}
+
+glm::mat4 testProjection(float near, float far) {
+	return glm::perspective(glm::radians(70.0f), 16.0f / 9.0f, near, far);
+}
+
+glm::mat4 randomView(float range, float distance) {
+	return glm::lookAt(randomPoint(range), randomPoint(range) + glm::vec3(0.0f, 0.0f, distance), glm::vec3(0.0f, 1.0f, 0.0f));
+}
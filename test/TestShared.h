@@ -11,6 +11,7 @@
 
 #include <catch.hpp>
 #include <rapidcheck/catch.h>
+#include <glm/glm.hpp>
 
 bool approxEqual(float a, float b);
 
@@ -18,4 +19,15 @@ float floor0(float x);
 
 float floatInRange(float a, float b);
 
+/// Point with every coordinate in [-range, range].
+glm::vec3 randomPoint(float range);
+
+/// Perspective projection of the test cameras, with a vertical field of view
+/// of 70 degrees and a 16:9 aspect ratio.
+glm::mat4 testProjection(float near, float far);
+
+/// View from a random point within range of the origin, looking towards
+/// another one moved distance along z.
+glm::mat4 randomView(float range, float distance);
+
 #endif // TestShared_H
@@ -0,0 +1,151 @@
+//===----------------------------------------------------------------------===//
+//
+// This file is part of the Noxoscope project
+//
+// Copyright (c) 2016 Niklas Helmertz
+//
+//===----------------------------------------------------------------------===//
+
+#include "TestShared.h"
+
+#include <cstdlib>
+#include <algorithm>
+
+#include <TextureCompression.h>
+
+static int rgb565Channel(int value, int bits) {
+	return (value << (8 - bits)) | (value >> (2 * bits - 8));
+}
+
+// Reference decoder for BC1 blocks in four color mode
+static void decodeBC1Block(const unsigned char* block, unsigned char* rgba) {
+	int color0 = block[0] | block[1] << 8;
+	int color1 = block[2] | block[3] << 8;
+	uint32_t indices = block[4] | block[5] << 8 | block[6] << 16 | uint32_t(block[7]) << 24;
+
+	int endpoints[2][3];
+	for (int i = 0; i < 2; i++) {
+		int color = i == 0 ? color0 : color1;
+		endpoints[i][0] = rgb565Channel((color >> 11) & 31, 5);
+		endpoints[i][1] = rgb565Channel((color >> 5) & 63, 6);
+		endpoints[i][2] = rgb565Channel(color & 31, 5);
+	}
+
+	for (int i = 0; i < 16; i++) {
+		int index = (indices >> (2 * i)) & 3;
+		for (int c = 0; c < 3; c++) {
+			int e0 = endpoints[0][c];
+			int e1 = endpoints[1][c];
+			int palette[4] = {e0, e1, (2 * e0 + e1) / 3, (e0 + 2 * e1) / 3};
+			rgba[i * 4 + c] = static_cast<unsigned char>(palette[index]);
+		}
+		rgba[i * 4 + 3] = 255;
+	}
+}
+
+// Reference decoder for BC4 blocks
+static void decodeBC4Block(const unsigned char* block, unsigned char* values) {
+	int a0 = block[0];
+	int a1 = block[1];
+	int palette[8] = {a0, a1};
+	for (int j = 2; j < 8; j++) {
+		palette[j] = a0 > a1 ? ((8 - j) * a0 + (j - 1) * a1) / 7 : j < 6 ? ((6 - j) * a0 + (j - 1) * a1) / 5 : j == 6 ? 0 : 255;
+	}
+
+	uint64_t indices = 0;
+	for (int i = 0; i < 6; i++) {
+		indices |= uint64_t(block[2 + i]) << (8 * i);
+	}
+	for (int i = 0; i < 16; i++) {
+		values[i] = static_cast<unsigned char>(palette[(indices >> (3 * i)) & 7]);
+	}
+}
+
+TEST_CASE("BC1 blocks of a single color are decoded with quantization error only") {
+	rc::prop("", []() {
+		int color[3] = {*rc::gen::inRange(0, 256), *rc::gen::inRange(0, 256), *rc::gen::inRange(0, 256)};
+		unsigned char texels[16 * 4];
+		for (int i = 0; i < 16; i++) {
+			std::copy_n(color, 3, texels + i * 4);
+			texels[i * 4 + 3] = 255;
+		}
+
+		unsigned char block[8];
+		unsigned char decoded[16 * 4];
+		encodeBC1Block(texels, block);
+		decodeBC1Block(block, decoded);
+
+		for (int i = 0; i < 16; i++) {
+			RC_ASSERT(std::abs(decoded[i * 4] - color[0]) <= 4);
+			RC_ASSERT(std::abs(decoded[i * 4 + 1] - color[1]) <= 2);
+			RC_ASSERT(std::abs(decoded[i * 4 + 2] - color[2]) <= 4);
+		}
+	});
+}
+
+TEST_CASE("BC4 error is bounded by the palette spacing") {
+	rc::prop("", []() {
+		unsigned char values[16];
+		for (auto& value : values) {
+			value = static_cast<unsigned char>(*rc::gen::inRange(0, 256));
+		}
+		auto range = *std::max_element(values, values + 16) - *std::min_element(values, values + 16);
+
+		unsigned char block[8];
+		unsigned char decoded[16];
+		encodeBC4Block(values, 1, block);
+		decodeBC4Block(block, decoded);
+
+		for (int i = 0; i < 16; i++) {
+			RC_ASSERT(std::abs(decoded[i] - values[i]) <= range / 14 + 2);
+		}
+	});
+}
+
+TEST_CASE("Compressed textures have a complete mip chain") {
+	const int width = 13;
+	const int height = 7;
+	std::vector<unsigned char> rgba(width * height * 4, 128);
+
+	CompressedTexture texture;
+	compressTexture(rgba.data(), width, height, BlockFormat::BC3, &texture);
+
+	int expectedSizes[][2] = {{13, 7}, {6, 3}, {3, 1}, {1, 1}};
+	REQUIRE(texture.levels.size() == 4);
+	for (size_t i = 0; i < texture.levels.size(); i++) {
+		auto& level = texture.levels[i];
+		REQUIRE(level.width == expectedSizes[i][0]);
+		REQUIRE(level.height == expectedSizes[i][1]);
+		REQUIRE(level.size == levelSize(BlockFormat::BC3, level.width, level.height));
+	}
+	REQUIRE(levelSize(BlockFormat::BC3, 13, 7) == 4 * 2 * 16);
+	REQUIRE(texture.byteSize() == texture.storage.size());
+}
+
+TEST_CASE("Resized images stay within the range of the source texels") {
+	rc::prop("", []() {
+		int width = *rc::gen::inRange(1, 20);
+		int height = *rc::gen::inRange(1, 20);
+		int newWidth = *rc::gen::inRange(1, 40);
+		int newHeight = *rc::gen::inRange(1, 40);
+		auto texels = *rc::gen::container<std::vector<unsigned char>>(size_t(width) * height * 4, rc::gen::arbitrary<unsigned char>());
+
+		auto resized = resizeRgba(texels.data(), width, height, newWidth, newHeight);
+		RC_ASSERT(resized.size() == size_t(newWidth) * newHeight * 4);
+		for (int c = 0; c < 4; c++) {
+			int low = 255;
+			int high = 0;
+			for (size_t i = c; i < texels.size(); i += 4) {
+				low = std::min<int>(low, texels[i]);
+				high = std::max<int>(high, texels[i]);
+			}
+			for (size_t i = c; i < resized.size(); i += 4) {
+				RC_ASSERT(resized[i] >= low);
+				RC_ASSERT(resized[i] <= high);
+			}
+		}
+	});
+	REQUIRE(nextPowerOfTwo(1) == 1);
+	REQUIRE(nextPowerOfTwo(300) == 512);
+	REQUIRE(nextPowerOfTwo(512) == 512);
+}
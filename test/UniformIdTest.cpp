@@ -0,0 +1,42 @@
+//===----------------------------------------------------------------------===//
+//
+// This file is part of the Noxoscope project
+//
+// Copyright (c) 2016 Niklas Helmertz
+//
+//===----------------------------------------------------------------------===//
+
+#include "TestShared.h"
+
+#include <map>
+#include <string>
+
+#include <UniformId.h>
+
+TEST_CASE("Uniform ids are hashed at compile time") {
+	constexpr UniformId id{"modelMatrix"};
+	static_assert(id.hash == hashString("modelMatrix"), "Hash differs from hashString");
+	REQUIRE(UniformId("modelMatrix").hash == id.hash);
+}
+
+TEST_CASE("Uniform table finds every inserted location") {
+	rc::prop("", []() {
+		auto locations = *rc::gen::container<std::map<std::string, GLint>>(
+			rc::gen::nonEmpty<std::string>(), rc::gen::inRange<GLint>(0, 1000));
+		auto missing = *rc::gen::arbitrary<std::string>();
+
+		UniformTable table;
+		// Reserve less room than needed, so that the table has to grow
+		table.reset(locations.size() / 2);
+		for (auto& entry : locations) {
+			RC_ASSERT(table.insert(UniformId(entry.first.c_str()), entry.second));
+		}
+		RC_ASSERT(table.size() == locations.size());
+		for (auto& entry : locations) {
+			RC_ASSERT(table[UniformId(entry.first.c_str())] == entry.second);
+		}
+		if (locations.count(missing) == 0) {
+			RC_ASSERT(table[UniformId(missing.c_str())] == -1);
+		}
+	});
+}
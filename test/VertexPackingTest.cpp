@@ -0,0 +1,54 @@
+//===----------------------------------------------------------------------===//
+//
+// This file is part of the Noxoscope project
+//
+// Copyright (c) 2016 Niklas Helmertz
+//
+//===----------------------------------------------------------------------===//
+
+#include "TestShared.h"
+
+#include <cmath>
+#include <vector>
+
+#include <VertexPacking.h>
+
+static glm::vec3 genUnitVector() {
+	glm::vec3 v(*rc::gen::inRange(-1000, 1001), *rc::gen::inRange(-1000, 1001), *rc::gen::inRange(-1000, 1001));
+	float l = glm::length(v);
+	return l > 0.0f ? v / l : glm::vec3(0.0f, 0.0f, 1.0f);
+}
+
+TEST_CASE("Octahedral encoding roundtrips unit vectors") {
+	rc::prop("", []() {
+		auto v = genUnitVector();
+		auto decoded = octahedralDecode(octahedralEncode(v));
+		RC_ASSERT(glm::dot(v, decoded) > 0.99999f);
+	});
+}
+
+TEST_CASE("Packed vertices keep positions within the mesh bounds and the tangent frame") {
+	rc::prop("", []() {
+		std::vector<Vertex> vertices(*rc::gen::inRange(1, 20));
+		for (auto& vertex : vertices) {
+			vertex.position = glm::vec3(*rc::gen::inRange(-5000, 5000), *rc::gen::inRange(-5000, 5000), *rc::gen::inRange(-5000, 5000)) / 100.0f;
+			vertex.normal = genUnitVector();
+			auto axis = std::abs(vertex.normal.x) < 0.5f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+			vertex.tangent = glm::normalize(glm::cross(vertex.normal, axis));
+			float sign = *rc::gen::element(-1.0f, 1.0f);
+			vertex.bitangent = sign * glm::cross(vertex.normal, vertex.tangent);
+			vertex.texCoords = glm::vec2(*rc::gen::inRange(-400, 400), *rc::gen::inRange(-400, 400)) / 100.0f;
+		}
+
+		auto quantization = positionQuantization(vertices.data(), vertices.size());
+		for (auto& vertex : vertices) {
+			auto unpacked = unpackVertex(packVertex(vertex, quantization), quantization);
+			auto tolerance = quantization.scale / 65535.0f + 1e-4f;
+			RC_ASSERT(glm::all(glm::lessThanEqual(glm::abs(unpacked.position - vertex.position), tolerance)));
+			RC_ASSERT(glm::dot(unpacked.normal, vertex.normal) > 0.9999f);
+			RC_ASSERT(glm::dot(unpacked.tangent, vertex.tangent) > 0.9999f);
+			RC_ASSERT(glm::dot(unpacked.bitangent, vertex.bitangent) > 0.999f);
+			RC_ASSERT(glm::all(glm::lessThanEqual(glm::abs(unpacked.texCoords - vertex.texCoords), glm::vec2(4e-3f))));
+		}
+	});
+}